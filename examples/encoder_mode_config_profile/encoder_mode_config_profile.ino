@@ -0,0 +1,90 @@
+/**
+ * @~Chinese
+ * @file encoder_mode_config_profile.ino
+ * @brief 示例：从EEPROM（AVR）或NVS（ESP32）载入配置文件并以差异方式应用，然后以±100 RPM交替驱动电机。
+ * @example encoder_mode_config_profile.ino
+ * 从EEPROM（AVR）或NVS（ESP32）载入配置文件并以差异方式应用，然后以±100 RPM交替驱动电机。首次运行时存储中没有有效的配置文件，
+ * 将创建默认配置文件并保存。
+ */
+/**
+ * @~English
+ * @file encoder_mode_config_profile.ino
+ * @brief Example: Load a configuration profile from the EEPROM (AVR) or NVS (ESP32), apply it as a diff, then drive the motors at ±100 RPM
+ * alternately.
+ * @example encoder_mode_config_profile.ino
+ * Load a configuration profile from the EEPROM (AVR) or NVS (ESP32), apply it as a diff, then drive the motors at ±100 RPM alternately. On the
+ * first run the store holds no valid profile, so a default one is created and saved.
+ */
+
+#include <Wire.h>
+
+#include "md40.h"
+#include "md40_config_store.h"
+
+namespace {
+constexpr uint16_t kEncoderPpr = 12;
+constexpr uint16_t kReductionRatio = 90;
+
+em::Md40 g_md40(em::Md40::kDefaultI2cAddress, Wire);
+
+#if defined(ARDUINO_ARCH_ESP32)
+em::NvsConfigStore g_store;
+#elif defined(ARDUINO_ARCH_AVR)
+em::EepromConfigStore g_store;
+#else
+#error "This example needs the EEPROM of an AVR or the NVS of an ESP32"
+#endif
+
+uint64_t g_trigger_time = 0;
+int32_t g_target_speed = 100;
+
+em::Md40::ConfigProfile DefaultConfigProfile() {
+  em::Md40::Motor::PidGains gains;
+  gains.speed_p = 1.5;
+  gains.speed_i = 1.5;
+  gains.speed_d = 1.0;
+  gains.position_p = 10.0;
+  gains.position_i = 1.0;
+  gains.position_d = 1.0;
+
+  em::Md40::ConfigProfile profile;
+  for (uint8_t i = 0; i < em::Md40::kMotorNum; i++) {
+    profile.SetEncoderMode(i, kEncoderPpr, kReductionRatio, em::Md40::Motor::PhaseRelation::kAPhaseLeads);
+    profile.SetPidGains(i, gains);
+  }
+  return profile;
+}
+}  // namespace
+
+void setup() {
+  Serial.begin(115200);
+
+  Wire.begin();
+
+  g_md40.Init();
+
+  em::Md40::ConfigProfile profile;
+  if (!profile.Load(g_store)) {
+    Serial.println(F("No valid profile stored, saving the default one"));
+    profile = DefaultConfigProfile();
+    profile.Save(g_store);
+  }
+
+  const uint32_t start_time = micros();
+  const em::Md40::Status status = g_md40.ApplyConfigProfile(profile);
+  Serial.print(F("Apply status: "));
+  Serial.print(static_cast<uint8_t>(status));
+  Serial.print(F(", took "));
+  Serial.print(micros() - start_time);
+  Serial.println(F(" us"));
+}
+
+void loop() {
+  if (g_trigger_time == 0 || millis() - g_trigger_time > 2000) {
+    g_trigger_time = millis();
+    for (uint8_t i = 0; i < em::Md40::kMotorNum; i++) {
+      g_md40[i].RunSpeed(g_target_speed);
+    }
+    g_target_speed = -g_target_speed;
+  }
+}
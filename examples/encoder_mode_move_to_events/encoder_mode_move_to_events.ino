@@ -0,0 +1,72 @@
+/**
+ * @~Chinese
+ * @file encoder_mode_move_to_events.ino
+ * @brief 示例：使用编码器模式和事件分发器，四个电机每到达目标位置就立即反向移动，不需要反复查询状态。
+ * @example encoder_mode_move_to_events.ino
+ * 使用编码器模式，四个电机以60 RPM速度在绝对位置0和720之间往返。每个电机订阅“任意状态 → kReachedPosition ”事件，
+ * 回调函数打印到达的位置并立即发出下一次移动命令；分发器只在有电机运动时频繁轮询。
+ */
+/**
+ * @~English
+ * @file encoder_mode_move_to_events.ino
+ * @brief Example: Using encoder mode and the event dispatcher, four motors turn back as soon as they reach their target, without polling the
+ * state by hand.
+ * @example encoder_mode_move_to_events.ino
+ * Using encoder mode, four motors shuttle between absolute positions 0 and 720 at 60 RPM. Every motor subscribes to the any state →
+ * kReachedPosition event, and the callback prints the position reached and sends the next move at once. The dispatcher only polls often while a
+ * motor is moving.
+ */
+
+#include <Wire.h>
+
+#include "md40_event_dispatcher.h"
+
+namespace {
+constexpr int32_t kMotorSpeed = 60;
+constexpr uint16_t kEncoderPpr = 12;
+constexpr uint16_t kReductionRatio = 90;
+
+em::Md40 g_md40(em::Md40::kDefaultI2cAddress, Wire);
+
+em::Md40EventDispatcher<> g_dispatcher(g_md40);
+
+int32_t g_target_positions[em::Md40::kMotorNum] = {720, 720, 720, 720};
+
+void OnReached(void *context, uint8_t index, em::Md40::Motor::State from, em::Md40::Motor::State to) {
+  (void)context;
+  (void)from;
+  (void)to;
+
+  Serial.print(F("Motor "));
+  Serial.print(index);
+  Serial.print(F(" reached "));
+  Serial.println(g_target_positions[index]);
+
+  g_target_positions[index] = g_target_positions[index] == 0 ? 720 : 0;
+  g_md40[index].MoveTo(g_target_positions[index], kMotorSpeed);
+}
+}  // namespace
+
+void setup() {
+  Serial.begin(115200);
+
+  Wire.begin();
+
+  g_md40.Init();
+
+  for (uint8_t i = 0; i < em::Md40::kMotorNum; i++) {
+    g_md40[i].SetEncoderMode(kEncoderPpr, kReductionRatio, em::Md40::Motor::PhaseRelation::kAPhaseLeads);
+    g_dispatcher.Subscribe(i, em::Md40::Motor::State::kReachedPosition, OnReached);
+  }
+
+  // Poll once to take the baseline before the moves start.
+  g_dispatcher.Poll();
+
+  for (uint8_t i = 0; i < em::Md40::kMotorNum; i++) {
+    g_md40[i].MoveTo(g_target_positions[i], kMotorSpeed);
+  }
+}
+
+void loop() {
+  g_dispatcher.Poll();
+}
@@ -0,0 +1,74 @@
+/**
+ * @~Chinese
+ * @file encoder_mode_pid_autotune.ino
+ * @brief 示例：编码器模式下，用继电反馈自整定速度环的PID参数。
+ * @example encoder_mode_pid_autotune.ino
+ * 编码器模式下，用继电反馈自整定速度环的PID参数。
+ */
+/**
+ * @~English
+ * @file encoder_mode_pid_autotune.ino
+ * @brief Example: Autotune the speed loop PID gains with relay feedback in encoder mode.
+ * @example encoder_mode_pid_autotune.ino
+ * Autotune the speed loop PID gains with relay feedback in encoder mode.
+ */
+
+#include <Wire.h>
+
+#include "md40.h"
+#include "md40_autotuner.h"
+
+namespace {
+em::Md40 g_md40(em::Md40::kDefaultI2cAddress, Wire);
+em::Md40Autotuner g_autotuner(g_md40);
+bool g_reported = false;
+}  // namespace
+
+void setup() {
+  Serial.begin(115200);
+
+  Wire.begin();
+
+  g_md40.Init();
+
+  g_md40[0].SetEncoderMode(12, 90, em::Md40::Motor::PhaseRelation::kAPhaseLeads);
+
+  em::Md40Autotuner::Config config;
+  config.loop = em::Md40Autotuner::Loop::kSpeed;
+  config.rule = em::Md40Autotuner::Rule::kTyreusLuyben;
+  config.setpoint = 100;
+  config.relay_amplitude = 300;
+  g_autotuner.Begin(0, config);
+}
+
+void loop() {
+  g_autotuner.Step();
+
+  if (g_reported || (g_autotuner.phase() != em::Md40Autotuner::Phase::kDone && g_autotuner.phase() != em::Md40Autotuner::Phase::kFailed)) {
+    return;
+  }
+  g_reported = true;
+
+  if (g_autotuner.phase() == em::Md40Autotuner::Phase::kFailed) {
+    Serial.println(F("Autotune failed"));
+    return;
+  }
+
+  const em::Md40Autotuner::Result &result = g_autotuner.result();
+  Serial.print(F("Ku: "));
+  Serial.print(result.ultimate_gain);
+  Serial.print(F(", Pu: "));
+  Serial.print(result.ultimate_period_us);
+  Serial.println(F(" us"));
+  Serial.print(F("P: "));
+  Serial.print(result.p);
+  Serial.print(F(", I: "));
+  Serial.print(result.i);
+  Serial.print(F(", D: "));
+  Serial.println(result.d);
+  Serial.print(F("Settling time predicted: "));
+  Serial.print(result.predicted_settling_us);
+  Serial.print(F(" us, measured: "));
+  Serial.print(result.measured_settling_us);
+  Serial.println(F(" us"));
+}
@@ -0,0 +1,85 @@
+/**
+ * @~Chinese
+ * @file encoder_mode_profile_move.ino
+ * @brief 示例：使用编码器模式，按S形速度曲线让四个电机来回转动两圈，并打印跟踪误差。
+ * @example encoder_mode_profile_move.ino
+ * 使用编码器模式，按S形速度曲线（最大速度60 RPM）让四个电机来回转动两圈。速度设定值以100 Hz发送，最后用 MoveTo 精确停到目标位置，
+ * 每次运动结束后打印最大跟踪误差和提交的命令数。
+ */
+/**
+ * @~English
+ * @file encoder_mode_profile_move.ino
+ * @brief Example: Using encoder mode, turn four motors two revolutions back and forth along an S-curve velocity profile and print the tracking
+ * error.
+ * @example encoder_mode_profile_move.ino
+ * Using encoder mode, turn four motors two revolutions back and forth along an S-curve velocity profile (maximum speed 60 RPM). Speed setpoints
+ * are sent at 100 Hz and MoveTo lands exactly on the target, after every move the largest tracking error and the number of submitted commands
+ * are printed.
+ */
+
+#include <Wire.h>
+
+#include "md40_profile.h"
+
+namespace {
+constexpr uint16_t kEncoderPpr = 12;
+constexpr uint16_t kReductionRatio = 90;
+
+// Degrees, degrees per second, degrees per second squared and cubed: 60 RPM is 360 degrees per second.
+constexpr float kDistance = 720;
+constexpr float kMaxSpeed = 360;
+constexpr float kMaxAcceleration = 720;
+constexpr float kMaxJerk = 2880;
+
+em::Md40 g_md40(em::Md40::kDefaultI2cAddress, Wire);
+
+em::Md40ProfileStreamer g_streamers[em::Md40::kMotorNum] = {
+    em::Md40ProfileStreamer(g_md40, 0),
+    em::Md40ProfileStreamer(g_md40, 1),
+    em::Md40ProfileStreamer(g_md40, 2),
+    em::Md40ProfileStreamer(g_md40, 3),
+};
+
+em::VelocityProfile g_profile = em::VelocityProfile::SCurve(kDistance, kMaxSpeed, kMaxAcceleration, kMaxJerk);
+}  // namespace
+
+void setup() {
+  Serial.begin(115200);
+
+  Wire.begin();
+
+  g_md40.Init();
+
+  for (uint8_t i = 0; i < em::Md40::kMotorNum; i++) {
+    g_md40[i].SetEncoderMode(kEncoderPpr, kReductionRatio, em::Md40::Motor::PhaseRelation::kAPhaseLeads);
+    g_streamers[i].Start(g_profile);
+  }
+}
+
+void loop() {
+  bool done = true;
+  for (auto &streamer : g_streamers) {
+    streamer.Poll();
+    done = done && streamer.phase() == em::Md40ProfileStreamer::Phase::kDone;
+  }
+
+  if (!done) {
+    return;
+  }
+
+  for (uint8_t i = 0; i < em::Md40::kMotorNum; i++) {
+    Serial.print(F("Motor "));
+    Serial.print(i);
+    Serial.print(F(" position: "));
+    Serial.print(g_md40[i].position());
+    Serial.print(F(", max tracking error: "));
+    Serial.print(g_streamers[i].max_tracking_error());
+    Serial.print(F(", commands: "));
+    Serial.println(g_streamers[i].command_count());
+  }
+
+  g_profile = em::VelocityProfile::SCurve(-g_profile.distance(), kMaxSpeed, kMaxAcceleration, kMaxJerk);
+  for (auto &streamer : g_streamers) {
+    streamer.Start(g_profile);
+  }
+}
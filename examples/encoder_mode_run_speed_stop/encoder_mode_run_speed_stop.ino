@@ -92,33 +92,38 @@ void loop() {
   if (millis() - g_last_print_time > 200) {
     g_last_print_time = millis();
 
+    em::Md40::Motor::Snapshot snapshots[em::Md40::kMotorNum];
+    for (uint8_t i = 0; i < em::Md40::kMotorNum; i++) {
+      snapshots[i] = g_md40[i].ReadSnapshot();
+    }
+
     Serial.print(F("speeds: "));
     for (uint8_t i = 0; i < em::Md40::kMotorNum; i++) {
-      Serial.print(g_md40[i].speed());
+      Serial.print(snapshots[i].speed);
       Serial.print(F(", "));
     }
 
     Serial.print(F("pwm duties: "));
     for (uint8_t i = 0; i < em::Md40::kMotorNum; i++) {
-      Serial.print(g_md40[i].pwm_duty());
+      Serial.print(snapshots[i].pwm_duty);
       Serial.print(F(", "));
     }
 
     Serial.print(F("positions: "));
     for (uint8_t i = 0; i < em::Md40::kMotorNum; i++) {
-      Serial.print(g_md40[i].position());
+      Serial.print(snapshots[i].position);
       Serial.print(F(", "));
     }
 
     Serial.print(F("pulse counts: "));
     for (uint8_t i = 0; i < em::Md40::kMotorNum; i++) {
-      Serial.print(g_md40[i].pulse_count());
+      Serial.print(snapshots[i].pulse_count);
       Serial.print(F(", "));
     }
 
     Serial.print(F("states: "));
     for (uint8_t i = 0; i < em::Md40::kMotorNum; i++) {
-      Serial.print(static_cast<uint8_t>(g_md40[i].state()));
+      Serial.print(static_cast<uint8_t>(snapshots[i].state));
       if (i < em::Md40::kMotorNum - 1) {
         Serial.print(F(", "));
       }
@@ -0,0 +1,84 @@
+/**
+ * @~Chinese
+ * @file encoder_mode_sampler_log.ino
+ * @brief 示例：使用编码器模式，让四个电机以不同速度转动，按100 Hz采集运行数据并批量打印。
+ * @example encoder_mode_sampler_log.ino
+ * 使用编码器模式，让四个电机以不同速度转动。采样器以100 Hz采集所有电机的运行数据，loop() 每次批量取出样本并打印，
+ * 打印耗时不会影响采样时刻。每秒打印一次采样间隔抖动、跳过的周期数和丢弃的样本数。
+ */
+/**
+ * @~English
+ * @file encoder_mode_sampler_log.ino
+ * @brief Example: Using encoder mode, run four motors at different speeds, capture their runtime data at 100 Hz and print it in batches.
+ * @example encoder_mode_sampler_log.ino
+ * Using encoder mode, run four motors at different speeds. The sampler captures the runtime data of all motors at 100 Hz, and loop() takes the
+ * samples out in batches and prints them, so the time spent printing does not move the sampling instants. Once per second the sampling interval
+ * jitter, the number of skipped periods and the number of dropped samples are printed.
+ */
+
+#include <Wire.h>
+
+#include "md40_sampler.h"
+
+namespace {
+constexpr uint16_t kEncoderPpr = 12;
+constexpr uint16_t kReductionRatio = 90;
+constexpr uint32_t kSamplePeriodUs = 10000;
+// One sample holds the runtime data of all four motors, 64 bytes on AVR, so boards with 2 KB of SRAM such as the Uno and Nano get a shorter
+// buffer. loop() steps the sampler between printed lines, so a few samples are enough.
+#if defined(ARDUINO_ARCH_AVR)
+constexpr uint16_t kSampleCapacity = 4;
+#else
+constexpr uint16_t kSampleCapacity = 16;
+#endif
+
+em::Md40 g_md40(em::Md40::kDefaultI2cAddress, Wire);
+
+em::Md40Sampler<kSampleCapacity> g_sampler(g_md40, kSamplePeriodUs);
+
+em::Md40Sampler<kSampleCapacity>::Sample g_samples[4];
+
+uint32_t g_last_report_ms = 0;
+}  // namespace
+
+void setup() {
+  Serial.begin(115200);
+
+  Wire.begin();
+
+  g_md40.Init();
+
+  for (uint8_t i = 0; i < em::Md40::kMotorNum; i++) {
+    g_md40[i].SetEncoderMode(kEncoderPpr, kReductionRatio, em::Md40::Motor::PhaseRelation::kAPhaseLeads);
+    g_md40[i].RunSpeed(25 * (i + 1));
+  }
+}
+
+void loop() {
+  g_sampler.Step();
+
+  const uint16_t count = g_sampler.Drain(g_samples, sizeof(g_samples) / sizeof(g_samples[0]));
+  for (uint16_t i = 0; i < count; i++) {
+    Serial.print(g_samples[i].timestamp_us);
+    for (const auto &snapshot : g_samples[i].snapshots) {
+      Serial.print(F(", "));
+      Serial.print(snapshot.speed);
+      Serial.print(F(", "));
+      Serial.print(snapshot.position);
+    }
+    Serial.println();
+
+    // Printing is slow, step the sampler between lines so it keeps its period.
+    g_sampler.Step();
+  }
+
+  if (millis() - g_last_report_ms >= 1000) {
+    g_last_report_ms = millis();
+    Serial.print(F("max jitter us: "));
+    Serial.print(g_sampler.max_jitter_us());
+    Serial.print(F(", missed periods: "));
+    Serial.print(g_sampler.missed_period_count());
+    Serial.print(F(", dropped samples: "));
+    Serial.println(g_sampler.overflow_count());
+  }
+}
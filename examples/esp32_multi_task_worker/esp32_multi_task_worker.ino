@@ -0,0 +1,81 @@
+/**
+ * @~Chinese
+ * @file esp32_multi_task_worker.ino
+ * @brief 示例：在ESP32上使用后台总线工作者，一个任务改变电机速度，loop() 同时打印运行数据。
+ * @example esp32_multi_task_worker.ino
+ * 仅适用于ESP32。使用编码器模式，后台工作者独占I2C总线；一个FreeRTOS任务每两秒切换四个电机的速度，loop() 每200毫秒读取工作者发布的运行数据并打印，
+ * 两者都不会等待总线。在其他平台上编译为空程序。
+ */
+/**
+ * @~English
+ * @file esp32_multi_task_worker.ino
+ * @brief Example: On ESP32, use the background bus worker while one task changes motor speeds and loop() prints runtime data.
+ * @example esp32_multi_task_worker.ino
+ * ESP32 only. Using encoder mode, the background worker owns the I2C bus. A FreeRTOS task switches the speed of the four motors every two seconds
+ * and loop() reads the telemetry published by the worker every 200 milliseconds and prints it, neither of them ever waits for the bus. On other
+ * platforms it compiles to an empty sketch.
+ */
+
+#if defined(ARDUINO_ARCH_ESP32)
+#include <Wire.h>
+
+#include "md40_worker.h"
+
+namespace {
+constexpr uint16_t kEncoderPpr = 12;
+constexpr uint16_t kReductionRatio = 90;
+
+em::Md40 g_md40(em::Md40::kDefaultI2cAddress, Wire);
+
+em::Md40Worker<> g_worker(g_md40);
+
+void SpeedTask(void *) {
+  int32_t rpm = 50;
+  while (true) {
+    for (uint8_t i = 0; i < em::Md40::kMotorNum; i++) {
+      g_worker.RunSpeed(i, rpm);
+    }
+    rpm = -rpm;
+    vTaskDelay(pdMS_TO_TICKS(2000));
+  }
+}
+}  // namespace
+
+void setup() {
+  Serial.begin(115200);
+
+  Wire.begin();
+
+  g_md40.Init();
+
+  for (uint8_t i = 0; i < em::Md40::kMotorNum; i++) {
+    g_md40[i].SetEncoderMode(kEncoderPpr, kReductionRatio, em::Md40::Motor::PhaseRelation::kAPhaseLeads);
+  }
+
+  g_worker.Begin();
+
+  xTaskCreate(SpeedTask, "speed", 2048, nullptr, 1, nullptr);
+}
+
+void loop() {
+  em::Md40Worker<>::Telemetry telemetry;
+  if (g_worker.ReadTelemetry(telemetry)) {
+    for (uint8_t i = 0; i < em::Md40::kMotorNum; i++) {
+      Serial.print(F("Motor "));
+      Serial.print(i);
+      Serial.print(F(" speed: "));
+      Serial.print(telemetry.snapshots[i].speed);
+      Serial.print(F(", position: "));
+      Serial.println(telemetry.snapshots[i].position);
+    }
+  }
+
+  delay(200);
+}
+#else
+void setup() {
+}
+
+void loop() {
+}
+#endif
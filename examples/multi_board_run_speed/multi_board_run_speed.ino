@@ -0,0 +1,83 @@
+/**
+ * @~Chinese
+ * @file multi_board_run_speed.ino
+ * @brief 示例：使用 Md40Bus 把两个MD40模块（地址0x16和0x17）作为8个电机的电机池驱动，每2秒切换方向（速度值为±100）。
+ * @example multi_board_run_speed.ino
+ * 使用 Md40Bus 把两个MD40模块（地址0x16和0x17）作为8个电机的电机池驱动，每2秒切换方向（速度值为±100）。
+ * 命令以非阻塞方式提交，在每个周期读取运行数据时交替执行，并打印每个周期的耗时和可达到的更新频率。
+ */
+/**
+ * @~English
+ * @file multi_board_run_speed.ino
+ * @brief Example: Using Md40Bus, drive two MD40 modules (addresses 0x16 and 0x17) as a pool of 8 motors and switch direction every 2 seconds
+ * (with a speed value of ± 100).
+ * @example multi_board_run_speed.ino
+ * Using Md40Bus, drive two MD40 modules (addresses 0x16 and 0x17) as a pool of 8 motors and switch direction every 2 seconds (with a speed value
+ * of ± 100). Commands are submitted without blocking and executed in turn while every cycle reads the runtime data, the duration of each cycle and
+ * the achievable update rate are printed.
+ */
+
+#include <Wire.h>
+
+#include "md40_bus.h"
+
+namespace {
+constexpr uint16_t kEncoderPpr = 12;
+constexpr uint16_t kReductionRatio = 90;
+constexpr uint8_t kBoardNum = 2;
+
+em::Md40 g_md40_a(0x16, Wire);
+em::Md40 g_md40_b(0x17, Wire);
+em::Md40 *const g_boards[kBoardNum] = {&g_md40_a, &g_md40_b};
+em::Md40Bus<kBoardNum> g_md40_bus(g_boards);
+
+em::Md40::Motor::Snapshot g_snapshots[em::Md40Bus<kBoardNum>::kMotorNum];
+
+uint64_t g_last_print_time = 0;
+uint64_t g_trigger_time = 0;
+int32_t g_target_speed = 100;
+}  // namespace
+
+void setup() {
+  Serial.begin(115200);
+
+  Wire.begin();
+
+  g_md40_bus.Init();
+
+  for (uint8_t i = 0; i < em::Md40Bus<kBoardNum>::kMotorNum; i++) {
+    g_md40_bus[i].SubmitEncoderMode(kEncoderPpr, kReductionRatio, em::Md40::Motor::PhaseRelation::kAPhaseLeads);
+  }
+  g_md40_bus.Flush();
+}
+
+void loop() {
+  if (g_trigger_time == 0 || millis() - g_trigger_time > 2000) {
+    g_trigger_time = millis();
+    for (uint8_t i = 0; i < em::Md40Bus<kBoardNum>::kMotorNum; i++) {
+      g_md40_bus[i].SubmitRunSpeed(g_target_speed);
+    }
+    g_target_speed = -g_target_speed;
+  }
+
+  g_md40_bus.Update(g_snapshots);
+
+  if (millis() - g_last_print_time > 200) {
+    g_last_print_time = millis();
+
+    Serial.print(F("cycle us: "));
+    Serial.print(g_md40_bus.last_cycle_us());
+    Serial.print(F(", update rate Hz: "));
+    Serial.print(g_md40_bus.update_rate_hz());
+
+    Serial.print(F(", speeds: "));
+    for (uint8_t i = 0; i < em::Md40Bus<kBoardNum>::kMotorNum; i++) {
+      Serial.print(g_snapshots[i].speed);
+      if (i < em::Md40Bus<kBoardNum>::kMotorNum - 1) {
+        Serial.print(F(", "));
+      }
+    }
+
+    Serial.println();
+  }
+}
@@ -0,0 +1,49 @@
+/**
+ * @~Chinese
+ * @file negotiate_bus_speed.ino
+ * @brief 示例：协商I2C总线时钟频率。
+ * @example negotiate_bus_speed.ino
+ * 协商I2C总线时钟频率。
+ */
+/**
+ * @~English
+ * @file negotiate_bus_speed.ino
+ * @brief Example: Negotiate the I2C bus clock rate.
+ * @example negotiate_bus_speed.ino
+ * Negotiate the I2C bus clock rate.
+ */
+
+#include <Wire.h>
+
+#include "md40.h"
+
+namespace {
+em::Md40 g_md40(em::Md40::kDefaultI2cAddress, Wire);
+}  // namespace
+
+void setup() {
+  Serial.begin(115200);
+
+  Wire.begin();
+
+  g_md40.Init();
+
+  em::Md40::BusSpeedPolicy policy;
+  policy.trial_count = 16;
+  policy.error_budget = 1;
+  if (g_md40.NegotiateBusSpeed(policy) != em::Md40::Status::kOk) {
+    Serial.println(F("Bus speed negotiation failed"));
+    return;
+  }
+
+  Serial.print(F("Bus clock: "));
+  Serial.print(g_md40.bus_clock_hz());
+  Serial.print(F(" Hz, failed checks: "));
+  Serial.println(g_md40.bus_clock_error_count());
+}
+
+void loop() {
+  Serial.print(F("Motor 0 position: "));
+  Serial.println(g_md40[0].position());
+  delay(100);
+}
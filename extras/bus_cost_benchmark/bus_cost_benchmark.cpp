@@ -0,0 +1,427 @@
+/**
+ * @~Chinese
+ * @file bus_cost_benchmark.cpp
+ * @brief 测量每个公开API调用在总线上的开销：传输数、字节数、在100 kHz、400 kHz和1 MHz下的总线时间，以及主机CPU时间。
+ * @details 驱动通过 MemoryTransport 访问 Md40Simulator ，不需要硬件，结果是确定的。模拟器的命令延时设为0，
+ * 因此计数不包含等待命令完成时的轮询（轮询次数取决于 WaitPolicy 和固件）。传输数按 TwoWire 计算：每条消息从起始条件到停止条件，
+ * 写入后读取计为两次传输。总线时间按每字节9位加上每次传输的起始和停止条件估算，不包含时钟延展和命令执行时间。
+ * @code
+ * g++ -std=gnu++11 -O2 -Isrc extras/bus_cost_benchmark/bus_cost_benchmark.cpp src/md40_memory_transport.cpp src/md40_simulator.cpp \
+ *     -o bus_cost_benchmark
+ * ./bus_cost_benchmark                 # 表格
+ * ./bus_cost_benchmark --csv           # CSV，便于脚本处理
+ * ./bus_cost_benchmark --check extras/bus_cost_benchmark/thresholds.csv
+ * @endcode
+ * 使用 --check 时，任何调用的传输数或字节数超过阈值文件中的上限都会使程序返回1。有意增加开销的修改需要同时更新阈值文件。
+ */
+/**
+ * @~English
+ * @file bus_cost_benchmark.cpp
+ * @brief Measure the bus cost of every public API call: transactions, bytes, bus time at 100 kHz, 400 kHz and 1 MHz, and host CPU time.
+ * @details The driver talks to an Md40Simulator through MemoryTransport, so no hardware is needed and the results are deterministic. The
+ * simulator's command latency is set to 0, so the counts leave out the polling while waiting for a command to finish (how often that polls
+ * depends on the WaitPolicy and the firmware). Transactions are counted as on TwoWire: every message runs from a start to a stop condition, and a
+ * write-read counts as two. The bus time is modelled as 9 bits per byte plus the start and stop conditions of every transaction, leaving out clock
+ * stretching and command execution time.
+ * @code
+ * g++ -std=gnu++11 -O2 -Isrc extras/bus_cost_benchmark/bus_cost_benchmark.cpp src/md40_memory_transport.cpp src/md40_simulator.cpp \
+ *     -o bus_cost_benchmark
+ * ./bus_cost_benchmark                 # table
+ * ./bus_cost_benchmark --csv           # CSV for scripts
+ * ./bus_cost_benchmark --check extras/bus_cost_benchmark/thresholds.csv
+ * @endcode
+ * With --check, the program returns 1 when the transactions or bytes of any call exceed the limits in the threshold file. A change that adds cost
+ * on purpose has to update the threshold file along with it.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "md40.h"
+#include "md40_event_dispatcher.h"
+#include "md40_memory_transport.h"
+#include "md40_simulator.h"
+
+namespace {
+using Md40 = em::BasicMd40<em::MemoryTransport>;
+
+constexpr uint8_t kI2cAddress = Md40::kDefaultI2cAddress;
+constexpr uint32_t kCpuIterations = 2000;
+constexpr uint32_t kBusClocks[] = {100000, 400000, 1000000};
+
+// Same model as MemoryBus: 9 bits per byte and about one bit time each for the start and stop conditions.
+constexpr uint8_t kBitsPerByte = 9;
+constexpr uint8_t kStartStopBits = 2;
+
+struct Case {
+  const char *api;
+  void (*setup)(Md40 &md40);
+  void (*run)(Md40 &md40);
+};
+
+struct Result {
+  uint32_t transactions;
+  uint32_t bytes;
+  double cpu_ns;
+};
+
+void NoSetup(Md40 &md40) {
+  (void)md40;
+}
+
+void EncoderMode(Md40 &md40) {
+  md40[0].SetEncoderMode(12, 90, Md40::Motor::PhaseRelation::kAPhaseLeads);
+}
+
+void SetPidGains(Md40 &md40) {
+  Md40::Motor::PidGains gains;
+  gains.speed_p = 2.0f;
+  gains.position_p = 12.0f;
+  md40[0].SetPidGains(gains);
+}
+
+Md40::ConfigProfile MakeConfigProfile() {
+  Md40::Motor::PidGains gains;
+  gains.speed_p = 2.0f;
+  gains.speed_i = 1.5f;
+  gains.speed_d = 1.0f;
+  gains.position_p = 12.0f;
+  gains.position_i = 1.0f;
+  gains.position_d = 1.0f;
+
+  Md40::ConfigProfile profile;
+  for (uint8_t i = 0; i < Md40::kMotorNum; i++) {
+    profile.SetEncoderMode(i, 12, 90, Md40::Motor::PhaseRelation::kAPhaseLeads);
+    profile.SetPidGains(i, gains);
+  }
+  return profile;
+}
+
+// The board already holds the profile, as after a reboot of the host only.
+void ApplyConfigProfile(Md40 &md40) {
+  static const Md40::ConfigProfile profile = MakeConfigProfile();
+  md40.ApplyConfigProfile(profile);
+}
+
+// A move of 720 degrees at 100 rpm, 1.2 s long, is underway.
+void EncoderModeMoveTo(Md40 &md40) {
+  EncoderMode(md40);
+  md40[0].MoveTo(720, 100);
+}
+
+// Every case starts on a new bus whose virtual clock starts at 0, so this deadline is well after the end of the move.
+constexpr uint32_t kMoveDeadlineUs = 5000000;
+
+void ReachedBy(Md40 &md40) {
+  bool reached = false;
+  md40[0].ReachedBy(kMoveDeadlineUs, reached);
+}
+
+void SubmitRunSpeedAndPoll(Md40 &md40) {
+  const Md40::CommandHandle handle = md40[0].SubmitRunSpeed(100);
+  while (!handle.Done()) {
+    md40.Poll();
+  }
+}
+
+void SubmitPidGainsAndFlush(Md40 &md40) {
+  Md40::Motor::PidGains gains;
+  gains.speed_p = 2.0f;
+  gains.position_p = 12.0f;
+  md40[0].SubmitPidGains(gains);
+  md40.Flush();
+}
+
+void ReadConfigProfile(Md40 &md40) {
+  Md40::ConfigProfile profile;
+  md40.ReadConfigProfile(profile);
+}
+
+void GroupRunSpeed(Md40 &md40) {
+  static const int32_t rpm[Md40::kMotorNum] = {100, 100, 100, 100};
+  Md40::MotorGroup group(md40);
+  group.RunSpeed(rpm);
+}
+
+void GroupRunPwmDuty(Md40 &md40) {
+  static const int16_t pwm_duty[Md40::kMotorNum] = {500, 500, 500, 500};
+  Md40::MotorGroup group(md40);
+  group.RunPwmDuty(pwm_duty);
+}
+
+void GroupMoveTo(Md40 &md40) {
+  static const int32_t positions[Md40::kMotorNum] = {720, 360, -360, 0};
+  static const int32_t speeds[Md40::kMotorNum] = {100, 100, 100, 100};
+  Md40::MotorGroup group(md40);
+  group.MoveTo(positions, speeds);
+}
+
+void GroupStop(Md40 &md40) {
+  Md40::MotorGroup group(md40);
+  group.Stop();
+}
+
+void GroupCoordinatedMoveTo(Md40 &md40) {
+  static const int32_t positions[Md40::kMotorNum] = {720, 360, -360, 0};
+  Md40::MotorGroup group(md40);
+  group.CoordinatedMoveTo(positions, 100);
+}
+
+void GroupReadAllReached(Md40 &md40) {
+  Md40::MotorGroup group(md40);
+  bool reached = false;
+  group.ReadAllReached(reached);
+}
+
+void ReadAllFields(Md40 &md40) {
+  static const uint8_t fields[Md40::kMotorNum] = {
+      Md40::ReadPlan::kFieldAll, Md40::ReadPlan::kFieldAll, Md40::ReadPlan::kFieldAll, Md40::ReadPlan::kFieldAll};
+  Md40::ReadPlan plan(md40, fields);
+  Md40::Motor::Snapshot snapshots[Md40::kMotorNum];
+  plan.Execute(snapshots);
+}
+
+void ReadStateAndPosition(Md40 &md40) {
+  static const uint8_t fields[Md40::kMotorNum] = {Md40::ReadPlan::kFieldState | Md40::ReadPlan::kFieldPosition,
+                                                  Md40::ReadPlan::kFieldState | Md40::ReadPlan::kFieldPosition,
+                                                  Md40::ReadPlan::kFieldState | Md40::ReadPlan::kFieldPosition,
+                                                  Md40::ReadPlan::kFieldState | Md40::ReadPlan::kFieldPosition};
+  Md40::ReadPlan plan(md40, fields);
+  Md40::Motor::Snapshot snapshots[Md40::kMotorNum];
+  plan.Execute(snapshots);
+}
+
+void OnTransition(void *context, uint8_t index, Md40::Motor::State from, Md40::Motor::State to) {
+  (void)context;
+  (void)index;
+  (void)from;
+  (void)to;
+}
+
+void DispatcherPoll(Md40 &md40) {
+  em::BasicMd40EventDispatcher<em::MemoryTransport> dispatcher(md40);
+  dispatcher.Subscribe(0, Md40::Motor::State::kReachedPosition, OnTransition);
+  dispatcher.Poll();
+}
+
+// Calls that take arguments pass fixed values, the cost does not depend on them. Left out on purpose:
+// - Submit* variants other than the two below, which queue the same command as their blocking counterparts and cost the same once polled.
+// - Setters of local state (set_wait_policy, set_retry_count, set_command_write, set_config_cache_enabled...), which never touch the bus.
+// - BasicMd40Bus, Sampler, ProfileStreamer and Worker, whose bus traffic is the ReadPlan and command costs listed here, and the Autotuner,
+//   whose cost is set by its experiment's duration rather than by the driver.
+const Case kCases[] = {
+    {"Init", NoSetup, [](Md40 &md40) { md40.Init(); }},
+    {"firmware_version", NoSetup, [](Md40 &md40) { md40.firmware_version(); }},
+    {"device_id", NoSetup, [](Md40 &md40) { md40.device_id(); }},
+    {"name", NoSetup, [](Md40 &md40) { md40.name(); }},
+    {"ApplyConfigProfile(configured)", ApplyConfigProfile, ApplyConfigProfile},
+    {"Motor::Reset", NoSetup, [](Md40 &md40) { md40[0].Reset(); }},
+    {"Motor::SetEncoderMode", NoSetup, EncoderMode},
+    {"Motor::SetDcMode", NoSetup, [](Md40 &md40) { md40[0].SetDcMode(); }},
+    {"Motor::speed_pid_p", NoSetup, [](Md40 &md40) { md40[0].speed_pid_p(); }},
+    {"Motor::set_speed_pid_p", NoSetup, [](Md40 &md40) { md40[0].set_speed_pid_p(1.5f); }},
+    {"Motor::speed_pid_i", NoSetup, [](Md40 &md40) { md40[0].speed_pid_i(); }},
+    {"Motor::set_speed_pid_i", NoSetup, [](Md40 &md40) { md40[0].set_speed_pid_i(1.5f); }},
+    {"Motor::speed_pid_d", NoSetup, [](Md40 &md40) { md40[0].speed_pid_d(); }},
+    {"Motor::set_speed_pid_d", NoSetup, [](Md40 &md40) { md40[0].set_speed_pid_d(1.0f); }},
+    {"Motor::position_pid_p", NoSetup, [](Md40 &md40) { md40[0].position_pid_p(); }},
+    {"Motor::set_position_pid_p", NoSetup, [](Md40 &md40) { md40[0].set_position_pid_p(10.0f); }},
+    {"Motor::position_pid_i", NoSetup, [](Md40 &md40) { md40[0].position_pid_i(); }},
+    {"Motor::set_position_pid_i", NoSetup, [](Md40 &md40) { md40[0].set_position_pid_i(1.0f); }},
+    {"Motor::position_pid_d", NoSetup, [](Md40 &md40) { md40[0].position_pid_d(); }},
+    {"Motor::set_position_pid_d", NoSetup, [](Md40 &md40) { md40[0].set_position_pid_d(1.0f); }},
+    {"Motor::pid_gains", NoSetup, [](Md40 &md40) { md40[0].pid_gains(); }},
+    {"Motor::SetPidGains", NoSetup, SetPidGains},
+    {"Motor::SubmitPidGains+Flush", NoSetup, SubmitPidGainsAndFlush},
+    {"Motor::Refresh", NoSetup, [](Md40 &md40) { md40[0].Refresh(); }},
+    {"ReadConfigProfile", NoSetup, ReadConfigProfile},
+    {"Motor::set_position", EncoderMode, [](Md40 &md40) { md40[0].set_position(0); }},
+    {"Motor::set_pulse_count", EncoderMode, [](Md40 &md40) { md40[0].set_pulse_count(0); }},
+    {"Motor::Stop", EncoderMode, [](Md40 &md40) { md40[0].Stop(); }},
+    {"Motor::RunPwmDuty", EncoderMode, [](Md40 &md40) { md40[0].RunPwmDuty(500); }},
+    {"Motor::RunSpeed", EncoderMode, [](Md40 &md40) { md40[0].RunSpeed(100); }},
+    {"Motor::SubmitRunSpeed+Poll", EncoderMode, SubmitRunSpeedAndPoll},
+    {"Motor::MoveTo", EncoderMode, [](Md40 &md40) { md40[0].MoveTo(720, 100); }},
+    {"Motor::Move", EncoderMode, [](Md40 &md40) { md40[0].Move(360, 100); }},
+    {"Motor::ReachedBy(moving)", EncoderModeMoveTo, ReachedBy},
+    {"Motor::WaitUntilReached", EncoderModeMoveTo, [](Md40 &md40) { md40[0].WaitUntilReached(kMoveDeadlineUs); }},
+    {"Motor::state", EncoderMode, [](Md40 &md40) { md40[0].state(); }},
+    {"Motor::speed", EncoderMode, [](Md40 &md40) { md40[0].speed(); }},
+    {"Motor::position", EncoderMode, [](Md40 &md40) { md40[0].position(); }},
+    {"Motor::pulse_count", EncoderMode, [](Md40 &md40) { md40[0].pulse_count(); }},
+    {"Motor::pwm_duty", EncoderMode, [](Md40 &md40) { md40[0].pwm_duty(); }},
+    {"Motor::ReadSnapshot", EncoderMode, [](Md40 &md40) { md40[0].ReadSnapshot(); }},
+    {"MotorGroup::RunSpeed", EncoderMode, GroupRunSpeed},
+    {"MotorGroup::RunPwmDuty", EncoderMode, GroupRunPwmDuty},
+    {"MotorGroup::MoveTo", EncoderMode, GroupMoveTo},
+    {"MotorGroup::Stop", EncoderMode, GroupStop},
+    {"MotorGroup::CoordinatedMoveTo", EncoderMode, GroupCoordinatedMoveTo},
+    {"MotorGroup::ReadAllReached", EncoderMode, GroupReadAllReached},
+    {"ReadPlan::Execute(all fields)", EncoderMode, ReadAllFields},
+    {"ReadPlan::Execute(state+position)", EncoderMode, ReadStateAndPosition},
+    {"EventDispatcher::Poll(one motor)", EncoderMode, DispatcherPoll},
+    {"Poll(idle)", NoSetup, [](Md40 &md40) { md40.Poll(); }},
+    {"Flush(idle)", NoSetup, [](Md40 &md40) { md40.Flush(); }},
+    {"NegotiateBusSpeed", NoSetup, [](Md40 &md40) { md40.NegotiateBusSpeed(); }},
+};
+
+double CpuNow() {
+  timespec now;
+  clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &now);
+  return now.tv_sec * 1e9 + now.tv_nsec;
+}
+
+double BusTimeUs(const Result &result, const uint32_t clock_hz) {
+  return (static_cast<double>(result.bytes) * kBitsPerByte + static_cast<double>(result.transactions) * kStartStopBits) * 1e6 / clock_hz;
+}
+
+// Every case starts from a freshly initialized device, so one call's cost does not depend on the cases before it.
+Result Measure(const Case &test_case) {
+  em::MemoryBus bus;
+  em::Md40Simulator simulator(kI2cAddress);
+  simulator.set_command_latency_us(0);
+  bus.Attach(simulator);
+  Md40 md40(kI2cAddress, bus);
+  md40.Init();
+  test_case.setup(md40);
+
+  Result result;
+  bus.ResetCounters();
+  test_case.run(md40);
+  result.transactions = bus.message_count();
+  result.bytes = bus.byte_count();
+
+  const double start = CpuNow();
+  for (uint32_t i = 0; i < kCpuIterations; i++) {
+    test_case.run(md40);
+  }
+  result.cpu_ns = (CpuNow() - start) / kCpuIterations;
+  return result;
+}
+
+struct Threshold {
+  char api[64];
+  uint32_t max_transactions;
+  uint32_t max_bytes;
+  bool seen;
+};
+
+constexpr uint8_t kMaxThresholds = 64;
+
+// Reads "api,max_transactions,max_bytes" lines, skipping blank lines, comments starting with '#' and the header.
+int LoadThresholds(const char *path, Threshold (&thresholds)[kMaxThresholds]) {
+  FILE *file = fopen(path, "r");
+  if (file == nullptr) {
+    return -1;
+  }
+
+  int count = 0;
+  char line[256];
+  while (fgets(line, sizeof(line), file) != nullptr && count < kMaxThresholds) {
+    Threshold &threshold = thresholds[count];
+    if (line[0] == '#' || sscanf(line, "%63[^,],%u,%u", threshold.api, &threshold.max_transactions, &threshold.max_bytes) != 3) {
+      continue;
+    }
+    threshold.seen = false;
+    count++;
+  }
+  fclose(file);
+  return count;
+}
+
+Threshold *FindThreshold(Threshold *thresholds, const int count, const char *api) {
+  for (int i = 0; i < count; i++) {
+    if (strcmp(thresholds[i].api, api) == 0) {
+      return &thresholds[i];
+    }
+  }
+  return nullptr;
+}
+}  // namespace
+
+int main(int argc, char **argv) {
+  bool csv = false;
+  const char *threshold_path = nullptr;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--csv") == 0) {
+      csv = true;
+    } else if (strcmp(argv[i], "--check") == 0 && i + 1 < argc) {
+      threshold_path = argv[++i];
+    } else {
+      fprintf(stderr, "usage: %s [--csv] [--check thresholds.csv]\n", argv[0]);
+      return 2;
+    }
+  }
+
+  Threshold thresholds[kMaxThresholds];
+  int threshold_count = 0;
+  if (threshold_path != nullptr) {
+    threshold_count = LoadThresholds(threshold_path, thresholds);
+    if (threshold_count < 0) {
+      fprintf(stderr, "cannot read %s\n", threshold_path);
+      return 2;
+    }
+  }
+
+  if (csv) {
+    printf("api,transactions,bytes,bus_us_100khz,bus_us_400khz,bus_us_1mhz,cpu_ns\n");
+  } else {
+    printf("%-34s %12s %6s %12s %12s %12s %9s\n", "api", "transactions", "bytes", "us@100kHz", "us@400kHz", "us@1MHz", "cpu ns");
+  }
+
+  int failures = 0;
+  for (const Case &test_case : kCases) {
+    const Result result = Measure(test_case);
+    if (csv) {
+      printf("%s,%u,%u,%.1f,%.1f,%.1f,%.0f\n",
+             test_case.api,
+             result.transactions,
+             result.bytes,
+             BusTimeUs(result, kBusClocks[0]),
+             BusTimeUs(result, kBusClocks[1]),
+             BusTimeUs(result, kBusClocks[2]),
+             result.cpu_ns);
+    } else {
+      printf("%-34s %12u %6u %12.1f %12.1f %12.1f %9.0f\n",
+             test_case.api,
+             result.transactions,
+             result.bytes,
+             BusTimeUs(result, kBusClocks[0]),
+             BusTimeUs(result, kBusClocks[1]),
+             BusTimeUs(result, kBusClocks[2]),
+             result.cpu_ns);
+    }
+
+    if (threshold_path == nullptr) {
+      continue;
+    }
+    Threshold *threshold = FindThreshold(thresholds, threshold_count, test_case.api);
+    if (threshold == nullptr) {
+      fprintf(stderr, "note: %s has no threshold\n", test_case.api);
+      continue;
+    }
+    threshold->seen = true;
+    if (result.transactions > threshold->max_transactions || result.bytes > threshold->max_bytes) {
+      fprintf(stderr,
+              "FAIL: %s costs %u transactions and %u bytes, the limits are %u and %u\n",
+              test_case.api,
+              result.transactions,
+              result.bytes,
+              threshold->max_transactions,
+              threshold->max_bytes);
+      failures++;
+    } else if (result.transactions < threshold->max_transactions || result.bytes < threshold->max_bytes) {
+      fprintf(stderr, "note: %s is below its limits, the threshold can be tightened\n", test_case.api);
+    }
+  }
+
+  // A threshold nothing matched means a case was renamed or removed, which would silently drop its check.
+  for (int i = 0; i < threshold_count; i++) {
+    if (!thresholds[i].seen) {
+      fprintf(stderr, "FAIL: threshold for %s matches no measured call\n", thresholds[i].api);
+      failures++;
+    }
+  }
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,763 @@
+/**
+ * @~Chinese
+ * @file host_tests.cpp
+ * @brief 在主机上通过 MemoryTransport 和 Md40Simulator 检查驱动的行为，不需要硬件。
+ * @code
+ * g++ -std=gnu++11 -O2 -Isrc extras/host_tests/host_tests.cpp src/md40_memory_transport.cpp src/md40_simulator.cpp -o host_tests
+ * ./host_tests
+ * @endcode
+ * 每个失败的检查打印一行，任何检查失败时程序返回1。
+ */
+/**
+ * @~English
+ * @file host_tests.cpp
+ * @brief Check the behaviour of the driver on the host through MemoryTransport and Md40Simulator, no hardware needed.
+ * @code
+ * g++ -std=gnu++11 -O2 -Isrc extras/host_tests/host_tests.cpp src/md40_memory_transport.cpp src/md40_simulator.cpp -o host_tests
+ * ./host_tests
+ * @endcode
+ * Every failed check prints one line, and the program returns 1 when any check failed.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "md40.h"
+#include "md40_autotuner.h"
+#include "md40_bus.h"
+#include "md40_event_dispatcher.h"
+#include "md40_memory_transport.h"
+#include "md40_simulator.h"
+
+namespace {
+using Md40 = em::BasicMd40<em::MemoryTransport>;
+using Autotuner = em::BasicMd40Autotuner<em::MemoryTransport>;
+using Md40Bus = em::BasicMd40Bus<em::MemoryTransport, 2>;
+using Dispatcher = em::BasicMd40EventDispatcher<em::MemoryTransport>;
+
+constexpr uint8_t kI2cAddress = Md40::kDefaultI2cAddress;
+
+int g_failures = 0;
+
+#define CHECK(condition)                                                            \
+  do {                                                                              \
+    if (!(condition)) {                                                             \
+      fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #condition); \
+      g_failures++;                                                                 \
+    }                                                                               \
+  } while (0)
+
+// A bus with one simulated MD40 on it. A wait that never finishes times out instead of hanging the tests.
+struct Fixture {
+  Fixture() : simulator(kI2cAddress), md40(kI2cAddress, bus) {
+    bus.Attach(simulator);
+    md40.set_wait_policy(Md40::WaitPolicy::Spin(100000));
+  }
+
+  em::MemoryBus bus;
+  em::Md40Simulator simulator;
+  Md40 md40;
+};
+
+// Firmware that ignores an execute flag written together with the command is detected by Init, and the driver falls back to two writes without
+// the detection having changed any setting.
+void TestLegacyFirmwareWritesCommandAndExecuteSeparately() {
+  Fixture fixture;
+  fixture.simulator.set_fused_command_accepted(false);
+  CHECK(fixture.md40.Init() == Md40::Status::kOk);
+  CHECK(!fixture.md40.fused_command());
+  CHECK(fixture.md40[0].speed_pid_p() == 1.5f);
+  CHECK(fixture.md40[0].SetEncoderMode(12, 90, Md40::Motor::PhaseRelation::kAPhaseLeads) == Md40::Status::kOk);
+
+  // The command, the execute flag, then a write-read of the execute flag: one message more than the fused path.
+  fixture.bus.ResetCounters();
+  const uint32_t command_count = fixture.simulator.command_count();
+  fixture.simulator.set_command_latency_us(0);
+  CHECK(fixture.md40[0].RunSpeed(100) == Md40::Status::kOk);
+  CHECK(fixture.bus.message_count() == 4);
+  CHECK(fixture.simulator.command_count() == command_count + 1);
+
+  fixture.bus.Advance(500000);
+  CHECK(fixture.md40[0].speed() >= 95 && fixture.md40[0].speed() <= 105);
+}
+
+void TestCurrentFirmwareFusesCommandAndExecute() {
+  Fixture fixture;
+  CHECK(fixture.md40.Init() == Md40::Status::kOk);
+  CHECK(fixture.md40.fused_command());
+  CHECK(fixture.md40[0].SetEncoderMode(12, 90, Md40::Motor::PhaseRelation::kAPhaseLeads) == Md40::Status::kOk);
+
+  fixture.bus.ResetCounters();
+  fixture.simulator.set_command_latency_us(0);
+  CHECK(fixture.md40[0].RunSpeed(100) == Md40::Status::kOk);
+  CHECK(fixture.bus.message_count() == 3);
+}
+
+// A command write set by the user skips the detection, even where the firmware would accept the single write.
+void TestCommandWriteOverrideSkipsDetection() {
+  Fixture fixture;
+  fixture.md40.set_command_write(Md40::CommandWrite::kSeparate);
+  const uint32_t command_count = fixture.simulator.command_count();
+  CHECK(fixture.md40.Init() == Md40::Status::kOk);
+  CHECK(!fixture.md40.fused_command());
+  CHECK(fixture.simulator.command_count() == command_count + Md40::kMotorNum);
+  CHECK(fixture.md40[0].SetEncoderMode(12, 90, Md40::Motor::PhaseRelation::kAPhaseLeads) == Md40::Status::kOk);
+
+  fixture.bus.ResetCounters();
+  fixture.simulator.set_command_latency_us(0);
+  CHECK(fixture.md40[0].RunSpeed(100) == Md40::Status::kOk);
+  CHECK(fixture.bus.message_count() == 4);
+
+  fixture.md40.set_command_write(Md40::CommandWrite::kFused);
+  fixture.bus.ResetCounters();
+  CHECK(fixture.md40[0].RunSpeed(50) == Md40::Status::kOk);
+  CHECK(fixture.bus.message_count() == 3);
+}
+
+// A full queue turns a Submit* away at once instead of blocking on the bus, and the blocking calls still make room for themselves.
+void TestFullQueueRejectsWithoutBlocking() {
+  Fixture fixture;
+  CHECK(fixture.md40.Init() == Md40::Status::kOk);
+
+  // Fill the queue, whatever its depth.
+  const Md40::CommandHandle first = fixture.md40[0].SubmitStop();
+  Md40::CommandHandle last = first;
+  uint8_t queued = 1;
+  while (queued < 64) {
+    const Md40::CommandHandle handle = fixture.md40[queued % Md40::kMotorNum].SubmitStop();
+    if (handle.rejected()) {
+      break;
+    }
+    last = handle;
+    queued++;
+  }
+  CHECK(queued >= Md40::kMotorNum);
+
+  fixture.bus.ResetCounters();
+  const Md40::CommandHandle rejected = fixture.md40[0].SubmitRunSpeed(100);
+  CHECK(rejected.rejected());
+  CHECK(rejected.Done());
+  CHECK(fixture.md40.last_status() == Md40::Status::kQueueFull);
+  CHECK(fixture.md40.Wait(rejected) == Md40::Status::kQueueFull);
+  CHECK(fixture.bus.message_count() == 0);
+
+  while (!first.Done()) {
+    CHECK(fixture.md40.Poll() == Md40::Status::kOk);
+  }
+  CHECK(!fixture.md40[0].SubmitRunSpeed(100).rejected());
+
+  CHECK(fixture.md40[1].Stop() == Md40::Status::kOk);
+  CHECK(last.Done());
+}
+
+// SubmitPidGains queues all six commands without touching the bus, or none of them.
+void TestSubmitPidGainsIsNonBlockingAndAllOrNothing() {
+  Fixture fixture;
+  CHECK(fixture.md40.Init() == Md40::Status::kOk);
+
+  Md40::Motor::PidGains gains;
+  gains.speed_p = 2.5f;
+  gains.speed_i = 1.25f;
+  gains.speed_d = 0.5f;
+  gains.position_p = 12.0f;
+  gains.position_i = 0.75f;
+  gains.position_d = 1.5f;
+
+  fixture.bus.ResetCounters();
+  const Md40::CommandHandle handle = fixture.md40[0].SubmitPidGains(gains);
+  CHECK(!handle.rejected());
+  CHECK(fixture.bus.message_count() == 0);
+  while (!handle.Done()) {
+    CHECK(fixture.md40.Poll() == Md40::Status::kOk);
+  }
+  const Md40::Motor::PidGains read = fixture.md40[0].pid_gains();
+  CHECK(read.speed_p == gains.speed_p && read.speed_i == gains.speed_i && read.speed_d == gains.speed_d);
+  CHECK(read.position_p == gains.position_p && read.position_i == gains.position_i && read.position_d == gains.position_d);
+
+  // With another command still queued the six do not fit, and a rejected call leaves nothing behind.
+  const uint32_t command_count = fixture.simulator.command_count();
+  CHECK(!fixture.md40[1].SubmitStop().rejected());
+  gains.speed_p = 3.0f;
+  CHECK(fixture.md40[0].SubmitPidGains(gains).rejected());
+  CHECK(fixture.md40.Flush() == Md40::Status::kOk);
+  CHECK(fixture.simulator.command_count() == command_count + 1);
+
+  CHECK(fixture.md40[0].SetPidGains(gains) == Md40::Status::kOk);
+  CHECK(fixture.md40[0].speed_pid_p() == 3.0f);
+}
+
+// A fused command write that fails after the address was acknowledged may already carry the execute flag, so it must not be written again.
+void TestFailedFusedWriteIsNotResent() {
+  Fixture fixture;
+  CHECK(fixture.md40.Init() == Md40::Status::kOk);
+  const uint32_t command_count = fixture.simulator.command_count();
+
+  fixture.bus.set_clock_hz(1000000);
+  fixture.bus.set_fault_injection(400000, 1);
+  const Md40::CommandHandle handle = fixture.md40[0].SubmitStop();
+  CHECK(fixture.md40.Poll() == Md40::Status::kBusError);
+  CHECK(handle.Done());
+
+  fixture.bus.set_fault_injection(0, 0);
+  fixture.bus.ResetCounters();
+  CHECK(fixture.md40.Poll() == Md40::Status::kOk);
+  CHECK(fixture.bus.message_count() == 0);
+  CHECK(fixture.simulator.command_count() == command_count);
+}
+
+// The start positions are read after the queue has drained, so a queued SubmitPosition is part of the distances and the axes still arrive
+// together.
+void TestCoordinatedMoveToDrainsQueueFirst() {
+  Fixture fixture;
+  CHECK(fixture.md40.Init() == Md40::Status::kOk);
+  for (uint8_t i = 0; i < 2; i++) {
+    CHECK(fixture.md40[i].SetEncoderMode(12, 90, Md40::Motor::PhaseRelation::kAPhaseLeads) == Md40::Status::kOk);
+  }
+
+  CHECK(!fixture.md40[0].SubmitPosition(360).rejected());
+  Md40::MotorGroup group(fixture.md40, 0x03);
+  const int32_t positions[Md40::kMotorNum] = {720, 360, 0, 0};
+  CHECK(group.CoordinatedMoveTo(positions, 60) == Md40::Status::kOk);
+
+  uint32_t arrival_us[2] = {0, 0};
+  const uint32_t start_us = fixture.bus.now_us();
+  while (fixture.bus.now_us() - start_us < 3000000 && (arrival_us[0] == 0 || arrival_us[1] == 0)) {
+    fixture.bus.Advance(1000);
+    for (uint8_t i = 0; i < 2; i++) {
+      if (arrival_us[i] == 0 && fixture.md40[i].state() == Md40::Motor::State::kReachedPosition) {
+        arrival_us[i] = fixture.bus.now_us() - start_us;
+      }
+    }
+  }
+  CHECK(arrival_us[0] != 0 && arrival_us[1] != 0);
+  const uint32_t skew_us = arrival_us[0] > arrival_us[1] ? arrival_us[0] - arrival_us[1] : arrival_us[1] - arrival_us[0];
+  CHECK(skew_us < 100000);
+}
+
+// A move still waiting in the queue must not be reported as arrived on the strength of the previous move's state.
+void TestReachedByWaitsForQueuedMove() {
+  Fixture fixture;
+  CHECK(fixture.md40.Init() == Md40::Status::kOk);
+  CHECK(fixture.md40[0].SetEncoderMode(12, 90, Md40::Motor::PhaseRelation::kAPhaseLeads) == Md40::Status::kOk);
+  CHECK(fixture.md40[0].MoveTo(90, 60) == Md40::Status::kOk);
+  CHECK(fixture.md40[0].WaitUntilReached(fixture.bus.now_us() + 3000000) == Md40::Status::kOk);
+
+  const Md40::CommandHandle handle = fixture.md40[0].SubmitMoveTo(180, 60);
+  CHECK(!handle.rejected());
+  bool reached = true;
+  fixture.bus.ResetCounters();
+  CHECK(fixture.md40[0].ReachedBy(fixture.bus.now_us() + 3000000, reached) == Md40::Status::kOk);
+  CHECK(!reached);
+  CHECK(fixture.bus.message_count() == 0);
+
+  while (!handle.Done()) {
+    CHECK(fixture.md40.Poll() == Md40::Status::kOk);
+  }
+  const uint32_t deadline_us = fixture.bus.now_us() + 3000000;
+  reached = false;
+  while (!reached && static_cast<int32_t>(fixture.bus.now_us() - deadline_us) < 0) {
+    CHECK(fixture.md40[0].ReachedBy(deadline_us, reached) == Md40::Status::kOk);
+    fixture.bus.Advance(1000);
+  }
+  CHECK(reached);
+  const int32_t position = fixture.md40[0].position();
+  CHECK(position >= 175 && position <= 185);
+}
+
+// A move that would take days has an ETA far beyond what a uint32_t of microseconds holds, the next check is simply put at the deadline.
+void TestReachedByClampsLongEtaToDeadline() {
+  Fixture fixture;
+  CHECK(fixture.md40.Init() == Md40::Status::kOk);
+  CHECK(fixture.md40[0].SetEncoderMode(12, 90, Md40::Motor::PhaseRelation::kAPhaseLeads) == Md40::Status::kOk);
+  CHECK(fixture.md40[0].MoveTo(100000000, 1) == Md40::Status::kOk);
+
+  const uint32_t deadline_us = fixture.bus.now_us() + 2000000;
+  bool reached = true;
+  CHECK(fixture.md40[0].ReachedBy(deadline_us, reached) == Md40::Status::kOk);
+  CHECK(!reached);
+
+  fixture.bus.Advance(900000);
+  fixture.bus.ResetCounters();
+  CHECK(fixture.md40[0].ReachedBy(deadline_us, reached) == Md40::Status::kOk);
+  CHECK(fixture.bus.message_count() == 0);
+
+  fixture.bus.Advance(1100000);
+  CHECK(fixture.md40[0].ReachedBy(deadline_us, reached) == Md40::Status::kTimeout);
+  CHECK(!reached);
+  CHECK(fixture.md40[0].Stop() == Md40::Status::kOk);
+}
+
+// With every rate above 400 kHz corrupting the traffic, negotiation settles on 400 kHz, leaves the bus there and puts the borrowed PID gain back.
+void TestNegotiateBusSpeedFallsBackToHighestCleanRate() {
+  Fixture fixture;
+  CHECK(fixture.md40.Init() == Md40::Status::kOk);
+  CHECK(fixture.md40[0].set_speed_pid_p(2.5f) == Md40::Status::kOk);
+
+  fixture.bus.set_fault_injection(400000, 20);
+  CHECK(fixture.md40.NegotiateBusSpeed() == Md40::Status::kOk);
+  CHECK(fixture.md40.bus_clock_hz() == 400000);
+  CHECK(fixture.md40.bus_clock_error_count() == 0);
+  CHECK(fixture.bus.clock_hz() == 400000);
+  CHECK(fixture.md40[0].speed_pid_p() == 2.5f);
+
+  // Nothing but the reference rate is clean.
+  fixture.bus.set_fault_injection(100000, 20);
+  CHECK(fixture.md40.NegotiateBusSpeed() == Md40::Status::kOk);
+  CHECK(fixture.md40.bus_clock_hz() == 100000);
+  CHECK(fixture.bus.clock_hz() == 100000);
+  CHECK(fixture.md40[0].speed_pid_p() == 2.5f);
+
+  fixture.bus.set_fault_injection(0, 0);
+  CHECK(fixture.md40.NegotiateBusSpeed() == Md40::Status::kOk);
+  CHECK(fixture.md40.bus_clock_hz() == 1000000);
+  CHECK(fixture.bus.clock_hz() == 1000000);
+  CHECK(fixture.md40[0].speed_pid_p() == 2.5f);
+}
+
+// Runs the autotuner to the end against the simulator, as loop() would on a board. Returns false when it did not finish in time.
+bool RunAutotuner(Fixture &fixture, Autotuner &autotuner, const Autotuner::Config &config) {
+  CHECK(autotuner.Begin(0, config) == Md40::Status::kOk);
+  const uint32_t start_us = fixture.bus.now_us();
+  while (autotuner.phase() != Autotuner::Phase::kDone && autotuner.phase() != Autotuner::Phase::kFailed) {
+    if (fixture.bus.now_us() - start_us > config.timeout_us) {
+      return false;
+    }
+    autotuner.Step();
+    fixture.bus.Advance(100);
+  }
+  return autotuner.phase() == Autotuner::Phase::kDone;
+}
+
+bool Within(const float value, const float expected, const float tolerance) {
+  return value >= expected * (1 - tolerance) && value <= expected * (1 + tolerance);
+}
+
+// The simulated motor is first order with no dead time, 150 RPM at full duty and here a 50 ms time constant, which is what the relay experiment
+// has to find again. A motor much faster than that would be only a couple of 10 ms control periods, too fast for the onboard PID to follow any
+// tuning. The settling time of the model step has to match the real one within a factor of two.
+void TestAutotunerFitsSimulatedSpeedLoop() {
+  Fixture fixture;
+  em::Md40Simulator::MotorModel model;
+  model.time_constant_s = 0.05f;
+  fixture.simulator.set_motor_model(0, model);
+  CHECK(fixture.md40.Init() == Md40::Status::kOk);
+  CHECK(fixture.md40[0].SetEncoderMode(12, 90, Md40::Motor::PhaseRelation::kAPhaseLeads) == Md40::Status::kOk);
+
+  Autotuner autotuner(fixture.md40);
+  Autotuner::Config config;
+  config.loop = Autotuner::Loop::kSpeed;
+  config.rule = Autotuner::Rule::kNoOvershoot;
+  CHECK(RunAutotuner(fixture, autotuner, config));
+
+  const Autotuner::Result &result = autotuner.result();
+  CHECK(Within(result.model_gain, 150.0f / 1023, 0.05f));
+  CHECK(Within(result.model_time_constant_s, 0.05f, 0.25f));
+  CHECK(result.p > 0 && result.i > 0);
+  CHECK(result.predicted_settling_us != Autotuner::kNotSettled && result.measured_settling_us != Autotuner::kNotSettled);
+  CHECK(result.measured_settling_us <= 2 * result.predicted_settling_us && result.predicted_settling_us <= 2 * result.measured_settling_us);
+  // The board keeps gains in hundredths.
+  CHECK(fabsf(fixture.md40[0].speed_pid_p() - result.p) <= 0.005f);
+}
+
+// The position loop drives the already tuned speed loop, so the plant seen by the relay is that closed loop plus an integrator.
+void TestAutotunerTunesSimulatedPositionLoop() {
+  Fixture fixture;
+  CHECK(fixture.md40.Init() == Md40::Status::kOk);
+  CHECK(fixture.md40[0].SetEncoderMode(12, 90, Md40::Motor::PhaseRelation::kAPhaseLeads) == Md40::Status::kOk);
+
+  Autotuner autotuner(fixture.md40);
+  Autotuner::Config config;
+  config.loop = Autotuner::Loop::kPosition;
+  config.rule = Autotuner::Rule::kTyreusLuyben;
+  config.setpoint = 90;
+  config.relay_amplitude = 60;
+  CHECK(RunAutotuner(fixture, autotuner, config));
+
+  const Autotuner::Result &result = autotuner.result();
+  // One RPM is six degrees per second, the lag of the closed speed loop is what the fit is free to choose.
+  CHECK(Within(result.model_gain, 6.0f, 0.05f));
+  CHECK(result.model_time_constant_s > 0 && result.model_time_constant_s < 0.5f);
+  CHECK(result.p > 0);
+  CHECK(result.predicted_settling_us != Autotuner::kNotSettled && result.measured_settling_us != Autotuner::kNotSettled);
+  CHECK(result.measured_settling_us <= 2 * result.predicted_settling_us && result.predicted_settling_us <= 2 * result.measured_settling_us);
+  CHECK(fabsf(fixture.md40[0].position_pid_p() - result.p) <= 0.005f);
+}
+
+// A gain turned away by a full queue must not end up in the config cache, or the retry would be skipped as unchanged.
+void TestRejectedSubmitLeavesConfigCacheUnchanged() {
+  Fixture fixture;
+  CHECK(fixture.md40.Init() == Md40::Status::kOk);
+  Md40::Motor &motor = fixture.md40[0];
+  motor.set_config_cache_enabled(true);
+  CHECK(motor.set_speed_pid_p(1.0f) == Md40::Status::kOk);
+
+  // Fill the queue, whatever its depth.
+  uint8_t queued = 0;
+  while (queued < 64 && !fixture.md40[1].SubmitStop().rejected()) {
+    queued++;
+  }
+  CHECK(motor.SubmitSpeedPidP(2.0f).rejected());
+  CHECK(fixture.md40.Flush() == Md40::Status::kOk);
+  CHECK(motor.speed_pid_p() == 1.0f);
+
+  const uint32_t command_count = fixture.simulator.command_count();
+  CHECK(!motor.SubmitSpeedPidP(2.0f).Done());
+  CHECK(fixture.md40.Flush() == Md40::Status::kOk);
+  CHECK(fixture.simulator.command_count() == command_count + 1);
+
+  // The same for the mode.
+  CHECK(motor.SetEncoderMode(12, 90, Md40::Motor::PhaseRelation::kAPhaseLeads) == Md40::Status::kOk);
+  while (queued < 64 && !fixture.md40[1].SubmitStop().rejected()) {
+    queued++;
+  }
+  CHECK(motor.SubmitDcMode().rejected());
+  CHECK(fixture.md40.Flush() == Md40::Status::kOk);
+  CHECK(!motor.SubmitDcMode().Done());
+  CHECK(fixture.md40.Flush() == Md40::Status::kOk);
+
+  // Reading around the cache shows what the device actually holds.
+  motor.set_config_cache_enabled(false);
+  CHECK(motor.speed_pid_p() == 2.0f);
+}
+
+// With the gains the board starts with, a move has to come to rest at its target rather than keep hunting around it.
+void TestSimulatedMoveSettlesWithDefaultGains() {
+  Fixture fixture;
+  CHECK(fixture.md40.Init() == Md40::Status::kOk);
+  CHECK(fixture.md40[0].SetEncoderMode(12, 90, Md40::Motor::PhaseRelation::kAPhaseLeads) == Md40::Status::kOk);
+  CHECK(fixture.md40[0].MoveTo(90, 60) == Md40::Status::kOk);
+  CHECK(fixture.md40[0].WaitUntilReached(fixture.bus.now_us() + 3000000) == Md40::Status::kOk);
+
+  // Allow the overshoot to die out, then stay within a degree for two seconds.
+  fixture.bus.Advance(1500000);
+  int32_t low = INT32_MAX;
+  int32_t high = INT32_MIN;
+  for (uint32_t i = 0; i < 200; i++) {
+    fixture.bus.Advance(10000);
+    const int32_t position = fixture.md40[0].position();
+    low = position < low ? position : low;
+    high = position > high ? position : high;
+  }
+  CHECK(low >= 89 && high <= 91);
+  CHECK(fixture.md40[0].state() == Md40::Motor::State::kReachedPosition);
+}
+
+void CountCallback(void *context, uint8_t, Dispatcher::State, Dispatcher::State) {
+  (*static_cast<uint32_t *>(context))++;
+}
+
+// Lets the dispatcher back off to its idle interval with motor 0 at rest.
+void SettleDispatcher(Fixture &fixture, Dispatcher &dispatcher) {
+  for (uint32_t i = 0; i < 2000; i++) {
+    CHECK(fixture.md40.Poll() == Md40::Status::kOk);
+    CHECK(dispatcher.Poll() == Md40::Status::kOk);
+    fixture.bus.Advance(1000);
+  }
+  CHECK(dispatcher.interval_us() == Dispatcher::kDefaultIdleIntervalUs);
+}
+
+// Polls for 150 ms, less than the idle interval, and returns whether the move finished in that time.
+bool PollBriefly(Fixture &fixture, Dispatcher &dispatcher) {
+  for (uint32_t i = 0; i < 150; i++) {
+    CHECK(fixture.md40.Poll() == Md40::Status::kOk);
+    CHECK(dispatcher.Poll() == Md40::Status::kOk);
+    fixture.bus.Advance(1000);
+  }
+  return fixture.md40[0].state() == Md40::Motor::State::kReachedPosition;
+}
+
+// A short move submitted while the dispatcher idles has to wake it, whether it went through the queue or through a MotorGroup.
+void TestDispatcherWakesOnNewCommand() {
+  Fixture fixture;
+  CHECK(fixture.md40.Init() == Md40::Status::kOk);
+  CHECK(fixture.md40[0].SetEncoderMode(12, 90, Md40::Motor::PhaseRelation::kAPhaseLeads) == Md40::Status::kOk);
+  CHECK(fixture.md40[0].MoveTo(90, 60) == Md40::Status::kOk);
+  CHECK(fixture.md40[0].WaitUntilReached(fixture.bus.now_us() + 3000000) == Md40::Status::kOk);
+
+  Dispatcher dispatcher(fixture.md40);
+  uint32_t arrivals = 0;
+  CHECK(dispatcher.Subscribe(0, Md40::Motor::State::kRuningToPosition, Md40::Motor::State::kReachedPosition, CountCallback, &arrivals) !=
+        Dispatcher::kInvalidSubscription);
+  SettleDispatcher(fixture, dispatcher);
+
+  CHECK(!fixture.md40[0].SubmitMoveTo(100, 60).rejected());
+  CHECK(PollBriefly(fixture, dispatcher));
+  CHECK(arrivals == 1);
+
+  SettleDispatcher(fixture, dispatcher);
+  Md40::MotorGroup group(fixture.md40, 0x01);
+  const int32_t positions[Md40::kMotorNum] = {110, 0, 0, 0};
+  const int32_t speeds[Md40::kMotorNum] = {60, 0, 0, 0};
+  CHECK(group.MoveTo(positions, speeds) == Md40::Status::kOk);
+  CHECK(PollBriefly(fixture, dispatcher));
+  CHECK(arrivals == 2);
+}
+
+// A bus error on one module costs only the command at the head of its queue, the command behind it still goes out on the next cycle.
+void TestBusUpdateAbandonsOnlyHeadCommand() {
+  em::MemoryBus bus;
+  em::Md40Simulator simulator(kI2cAddress);
+  em::Md40Simulator other_simulator(kI2cAddress + 1);
+  bus.Attach(simulator);
+  bus.Attach(other_simulator);
+  Md40 board(kI2cAddress, bus);
+  Md40 other_board(kI2cAddress + 1, bus);
+  Md40 *const boards[] = {&board, &other_board};
+  Md40Bus md40_bus(boards);
+  md40_bus.set_wait_policy(Md40::WaitPolicy::Spin(100000));
+  CHECK(md40_bus.Init() == Md40::Status::kOk);
+  const uint32_t command_count = simulator.command_count();
+
+  const Md40::CommandHandle first = board[0].SubmitStop();
+  const Md40::CommandHandle second = board[1].SubmitStop();
+  Md40::Motor::Snapshot snapshots[Md40Bus::kMotorNum];
+  bus.set_clock_hz(1000000);
+  bus.set_fault_injection(400000, 1);
+  CHECK(md40_bus.Update(snapshots) == Md40::Status::kBusError);
+  CHECK(first.Done());
+  CHECK(!second.Done());
+
+  bus.set_fault_injection(0, 0);
+  CHECK(md40_bus.Flush() == Md40::Status::kOk);
+  CHECK(second.Done());
+  CHECK(simulator.command_count() == command_count + 1);
+}
+
+// Bytes a, a + 1, ... read little-endian, the value a field at register address a has when every register holds its own address.
+int32_t AddressPattern(const uint8_t address, const uint8_t length) {
+  uint32_t value = 0;
+  for (uint8_t i = 0; i < length; i++) {
+    value |= static_cast<uint32_t>(static_cast<uint8_t>(address + i)) << (8 * i);
+  }
+  return static_cast<int32_t>(value);
+}
+
+// Merged segments have to deliver every field from its own offset, and merging has to stop at gaps that cost more than a separate segment and at
+// the transport's buffer length.
+void TestReadPlanMergesSegments() {
+  em::MemoryBus bus;
+  em::Md40MemoryDevice device(kI2cAddress);
+  bus.Attach(device);
+  Md40 md40(kI2cAddress, bus);
+  for (uint16_t reg = 0; reg < em::Md40MemoryDevice::kRegisterNum; reg++) {
+    device.registers()[reg] = static_cast<uint8_t>(reg);
+  }
+
+  // All fields of all motors: the state of motor 0 alone, then one segment from each motor's speed through the next motor's state, cut short of
+  // 32 bytes by the buffer. Four latches plus five write-reads.
+  const uint8_t all[Md40::kMotorNum] = {Md40::ReadPlan::kFieldAll, Md40::ReadPlan::kFieldAll, Md40::ReadPlan::kFieldAll, Md40::ReadPlan::kFieldAll};
+  Md40::ReadPlan all_plan(md40, all);
+  CHECK(all_plan.transaction_count() == 14);
+  Md40::Motor::Snapshot snapshots[Md40::kMotorNum];
+  bus.ResetCounters();
+  CHECK(all_plan.Execute(snapshots) == Md40::Status::kOk);
+  CHECK(bus.message_count() == 14);
+  CHECK(bus.byte_count() == 93);
+  for (uint8_t i = 0; i < Md40::kMotorNum; i++) {
+    const uint8_t base = i * 0x20;
+    // The latch write has just cleared the state register.
+    CHECK(static_cast<uint8_t>(snapshots[i].state) == 0);
+    CHECK(snapshots[i].speed == AddressPattern(0x34 + base, 4));
+    CHECK(snapshots[i].position == AddressPattern(0x38 + base, 4));
+    CHECK(snapshots[i].pulse_count == AddressPattern(0x3C + base, 4));
+    CHECK(snapshots[i].pwm_duty == static_cast<int16_t>(AddressPattern(0x40 + base, 2)));
+  }
+
+  // Speed and pulse count leave the 4-byte position between them, which is cheaper read as a second segment than skipped.
+  const uint8_t sparse[Md40::kMotorNum] = {Md40::ReadPlan::kFieldSpeed | Md40::ReadPlan::kFieldPulseCount, 0, 0, 0};
+  Md40::ReadPlan sparse_plan(md40, sparse);
+  CHECK(sparse_plan.transaction_count() == 5);
+  Md40::Motor::Snapshot sparse_snapshots[Md40::kMotorNum];
+  bus.ResetCounters();
+  CHECK(sparse_plan.Execute(sparse_snapshots) == Md40::Status::kOk);
+  CHECK(bus.message_count() == 5);
+  CHECK(bus.byte_count() == 17);
+  CHECK(sparse_snapshots[0].speed == AddressPattern(0x34, 4));
+  CHECK(sparse_snapshots[0].pulse_count == AddressPattern(0x3C, 4));
+  CHECK(sparse_snapshots[0].position == 0);
+
+  // Speed and position are adjacent and come in one read.
+  const uint8_t contiguous[Md40::kMotorNum] = {0, Md40::ReadPlan::kFieldSpeed | Md40::ReadPlan::kFieldPosition, 0, 0};
+  Md40::ReadPlan contiguous_plan(md40, contiguous);
+  CHECK(contiguous_plan.transaction_count() == 3);
+  Md40::Motor::Snapshot contiguous_snapshots[Md40::kMotorNum];
+  CHECK(contiguous_plan.Execute(contiguous_snapshots) == Md40::Status::kOk);
+  CHECK(contiguous_snapshots[1].speed == AddressPattern(0x54, 4));
+  CHECK(contiguous_snapshots[1].position == AddressPattern(0x58, 4));
+}
+
+// The wait policy spaces the polls of a command that does not finish and gives up at its timeout. The mailbox is then no longer known to be
+// empty, so the next command polls it first.
+void TestWaitPolicyBacksOffAndTimesOut() {
+  Fixture fixture;
+  CHECK(fixture.md40.Init() == Md40::Status::kOk);
+  // Without bus time the polls happen exactly when the policy says.
+  fixture.bus.set_clock_hz(0);
+  fixture.simulator.set_command_latency_us(30000);
+  fixture.md40.set_wait_policy(Md40::WaitPolicy::ExponentialBackoff(1000, 8000, 20000));
+
+  fixture.bus.ResetCounters();
+  const uint32_t start_us = fixture.bus.now_us();
+  CHECK(fixture.md40[0].Stop() == Md40::Status::kTimeout);
+  // The command write, then polls at 0, 1, 3, 7, 15 and 23 ms, the last one past the timeout.
+  CHECK(fixture.bus.message_count() == 1 + 6 * 2);
+  CHECK(fixture.bus.now_us() - start_us == 23000);
+  CHECK(fixture.md40.last_status() == Md40::Status::kTimeout);
+
+  fixture.bus.Advance(10000);
+  fixture.simulator.set_command_latency_us(0);
+  fixture.md40.set_wait_policy(Md40::WaitPolicy::FixedInterval(5000, 20000));
+  fixture.bus.ResetCounters();
+  CHECK(fixture.md40[0].Stop() == Md40::Status::kOk);
+  CHECK(fixture.bus.message_count() == 2 + 1 + 2);
+
+  // Known empty now, so the next command goes out without the poll.
+  fixture.bus.ResetCounters();
+  CHECK(fixture.md40[1].Stop() == Md40::Status::kOk);
+  CHECK(fixture.bus.message_count() == 1 + 2);
+}
+
+// A group stages all commands and writes each one as soon as the mailbox has taken the previous one: one write and one mailbox poll per motor,
+// with the starts exactly one poll and one write apart.
+void TestMotorGroupFiresBackToBack() {
+  Fixture fixture;
+  CHECK(fixture.md40.Init() == Md40::Status::kOk);
+  for (uint8_t i = 0; i < Md40::kMotorNum; i++) {
+    CHECK(fixture.md40[i].SetEncoderMode(12, 90, Md40::Motor::PhaseRelation::kAPhaseLeads) == Md40::Status::kOk);
+  }
+  fixture.simulator.set_command_latency_us(0);
+
+  Md40::MotorGroup group(fixture.md40);
+  const int32_t rpm[Md40::kMotorNum] = {30, -40, 50, -60};
+  fixture.bus.ResetCounters();
+  CHECK(group.RunSpeed(rpm) == Md40::Status::kOk);
+  CHECK(fixture.bus.message_count() == Md40::kMotorNum * 3);
+  // At 100 kHz and 9 bits per byte, a poll of the execute flag takes 400 us and a fused command write of 21 bytes (address, register and the 19
+  // mailbox bytes) 1910 us.
+  constexpr uint32_t kStartIntervalUs = 400 + 1910;
+  for (uint8_t i = 0; i < Md40::kMotorNum; i++) {
+    CHECK(group.start_offset_us(i) == i * kStartIntervalUs);
+  }
+  CHECK(group.start_skew_us() == (Md40::kMotorNum - 1) * kStartIntervalUs);
+
+  fixture.bus.Advance(500000);
+  for (uint8_t i = 0; i < Md40::kMotorNum; i++) {
+    CHECK(fixture.md40[i].speed() >= rpm[i] - 5 && fixture.md40[i].speed() <= rpm[i] + 5);
+  }
+
+  CHECK(group.Stop() == Md40::Status::kOk);
+  fixture.bus.Advance(500000);
+  for (uint8_t i = 0; i < Md40::kMotorNum; i++) {
+    CHECK(fixture.md40[i].speed() >= -1 && fixture.md40[i].speed() <= 1);
+  }
+}
+
+// Init reads the whole identity in one burst and caches it, so the getters cost no bus traffic, and the version is formatted into the caller's
+// buffer.
+void TestDeviceInfoIsReadOnceAndCached() {
+  Fixture fixture;
+  fixture.simulator.set_firmware_version(12, 3, 255);
+  const uint32_t command_count = fixture.simulator.command_count();
+  CHECK(fixture.md40.Init() == Md40::Status::kOk);
+  // The command write detection and the four resets.
+  CHECK(fixture.simulator.command_count() == command_count + 1 + Md40::kMotorNum);
+
+  fixture.bus.ResetCounters();
+  CHECK(fixture.md40.device_id() == 0x40);
+  const Md40::DeviceInfo &info = fixture.md40.device_info();
+  CHECK(strcmp(info.name, "MD40") == 0);
+  CHECK(fixture.bus.message_count() == 0);
+
+  char text[Md40::DeviceInfo::kVersionLength + 1] = {0};
+  CHECK(info.FormatFirmwareVersion(text, sizeof(text)) == 8);
+  CHECK(strcmp(text, "12.3.255") == 0);
+  char short_text[5] = {0};
+  CHECK(info.FormatFirmwareVersion(short_text, sizeof(short_text)) == 4);
+  CHECK(strcmp(short_text, "12.3") == 0);
+
+  // One write-read of the twelve identity registers.
+  Md40::DeviceInfo read;
+  CHECK(fixture.md40.ReadDeviceInfo(read) == Md40::Status::kOk);
+  CHECK(fixture.bus.message_count() == 2);
+  CHECK(fixture.bus.byte_count() == 2 + 1 + 12);
+  CHECK(read.firmware_version[0] == 12 && read.firmware_version[1] == 3 && read.firmware_version[2] == 255);
+}
+
+// A profile survives its serialized form, a corrupted copy is refused, and applying it sends only the commands that differ from the device.
+void TestConfigProfileAppliesOnlyDifferences() {
+  Fixture fixture;
+  CHECK(fixture.md40.Init() == Md40::Status::kOk);
+
+  // The onboard defaults except for the speed loop's P gain.
+  Md40::Motor::PidGains gains;
+  gains.speed_p = 2.5f;
+  gains.speed_i = 1.5f;
+  gains.speed_d = 1.0f;
+  gains.position_p = 10.0f;
+  gains.position_i = 1.0f;
+  gains.position_d = 1.0f;
+  Md40::ConfigProfile profile;
+  profile.SetEncoderMode(0, 12, 90, Md40::Motor::PhaseRelation::kAPhaseLeads);
+  profile.SetPidGains(0, gains);
+
+  uint8_t data[Md40::ConfigProfile::kSerializedLength] = {0};
+  profile.Serialize(data);
+  Md40::ConfigProfile loaded;
+  CHECK(loaded.Deserialize(data));
+  CHECK(loaded.has_mode(0) && loaded.has_pid_gains(0));
+  CHECK(!loaded.has_mode(1) && !loaded.has_pid_gains(1));
+  CHECK(loaded.pid_gains(0).speed_p == 2.5f);
+  data[sizeof(data) / 2] ^= 0x01;
+  Md40::ConfigProfile corrupted;
+  CHECK(!corrupted.Deserialize(data));
+
+  // The mode, which cannot be read back, and the one gain that differs.
+  uint32_t command_count = fixture.simulator.command_count();
+  CHECK(fixture.md40.ApplyConfigProfile(loaded) == Md40::Status::kOk);
+  CHECK(fixture.simulator.command_count() == command_count + 2);
+  CHECK(fixture.md40[0].speed_pid_p() == 2.5f);
+  CHECK(fixture.md40[0].position_pid_p() == 10.0f);
+
+  // Without the config cache the mode goes out again, the gains already match.
+  command_count = fixture.simulator.command_count();
+  CHECK(fixture.md40.ApplyConfigProfile(loaded) == Md40::Status::kOk);
+  CHECK(fixture.simulator.command_count() == command_count + 1);
+
+  // With it, a configured board needs no command at all.
+  fixture.md40[0].set_config_cache_enabled(true);
+  CHECK(fixture.md40.ApplyConfigProfile(loaded) == Md40::Status::kOk);
+  command_count = fixture.simulator.command_count();
+  CHECK(fixture.md40.ApplyConfigProfile(loaded) == Md40::Status::kOk);
+  CHECK(fixture.simulator.command_count() == command_count);
+}
+}  // namespace
+
+int main() {
+  TestLegacyFirmwareWritesCommandAndExecuteSeparately();
+  TestCurrentFirmwareFusesCommandAndExecute();
+  TestCommandWriteOverrideSkipsDetection();
+  TestFullQueueRejectsWithoutBlocking();
+  TestFailedFusedWriteIsNotResent();
+  TestSubmitPidGainsIsNonBlockingAndAllOrNothing();
+  TestCoordinatedMoveToDrainsQueueFirst();
+  TestReachedByWaitsForQueuedMove();
+  TestReachedByClampsLongEtaToDeadline();
+  TestNegotiateBusSpeedFallsBackToHighestCleanRate();
+  TestAutotunerFitsSimulatedSpeedLoop();
+  TestAutotunerTunesSimulatedPositionLoop();
+  TestRejectedSubmitLeavesConfigCacheUnchanged();
+  TestSimulatedMoveSettlesWithDefaultGains();
+  TestDispatcherWakesOnNewCommand();
+  TestBusUpdateAbandonsOnlyHeadCommand();
+  TestReadPlanMergesSegments();
+  TestWaitPolicyBacksOffAndTimesOut();
+  TestMotorGroupFiresBackToBack();
+  TestDeviceInfoIsReadOnceAndCached();
+  TestConfigProfileAppliesOnlyDifferences();
+
+  if (g_failures == 0) {
+    printf("all checks passed\n");
+  }
+  return g_failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,117 @@
+/**
+ * @~Chinese
+ * @file linux_i2c_benchmark.cpp
+ * @brief 测量在Linux i2c-dev上每次调用 Motor::position() 所需的系统调用数、总线传输数和耗时。
+ * @details 分别测量 LinuxI2cTransport 支持的每种传输方式，以及先写入寄存器地址、再单独读取的两步方式（与 TwoWire 的
+ * endTransmission + requestFrom 相同）作为对比。可以在没有MD40的Linux主机上使用内核的 i2c-stub 模块运行：
+ * @code
+ * sudo modprobe i2c-dev
+ * sudo modprobe i2c-stub chip_addr=0x16
+ * i2cdetect -l  # 找到 "SMBus stub driver" 对应的 /dev/i2c-N
+ * g++ -std=gnu++11 -O2 -Isrc extras/linux_i2c_benchmark/linux_i2c_benchmark.cpp src/md40_linux_i2c_transport.cpp -o linux_i2c_benchmark
+ * sudo ./linux_i2c_benchmark /dev/i2c-N [I2C地址] [次数]
+ * @endcode
+ * i2c-stub 只支持SMBus，因此只会测量SMBus方式。
+ */
+/**
+ * @~English
+ * @file linux_i2c_benchmark.cpp
+ * @brief Measure the system calls, bus transactions and time per Motor::position() call on Linux i2c-dev.
+ * @details Every transfer method LinuxI2cTransport supports is measured, together with a two-step method that writes the register address and
+ * then reads separately (the same as TwoWire's endTransmission + requestFrom) for comparison. It runs on a Linux host without an MD40 using the
+ * kernel's i2c-stub module:
+ * @code
+ * sudo modprobe i2c-dev
+ * sudo modprobe i2c-stub chip_addr=0x16
+ * i2cdetect -l  # find the /dev/i2c-N of the "SMBus stub driver"
+ * g++ -std=gnu++11 -O2 -Isrc extras/linux_i2c_benchmark/linux_i2c_benchmark.cpp src/md40_linux_i2c_transport.cpp -o linux_i2c_benchmark
+ * sudo ./linux_i2c_benchmark /dev/i2c-N [i2c address] [iterations]
+ * @endcode
+ * i2c-stub only speaks SMBus, so only the SMBus method is measured there.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "md40.h"
+#include "md40_linux_i2c_transport.h"
+
+namespace {
+constexpr uint32_t kDefaultIterations = 1000;
+
+// Reads in two steps like the TwoWire port: a write of the register address, then a separate read.
+class TwoStepTransport : public em::LinuxI2cTransport {
+ public:
+  TwoStepTransport(em::LinuxI2cBus &bus) : em::LinuxI2cTransport(bus) {
+  }
+
+  em::I2cResult WriteRead(const uint8_t i2c_address, const uint8_t reg, void *data, const uint8_t length) {
+    const em::I2cResult result = Write(i2c_address, reg, nullptr, 0);
+    if (result != em::I2cResult::kOk) {
+      return result;
+    }
+    return Read(i2c_address, data, length);
+  }
+};
+
+const char *MethodName(const em::LinuxI2cBus::Method method) {
+  switch (method) {
+    case em::LinuxI2cBus::Method::kI2cRdwr:
+      return "i2c_rdwr";
+    default:
+      return "smbus";
+  }
+}
+
+template <typename Transport>
+void Measure(const char *label, em::LinuxI2cBus &bus, const uint8_t i2c_address, const uint32_t iterations) {
+  em::BasicMd40<Transport> md40(i2c_address, bus);
+  Transport clock(bus);
+
+  bus.ResetCounters();
+  const uint32_t start_time = clock.Micros();
+  for (uint32_t i = 0; i < iterations; i++) {
+    md40[0].position();
+  }
+  const uint32_t elapsed_us = clock.Micros() - start_time;
+
+  if (md40.last_status() != em::BasicMd40<Transport>::Status::kOk) {
+    printf("%-18s failed\n", label);
+    return;
+  }
+  printf("%-18s %14.2f %18.2f %10.1f\n",
+         label,
+         static_cast<double>(bus.syscall_count()) / iterations,
+         static_cast<double>(bus.transaction_count()) / iterations,
+         static_cast<double>(elapsed_us) / iterations);
+}
+}  // namespace
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    fprintf(stderr, "usage: %s /dev/i2c-N [i2c address] [iterations]\n", argv[0]);
+    return 2;
+  }
+  const uint8_t i2c_address = argc > 2 ? strtoul(argv[2], nullptr, 0) : em::BasicMd40<em::LinuxI2cTransport>::kDefaultI2cAddress;
+  const uint32_t iterations = argc > 3 ? strtoul(argv[3], nullptr, 0) : kDefaultIterations;
+
+  em::LinuxI2cBus bus;
+  if (!bus.Open(argv[1])) {
+    fprintf(stderr, "cannot open %s as an I2C bus\n", argv[1]);
+    return 1;
+  }
+
+  printf("%-18s %14s %18s %10s\n", "method", "syscalls/call", "transactions/call", "us/call");
+  const em::LinuxI2cBus::Method methods[] = {em::LinuxI2cBus::Method::kI2cRdwr, em::LinuxI2cBus::Method::kSmbus};
+  for (const auto method : methods) {
+    if (!bus.set_method(method)) {
+      continue;
+    }
+    char label[32] = {0};
+    snprintf(label, sizeof(label), "%s", MethodName(method));
+    Measure<em::LinuxI2cTransport>(label, bus, i2c_address, iterations);
+    snprintf(label, sizeof(label), "%s two-step", MethodName(method));
+    Measure<TwoStepTransport>(label, bus, i2c_address, iterations);
+  }
+  return 0;
+}
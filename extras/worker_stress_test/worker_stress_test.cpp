@@ -0,0 +1,231 @@
+/**
+ * @~Chinese
+ * @file worker_stress_test.cpp
+ * @brief 在主机上对 BasicMd40Worker 做并发压力测试：多个生产者线程同时提交命令，一个线程不停读取运行数据。
+ * @details 设备记录每条被执行的命令，并在每次锁存时把同一个戳记写入所有电机的速度、位置和脉冲计数寄存器。
+ * 测试检查每个生产者的命令按提交顺序各执行一次，并且读到的每份运行数据中所有字段都带同一个戳记、戳记和发布序号都不倒退，即没有撕裂的快照。
+ * 配合 ThreadSanitizer 编译可以同时检查数据竞争：
+ * @code
+ * g++ -std=gnu++11 -O2 -pthread -Isrc extras/worker_stress_test/worker_stress_test.cpp src/md40_memory_transport.cpp -o worker_stress_test
+ * g++ -std=gnu++11 -O1 -g -fsanitize=thread -pthread -Isrc extras/worker_stress_test/worker_stress_test.cpp src/md40_memory_transport.cpp \
+ *     -o worker_stress_test_tsan
+ * ./worker_stress_test
+ * @endcode
+ * 每个失败的检查打印一行，任何检查失败时程序返回1。
+ */
+/**
+ * @~English
+ * @file worker_stress_test.cpp
+ * @brief Concurrency stress test of BasicMd40Worker on the host: several producer threads submit commands at once while one thread keeps reading
+ * the telemetry.
+ * @details The device logs every command it executes and, on every latch, writes one stamp into the speed, position and pulse count registers of
+ * all motors. The test checks that the commands of every producer are executed once each in the order they were submitted, and that every
+ * telemetry read carries the same stamp in all fields with neither the stamp nor the publication number ever going backwards, i.e. no snapshot is
+ * torn. Built with ThreadSanitizer it checks for data races as well:
+ * @code
+ * g++ -std=gnu++11 -O2 -pthread -Isrc extras/worker_stress_test/worker_stress_test.cpp src/md40_memory_transport.cpp -o worker_stress_test
+ * g++ -std=gnu++11 -O1 -g -fsanitize=thread -pthread -Isrc extras/worker_stress_test/worker_stress_test.cpp src/md40_memory_transport.cpp \
+ *     -o worker_stress_test_tsan
+ * ./worker_stress_test
+ * @endcode
+ * Every failed check prints one line, and the program returns 1 when any check failed.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include <chrono>
+#include <thread>
+
+#include "md40_memory_transport.h"
+#include "md40_worker.h"
+
+namespace {
+using Md40 = em::BasicMd40<em::MemoryTransport>;
+using Worker = em::BasicMd40Worker<em::MemoryTransport>;
+
+constexpr uint8_t kI2cAddress = Md40::kDefaultI2cAddress;
+constexpr uint32_t kProducerNum = 8;
+constexpr uint32_t kCommandsPerProducer = 2000;
+constexpr uint32_t kCommandNum = kProducerNum * kCommandsPerProducer;
+// Room for the command write detection and the resets of Init as well.
+constexpr uint32_t kLogCapacity = kCommandNum + 1 + Md40::kMotorNum;
+constexpr uint32_t kTimeoutMs = 60000;
+
+// Register map of the MD40, only what the device below needs.
+constexpr uint8_t kCommandType = 0x11;
+constexpr uint8_t kCommandIndex = 0x12;
+constexpr uint8_t kCommandParam = 0x13;
+constexpr uint8_t kCommandExecute = 0x23;
+constexpr uint8_t kState = 0x24;
+constexpr uint8_t kSpeed = 0x34;
+constexpr uint8_t kPosition = 0x38;
+constexpr uint8_t kPulseCount = 0x3C;
+constexpr uint8_t kPwmDuty = 0x40;
+constexpr uint8_t kMotorStateOffset = 0x20;
+constexpr uint8_t kSetPosition = 9;
+
+int g_failures = 0;
+
+#define CHECK(condition)                                                            \
+  do {                                                                              \
+    if (!(condition)) {                                                             \
+      fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #condition); \
+      g_failures++;                                                                 \
+    }                                                                               \
+  } while (0)
+
+// Only the worker thread touches the bus, so everything here except the executed count is plain data. The log is read after End() has joined
+// the worker.
+class StampingDevice : public em::Md40MemoryDevice {
+ public:
+  struct Entry {
+    uint8_t type;
+    uint8_t index;
+    int32_t param;
+  };
+
+  explicit StampingDevice(const uint8_t i2c_address) : Md40MemoryDevice(i2c_address) {
+  }
+
+  uint32_t executed_count() const {
+    return __atomic_load_n(&executed_count_, __ATOMIC_ACQUIRE);
+  }
+
+  const Entry &entry(const uint32_t i) const {
+    return log_[i];
+  }
+
+ protected:
+  void OnWrite(const uint8_t reg, const uint8_t length) override {
+    if (reg <= kCommandExecute && kCommandExecute - reg < length && registers_[kCommandExecute] != 0) {
+      const uint32_t count = __atomic_load_n(&executed_count_, __ATOMIC_RELAXED);
+      if (count < kLogCapacity) {
+        log_[count].type = registers_[kCommandType];
+        log_[count].index = registers_[kCommandIndex];
+        memcpy(&log_[count].param, &registers_[kCommandParam], sizeof(log_[count].param));
+      }
+      __atomic_store_n(&executed_count_, count + 1, __ATOMIC_RELEASE);
+    }
+    Md40MemoryDevice::OnWrite(reg, length);
+
+    // The read plan latches motor 0 first, so a new stamp per latch round makes every field of every motor in one telemetry equal.
+    if (reg == kState && length == 1) {
+      stamp_++;
+      for (uint8_t i = 0; i < Md40::kMotorNum; i++) {
+        const uint8_t offset = i * kMotorStateOffset;
+        memcpy(&registers_[kSpeed + offset], &stamp_, sizeof(stamp_));
+        memcpy(&registers_[kPosition + offset], &stamp_, sizeof(stamp_));
+        memcpy(&registers_[kPulseCount + offset], &stamp_, sizeof(stamp_));
+        const int16_t pwm_duty = static_cast<int16_t>(stamp_ & 0x7FFF);
+        memcpy(&registers_[kPwmDuty + offset], &pwm_duty, sizeof(pwm_duty));
+      }
+    }
+  }
+
+ private:
+  Entry log_[kLogCapacity];
+  uint32_t executed_count_ = 0;
+  int32_t stamp_ = 0;
+};
+
+// Producer p uses motor p % kMotorNum and numbers its commands 1, 2, 3... in the low bits of the position.
+int32_t Tag(const uint32_t producer, const uint32_t k) {
+  return static_cast<int32_t>(producer << 20 | k);
+}
+
+void Produce(Worker &worker, const uint32_t producer) {
+  const uint8_t index = producer % Md40::kMotorNum;
+  for (uint32_t k = 1; k <= kCommandsPerProducer; k++) {
+    while (!worker.SetPosition(index, Tag(producer, k))) {
+      std::this_thread::yield();
+    }
+  }
+}
+
+void ReadTelemetry(const Worker &worker, const bool &stop, uint32_t &read_count) {
+  uint32_t last_number = 0;
+  int32_t last_stamp = 0;
+  while (!__atomic_load_n(&stop, __ATOMIC_ACQUIRE)) {
+    Worker::Telemetry telemetry;
+    if (!worker.ReadTelemetry(telemetry)) {
+      std::this_thread::yield();
+      continue;
+    }
+    read_count++;
+
+    CHECK(telemetry.number >= last_number);
+    const int32_t stamp = telemetry.snapshots[0].speed;
+    CHECK(stamp >= last_stamp);
+    for (uint8_t i = 0; i < Md40::kMotorNum; i++) {
+      const Md40::Motor::Snapshot &snapshot = telemetry.snapshots[i];
+      CHECK(snapshot.speed == stamp && snapshot.position == stamp && snapshot.pulse_count == stamp);
+      CHECK(snapshot.pwm_duty == static_cast<int16_t>(stamp & 0x7FFF));
+    }
+    last_number = telemetry.number;
+    last_stamp = stamp;
+  }
+}
+}  // namespace
+
+int main() {
+  em::MemoryBus bus;
+  static StampingDevice device(kI2cAddress);
+  bus.Attach(device);
+  Md40 md40(kI2cAddress, bus);
+  CHECK(md40.Init() == Md40::Status::kOk);
+  const uint32_t reset_count = device.executed_count();
+
+  Worker worker(md40);
+  CHECK(worker.Begin());
+
+  bool stop = false;
+  uint32_t read_count = 0;
+  std::thread reader(ReadTelemetry, std::cref(worker), std::cref(stop), std::ref(read_count));
+  std::thread producers[kProducerNum];
+  for (uint32_t p = 0; p < kProducerNum; p++) {
+    producers[p] = std::thread(Produce, std::ref(worker), p);
+  }
+  for (auto &producer : producers) {
+    producer.join();
+  }
+
+  const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(kTimeoutMs);
+  while (device.executed_count() < reset_count + kCommandNum && std::chrono::steady_clock::now() < deadline) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  __atomic_store_n(&stop, true, __ATOMIC_RELEASE);
+  reader.join();
+  worker.End();
+
+  CHECK(device.executed_count() == reset_count + kCommandNum);
+  CHECK(worker.failed_command_count() == 0);
+  CHECK(read_count > 0);
+
+  // Every producer's commands were executed once each, in the order it submitted them, on its own motor.
+  uint32_t next_k[kProducerNum];
+  for (auto &k : next_k) {
+    k = 1;
+  }
+  for (uint32_t i = reset_count; i < device.executed_count() && i < kLogCapacity; i++) {
+    const StampingDevice::Entry &entry = device.entry(i);
+    const uint32_t producer = static_cast<uint32_t>(entry.param) >> 20;
+    const uint32_t k = static_cast<uint32_t>(entry.param) & 0xFFFFF;
+    CHECK(entry.type == kSetPosition);
+    CHECK(producer < kProducerNum);
+    if (producer >= kProducerNum) {
+      continue;
+    }
+    CHECK(entry.index == producer % Md40::kMotorNum);
+    CHECK(k == next_k[producer]);
+    next_k[producer] = k + 1;
+  }
+  for (uint32_t p = 0; p < kProducerNum; p++) {
+    CHECK(next_k[p] == kCommandsPerProducer + 1);
+  }
+
+  if (g_failures == 0) {
+    printf("all checks passed, %u telemetry reads\n", static_cast<unsigned>(read_count));
+  }
+  return g_failures == 0 ? 0 : 1;
+}
@@ -2,10 +2,13 @@
 #ifndef _EM_CHECK_H_
 #define _EM_CHECK_H_
 
+#ifdef ARDUINO
 #include <Arduino.h>
+#endif
 
-#ifdef ARDUINO_ARCH_ESP32
+#if defined(ARDUINO_ARCH_ESP32) || !defined(ARDUINO)
 #include <stdio.h>
+#include <stdlib.h>
 #endif
 
 /**
@@ -20,7 +23,7 @@
  * @param file 发生断言的源文件名
  * @param line 发生断言的行号
  * @details 当断言失败时，此函数会输出错误信息并停止程序运行
- *          - 在ESP32平台上使用printf输出并调用abort()
+ *          - 在ESP32平台和非Arduino平台上使用printf输出并调用abort()
  *          - 在其他Arduino平台上使用Serial输出并进入死循环
  */
 /**
@@ -31,11 +34,11 @@
  * @param file The source file name where assertion occurred
  * @param line The line number where assertion occurred
  * @details When an assertion fails, this function outputs error information and stops program execution
- *          - On ESP32 platform, uses printf output and calls abort()
+ *          - On ESP32 and non-Arduino platforms, uses printf output and calls abort()
  *          - On other Arduino platforms, uses Serial output and enters an infinite loop
  */
 static inline void AssertFailHandle(const char* expr, const char* function, const char* file, const int line) {
-#ifdef ARDUINO_ARCH_ESP32
+#if defined(ARDUINO_ARCH_ESP32) || !defined(ARDUINO)
   printf("\nassert failed: %s %s:%d (%s)\n", function, file, line, expr);
   abort();
 #else
@@ -0,0 +1,140 @@
+#pragma once
+
+#ifndef _EM_MPSC_QUEUE_H_
+#define _EM_MPSC_QUEUE_H_
+
+#ifdef ARDUINO
+#include <Arduino.h>
+#else
+#include <stdint.h>
+#endif
+
+/**
+ * @file em_mpsc_queue.h
+ */
+
+namespace em {
+
+/**
+ * @~Chinese
+ * @class MpscQueue
+ * @brief 预分配的多生产者单消费者无锁有界队列。
+ * @details 每个槽位带一个序号：生产者用比较交换抢占写入位置，写完元素后以释放语义更新槽位序号；消费者看到序号就绪后取走元素，
+ * 再把序号推进一圈让出槽位。生产者之间只在抢占写入位置时竞争，不会等待其他生产者或消费者。队列满时 @ref Push 立即返回false。
+ * 需要32位比较交换，因此只适用于ESP32和主机平台，不适用于AVR。
+ * @tparam T 元素类型，需可复制。
+ * @tparam kCapacity 容量，必须是2的幂。
+ */
+/**
+ * @~English
+ * @class MpscQueue
+ * @brief A preallocated lock-free bounded multi-producer single-consumer queue.
+ * @details Every slot carries a sequence number: a producer claims a write position with a compare-and-swap, writes the element, then updates
+ * the slot's sequence number with release semantics. The consumer takes the element once it sees the sequence number ready and advances it by
+ * one lap to hand the slot back. Producers only contend on claiming a position and never wait for each other or the consumer. When the queue is
+ * full @ref Push returns false at once. A 32-bit compare-and-swap is required, so this is for ESP32 and host builds, not AVR.
+ * @tparam T Element type, must be copyable.
+ * @tparam kCapacity Capacity, must be a power of two.
+ */
+template <typename T, uint32_t kCapacity>
+class MpscQueue {
+ public:
+  static_assert(kCapacity > 0 && (kCapacity & (kCapacity - 1)) == 0, "kCapacity must be a power of two");
+
+  /**
+   * @~Chinese
+   * @brief 构造函数。
+   */
+  /**
+   * @~English
+   * @brief Constructor.
+   */
+  MpscQueue();
+
+  /**
+   * @~Chinese
+   * @brief 写入一个元素，可以由任意数量的生产者同时调用。
+   * @param[in] item 元素。
+   * @return 成功返回true，队列已满时返回false。
+   */
+  /**
+   * @~English
+   * @brief Write one element, any number of producers may call this concurrently.
+   * @param[in] item Element.
+   * @return True on success, false when the queue is full.
+   */
+  bool Push(const T &item);
+
+  /**
+   * @~Chinese
+   * @brief 取出一个元素，只能由消费者调用。
+   * @param[out] item 取出的元素。
+   * @return 成功返回true，队列为空或最早的元素尚未写完时返回false。
+   */
+  /**
+   * @~English
+   * @brief Take out one element, consumer only.
+   * @param[out] item The element taken out.
+   * @return True on success, false when the queue is empty or the oldest element is still being written.
+   */
+  bool Pop(T &item);
+
+ private:
+  MpscQueue(const MpscQueue &) = delete;
+  MpscQueue &operator=(const MpscQueue &) = delete;
+
+  struct Slot {
+    uint32_t sequence = 0;
+    T item;
+  };
+
+  Slot slots_[kCapacity];
+  uint32_t push_position_ = 0;
+  uint32_t pop_position_ = 0;
+};
+
+template <typename T, uint32_t kCapacity>
+MpscQueue<T, kCapacity>::MpscQueue() {
+  for (uint32_t i = 0; i < kCapacity; i++) {
+    slots_[i].sequence = i;
+  }
+}
+
+template <typename T, uint32_t kCapacity>
+bool MpscQueue<T, kCapacity>::Push(const T &item) {
+  uint32_t position = __atomic_load_n(&push_position_, __ATOMIC_RELAXED);
+  while (true) {
+    Slot &slot = slots_[position & (kCapacity - 1)];
+    const int32_t lag = static_cast<int32_t>(__atomic_load_n(&slot.sequence, __ATOMIC_ACQUIRE) - position);
+    if (lag < 0) {
+      return false;
+    }
+
+    if (lag > 0) {
+      // Another producer took this position, start over from the current one.
+      position = __atomic_load_n(&push_position_, __ATOMIC_RELAXED);
+      continue;
+    }
+
+    if (__atomic_compare_exchange_n(&push_position_, &position, position + 1, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+      slot.item = item;
+      __atomic_store_n(&slot.sequence, position + 1, __ATOMIC_RELEASE);
+      return true;
+    }
+  }
+}
+
+template <typename T, uint32_t kCapacity>
+bool MpscQueue<T, kCapacity>::Pop(T &item) {
+  Slot &slot = slots_[pop_position_ & (kCapacity - 1)];
+  if (__atomic_load_n(&slot.sequence, __ATOMIC_ACQUIRE) != pop_position_ + 1) {
+    return false;
+  }
+
+  item = slot.item;
+  __atomic_store_n(&slot.sequence, pop_position_ + kCapacity, __ATOMIC_RELEASE);
+  pop_position_++;
+  return true;
+}
+}  // namespace em
+#endif
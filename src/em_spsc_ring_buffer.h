@@ -0,0 +1,158 @@
+#pragma once
+
+#ifndef _EM_SPSC_RING_BUFFER_H_
+#define _EM_SPSC_RING_BUFFER_H_
+
+#ifdef ARDUINO
+#include <Arduino.h>
+#else
+#include <stdint.h>
+#endif
+
+/**
+ * @file em_spsc_ring_buffer.h
+ */
+
+namespace em {
+
+/**
+ * @~Chinese
+ * @class SpscRingBuffer
+ * @brief 预分配的单生产者单消费者无锁环形缓冲区。
+ * @details 生产者和消费者可以位于不同的线程、任务或中断中，互不阻塞：读写位置是自由递增的计数器，分别只由一方写入，
+ * 通过GCC的 __atomic 内建函数以获取/释放语义发布，元素本身不需要原子操作。缓冲区满时 @ref Push 丢弃新元素并增加溢出计数，
+ * 不会覆盖消费者尚未取走的数据。AVR上计数器为单字节（单字节读写是原子的），因此容量最多为128。
+ * @tparam T 元素类型，需可复制。
+ * @tparam kCapacity 容量，必须是2的幂。
+ */
+/**
+ * @~English
+ * @class SpscRingBuffer
+ * @brief A preallocated lock-free single-producer single-consumer ring buffer.
+ * @details The producer and the consumer may live in different threads, tasks or interrupts and never block each other: the read and write
+ * positions are free-running counters, each written by one side only and published with acquire/release semantics through GCC's __atomic
+ * builtins, the elements themselves need no atomic access. When the buffer is full @ref Push drops the new element and increments the overflow
+ * count instead of overwriting data the consumer has not taken yet. On AVR the counters are single bytes (single-byte loads and stores are
+ * atomic), so the capacity is at most 128.
+ * @tparam T Element type, must be copyable.
+ * @tparam kCapacity Capacity, must be a power of two.
+ */
+template <typename T, uint16_t kCapacity>
+class SpscRingBuffer {
+ public:
+  /**
+   * @~Chinese
+   * @brief 读写位置计数器的类型。
+   */
+  /**
+   * @~English
+   * @brief Type of the read and write position counters.
+   */
+#ifdef __AVR__
+  using Index = uint8_t;
+#else
+  using Index = uint32_t;
+#endif
+
+  static_assert(kCapacity > 0 && (kCapacity & (kCapacity - 1)) == 0, "kCapacity must be a power of two");
+  static_assert(kCapacity <= static_cast<Index>(~static_cast<Index>(0)) / 2 + 1, "kCapacity is too large for the index type");
+
+  /**
+   * @~Chinese
+   * @brief 写入一个元素，只能由生产者调用。
+   * @param[in] item 元素。
+   * @return 成功返回true，缓冲区已满时丢弃该元素、增加溢出计数并返回false。
+   */
+  /**
+   * @~English
+   * @brief Write one element, producer only.
+   * @param[in] item Element.
+   * @return True on success. When the buffer is full the element is dropped, the overflow count is incremented and false is returned.
+   */
+  bool Push(const T &item);
+
+  /**
+   * @~Chinese
+   * @brief 取出最多 max_count 个元素，只能由消费者调用。
+   * @param[out] items 存放元素的数组。
+   * @param[in] max_count 最多取出的元素数。
+   * @return 实际取出的元素数。
+   */
+  /**
+   * @~English
+   * @brief Take out up to max_count elements, consumer only.
+   * @param[out] items Array receiving the elements.
+   * @param[in] max_count Maximum number of elements to take out.
+   * @return Number of elements taken out.
+   */
+  uint16_t Pop(T *items, const uint16_t max_count);
+
+  /**
+   * @~Chinese
+   * @brief 获取当前的元素数，生产者和消费者都可以调用，结果可能立即过时。
+   * @return 元素数。
+   */
+  /**
+   * @~English
+   * @brief Get the current number of elements, callable from both sides, the result may be stale immediately.
+   * @return Number of elements.
+   */
+  uint16_t size() const;
+
+  /**
+   * @~Chinese
+   * @brief 获取因缓冲区已满而丢弃的元素数。由生产者写入，在其他上下文中读取时在AVR上可能读到不完整的值。
+   * @return 溢出计数。
+   */
+  /**
+   * @~English
+   * @brief Get the number of elements dropped because the buffer was full. Written by the producer, reading it from another context may see a
+   * torn value on AVR.
+   * @return Overflow count.
+   */
+  uint32_t overflow_count() const;
+
+ private:
+  T items_[kCapacity];
+  Index head_ = 0;
+  Index tail_ = 0;
+  volatile uint32_t overflow_count_ = 0;
+};
+
+template <typename T, uint16_t kCapacity>
+bool SpscRingBuffer<T, kCapacity>::Push(const T &item) {
+  const Index tail = __atomic_load_n(&tail_, __ATOMIC_RELAXED);
+  const Index head = __atomic_load_n(&head_, __ATOMIC_ACQUIRE);
+  if (static_cast<Index>(tail - head) >= kCapacity) {
+    overflow_count_ = overflow_count_ + 1;
+    return false;
+  }
+  items_[tail & (kCapacity - 1)] = item;
+  __atomic_store_n(&tail_, static_cast<Index>(tail + 1), __ATOMIC_RELEASE);
+  return true;
+}
+
+template <typename T, uint16_t kCapacity>
+uint16_t SpscRingBuffer<T, kCapacity>::Pop(T *items, const uint16_t max_count) {
+  const Index head = __atomic_load_n(&head_, __ATOMIC_RELAXED);
+  const Index tail = __atomic_load_n(&tail_, __ATOMIC_ACQUIRE);
+  const Index available = tail - head;
+  const uint16_t count = available < max_count ? available : max_count;
+  for (uint16_t i = 0; i < count; i++) {
+    items[i] = items_[static_cast<Index>(head + i) & (kCapacity - 1)];
+  }
+  __atomic_store_n(&head_, static_cast<Index>(head + count), __ATOMIC_RELEASE);
+  return count;
+}
+
+template <typename T, uint16_t kCapacity>
+uint16_t SpscRingBuffer<T, kCapacity>::size() const {
+  return static_cast<Index>(__atomic_load_n(&tail_, __ATOMIC_ACQUIRE) - __atomic_load_n(&head_, __ATOMIC_ACQUIRE));
+}
+
+template <typename T, uint16_t kCapacity>
+uint32_t SpscRingBuffer<T, kCapacity>::overflow_count() const {
+  return overflow_count_;
+}
+}  // namespace em
+#endif
@@ -3,10 +3,17 @@
 #ifndef _EM_MD40_H_
 #define _EM_MD40_H_
 
+#ifdef ARDUINO
 #include <Arduino.h>
-#include <Wire.h>
+#else
+#include <stdint.h>
+#include <string.h>
+
+#include <string>
+#endif
 
 #include "em_check.h"
+#include "md40_transport.h"
 
 /**
  * @file md40.h
@@ -14,17 +21,34 @@
 
 namespace em {
 
+#ifndef ARDUINO
+/**
+ * @~Chinese
+ * @brief 非Arduino平台上使用 std::string 代替Arduino的 String 。
+ */
+/**
+ * @~English
+ * @brief std::string stands in for the Arduino String on non-Arduino platforms.
+ */
+using String = std::string;
+#endif
+
 /**
  * @~Chinese
- * @class Md40
- * @brief Md40是一个用于控制MD40模块的驱动类，用来驱动电机。
+ * @class BasicMd40
+ * @brief BasicMd40是一个用于控制MD40模块的驱动类，用来驱动电机。
+ * @details 总线访问由模板参数 Transport 提供，参见 @ref transport_concept 。Arduino上通常直接使用 @ref Md40 。
+ * @tparam Transport 传输层类型。
  */
 /**
  * @~English
- * @class Md40
- * @brief Md40 is a driver class used to control the MD40 module for motor driving.
+ * @class BasicMd40
+ * @brief BasicMd40 is a driver class used to control the MD40 module for motor driving.
+ * @details Bus access is provided by the Transport template parameter, see @ref transport_concept. On Arduino, use @ref Md40 directly.
+ * @tparam Transport Transport type.
  */
-class Md40 {
+template <typename Transport>
+class BasicMd40 {
  public:
   /**
    * @~Chinese
@@ -47,489 +71,2042 @@ class Md40 {
 
   /**
    * @~Chinese
-   * @class Md40::Motor
-   * @brief Motor类代表一个电机对象，提供对单个电机的控制功能，如速度、位置和PID参数设置。
+   * @brief 操作结果。
    */
   /**
    * @~English
-   * @class Md40::Motor
-   * @brief The Motor class represents a motor object, providing control functions for a single motor, such as speed, position, and PID parameters
-   * setting.
+   * @brief Operation result.
    */
-  class Motor {
-   public:
+  enum class Status : uint8_t {
     /**
      * @~Chinese
-     * @brief 用于明确电机正转时编码器AB相的相位关系，以便在脉冲计数及后续速度计算等操作中依据正确的相位关系进行处理。
+     * @brief 操作成功。
      */
     /**
      * @~English
-     * @brief Used to clarify the phase relationship between phase A and phase B of the encoder when the motor is rotating
-     * forward, so that the correct phase relationship can be used in operations such as pulse counting and subsequent speed
-     * calculation.
+     * @brief The operation succeeded.
      */
-    enum class PhaseRelation : uint8_t {
-      /**
-       * @~Chinese
-       * @brief 表示电机正转时A相领先于B相。
-       */
-      /**
-       * @~English
-       * @brief Represents the situation where phase A leads phase B when the motor is rotating forward.
-       */
-      kAPhaseLeads = 0,
+    kOk = 0,
 
-      /**
-       * @~Chinese
-       * @brief 表示电机正转时B相领先于A相。
-       */
-      /**
-       * @~English
-       * @brief Represents the situation where phase B leads phase A when the motor is rotating forward.
-       */
-      kBPhaseLeads = 1,
-    };
+    /**
+     * @~Chinese
+     * @brief 在等待策略的超时时间内未完成。
+     */
+    /**
+     * @~English
+     * @brief The operation did not complete within the timeout of the wait policy.
+     */
+    kTimeout = 1,
 
     /**
      * @~Chinese
-     * @brief 电机状态枚举。
+     * @brief I2C传输在用尽重试次数后仍然失败。
      */
     /**
      * @~English
-     * @brief Motor state enumeration.
+     * @brief An I2C transaction still failed after the retry budget was used up.
      */
-    enum class State : uint8_t {
-      /**
-       * @~Chinese
-       * @brief 表示电机处于空闲状态。
-       */
-      /**
-       * @~English
-       * @brief Indicates that the motor is in idle state.
-       */
-      kIdle = 0,
+    kBusError = 2,
 
-      /**
-       * @~Chinese
-       * @brief 表示电机处于PWM占空比模式运行。
-       */
-      /**
-       * @~English
-       * @brief Indicates that the motor is running in PWM duty mode.
-       */
-      kRuningWithPwmDuty = 1,
+    /**
+     * @~Chinese
+     * @brief 命令队列已满，命令未被放入队列。调用 @ref Md40::Poll 推进已有的命令后重新提交。
+     */
+    /**
+     * @~English
+     * @brief The command queue is full and the command was not queued. Call @ref Md40::Poll to advance the queued commands, then submit again.
+     */
+    kQueueFull = 3,
+  };
+
+  /**
+   * @~Chinese
+   * @brief 命令的写入方式。
+   */
+  /**
+   * @~English
+   * @brief How commands are written to the MD40.
+   */
+  enum class CommandWrite : uint8_t {
+    /**
+     * @~Chinese
+     * @brief 由 @ref Init 检测：写入一条不改变任何设置的命令，同时写入执行标志，若命令邮箱随后清空则使用一次写入，否则单独写入执行标志。
+     */
+    /**
+     * @~English
+     * @brief Detected by @ref Init: a command that changes no setting is written together with its execute flag, and if the command mailbox
+     * clears afterwards commands are written in one go, otherwise the execute flag is written on its own.
+     */
+    kDetect = 0,
+
+    /**
+     * @~Chinese
+     * @brief 命令类型、电机索引、参数和执行标志通过一次I2C写入提交。
+     */
+    /**
+     * @~English
+     * @brief The command type, motor index, parameters and execute flag go out in a single I2C write.
+     */
+    kFused = 1,
+
+    /**
+     * @~Chinese
+     * @brief 先写入命令，再单独写入执行标志，适用于所有固件。
+     */
+    /**
+     * @~English
+     * @brief The command is written first and the execute flag on its own afterwards, which works with every firmware.
+     */
+    kSeparate = 2,
+  };
 
+  /**
+   * @~Chinese
+   * @brief 等待命令执行完毕时的轮询策略。
+   */
+  /**
+   * @~English
+   * @brief Polling policy used while waiting for commands to be executed.
+   */
+  struct WaitPolicy {
+    /**
+     * @~Chinese
+     * @brief 轮询方式。
+     */
+    /**
+     * @~English
+     * @brief Polling mode.
+     */
+    enum class Mode : uint8_t {
       /**
        * @~Chinese
-       * @brief 表示电机处于速度模式运行。
+       * @brief 不间断地连续轮询。
        */
       /**
        * @~English
-       * @brief Indicates that the motor is running in speed mode.
+       * @brief Poll back to back without pause.
        */
-      kRuningWithSpeed = 2,
+      kSpin = 0,
 
       /**
        * @~Chinese
-       * @brief 表示电机正在执行位置闭环运动，向目标位置运行中。
+       * @brief 每次轮询之间间隔固定时间。
        */
       /**
        * @~English
-       * @brief Indicates that the motor is executing position closed-loop motion and moving towards the target position.
+       * @brief Pause for a fixed interval between polls.
        */
-      kRuningToPosition = 3,
+      kFixedInterval = 1,
 
       /**
        * @~Chinese
-       * @brief 表示电机到达目标位置状态。
+       * @brief 轮询间隔从 interval_us 开始每次加倍，最大不超过 max_interval_us 。
        */
       /**
        * @~English
-       * @brief Indicates that the motor has reached the target position.
+       * @brief The interval between polls starts at interval_us and doubles every time, up to max_interval_us.
        */
-      kReachedPosition = 4,
+      kExponentialBackoff = 2,
     };
 
     /**
      * @~Chinese
-     * @brief 构造函数。
-     * @param[in] index 电机索引。
-     * @param[in] i2c_address I2C地址。
-     * @param[in] wire TwoWire 对象引用。
+     * @brief 创建连续轮询策略。
+     * @param[in] timeout_us 超时时间（微秒），0表示不超时。
+     * @return 等待策略。
      */
     /**
      * @~English
-     * @brief Constructor.
-     * @param[in] index Motor index.
-     * @param[in] i2c_address I2C address.
-     * @param[in] wire TwoWire object reference.
+     * @brief Create a spinning policy.
+     * @param[in] timeout_us Timeout in microseconds, 0 means no timeout.
+     * @return Wait policy.
      */
-    Motor(const uint8_t index, const uint8_t i2c_address, TwoWire &wire);
+    static WaitPolicy Spin(const uint32_t timeout_us = 0);
 
     /**
      * @~Chinese
-     * @brief 重置电机。
+     * @brief 创建固定间隔轮询策略。
+     * @param[in] interval_us 轮询间隔（微秒）。
+     * @param[in] timeout_us 超时时间（微秒），0表示不超时。
+     * @return 等待策略。
      */
     /**
      * @~English
-     * @brief Reset the motor.
+     * @brief Create a fixed interval policy.
+     * @param[in] interval_us Interval between polls in microseconds.
+     * @param[in] timeout_us Timeout in microseconds, 0 means no timeout.
+     * @return Wait policy.
      */
-    void Reset();
+    static WaitPolicy FixedInterval(const uint32_t interval_us, const uint32_t timeout_us = 0);
 
     /**
      * @~Chinese
-     * @brief 设置电机为编码器模式。
-     * @param[in] ppr 每转脉冲数。
-     * @param[in] reduction_ratio 减速比。
-     * @param[in] phase_relation 相位关系（A相领先或B相领先，指电机正转时的情况），参数说明请查阅： @ref PhaseRelation 。
+     * @brief 创建指数退避轮询策略。
+     * @param[in] interval_us 初始轮询间隔（微秒）。
+     * @param[in] max_interval_us 最大轮询间隔（微秒）。
+     * @param[in] timeout_us 超时时间（微秒），0表示不超时。
+     * @return 等待策略。
      */
     /**
      * @~English
-     * @brief Set the motor to encoder mode.
-     * @param[in] ppr Pulses per revolution.
-     * @param[in] reduction_ratio Reduction ratio.
-     * @param[in] phase_relation Phase relationship (A phase leads or B phase leads, referring to the situation when the motor is
-     * rotating forward), for parameter descriptions, please refer to: @ref PhaseRelation.
+     * @brief Create an exponential backoff policy.
+     * @param[in] interval_us Initial interval between polls in microseconds.
+     * @param[in] max_interval_us Maximum interval between polls in microseconds.
+     * @param[in] timeout_us Timeout in microseconds, 0 means no timeout.
+     * @return Wait policy.
      */
-    void SetEncoderMode(const uint16_t ppr, const uint16_t reduction_ratio, const PhaseRelation phase_relation);
+    static WaitPolicy ExponentialBackoff(const uint32_t interval_us, const uint32_t max_interval_us, const uint32_t timeout_us = 0);
 
     /**
      * @~Chinese
-     * @brief 设置电机为直流模式。
+     * @brief 轮询方式。
      */
     /**
      * @~English
-     * @brief Set the motor to DC mode.
+     * @brief Polling mode.
      */
-    void SetDcMode();
+    Mode mode = Mode::kSpin;
 
     /**
      * @~Chinese
-     * @brief 获取速度PID控制器的比例（P）值。
-     * @return 速度PID控制器的比例（P）值。
+     * @brief 轮询间隔（微秒），指数退避时为初始间隔。
      */
     /**
      * @~English
-     * @brief Get the proportional (P) value of the speed PID controller.
-     * @return The proportional (P) value of the speed PID controller.
+     * @brief Interval between polls in microseconds, the initial interval for exponential backoff.
      */
-    float speed_pid_p();
+    uint32_t interval_us = 0;
 
     /**
      * @~Chinese
-     * @brief 设置速度PID控制器的比例（P）值。
-     * @param[in] value 速度PID控制器的比例（P）值。
+     * @brief 指数退避的最大轮询间隔（微秒）。
      */
     /**
      * @~English
-     * @brief Set the proportional (P) value of the speed PID controller.
-     * @param[in] value The proportional (P) value of the speed PID controller.
+     * @brief Maximum interval between polls for exponential backoff, in microseconds.
      */
-    void set_speed_pid_p(const float value);
+    uint32_t max_interval_us = 0;
 
     /**
      * @~Chinese
-     * @brief 获取速度PID控制器的积分（I）值。
-     * @return 速度PID控制器的积分（I）值。
+     * @brief 每次等待的超时时间（微秒），0表示不超时。
      */
     /**
      * @~English
-     * @brief Get the integral (I) value of the speed PID controller.
-     * @return The integral (I) value of the speed PID controller.
+     * @brief Timeout of each wait in microseconds, 0 means no timeout.
      */
-    float speed_pid_i();
+    uint32_t timeout_us = 0;
+  };
 
+  /**
+   * @~Chinese
+   * @struct BusSpeedPolicy
+   * @brief @ref NegotiateBusSpeed 的参数。
+   */
+  /**
+   * @~English
+   * @struct BusSpeedPolicy
+   * @brief Parameters of @ref NegotiateBusSpeed.
+   */
+  struct BusSpeedPolicy {
     /**
      * @~Chinese
-     * @brief 设置速度PID控制器的积分（I）值。
-     * @param[in] value 速度PID控制器的积分（I）值。
+     * @brief 默认的候选总线时钟频率（Hz）：100kHz、400kHz和1MHz。
      */
     /**
      * @~English
-     * @brief Set the integral (I) value of the speed PID controller.
-     * @param[in] value The integral (I) value of the speed PID controller.
+     * @brief Default candidate bus clock rates (Hz): 100 kHz, 400 kHz and 1 MHz.
      */
-    void set_speed_pid_i(const float value);
+    static constexpr uint32_t kDefaultClocksHz[] = {100000, 400000, 1000000};
 
     /**
      * @~Chinese
-     * @brief 获取速度PID控制器的微分（D）值。
-     * @return 速度PID控制器的微分（D）值。
+     * @brief 候选总线时钟频率（Hz），必须从低到高排列。第一个频率用于读取比对的参考值，应当是确定可靠的频率。
      */
     /**
      * @~English
-     * @brief Get the derivative (D) value of the speed PID controller.
-     * @return The derivative (D) value of the speed PID controller.
+     * @brief Candidate bus clock rates (Hz), in ascending order. The reference values to compare against are read at the first one, so it should
+     * be a rate known to be reliable.
      */
-    float speed_pid_d();
+    const uint32_t *clocks_hz = kDefaultClocksHz;
 
     /**
      * @~Chinese
-     * @brief 设置速度PID控制器的微分（D）值。
-     * @param[in] value 速度PID控制器的微分（D）值。
+     * @brief 候选总线时钟频率的个数，至少为1。
      */
     /**
      * @~English
-     * @brief Set the derivative (D) value of the speed PID controller.
-     * @param[in] value The derivative (D) value of the speed PID controller.
+     * @brief Number of candidate bus clock rates, at least 1.
      */
-    void set_speed_pid_d(const float value);
+    uint8_t clock_num = sizeof(kDefaultClocksHz) / sizeof(kDefaultClocksHz[0]);
 
     /**
      * @~Chinese
-     * @brief 获取位置PID控制器的比例（P）值。
-     * @return 位置PID控制器的比例（P）值。
+     * @brief 每个频率上的检查次数。
      */
     /**
      * @~English
-     * @brief Get the proportional (P) value of the position PID controller.
-     * @return The proportional (P) value of the position PID controller.
+     * @brief Number of checks at every rate.
      */
-    float position_pid_p();
+    uint8_t trial_count = 8;
 
     /**
      * @~Chinese
-     * @brief 设置位置PID控制器的比例（P）值。
-     * @param[in] value 位置PID控制器的比例（P）值。
+     * @brief 每个频率上允许失败的检查次数，超过时该频率不通过。
      */
     /**
      * @~English
-     * @brief Set the proportional (P) value of the position PID controller.
-     * @param[in] value The proportional (P) value of the position PID controller.
+     * @brief Number of checks allowed to fail at every rate, a rate with more failures does not pass.
      */
-    void set_position_pid_p(const float value);
+    uint8_t error_budget = 0;
+  };
 
+  /**
+   * @~Chinese
+   * @brief 设备信息：设备ID、固件版本和设备名称，由一次连续读取获得。
+   * @details 普通数据结构，不分配内存。 @ref Init 读取并缓存一份，参见 @ref device_info 。
+   */
+  /**
+   * @~English
+   * @brief Device information: device ID, firmware version and device name, fetched in one burst read.
+   * @details Plain data, nothing is allocated. @ref Init reads and caches a copy, see @ref device_info.
+   */
+  struct DeviceInfo {
     /**
      * @~Chinese
-     * @brief 获取位置PID控制器的积分（I）值。
-     * @return 位置PID控制器的积分（I）值。
+     * @brief 设备名称的最大长度，不含结束符。
      */
     /**
      * @~English
-     * @brief Get the integral (I) value of the position PID controller.
-     * @return The integral (I) value of the position PID controller.
+     * @brief Maximum length of the device name, excluding the terminator.
      */
-    float position_pid_i();
+    static constexpr uint8_t kNameLength = 8;
 
     /**
      * @~Chinese
-     * @brief 设置位置PID控制器的积分（I）值。
-     * @param[in] value 位置PID控制器的积分（I）值。
+     * @brief 固件版本字符串的最大长度，不含结束符（"255.255.255"）。
      */
     /**
      * @~English
-     * @brief Set the integral (I) value of the position PID controller.
-     * @param[in] value The integral (I) value of the position PID controller.
+     * @brief Maximum length of the firmware version string, excluding the terminator ("255.255.255").
      */
-    void set_position_pid_i(const float value);
+    static constexpr uint8_t kVersionLength = 11;
 
     /**
      * @~Chinese
-     * @brief 获取位置PID控制器的微分（D）值。
-     * @return 位置PID控制器的微分（D）值。
+     * @brief 将固件版本格式化为"主版本.次版本.修订号"，写入调用者提供的缓冲区，过长时截断，始终以0结尾。
+     * @param[out] buffer 缓冲区，长度为 kVersionLength + 1 时总能容纳完整的版本。
+     * @param[in] size 缓冲区长度，必须大于0。
+     * @return 写入的字符数，不含结束符。
      */
     /**
      * @~English
-     * @brief Get the derivative (D) value of the position PID controller.
-     * @return The derivative (D) value of the position PID controller.
+     * @brief Format the firmware version as "major.minor.patch" into a caller-provided buffer, truncated when too long and always terminated.
+     * @param[out] buffer Buffer, kVersionLength + 1 bytes always hold the whole version.
+     * @param[in] size Buffer length, must be greater than 0.
+     * @return Number of characters written, excluding the terminator.
      */
-    float position_pid_d();
+    uint8_t FormatFirmwareVersion(char *buffer, const uint8_t size) const;
 
     /**
      * @~Chinese
-     * @brief 设置位置PID控制器的微分（D）值。
-     * @param[in] value 位置PID控制器的微分（D）值。
+     * @brief 设备ID。
      */
     /**
      * @~English
-     * @brief Set the derivative (D) value of the position PID controller.
-     * @param[in] value The derivative (D) value of the position PID controller.
+     * @brief Device ID.
      */
-    void set_position_pid_d(const float value);
+    uint8_t device_id;
 
     /**
      * @~Chinese
-     * @brief 设定电机输出轴的位置值，单位为角度(°)。（电机输出轴累计角度值，例如：360度表示正转1整圈，-360度表示反转一整圈）
-     * @param[in] position 位置设定值，单位为角度(°)，表示从零位开始的累计角度。
+     * @brief 固件版本：主版本、次版本、修订号。
      */
     /**
      * @~English
-     * @brief Set the position value of the motor output shaft unit degrees (°). (Accumulated angle value of motor output shaft, for example: 360
-     * degrees represents 1 full circle of forward rotation, -360 degrees represents 1 full circle of reverse rotation)
-     * @param[in] position Position setting value, unit degree (°), represents the cumulative angle from zero position.
+     * @brief Firmware version: major, minor, patch.
      */
-    void set_position(const int32_t position);
+    uint8_t firmware_version[3];
 
     /**
      * @~Chinese
-     * @brief 设定电机的编码器脉冲计数。该计数值是在A相下降沿的时候计数，如果是正转会加一，反转则减一。
-     * @param[in] pulse_count 编码器脉冲数。
+     * @brief 设备名称，以0结尾。
      */
     /**
      * @~English
-     * @brief Set the encoder pulse count for the motor. The count value is counted at the falling edge of phase A. If it is positive, add one; if it
-     * is negative, subtract one.
-     * @param[in] pulse_count Encoder pulse count.
+     * @brief Device name, zero terminated.
      */
-    void set_pulse_count(const int32_t pulse_count);
+    char name[kNameLength + 1];
+  };
 
+  /**
+   * @~Chinese
+   * @class Md40::CommandHandle
+   * @brief 非阻塞命令的句柄，用于查询命令是否已被执行。
+   * @details Submit* 函数从不阻塞：命令队列已满时命令不会被放入队列，返回的句柄 @ref rejected 为true， @ref Md40::last_status 为
+   * @ref Status::kQueueFull 。调用 @ref Md40::Poll 腾出空间后重新提交即可。
+   */
+  /**
+   * @~English
+   * @class Md40::CommandHandle
+   * @brief Handle of a non-blocking command, used to query whether the command has been executed.
+   * @details The Submit* functions never block: when the command queue is full the command is not queued, the returned handle's @ref rejected
+   * is true and @ref Md40::last_status is @ref Status::kQueueFull. Submit again once @ref Md40::Poll has made room.
+   */
+  class CommandHandle {
+   public:
     /**
      * @~Chinese
-     * @brief 停止电机运行。
+     * @brief 构造一个不对应任何命令的句柄，其 @ref Done 始终返回true。
      */
     /**
      * @~English
-     * @brief Stop the motor.
+     * @brief Construct a handle that refers to no command, its @ref Done always returns true.
      */
-    void Stop();
+    CommandHandle() = default;
 
     /**
      * @~Chinese
-     * @brief 以设定的速度值（RPM）设置电机输出轴转速。正数代表正转，负数代表反转。
-     * @param[in] rpm 速度设定值（RPM）。正数代表正转，负数代表反转。
+     * @brief 查询命令是否已结束（已被执行，或因 @ref Md40::Wait 超时被放弃）。该函数不访问总线，需调用 @ref Md40::Poll 推进命令的执行。
+     * @return 命令已结束时返回true。
      */
     /**
      * @~English
-     * @brief Set the motor output shaft speed to the set speed value (RPM). Positive numbers represent forward rotation, while negative numbers
-     * represent reverse rotation.
-     * @param[in] rpm Speed setting value (RPM). Positive numbers represent forward rotation, while negative numbers represent reverse rotation.
+     * @brief Query whether the command has finished (executed, or abandoned by a timed out @ref Md40::Wait). This function does not touch the
+     * bus, call @ref Md40::Poll to advance the command.
+     * @return True once the command has finished.
      */
-    void RunSpeed(const int32_t rpm);
+    bool Done() const;
 
     /**
      * @~Chinese
-     * @brief 以设定的PWM占空比运行电机。正数代表正转，负数代表反转。
-     * @param[in] pwm_duty PWM占空比（取值范围 -1023到1023）。正数代表正转，负数代表反转。
+     * @brief 查询命令是否因命令队列已满而未被放入队列。被拒绝的命令不会被执行，其 @ref Done 返回true。
+     * @return 命令被拒绝时返回true。
      */
     /**
      * @~English
-     * @brief Run the motor with the set PWM duty. Positive numbers represent forward rotation, while negative numbers represent reverse
-     * rotation.
-     * @param[in] pwm_duty PWM duty (value range -1023 to 1023). Positive values represent forward rotation, negative values represent reverse
-     * rotation.
+     * @brief Query whether the command was turned away because the command queue was full. A rejected command is never executed, its
+     * @ref Done returns true.
+     * @return True when the command was rejected.
      */
-    void RunPwmDuty(const int16_t pwm_duty);
+    bool rejected() const;
+
+   private:
+    friend class BasicMd40;
+
+    CommandHandle(const BasicMd40 *md40, const uint16_t sequence);
+
+    const BasicMd40 *md40_ = nullptr;
+    uint16_t sequence_ = 0;
+    bool rejected_ = false;
+  };
+
+  /**
+   * @~Chinese
+   * @class Md40::Motor
+   * @brief Motor类代表一个电机对象，提供对单个电机的控制功能，如速度、位置和PID参数设置。
+   */
+  /**
+   * @~English
+   * @class Md40::Motor
+   * @brief The Motor class represents a motor object, providing control functions for a single motor, such as speed, position, and PID parameters
+   * setting.
+   */
+  class Motor {
+   public:
+    /**
+     * @~Chinese
+     * @brief 用于明确电机正转时编码器AB相的相位关系，以便在脉冲计数及后续速度计算等操作中依据正确的相位关系进行处理。
+     */
+    /**
+     * @~English
+     * @brief Used to clarify the phase relationship between phase A and phase B of the encoder when the motor is rotating
+     * forward, so that the correct phase relationship can be used in operations such as pulse counting and subsequent speed
+     * calculation.
+     */
+    enum class PhaseRelation : uint8_t {
+      /**
+       * @~Chinese
+       * @brief 表示电机正转时A相领先于B相。
+       */
+      /**
+       * @~English
+       * @brief Represents the situation where phase A leads phase B when the motor is rotating forward.
+       */
+      kAPhaseLeads = 0,
+
+      /**
+       * @~Chinese
+       * @brief 表示电机正转时B相领先于A相。
+       */
+      /**
+       * @~English
+       * @brief Represents the situation where phase B leads phase A when the motor is rotating forward.
+       */
+      kBPhaseLeads = 1,
+    };
+
+    /**
+     * @~Chinese
+     * @brief 电机状态枚举。
+     */
+    /**
+     * @~English
+     * @brief Motor state enumeration.
+     */
+    enum class State : uint8_t {
+      /**
+       * @~Chinese
+       * @brief 表示电机处于空闲状态。
+       */
+      /**
+       * @~English
+       * @brief Indicates that the motor is in idle state.
+       */
+      kIdle = 0,
+
+      /**
+       * @~Chinese
+       * @brief 表示电机处于PWM占空比模式运行。
+       */
+      /**
+       * @~English
+       * @brief Indicates that the motor is running in PWM duty mode.
+       */
+      kRuningWithPwmDuty = 1,
+
+      /**
+       * @~Chinese
+       * @brief 表示电机处于速度模式运行。
+       */
+      /**
+       * @~English
+       * @brief Indicates that the motor is running in speed mode.
+       */
+      kRuningWithSpeed = 2,
+
+      /**
+       * @~Chinese
+       * @brief 表示电机正在执行位置闭环运动，向目标位置运行中。
+       */
+      /**
+       * @~English
+       * @brief Indicates that the motor is executing position closed-loop motion and moving towards the target position.
+       */
+      kRuningToPosition = 3,
+
+      /**
+       * @~Chinese
+       * @brief 表示电机到达目标位置状态。
+       */
+      /**
+       * @~English
+       * @brief Indicates that the motor has reached the target position.
+       */
+      kReachedPosition = 4,
+    };
+
+    /**
+     * @~Chinese
+     * @brief 电机运行数据快照，由 @ref ReadSnapshot 一次性读取。
+     */
+    /**
+     * @~English
+     * @brief Snapshot of the motor's runtime data, read in one go by @ref ReadSnapshot.
+     */
+    struct Snapshot {
+      /**
+       * @~Chinese
+       * @brief 电机状态，参见 @ref state 。
+       */
+      /**
+       * @~English
+       * @brief Motor state, see @ref state.
+       */
+      State state = State::kIdle;
+
+      /**
+       * @~Chinese
+       * @brief 电机输出轴转速（RPM），参见 @ref speed 。
+       */
+      /**
+       * @~English
+       * @brief Motor output shaft speed (RPM), see @ref speed.
+       */
+      int32_t speed = 0;
+
+      /**
+       * @~Chinese
+       * @brief 电机输出轴位置，单位为角度(°)，参见 @ref position 。
+       */
+      /**
+       * @~English
+       * @brief Motor output shaft position, unit degrees (°), see @ref position.
+       */
+      int32_t position = 0;
+
+      /**
+       * @~Chinese
+       * @brief 编码器脉冲计数，参见 @ref pulse_count 。
+       */
+      /**
+       * @~English
+       * @brief Encoder pulse count, see @ref pulse_count.
+       */
+      int32_t pulse_count = 0;
+
+      /**
+       * @~Chinese
+       * @brief PWM占空比，参见 @ref pwm_duty 。
+       */
+      /**
+       * @~English
+       * @brief PWM duty, see @ref pwm_duty.
+       */
+      int16_t pwm_duty = 0;
+    };
+
+    /**
+     * @~Chinese
+     * @brief 电机全部六个PID参数，由 @ref SetPidGains 一次性设置，由 @ref pid_gains 一次性读取。
+     * @details MD40以参数值乘以100后的uint16保存，有效范围为0到655.35，超出范围的值会被限制到范围内，并四舍五入到0.01。
+     */
+    /**
+     * @~English
+     * @brief All six PID gains of a motor, set in one go by @ref SetPidGains and read in one go by @ref pid_gains.
+     * @details The MD40 stores each gain as a uint16 of the value multiplied by 100, so the valid range is 0 to 655.35. Values out of range
+     * are clamped into it, and values are rounded to 0.01.
+     */
+    struct PidGains {
+      /**
+       * @~Chinese
+       * @brief 速度PID控制器的比例（P）值，参见 @ref speed_pid_p 。
+       */
+      /**
+       * @~English
+       * @brief The proportional (P) value of the speed PID controller, see @ref speed_pid_p.
+       */
+      float speed_p = 0;
+
+      /**
+       * @~Chinese
+       * @brief 速度PID控制器的积分（I）值，参见 @ref speed_pid_i 。
+       */
+      /**
+       * @~English
+       * @brief The integral (I) value of the speed PID controller, see @ref speed_pid_i.
+       */
+      float speed_i = 0;
+
+      /**
+       * @~Chinese
+       * @brief 速度PID控制器的微分（D）值，参见 @ref speed_pid_d 。
+       */
+      /**
+       * @~English
+       * @brief The derivative (D) value of the speed PID controller, see @ref speed_pid_d.
+       */
+      float speed_d = 0;
+
+      /**
+       * @~Chinese
+       * @brief 位置PID控制器的比例（P）值，参见 @ref position_pid_p 。
+       */
+      /**
+       * @~English
+       * @brief The proportional (P) value of the position PID controller, see @ref position_pid_p.
+       */
+      float position_p = 0;
+
+      /**
+       * @~Chinese
+       * @brief 位置PID控制器的积分（I）值，参见 @ref position_pid_i 。
+       */
+      /**
+       * @~English
+       * @brief The integral (I) value of the position PID controller, see @ref position_pid_i.
+       */
+      float position_i = 0;
+
+      /**
+       * @~Chinese
+       * @brief 位置PID控制器的微分（D）值，参见 @ref position_pid_d 。
+       */
+      /**
+       * @~English
+       * @brief The derivative (D) value of the position PID controller, see @ref position_pid_d.
+       */
+      float position_d = 0;
+    };
+
+    /**
+     * @~Chinese
+     * @brief 构造函数。
+     * @param[in] md40 电机所属的 Md40 对象引用。
+     * @param[in] index 电机索引。
+     */
+    /**
+     * @~English
+     * @brief Constructor.
+     * @param[in] md40 Reference to the Md40 object the motor belongs to.
+     * @param[in] index Motor index.
+     */
+    Motor(BasicMd40 &md40, const uint8_t index);
+
+    /**
+     * @~Chinese
+     * @brief 重置电机。
+     * @return 执行结果，在等待策略的超时时间内未执行完毕时返回 @ref Status::kTimeout 。
+     */
+    /**
+     * @~English
+     * @brief Reset the motor.
+     * @return Execution result, @ref Status::kTimeout if the command was not executed within the timeout of the wait policy.
+     */
+    Status Reset();
+
+    /**
+     * @~Chinese
+     * @brief 重置电机，非阻塞版本的 @ref Reset 。
+     * @details 命令被放入命令队列后立即返回，由 @ref Md40::Poll 推进执行。
+     * @return 命令句柄，用于查询命令是否已被执行。
+     */
+    /**
+     * @~English
+     * @brief Non-blocking variant of @ref Reset.
+     * @details The command is queued and the call returns immediately, execution is advanced by @ref Md40::Poll.
+     * @return Command handle used to query whether the command has been executed.
+     */
+    CommandHandle SubmitReset();
+
+    /**
+     * @~Chinese
+     * @brief 设置电机为编码器模式。
+     * @param[in] ppr 每转脉冲数。
+     * @param[in] reduction_ratio 减速比。
+     * @param[in] phase_relation 相位关系（A相领先或B相领先，指电机正转时的情况），参数说明请查阅： @ref PhaseRelation 。
+     * @return 执行结果，在等待策略的超时时间内未执行完毕时返回 @ref Status::kTimeout 。
+     */
+    /**
+     * @~English
+     * @brief Set the motor to encoder mode.
+     * @param[in] ppr Pulses per revolution.
+     * @param[in] reduction_ratio Reduction ratio.
+     * @param[in] phase_relation Phase relationship (A phase leads or B phase leads, referring to the situation when the motor is
+     * rotating forward), for parameter descriptions, please refer to: @ref PhaseRelation.
+     * @return Execution result, @ref Status::kTimeout if the command was not executed within the timeout of the wait policy.
+     */
+    Status SetEncoderMode(const uint16_t ppr, const uint16_t reduction_ratio, const PhaseRelation phase_relation);
+
+    /**
+     * @~Chinese
+     * @brief 设置电机为编码器模式，非阻塞版本的 @ref SetEncoderMode 。
+     * @details 命令被放入命令队列后立即返回，由 @ref Md40::Poll 推进执行。
+     * @param[in] ppr 每转脉冲数。
+     * @param[in] reduction_ratio 减速比。
+     * @param[in] phase_relation 相位关系，参见 @ref PhaseRelation 。
+     * @return 命令句柄，用于查询命令是否已被执行。
+     */
+    /**
+     * @~English
+     * @brief Non-blocking variant of @ref SetEncoderMode.
+     * @details The command is queued and the call returns immediately, execution is advanced by @ref Md40::Poll.
+     * @param[in] ppr Pulses per revolution.
+     * @param[in] reduction_ratio Reduction ratio.
+     * @param[in] phase_relation Phase relationship, see @ref PhaseRelation.
+     * @return Command handle used to query whether the command has been executed.
+     */
+    CommandHandle SubmitEncoderMode(const uint16_t ppr, const uint16_t reduction_ratio, const PhaseRelation phase_relation);
+
+    /**
+     * @~Chinese
+     * @brief 设置电机为直流模式。
+     * @return 执行结果，在等待策略的超时时间内未执行完毕时返回 @ref Status::kTimeout 。
+     */
+    /**
+     * @~English
+     * @brief Set the motor to DC mode.
+     * @return Execution result, @ref Status::kTimeout if the command was not executed within the timeout of the wait policy.
+     */
+    Status SetDcMode();
+
+    /**
+     * @~Chinese
+     * @brief 设置电机为直流模式，非阻塞版本的 @ref SetDcMode 。
+     * @details 命令被放入命令队列后立即返回，由 @ref Md40::Poll 推进执行。
+     * @return 命令句柄，用于查询命令是否已被执行。
+     */
+    /**
+     * @~English
+     * @brief Non-blocking variant of @ref SetDcMode.
+     * @details The command is queued and the call returns immediately, execution is advanced by @ref Md40::Poll.
+     * @return Command handle used to query whether the command has been executed.
+     */
+    CommandHandle SubmitDcMode();
+
+    /**
+     * @~Chinese
+     * @brief 获取速度PID控制器的比例（P）值。
+     * @return 速度PID控制器的比例（P）值。
+     */
+    /**
+     * @~English
+     * @brief Get the proportional (P) value of the speed PID controller.
+     * @return The proportional (P) value of the speed PID controller.
+     */
+    float speed_pid_p();
+
+    /**
+     * @~Chinese
+     * @brief 设置速度PID控制器的比例（P）值。
+     * @param[in] value 速度PID控制器的比例（P）值。
+     * @return 执行结果，在等待策略的超时时间内未执行完毕时返回 @ref Status::kTimeout 。
+     */
+    /**
+     * @~English
+     * @brief Set the proportional (P) value of the speed PID controller.
+     * @param[in] value The proportional (P) value of the speed PID controller.
+     * @return Execution result, @ref Status::kTimeout if the command was not executed within the timeout of the wait policy.
+     */
+    Status set_speed_pid_p(const float value);
+
+    /**
+     * @~Chinese
+     * @brief 设置速度PID控制器的比例（P）值，非阻塞版本的 @ref set_speed_pid_p 。
+     * @details 命令被放入命令队列后立即返回，由 @ref Md40::Poll 推进执行。
+     * @param[in] value 速度PID控制器的比例（P）值。
+     * @return 命令句柄，用于查询命令是否已被执行。
+     */
+    /**
+     * @~English
+     * @brief Non-blocking variant of @ref set_speed_pid_p.
+     * @details The command is queued and the call returns immediately, execution is advanced by @ref Md40::Poll.
+     * @param[in] value The proportional (P) value of the speed PID controller.
+     * @return Command handle used to query whether the command has been executed.
+     */
+    CommandHandle SubmitSpeedPidP(const float value);
+
+    /**
+     * @~Chinese
+     * @brief 获取速度PID控制器的积分（I）值。
+     * @return 速度PID控制器的积分（I）值。
+     */
+    /**
+     * @~English
+     * @brief Get the integral (I) value of the speed PID controller.
+     * @return The integral (I) value of the speed PID controller.
+     */
+    float speed_pid_i();
+
+    /**
+     * @~Chinese
+     * @brief 设置速度PID控制器的积分（I）值。
+     * @param[in] value 速度PID控制器的积分（I）值。
+     * @return 执行结果，在等待策略的超时时间内未执行完毕时返回 @ref Status::kTimeout 。
+     */
+    /**
+     * @~English
+     * @brief Set the integral (I) value of the speed PID controller.
+     * @param[in] value The integral (I) value of the speed PID controller.
+     * @return Execution result, @ref Status::kTimeout if the command was not executed within the timeout of the wait policy.
+     */
+    Status set_speed_pid_i(const float value);
+
+    /**
+     * @~Chinese
+     * @brief 设置速度PID控制器的积分（I）值，非阻塞版本的 @ref set_speed_pid_i 。
+     * @details 命令被放入命令队列后立即返回，由 @ref Md40::Poll 推进执行。
+     * @param[in] value 速度PID控制器的积分（I）值。
+     * @return 命令句柄，用于查询命令是否已被执行。
+     */
+    /**
+     * @~English
+     * @brief Non-blocking variant of @ref set_speed_pid_i.
+     * @details The command is queued and the call returns immediately, execution is advanced by @ref Md40::Poll.
+     * @param[in] value The integral (I) value of the speed PID controller.
+     * @return Command handle used to query whether the command has been executed.
+     */
+    CommandHandle SubmitSpeedPidI(const float value);
+
+    /**
+     * @~Chinese
+     * @brief 获取速度PID控制器的微分（D）值。
+     * @return 速度PID控制器的微分（D）值。
+     */
+    /**
+     * @~English
+     * @brief Get the derivative (D) value of the speed PID controller.
+     * @return The derivative (D) value of the speed PID controller.
+     */
+    float speed_pid_d();
+
+    /**
+     * @~Chinese
+     * @brief 设置速度PID控制器的微分（D）值。
+     * @param[in] value 速度PID控制器的微分（D）值。
+     * @return 执行结果，在等待策略的超时时间内未执行完毕时返回 @ref Status::kTimeout 。
+     */
+    /**
+     * @~English
+     * @brief Set the derivative (D) value of the speed PID controller.
+     * @param[in] value The derivative (D) value of the speed PID controller.
+     * @return Execution result, @ref Status::kTimeout if the command was not executed within the timeout of the wait policy.
+     */
+    Status set_speed_pid_d(const float value);
+
+    /**
+     * @~Chinese
+     * @brief 设置速度PID控制器的微分（D）值，非阻塞版本的 @ref set_speed_pid_d 。
+     * @details 命令被放入命令队列后立即返回，由 @ref Md40::Poll 推进执行。
+     * @param[in] value 速度PID控制器的微分（D）值。
+     * @return 命令句柄，用于查询命令是否已被执行。
+     */
+    /**
+     * @~English
+     * @brief Non-blocking variant of @ref set_speed_pid_d.
+     * @details The command is queued and the call returns immediately, execution is advanced by @ref Md40::Poll.
+     * @param[in] value The derivative (D) value of the speed PID controller.
+     * @return Command handle used to query whether the command has been executed.
+     */
+    CommandHandle SubmitSpeedPidD(const float value);
+
+    /**
+     * @~Chinese
+     * @brief 获取位置PID控制器的比例（P）值。
+     * @return 位置PID控制器的比例（P）值。
+     */
+    /**
+     * @~English
+     * @brief Get the proportional (P) value of the position PID controller.
+     * @return The proportional (P) value of the position PID controller.
+     */
+    float position_pid_p();
+
+    /**
+     * @~Chinese
+     * @brief 设置位置PID控制器的比例（P）值。
+     * @param[in] value 位置PID控制器的比例（P）值。
+     * @return 执行结果，在等待策略的超时时间内未执行完毕时返回 @ref Status::kTimeout 。
+     */
+    /**
+     * @~English
+     * @brief Set the proportional (P) value of the position PID controller.
+     * @param[in] value The proportional (P) value of the position PID controller.
+     * @return Execution result, @ref Status::kTimeout if the command was not executed within the timeout of the wait policy.
+     */
+    Status set_position_pid_p(const float value);
+
+    /**
+     * @~Chinese
+     * @brief 设置位置PID控制器的比例（P）值，非阻塞版本的 @ref set_position_pid_p 。
+     * @details 命令被放入命令队列后立即返回，由 @ref Md40::Poll 推进执行。
+     * @param[in] value 位置PID控制器的比例（P）值。
+     * @return 命令句柄，用于查询命令是否已被执行。
+     */
+    /**
+     * @~English
+     * @brief Non-blocking variant of @ref set_position_pid_p.
+     * @details The command is queued and the call returns immediately, execution is advanced by @ref Md40::Poll.
+     * @param[in] value The proportional (P) value of the position PID controller.
+     * @return Command handle used to query whether the command has been executed.
+     */
+    CommandHandle SubmitPositionPidP(const float value);
+
+    /**
+     * @~Chinese
+     * @brief 获取位置PID控制器的积分（I）值。
+     * @return 位置PID控制器的积分（I）值。
+     */
+    /**
+     * @~English
+     * @brief Get the integral (I) value of the position PID controller.
+     * @return The integral (I) value of the position PID controller.
+     */
+    float position_pid_i();
+
+    /**
+     * @~Chinese
+     * @brief 设置位置PID控制器的积分（I）值。
+     * @param[in] value 位置PID控制器的积分（I）值。
+     * @return 执行结果，在等待策略的超时时间内未执行完毕时返回 @ref Status::kTimeout 。
+     */
+    /**
+     * @~English
+     * @brief Set the integral (I) value of the position PID controller.
+     * @param[in] value The integral (I) value of the position PID controller.
+     * @return Execution result, @ref Status::kTimeout if the command was not executed within the timeout of the wait policy.
+     */
+    Status set_position_pid_i(const float value);
+
+    /**
+     * @~Chinese
+     * @brief 设置位置PID控制器的积分（I）值，非阻塞版本的 @ref set_position_pid_i 。
+     * @details 命令被放入命令队列后立即返回，由 @ref Md40::Poll 推进执行。
+     * @param[in] value 位置PID控制器的积分（I）值。
+     * @return 命令句柄，用于查询命令是否已被执行。
+     */
+    /**
+     * @~English
+     * @brief Non-blocking variant of @ref set_position_pid_i.
+     * @details The command is queued and the call returns immediately, execution is advanced by @ref Md40::Poll.
+     * @param[in] value The integral (I) value of the position PID controller.
+     * @return Command handle used to query whether the command has been executed.
+     */
+    CommandHandle SubmitPositionPidI(const float value);
+
+    /**
+     * @~Chinese
+     * @brief 获取位置PID控制器的微分（D）值。
+     * @return 位置PID控制器的微分（D）值。
+     */
+    /**
+     * @~English
+     * @brief Get the derivative (D) value of the position PID controller.
+     * @return The derivative (D) value of the position PID controller.
+     */
+    float position_pid_d();
+
+    /**
+     * @~Chinese
+     * @brief 设置位置PID控制器的微分（D）值。
+     * @param[in] value 位置PID控制器的微分（D）值。
+     * @return 执行结果，在等待策略的超时时间内未执行完毕时返回 @ref Status::kTimeout 。
+     */
+    /**
+     * @~English
+     * @brief Set the derivative (D) value of the position PID controller.
+     * @param[in] value The derivative (D) value of the position PID controller.
+     * @return Execution result, @ref Status::kTimeout if the command was not executed within the timeout of the wait policy.
+     */
+    Status set_position_pid_d(const float value);
+
+    /**
+     * @~Chinese
+     * @brief 设置位置PID控制器的微分（D）值，非阻塞版本的 @ref set_position_pid_d 。
+     * @details 命令被放入命令队列后立即返回，由 @ref Md40::Poll 推进执行。
+     * @param[in] value 位置PID控制器的微分（D）值。
+     * @return 命令句柄，用于查询命令是否已被执行。
+     */
+    /**
+     * @~English
+     * @brief Non-blocking variant of @ref set_position_pid_d.
+     * @details The command is queued and the call returns immediately, execution is advanced by @ref Md40::Poll.
+     * @param[in] value The derivative (D) value of the position PID controller.
+     * @return Command handle used to query whether the command has been executed.
+     */
+    CommandHandle SubmitPositionPidD(const float value);
+
+    /**
+     * @~Chinese
+     * @brief 一次性读取全部六个PID参数，只需要一次总线读取。启用配置缓存且缓存有效时直接返回缓存值。
+     * @return 全部PID参数，读取失败时各参数为0。
+     */
+    /**
+     * @~English
+     * @brief Read all six PID gains with a single bus read. Served from the configuration cache when it is enabled and valid.
+     * @return All PID gains, zeros if the read failed.
+     */
+    PidGains pid_gains();
+
+    /**
+     * @~Chinese
+     * @brief 设置全部六个PID参数。
+     * @details 六条命令连续放入命令队列，每条命令执行的同时即可写入下一条，等待最后一条执行完毕后返回。
+     * 启用配置缓存时，与缓存相同的参数不会发送。
+     * @param[in] gains 全部PID参数，超出0到655.35的值会被限制到范围内。
+     * @return 执行结果，在等待策略的超时时间内未执行完毕时返回 @ref Status::kTimeout 。
+     */
+    /**
+     * @~English
+     * @brief Set all six PID gains.
+     * @details The six commands are queued back to back so each one is written as soon as the previous one has been executed, the call
+     * returns once the last one has been executed. With the configuration cache enabled, gains equal to the cached ones are not sent.
+     * @param[in] gains All PID gains, values outside 0 to 655.35 are clamped into range.
+     * @return Execution result, @ref Status::kTimeout if the commands were not executed within the timeout of the wait policy.
+     */
+    Status SetPidGains(const PidGains &gains);
+
+    /**
+     * @~Chinese
+     * @brief 设置全部六个PID参数，非阻塞版本的 @ref SetPidGains 。
+     * @details 命令被放入命令队列后立即返回，由 @ref Md40::Poll 推进执行。命令队列放不下全部六条命令时一条也不放入，返回被拒绝的句柄，
+     * 参见 @ref CommandHandle::rejected 。
+     * @param[in] gains 全部PID参数。
+     * @return 最后一条命令的句柄，该命令执行完毕即表示全部参数已设置。
+     */
+    /**
+     * @~English
+     * @brief Non-blocking variant of @ref SetPidGains.
+     * @details The commands are queued and the call returns, execution is advanced by @ref Md40::Poll. When the command queue has no room for
+     * all six commands, none is queued and a rejected handle is returned, see @ref CommandHandle::rejected.
+     * @param[in] gains All PID gains.
+     * @return Handle of the last command, once it is done all gains have been set.
+     */
+    CommandHandle SubmitPidGains(const PidGains &gains);
+
+    /**
+     * @~Chinese
+     * @brief 设定电机输出轴的位置值，单位为角度(°)。（电机输出轴累计角度值，例如：360度表示正转1整圈，-360度表示反转一整圈）
+     * @param[in] position 位置设定值，单位为角度(°)，表示从零位开始的累计角度。
+     * @return 执行结果，在等待策略的超时时间内未执行完毕时返回 @ref Status::kTimeout 。
+     */
+    /**
+     * @~English
+     * @brief Set the position value of the motor output shaft unit degrees (°). (Accumulated angle value of motor output shaft, for example: 360
+     * degrees represents 1 full circle of forward rotation, -360 degrees represents 1 full circle of reverse rotation)
+     * @param[in] position Position setting value, unit degree (°), represents the cumulative angle from zero position.
+     * @return Execution result, @ref Status::kTimeout if the command was not executed within the timeout of the wait policy.
+     */
+    Status set_position(const int32_t position);
+
+    /**
+     * @~Chinese
+     * @brief 设定电机输出轴的位置值，非阻塞版本的 @ref set_position 。
+     * @details 命令被放入命令队列后立即返回，由 @ref Md40::Poll 推进执行。
+     * @param[in] position 位置设定值，单位为角度(°)。
+     * @return 命令句柄，用于查询命令是否已被执行。
+     */
+    /**
+     * @~English
+     * @brief Non-blocking variant of @ref set_position.
+     * @details The command is queued and the call returns immediately, execution is advanced by @ref Md40::Poll.
+     * @param[in] position Position setting value, unit degrees (°).
+     * @return Command handle used to query whether the command has been executed.
+     */
+    CommandHandle SubmitPosition(const int32_t position);
+
+    /**
+     * @~Chinese
+     * @brief 设定电机的编码器脉冲计数。该计数值是在A相下降沿的时候计数，如果是正转会加一，反转则减一。
+     * @param[in] pulse_count 编码器脉冲数。
+     * @return 执行结果，在等待策略的超时时间内未执行完毕时返回 @ref Status::kTimeout 。
+     */
+    /**
+     * @~English
+     * @brief Set the encoder pulse count for the motor. The count value is counted at the falling edge of phase A. If it is positive, add one; if it
+     * is negative, subtract one.
+     * @param[in] pulse_count Encoder pulse count.
+     * @return Execution result, @ref Status::kTimeout if the command was not executed within the timeout of the wait policy.
+     */
+    Status set_pulse_count(const int32_t pulse_count);
+
+    /**
+     * @~Chinese
+     * @brief 设定电机的编码器脉冲计数，非阻塞版本的 @ref set_pulse_count 。
+     * @details 命令被放入命令队列后立即返回，由 @ref Md40::Poll 推进执行。
+     * @param[in] pulse_count 编码器脉冲数。
+     * @return 命令句柄，用于查询命令是否已被执行。
+     */
+    /**
+     * @~English
+     * @brief Non-blocking variant of @ref set_pulse_count.
+     * @details The command is queued and the call returns immediately, execution is advanced by @ref Md40::Poll.
+     * @param[in] pulse_count Encoder pulse count.
+     * @return Command handle used to query whether the command has been executed.
+     */
+    CommandHandle SubmitPulseCount(const int32_t pulse_count);
+
+    /**
+     * @~Chinese
+     * @brief 停止电机运行。
+     * @return 执行结果，在等待策略的超时时间内未执行完毕时返回 @ref Status::kTimeout 。
+     */
+    /**
+     * @~English
+     * @brief Stop the motor.
+     * @return Execution result, @ref Status::kTimeout if the command was not executed within the timeout of the wait policy.
+     */
+    Status Stop();
+
+    /**
+     * @~Chinese
+     * @brief 停止电机运行，非阻塞版本的 @ref Stop 。
+     * @details 命令被放入命令队列后立即返回，由 @ref Md40::Poll 推进执行。
+     * @return 命令句柄，用于查询命令是否已被执行。
+     */
+    /**
+     * @~English
+     * @brief Non-blocking variant of @ref Stop.
+     * @details The command is queued and the call returns immediately, execution is advanced by @ref Md40::Poll.
+     * @return Command handle used to query whether the command has been executed.
+     */
+    CommandHandle SubmitStop();
+
+    /**
+     * @~Chinese
+     * @brief 以设定的速度值（RPM）设置电机输出轴转速。正数代表正转，负数代表反转。
+     * @param[in] rpm 速度设定值（RPM）。正数代表正转，负数代表反转。
+     * @return 执行结果，在等待策略的超时时间内未执行完毕时返回 @ref Status::kTimeout 。
+     */
+    /**
+     * @~English
+     * @brief Set the motor output shaft speed to the set speed value (RPM). Positive numbers represent forward rotation, while negative numbers
+     * represent reverse rotation.
+     * @param[in] rpm Speed setting value (RPM). Positive numbers represent forward rotation, while negative numbers represent reverse rotation.
+     * @return Execution result, @ref Status::kTimeout if the command was not executed within the timeout of the wait policy.
+     */
+    Status RunSpeed(const int32_t rpm);
+
+    /**
+     * @~Chinese
+     * @brief 以设定的速度值运行电机，非阻塞版本的 @ref RunSpeed 。
+     * @details 命令被放入命令队列后立即返回，由 @ref Md40::Poll 推进执行。
+     * @param[in] rpm 速度设定值（RPM）。
+     * @return 命令句柄，用于查询命令是否已被执行。
+     */
+    /**
+     * @~English
+     * @brief Non-blocking variant of @ref RunSpeed.
+     * @details The command is queued and the call returns immediately, execution is advanced by @ref Md40::Poll.
+     * @param[in] rpm Speed setting value (RPM).
+     * @return Command handle used to query whether the command has been executed.
+     */
+    CommandHandle SubmitRunSpeed(const int32_t rpm);
+
+    /**
+     * @~Chinese
+     * @brief 以设定的PWM占空比运行电机。正数代表正转，负数代表反转。
+     * @param[in] pwm_duty PWM占空比（取值范围 -1023到1023）。正数代表正转，负数代表反转。
+     * @return 执行结果，在等待策略的超时时间内未执行完毕时返回 @ref Status::kTimeout 。
+     */
+    /**
+     * @~English
+     * @brief Run the motor with the set PWM duty. Positive numbers represent forward rotation, while negative numbers represent reverse
+     * rotation.
+     * @param[in] pwm_duty PWM duty (value range -1023 to 1023). Positive values represent forward rotation, negative values represent reverse
+     * rotation.
+     * @return Execution result, @ref Status::kTimeout if the command was not executed within the timeout of the wait policy.
+     */
+    Status RunPwmDuty(const int16_t pwm_duty);
+
+    /**
+     * @~Chinese
+     * @brief 以设定的PWM占空比运行电机，非阻塞版本的 @ref RunPwmDuty 。
+     * @details 命令被放入命令队列后立即返回，由 @ref Md40::Poll 推进执行。
+     * @param[in] pwm_duty PWM占空比（取值范围 -1023到1023）。
+     * @return 命令句柄，用于查询命令是否已被执行。
+     */
+    /**
+     * @~English
+     * @brief Non-blocking variant of @ref RunPwmDuty.
+     * @details The command is queued and the call returns immediately, execution is advanced by @ref Md40::Poll.
+     * @param[in] pwm_duty PWM duty (value range -1023 to 1023).
+     * @return Command handle used to query whether the command has been executed.
+     */
+    CommandHandle SubmitRunPwmDuty(const int16_t pwm_duty);
 
     /**
      * @~Chinese
      * @brief 将电机输出轴转动到指定位置，单位为角度(°)。
      * @param[in] position 目标位置设定值，单位为角度(°)，累计角度值。
      * @param[in] speed 电机输出轴运行速度设定值（RPM）。
+     * @return 执行结果，在等待策略的超时时间内未执行完毕时返回 @ref Status::kTimeout 。
+     */
+    /**
+     * @~English
+     * @brief Rotate the motor output shaft to the designated position, unit degrees (°).
+     * @param[in] position Target position setting value, unit: angle (°), cumulative angle value.
+     * @param[in] speed Motor output shaft operating speed set value (RPM).
+     * @return Execution result, @ref Status::kTimeout if the command was not executed within the timeout of the wait policy.
+     */
+    Status MoveTo(const int32_t position, const int32_t speed);
+
+    /**
+     * @~Chinese
+     * @brief 将电机输出轴转动到指定位置，非阻塞版本的 @ref MoveTo 。
+     * @details 命令被放入命令队列后立即返回，由 @ref Md40::Poll 推进执行。
+     * @param[in] position 目标位置设定值，单位为角度(°)。
+     * @param[in] speed 电机输出轴运行速度设定值（RPM）。
+     * @return 命令句柄，用于查询命令是否已被执行。
+     */
+    /**
+     * @~English
+     * @brief Non-blocking variant of @ref MoveTo.
+     * @details The command is queued and the call returns immediately, execution is advanced by @ref Md40::Poll.
+     * @param[in] position Target position setting value, unit degrees (°).
+     * @param[in] speed Motor output shaft operating speed set value (RPM).
+     * @return Command handle used to query whether the command has been executed.
+     */
+    CommandHandle SubmitMoveTo(const int32_t position, const int32_t speed);
+
+    /**
+     * @~Chinese
+     * @brief 电机输出轴相对转动指定角度，单位为角度(°)。
+     * @param[in] offset 相对位移设定值，单位为角度(°)，基于当前位置的相对角度。
+     * @param[in] speed 电机输出轴运行速度设定值（RPM）。
+     * @return 执行结果，在等待策略的超时时间内未执行完毕时返回 @ref Status::kTimeout 。
+     */
+    /**
+     * @~English
+     * @brief The motor output shaft rotates relative to the specified angle, unit degrees (°).
+     * @param[in] offset Relative displacement setting value, unit degrees (°), based on the relative angle at the current position.
+     * @param[in] speed Motor output shaft operating speed set value (RPM).
+     * @return Execution result, @ref Status::kTimeout if the command was not executed within the timeout of the wait policy.
+     */
+    Status Move(const int32_t offset, const int32_t speed);
+
+    /**
+     * @~Chinese
+     * @brief 电机输出轴相对转动指定角度，非阻塞版本的 @ref Move 。
+     * @details 命令被放入命令队列后立即返回，由 @ref Md40::Poll 推进执行。
+     * @param[in] offset 相对位移设定值，单位为角度(°)。
+     * @param[in] speed 电机输出轴运行速度设定值（RPM）。
+     * @return 命令句柄，用于查询命令是否已被执行。
+     */
+    /**
+     * @~English
+     * @brief Non-blocking variant of @ref Move.
+     * @details The command is queued and the call returns immediately, execution is advanced by @ref Md40::Poll.
+     * @param[in] offset Relative displacement setting value, unit degrees (°).
+     * @param[in] speed Motor output shaft operating speed set value (RPM).
+     * @return Command handle used to query whether the command has been executed.
+     */
+    CommandHandle SubmitMove(const int32_t offset, const int32_t speed);
+
+    /**
+     * @~Chinese
+     * @brief 非阻塞地查询最近一次 @ref MoveTo 或 @ref Move 是否已在截止时刻之前到达目标位置。
+     * @details 根据目标位置、设定速度以及读到的位置预测到达时刻（ETA）。未到下一次检查时刻时直接返回，不访问总线；
+     * 每次检查读取一次状态和位置，下一次检查安排在剩余时间的一半之后，接近到达时按固定的短间隔检查，因此长距离运动只占用很少的总线时间。
+     * 相对运动的起点未知，ETA从命令提交时刻开始估算。没有记录到运动命令时（例如由其他主机发出）每次都按短间隔检查。
+     * 命令如果是非阻塞提交的，需要另外调用 @ref Md40::Poll 推进执行；在它执行之前读到的状态仍属于之前的命令，因此只返回未到达，不访问总线。
+     * @param[in] deadline_us 截止时刻，单位为微秒，与传输层的时钟相同（Arduino上即 micros() ）。
+     * @param[out] reached 已到达目标位置时为true。
+     * @return 执行结果，超过截止时刻仍未到达时返回 @ref Status::kTimeout 。
+     */
+    /**
+     * @~English
+     * @brief Non-blocking check whether the latest @ref MoveTo or @ref Move has reached its target by the deadline.
+     * @details The arrival time (ETA) is predicted from the target, the commanded speed and the position read back. Before the next check is due
+     * the call returns at once without touching the bus. Every check reads the state and position once and schedules the next check after half of
+     * the predicted remaining time, near arrival it checks at a short fixed interval, so a long move takes very little bus time. The start of a
+     * relative move is unknown, so its ETA counts from the time the command was submitted. When no move command was recorded (for example one
+     * sent by another host) every check uses the short interval. Commands submitted without waiting still need @ref Md40::Poll to be executed,
+     * and until then the state on the device still belongs to the previous command, so the call reports not reached without touching the bus.
+     * @param[in] deadline_us Deadline in microseconds on the transport's clock (micros() on Arduino).
+     * @param[out] reached True when the target has been reached.
+     * @return Execution result, @ref Status::kTimeout when the target has not been reached by the deadline.
+     */
+    Status ReachedBy(const uint32_t deadline_us, bool &reached);
+
+    /**
+     * @~Chinese
+     * @brief 阻塞等待最近一次 @ref MoveTo 或 @ref Move 到达目标位置，检查的时机与 @ref ReachedBy 相同，两次检查之间通过传输层的
+     * DelayMicroseconds 休眠或让出CPU。开始前先等待命令队列中的命令执行完毕。
+     * @param[in] deadline_us 截止时刻，单位为微秒，与传输层的时钟相同（Arduino上即 micros() ）。
+     * @return 执行结果，超过截止时刻仍未到达时返回 @ref Status::kTimeout 。
+     */
+    /**
+     * @~English
+     * @brief Block until the latest @ref MoveTo or @ref Move reaches its target. Checks happen at the same times as with @ref ReachedBy, and
+     * between them the call sleeps or yields through the transport's DelayMicroseconds. The command queue is flushed first.
+     * @param[in] deadline_us Deadline in microseconds on the transport's clock (micros() on Arduino).
+     * @return Execution result, @ref Status::kTimeout when the target has not been reached by the deadline.
+     */
+    Status WaitUntilReached(const uint32_t deadline_us);
+
+    /**
+     * @~Chinese
+     * @brief 获取电机当前状态。
+     * @return 电机当前状态。
+     */
+    /**
+     * @~English
+     * @brief Get the current state of the motor.
+     * @return The current state of the motor.
+     */
+    State state();
+
+    /**
+     * @~Chinese
+     * @brief 获取电机输出轴当前的转速（RPM）。正数代表正转，负数代表反转。
+     * @return 电机输出轴当前的转速（RPM）。正数代表正转，负数代表反转。
+     */
+    /**
+     * @~English
+     * @brief Get the current RPM of the motor output shaft. Positive numbers represent forward rotation, while negative numbers represent reverse rotation.
+     * @return The current speed (RPM) of the motor output shaft. Positive numbers represent forward rotation, while negative numbers represent
+     * reverse rotation.
+     */
+    int32_t speed();
+
+    /**
+     * @~Chinese
+     * @brief 获取电机输出轴的位置值，单位为角度(°)。（电机输出轴累计角度值，例如：360度表示正转1整圈，-360度表示反转一整圈）
+     * @return 电机输出轴当前位置，单位为角度(°)，表示从零位开始的累计角度。
+     */
+    /**
+     * @~English
+     * @brief Get the position value of the motor output shaft, unit degrees (°). (Accumulated angle value of motor output shaft, for example: 360 degrees represents 1 full circle of forward rotation, -360 degrees represents 1 full circle of reverse rotation)
+     * @return The current position of the motor output shaft, unit degrees (°), represents the cumulative angle from zero position.
+     */
+    int32_t position();
+
+    /**
+     * @~Chinese
+     * @brief 获取电机当前的编码器脉冲计数。该计数值是在A相下降沿的时候计数，如果是正转会加一，反转则减一。
+     * @return 电机当前的编码器脉冲数。
+     */
+    /**
+     * @~English
+     * @brief Get the current encoder pulse count of the motor. The count value is counted at the falling edge of phase A. If it is positive, add one;
+     * if it is negative, subtract one.
+     * @return The current encoder pulse count of the motor.
+     */
+    int32_t pulse_count();
+
+    /**
+     * @~Chinese
+     * @brief 获取电机当前的PWM占空比。正数代表正转，负数代表反转。
+     * @return 电机当前的PWM占空比（取值范围 -1023到1023）。正数代表正转，负数代表反转。
+     */
+    /**
+     * @~English
+     * @brief Get the current PWM duty of the motor. Positive numbers represent forward rotation, while negative numbers represent reverse
+     * rotation.
+     * @return The current PWM duty of the motor (value range -1023 to 1023). Positive values represent forward rotation, negative values
+     * represent reverse rotation.
+     */
+    int16_t pwm_duty();
+
+    /**
+     * @~Chinese
+     * @brief 一次性读取电机的状态、转速、位置、脉冲计数和PWM占空比。
+     * @details 只锁存一次并通过一次I2C读取获取整个电机数据块，所有字段来自同一时刻，总线开销远小于分别调用 @ref state 、 @ref speed 、
+     * @ref position 、 @ref pulse_count 和 @ref pwm_duty 。
+     * @return 电机运行数据快照。
+     */
+    /**
+     * @~English
+     * @brief Read the state, speed, position, pulse count and PWM duty of the motor in one go.
+     * @details Latches once and fetches the whole motor data block in a single I2C read, so all fields come from the same instant and the bus cost
+     * is a fraction of calling @ref state, @ref speed, @ref position, @ref pulse_count and @ref pwm_duty separately.
+     * @return Snapshot of the motor's runtime data.
+     */
+    Snapshot ReadSnapshot();
+
+    /**
+     * @~Chinese
+     * @brief 启用或禁用配置缓存，默认禁用。切换时缓存会被清空。
+     * @details 启用后，PID参数和编码器/直流模式采用写穿透缓存：已缓存的PID参数直接从内存读取，设置与缓存相同的值时不会发送命令
+     * （非阻塞版本返回已结束的句柄）。只有当本驱动是唯一修改该电机配置的一方时才应启用。 @ref Reset 会自动清空缓存。
+     * @param[in] enabled true为启用，false为禁用。
+     */
+    /**
+     * @~English
+     * @brief Enable or disable the configuration cache, disabled by default. Switching clears the cache.
+     * @details When enabled, the PID gains and the encoder/DC mode are cached write-through: cached PID gains are served from RAM, and setting a
+     * value equal to the cached one sends no command (the non-blocking variants return a finished handle). Only enable it when this driver is
+     * the only party changing the motor's configuration. @ref Reset clears the cache automatically.
+     * @param[in] enabled True to enable, false to disable.
+     */
+    void set_config_cache_enabled(const bool enabled);
+
+    /**
+     * @~Chinese
+     * @brief 查询配置缓存是否启用。
+     * @return 启用时返回true。
+     */
+    /**
+     * @~English
+     * @brief Query whether the configuration cache is enabled.
+     * @return True when enabled.
+     */
+    bool config_cache_enabled() const;
+
+    /**
+     * @~Chinese
+     * @brief 清空配置缓存，之后的读取将重新访问总线，设置也会重新发送。
+     */
+    /**
+     * @~English
+     * @brief Clear the configuration cache, subsequent reads go to the bus again and settings are sent again.
+     */
+    void Invalidate();
+
+    /**
+     * @~Chinese
+     * @brief 清空配置缓存，并通过一次连续读取从MD40重新载入全部PID参数。编码器/直流模式无法从MD40读回，保持未缓存。
+     * @return 执行结果，参见 @ref Status 。
+     */
+    /**
+     * @~English
+     * @brief Clear the configuration cache and reload all PID gains from the MD40 in one burst read. The encoder/DC mode cannot be read back
+     * from the MD40 and stays uncached.
+     * @return Execution result, see @ref Status.
+     */
+    Status Refresh();
+
+   private:
+    friend class BasicMd40;
+
+    Motor(const Motor &) = delete;
+    Motor &operator=(const Motor &) = delete;
+
+    static constexpr uint8_t kPidGainNum = 6;
+    static constexpr uint8_t kPidGainsCached = (1 << kPidGainNum) - 1;
+    static constexpr uint8_t kSetupCached = 1 << kPidGainNum;
+    static constexpr uint8_t kSetupLength = 5;
+
+    float ReadPidGain(const uint8_t slot);
+
+    CommandHandle SubmitPidGain(const uint8_t slot, const float value);
+
+    CommandHandle SubmitPidGainRegister(const uint8_t slot, const uint16_t value);
+
+    CommandHandle SubmitSetup(const uint8_t *data, const uint8_t length);
+
+    void NoteCommand(const uint8_t type, const uint8_t *param, const uint16_t sequence);
+
+    BasicMd40 &md40_;
+    const uint8_t index_ = 0;
+    bool config_cache_enabled_ = false;
+    uint8_t cache_valid_ = 0;
+    uint16_t pid_gain_cache_[kPidGainNum] = {0};
+    uint8_t setup_cache_[kSetupLength] = {0};
+    uint8_t move_type_ = 0;
+    bool arrival_check_due_ = true;
+    int32_t move_value_ = 0;
+    int32_t move_speed_ = 0;
+    uint32_t move_submit_time_ = 0;
+    uint16_t move_sequence_ = 0;
+    uint32_t next_arrival_check_time_ = 0;
+  };
+
+  /**
+   * @~Chinese
+   * @class Md40::ConfigProfile
+   * @brief 所有电机的编码器/直流模式和PID参数组成的配置文件，可保存为带版本号的紧凑二进制格式，由 @ref ApplyConfigProfile 以差异方式应用。
+   * @details 每个电机的模式和PID参数分别记录是否已设置，未设置的部分应用时保持不变。PID参数以MD40寄存器的格式（乘以100后的uint16）保存，
+   * 因此与读回的值可以精确比较。二进制格式为：标识字节、版本号、模式掩码、PID参数掩码、每个电机5字节模式和12字节PID参数（小端序），
+   * 最后是CRC-8校验，共 @ref kSerializedLength 字节。
+   */
+  /**
+   * @~English
+   * @class Md40::ConfigProfile
+   * @brief A configuration profile of the encoder/DC mode and the PID gains of all motors. It can be stored in a compact, versioned binary
+   * format and is applied as a diff by @ref ApplyConfigProfile.
+   * @details Whether the mode and the PID gains of a motor are set is recorded separately, parts that are not set are left alone when applied.
+   * PID gains are kept in the MD40's register format (uint16 of the value multiplied by 100), so they compare exactly with the values read
+   * back. The binary format is a tag byte, the version, the mode mask, the PID gain mask, then 5 bytes of mode and 12 bytes of PID gains per
+   * motor (little endian), and finally a CRC-8, @ref kSerializedLength bytes in total.
+   */
+  class ConfigProfile {
+   public:
+    /**
+     * @~Chinese
+     * @brief 二进制格式的版本号。
+     */
+    /**
+     * @~English
+     * @brief Version of the binary format.
+     */
+    static constexpr uint8_t kVersion = 1;
+
+    /**
+     * @~Chinese
+     * @brief 二进制格式的长度（字节）。
+     */
+    /**
+     * @~English
+     * @brief Length of the binary format in bytes.
+     */
+    static constexpr uint8_t kSerializedLength = 5 + kMotorNum * (Motor::kSetupLength + Motor::kPidGainNum * sizeof(uint16_t));
+
+    /**
+     * @~Chinese
+     * @brief 将电机设置为编码器模式，参见 @ref Motor::SetEncoderMode 。
+     * @param[in] index 电机索引。
+     * @param[in] ppr 每转脉冲数。
+     * @param[in] reduction_ratio 减速比。
+     * @param[in] phase_relation 相位关系。
+     */
+    /**
+     * @~English
+     * @brief Set the motor to encoder mode, see @ref Motor::SetEncoderMode.
+     * @param[in] index Motor index.
+     * @param[in] ppr Pulses per revolution.
+     * @param[in] reduction_ratio Reduction ratio.
+     * @param[in] phase_relation Phase relation.
+     */
+    void SetEncoderMode(const uint8_t index, const uint16_t ppr, const uint16_t reduction_ratio, const typename Motor::PhaseRelation phase_relation);
+
+    /**
+     * @~Chinese
+     * @brief 将电机设置为直流模式，参见 @ref Motor::SetDcMode 。
+     * @param[in] index 电机索引。
+     */
+    /**
+     * @~English
+     * @brief Set the motor to DC mode, see @ref Motor::SetDcMode.
+     * @param[in] index Motor index.
+     */
+    void SetDcMode(const uint8_t index);
+
+    /**
+     * @~Chinese
+     * @brief 设置电机的全部六个PID参数，参见 @ref Motor::SetPidGains 。
+     * @param[in] index 电机索引。
+     * @param[in] gains PID参数。
+     */
+    /**
+     * @~English
+     * @brief Set all six PID gains of the motor, see @ref Motor::SetPidGains.
+     * @param[in] index Motor index.
+     * @param[in] gains PID gains.
+     */
+    void SetPidGains(const uint8_t index, const typename Motor::PidGains &gains);
+
+    /**
+     * @~Chinese
+     * @brief 获取电机的PID参数。
+     * @param[in] index 电机索引。
+     * @return PID参数，未设置时全部为0。
+     */
+    /**
+     * @~English
+     * @brief Get the PID gains of the motor.
+     * @param[in] index Motor index.
+     * @return PID gains, all 0 when not set.
+     */
+    typename Motor::PidGains pid_gains(const uint8_t index) const;
+
+    /**
+     * @~Chinese
+     * @brief 查询电机的模式是否已设置。
+     * @param[in] index 电机索引。
+     * @return 已设置时返回true。
+     */
+    /**
+     * @~English
+     * @brief Query whether the mode of the motor is set.
+     * @param[in] index Motor index.
+     * @return True when set.
+     */
+    bool has_mode(const uint8_t index) const;
+
+    /**
+     * @~Chinese
+     * @brief 查询电机的PID参数是否已设置。
+     * @param[in] index 电机索引。
+     * @return 已设置时返回true。
+     */
+    /**
+     * @~English
+     * @brief Query whether the PID gains of the motor are set.
+     * @param[in] index Motor index.
+     * @return True when set.
+     */
+    bool has_pid_gains(const uint8_t index) const;
+
+    /**
+     * @~Chinese
+     * @brief 转换为二进制格式。
+     * @param[out] data 二进制数据。
+     */
+    /**
+     * @~English
+     * @brief Convert to the binary format.
+     * @param[out] data Binary data.
+     */
+    void Serialize(uint8_t (&data)[kSerializedLength]) const;
+
+    /**
+     * @~Chinese
+     * @brief 从二进制格式转换。标识、版本号或校验不符时返回false，配置文件保持不变。
+     * @param[in] data 二进制数据。
+     * @return 成功时返回true。
+     */
+    /**
+     * @~English
+     * @brief Convert from the binary format. Returns false and leaves the profile unchanged when the tag, the version or the checksum does not
+     * match.
+     * @param[in] data Binary data.
+     * @return True on success.
+     */
+    bool Deserialize(const uint8_t (&data)[kSerializedLength]);
+
+    /**
+     * @~Chinese
+     * @brief 以二进制格式保存到存储中，参见 @ref config_store_concept 。
+     * @tparam Store 存储类型。
+     * @param[in] store 存储。
+     * @return 成功时返回true。
+     */
+    /**
+     * @~English
+     * @brief Save in the binary format to a store, see @ref config_store_concept.
+     * @tparam Store Store type.
+     * @param[in] store Store.
+     * @return True on success.
+     */
+    template <typename Store>
+    bool Save(Store &store) const;
+
+    /**
+     * @~Chinese
+     * @brief 从存储中载入，参见 @ref config_store_concept 。存储为空或内容无效时返回false，配置文件保持不变。
+     * @tparam Store 存储类型。
+     * @param[in] store 存储。
+     * @return 成功时返回true。
+     */
+    /**
+     * @~English
+     * @brief Load from a store, see @ref config_store_concept. Returns false and leaves the profile unchanged when the store is empty or its
+     * content is invalid.
+     * @tparam Store Store type.
+     * @param[in] store Store.
+     * @return True on success.
+     */
+    template <typename Store>
+    bool Load(Store &store);
+
+   private:
+    friend class BasicMd40;
+
+    static constexpr uint8_t kTag = 0xD4;
+
+    uint8_t mode_mask_ = 0;
+    uint8_t pid_gain_mask_ = 0;
+    uint8_t setups_[kMotorNum][Motor::kSetupLength] = {{0}};
+    uint16_t pid_gains_[kMotorNum][Motor::kPidGainNum] = {{0}};
+  };
+
+  /**
+   * @~Chinese
+   * @class Md40::ReadPlan
+   * @brief 读取计划，将多个电机的多个运行数据读取合并为尽量少的I2C传输。
+   * @details 构造时根据所需的字段计算出锁存和连续读取的传输序列，相邻的寄存器会被合并为一次读取，单次读取的长度不超过传输层的
+   * kBufferLength（Arduino上即 TwoWire 接收缓冲区的大小）。之后每次调用 @ref Execute 都按该序列执行，不会分配内存。
+   */
+  /**
+   * @~English
+   * @class Md40::ReadPlan
+   * @brief A read plan that coalesces runtime data reads of several motors into as few I2C transactions as possible.
+   * @details The latch and burst-read sequence is computed once at construction from the requested fields. Neighbouring registers are merged into
+   * one read, and no read is longer than the transport's kBufferLength (the TwoWire receive buffer on Arduino). Every call to @ref Execute then runs that sequence without
+   * allocating memory.
+   */
+  class ReadPlan {
+   public:
+    /**
+     * @~Chinese
+     * @brief 可读取的字段，可按位或组合。
+     */
+    /**
+     * @~English
+     * @brief Readable fields, can be combined with bitwise OR.
+     */
+    enum Field : uint8_t {
+      /**
+       * @~Chinese
+       * @brief 电机状态。
+       */
+      /**
+       * @~English
+       * @brief Motor state.
+       */
+      kFieldState = 1 << 0,
+
+      /**
+       * @~Chinese
+       * @brief 电机转速。
+       */
+      /**
+       * @~English
+       * @brief Motor speed.
+       */
+      kFieldSpeed = 1 << 1,
+
+      /**
+       * @~Chinese
+       * @brief 电机位置。
+       */
+      /**
+       * @~English
+       * @brief Motor position.
+       */
+      kFieldPosition = 1 << 2,
+
+      /**
+       * @~Chinese
+       * @brief 编码器脉冲计数。
+       */
+      /**
+       * @~English
+       * @brief Encoder pulse count.
+       */
+      kFieldPulseCount = 1 << 3,
+
+      /**
+       * @~Chinese
+       * @brief PWM占空比。
+       */
+      /**
+       * @~English
+       * @brief PWM duty.
+       */
+      kFieldPwmDuty = 1 << 4,
+
+      /**
+       * @~Chinese
+       * @brief 所有字段。
+       */
+      /**
+       * @~English
+       * @brief All fields.
+       */
+      kFieldAll = kFieldState | kFieldSpeed | kFieldPosition | kFieldPulseCount | kFieldPwmDuty,
+    };
+
+    /**
+     * @~Chinese
+     * @brief 构造函数，计算读取计划。
+     * @param[in] md40 Md40 对象引用。
+     * @param[in] fields 每个电机需要读取的字段，为 @ref Field 的按位或组合，0表示不读取该电机。
+     */
+    /**
+     * @~English
+     * @brief Constructor, computes the read plan.
+     * @param[in] md40 Md40 object reference.
+     * @param[in] fields Fields to read for each motor, a bitwise OR of @ref Field, 0 means the motor is not read.
+     */
+    ReadPlan(BasicMd40 &md40, const uint8_t (&fields)[kMotorNum]);
+
+    /**
+     * @~Chinese
+     * @brief 执行读取计划。
+     * @param[out] snapshots 每个电机的运行数据快照，只有计划中的字段会被更新。
+     * @return 执行结果，参见 @ref Status 。
+     */
+    /**
+     * @~English
+     * @brief Execute the read plan.
+     * @param[out] snapshots Snapshot of each motor's runtime data, only the planned fields are updated.
+     * @return Execution result, see @ref Status.
+     */
+    Status Execute(typename Motor::Snapshot (&snapshots)[kMotorNum]);
+
+    /**
+     * @~Chinese
+     * @brief 获取每次执行所需的I2C传输次数。
+     * @return 每次执行所需的I2C传输次数。
+     */
+    /**
+     * @~English
+     * @brief Get the number of I2C transactions needed per execution.
+     * @return The number of I2C transactions needed per execution.
+     */
+    uint8_t transaction_count() const;
+
+   private:
+    struct Segment {
+      uint8_t address = 0;
+      uint8_t length = 0;
+    };
+
+    static constexpr uint8_t kFieldNum = 5;
+
+    static void *FieldPointer(typename Motor::Snapshot &snapshot, const uint8_t field);
+
+    void AddRange(const uint8_t address, const uint8_t length);
+
+    BasicMd40 &md40_;
+    uint8_t fields_[kMotorNum] = {0};
+    Segment segments_[kMotorNum * kFieldNum];
+    uint8_t segment_num_ = 0;
+  };
+
+  /**
+   * @~Chinese
+   * @class Md40::MotorGroup
+   * @brief 电机组，让多个电机的命令以尽量小的时间差开始执行。
+   * @details 逐个调用 @ref Motor::RunSpeed 时，每个命令都要等待上一个命令执行完毕并经过等待策略的间隔，电机之间的启动时间差可达数个命令往返。
+   * 电机组先等待已排队的命令执行完毕，再把所有电机的命令在内存中编码好，然后连续发出：每个命令只写入一次（固件支持时类型、参数和执行标志一次写入），
+   * 写入后忙等命令执行完毕就立即发出下一个命令，不使用等待策略的间隔。每个命令执行标志写入完成的时间会被记录，用于计算实际的启动时间差。
+   * MD40固件没有同时启动多个电机的命令，邮箱一次只能容纳一个命令，因此启动时间差的下限是一次命令写入加上固件执行一个命令的时间。
+   */
+  /**
+   * @~English
+   * @class Md40::MotorGroup
+   * @brief A group of motors whose commands start executing as close together as possible.
+   * @details When @ref Motor::RunSpeed is called motor by motor, every command waits for the previous one to finish plus the wait policy's
+   * interval, so the motors can start several command round trips apart. A motor group first waits for the queued commands to finish, encodes the
+   * commands of all motors in memory, then fires them back to back: each command takes a single write (type, parameters and execute flag together
+   * when the firmware supports it), and the next command is written as soon as a busy poll sees the previous one executed, without the wait
+   * policy's interval. The time each execute flag write completes is recorded to measure the actual start skew. The MD40 firmware has no command
+   * that starts several motors at once and its mailbox holds one command at a time, so the skew is bounded below by one command write plus the
+   * time the firmware takes to execute one command.
+   */
+  class MotorGroup {
+   public:
+    /**
+     * @~Chinese
+     * @brief 包含所有电机的掩码。
      */
     /**
      * @~English
-     * @brief Rotate the motor output shaft to the designated position, unit degrees (°).
-     * @param[in] position Target position setting value, unit: angle (°), cumulative angle value.
-     * @param[in] speed Motor output shaft operating speed set value (RPM).
+     * @brief Mask containing all motors.
      */
-    void MoveTo(const int32_t position, const int32_t speed);
+    static constexpr uint8_t kAllMotors = (1 << kMotorNum) - 1;
 
     /**
      * @~Chinese
-     * @brief 电机输出轴相对转动指定角度，单位为角度(°)。
-     * @param[in] offset 相对位移设定值，单位为角度(°)，基于当前位置的相对角度。
-     * @param[in] speed 电机输出轴运行速度设定值（RPM）。
+     * @brief 构造函数。
+     * @param[in] md40 Md40 对象引用。
+     * @param[in] motors 组内电机的掩码，第 i 位表示电机 i ，默认为所有电机。
      */
     /**
      * @~English
-     * @brief The motor output shaft rotates relative to the specified angle, unit degrees (°).
-     * @param[in] offset Relative displacement setting value, unit degrees (°), based on the relative angle at the current position.
-     * @param[in] speed Motor output shaft operating speed set value (RPM).
+     * @brief Constructor.
+     * @param[in] md40 Md40 object reference.
+     * @param[in] motors Mask of the motors in the group, bit i stands for motor i, all motors by default.
      */
-    void Move(const int32_t offset, const int32_t speed);
+    explicit MotorGroup(BasicMd40 &md40, const uint8_t motors = kAllMotors);
 
     /**
      * @~Chinese
-     * @brief 获取电机当前状态。
-     * @return 电机当前状态。
+     * @brief 组内电机以各自的速度运行，参见 @ref Motor::RunSpeed 。
+     * @param[in] rpm 每个电机的速度，单位为RPM，不在组内的电机忽略。
+     * @return 执行结果，参见 @ref Status 。
      */
     /**
      * @~English
-     * @brief Get the current state of the motor.
-     * @return The current state of the motor.
+     * @brief Run the motors of the group at their own speeds, see @ref Motor::RunSpeed.
+     * @param[in] rpm Speed of every motor in RPM, ignored for motors outside the group.
+     * @return Execution result, see @ref Status.
      */
-    State state();
+    Status RunSpeed(const int32_t (&rpm)[kMotorNum]);
 
     /**
      * @~Chinese
-     * @brief 获取电机输出轴当前的转速（RPM）。正数代表正转，负数代表反转。
-     * @return 电机输出轴当前的转速（RPM）。正数代表正转，负数代表反转。
+     * @brief 组内电机以各自的PWM占空比运行，参见 @ref Motor::RunPwmDuty 。
+     * @param[in] pwm_duty 每个电机的PWM占空比，不在组内的电机忽略。
+     * @return 执行结果，参见 @ref Status 。
      */
     /**
      * @~English
-     * @brief Get the current RPM of the motor output shaft. Positive numbers represent forward rotation, while negative numbers represent reverse rotation.
-     * @return The current speed (RPM) of the motor output shaft. Positive numbers represent forward rotation, while negative numbers represent
-     * reverse rotation.
+     * @brief Run the motors of the group at their own PWM duties, see @ref Motor::RunPwmDuty.
+     * @param[in] pwm_duty PWM duty of every motor, ignored for motors outside the group.
+     * @return Execution result, see @ref Status.
      */
-    int32_t speed();
+    Status RunPwmDuty(const int16_t (&pwm_duty)[kMotorNum]);
 
     /**
      * @~Chinese
-     * @brief 获取电机输出轴的位置值，单位为角度(°)。（电机输出轴累计角度值，例如：360度表示正转1整圈，-360度表示反转一整圈）
-     * @return 电机输出轴当前位置，单位为角度(°)，表示从零位开始的累计角度。
+     * @brief 组内电机以各自的速度运动到各自的目标位置，参见 @ref Motor::MoveTo 。
+     * @param[in] positions 每个电机的目标位置，不在组内的电机忽略。
+     * @param[in] speeds 每个电机的速度，不在组内的电机忽略。
+     * @return 执行结果，参见 @ref Status 。
      */
     /**
      * @~English
-     * @brief Get the position value of the motor output shaft, unit degrees (°). (Accumulated angle value of motor output shaft, for example: 360 degrees represents 1 full circle of forward rotation, -360 degrees represents 1 full circle of reverse rotation)
-     * @return The current position of the motor output shaft, unit degrees (°), represents the cumulative angle from zero position.
+     * @brief Move the motors of the group to their own target positions at their own speeds, see @ref Motor::MoveTo.
+     * @param[in] positions Target position of every motor, ignored for motors outside the group.
+     * @param[in] speeds Speed of every motor, ignored for motors outside the group.
+     * @return Execution result, see @ref Status.
      */
-    int32_t position();
+    Status MoveTo(const int32_t (&positions)[kMotorNum], const int32_t (&speeds)[kMotorNum]);
 
     /**
      * @~Chinese
-     * @brief 获取电机当前的编码器脉冲计数。该计数值是在A相下降沿的时候计数，如果是正转会加一，反转则减一。
-     * @return 电机当前的编码器脉冲数。
+     * @brief 协调运动：组内电机同时到达各自的目标位置（关节空间的直线插补）。
+     * @details 先等待命令队列中已提交的命令执行完毕，再用一次 @ref ReadPlan 读取组内所有电机的当前位置，位移最大的电机使用 speed ，其他电机的速度按位移比例缩小（至少为1），
+     * 然后像 @ref MoveTo 一样连续发出。各电机的加减速由固件控制，因此同时到达是近似的。用 @ref ReadAllReached 查询是否全部到达。
+     * @param[in] positions 每个电机的目标位置，不在组内的电机忽略。
+     * @param[in] speed 位移最大的电机的速度，单位为RPM。
+     * @return 执行结果，参见 @ref Status 。
      */
     /**
      * @~English
-     * @brief Get the current encoder pulse count of the motor. The count value is counted at the falling edge of phase A. If it is positive, add one;
-     * if it is negative, subtract one.
-     * @return The current encoder pulse count of the motor.
+     * @brief Coordinated move: the motors of the group arrive at their own target positions together (linear interpolation in joint space).
+     * @details Commands already in the command queue are waited for first, then the current positions of all motors in the group are read
+     * with one @ref ReadPlan. The motor with the longest move runs at speed, the others are slowed down in proportion to their moves (to at
+     * least 1), then the moves are fired like @ref MoveTo. The firmware controls each motor's acceleration, so the arrival is simultaneous only
+     * approximately. Use @ref ReadAllReached to find out when all have arrived.
+     * @param[in] positions Target position of every motor, ignored for motors outside the group.
+     * @param[in] speed Speed of the motor with the longest move in RPM.
+     * @return Execution result, see @ref Status.
      */
-    int32_t pulse_count();
+    Status CoordinatedMoveTo(const int32_t (&positions)[kMotorNum], const int32_t speed);
 
     /**
      * @~Chinese
-     * @brief 获取电机当前的PWM占空比。正数代表正转，负数代表反转。
-     * @return 电机当前的PWM占空比（取值范围 -1023到1023）。正数代表正转，负数代表反转。
+     * @brief 用一次 @ref ReadPlan 读取组内所有电机的状态，判断是否都已到达目标位置（ @ref Motor::State::kReachedPosition ）。
+     * @param[out] reached 全部到达时为true。
+     * @return 执行结果，参见 @ref Status 。
      */
     /**
      * @~English
-     * @brief Get the current PWM duty of the motor. Positive numbers represent forward rotation, while negative numbers represent reverse
-     * rotation.
-     * @return The current PWM duty of the motor (value range -1023 to 1023). Positive values represent forward rotation, negative values
-     * represent reverse rotation.
+     * @brief Read the states of all motors in the group with one @ref ReadPlan and tell whether all of them have reached their target positions
+     * (@ref Motor::State::kReachedPosition).
+     * @param[out] reached True when all have arrived.
+     * @return Execution result, see @ref Status.
      */
-    int16_t pwm_duty();
+    Status ReadAllReached(bool &reached);
 
-   private:
-    Motor(const Motor &) = delete;
-    Motor &operator=(const Motor &) = delete;
+    /**
+     * @~Chinese
+     * @brief 停止组内电机，参见 @ref Motor::Stop 。
+     * @return 执行结果，参见 @ref Status 。
+     */
+    /**
+     * @~English
+     * @brief Stop the motors of the group, see @ref Motor::Stop.
+     * @return Execution result, see @ref Status.
+     */
+    Status Stop();
+
+    /**
+     * @~Chinese
+     * @brief 获取最近一次组命令中第一个和最后一个命令执行标志写入完成的时间差。
+     * @return 微秒数，组内少于两个电机时为0。
+     */
+    /**
+     * @~English
+     * @brief Get the time between the first and the last execute flag write of the most recent group command.
+     * @return Microseconds, 0 when the group has fewer than two motors.
+     */
+    uint32_t start_skew_us() const;
 
-    void ExecuteCommand();
+    /**
+     * @~Chinese
+     * @brief 获取最近一次组命令中指定电机相对第一个电机的启动时间差。
+     * @param[in] index 电机索引。
+     * @return 微秒数，不在组内的电机为0。
+     */
+    /**
+     * @~English
+     * @brief Get how much later the given motor started than the first one in the most recent group command.
+     * @param[in] index Motor index.
+     * @return Microseconds, 0 for motors outside the group.
+     */
+    uint32_t start_offset_us(const uint8_t index) const;
 
-    void WaitCommandEmptied();
+   private:
+    Status Fire(const uint8_t type, const void *params, const uint8_t param_length);
 
-    void WriteCommand(const uint8_t command, const uint8_t *data, const uint16_t length);
+    void FillFields(uint8_t (&fields)[kMotorNum], const uint8_t field) const;
 
-    const uint8_t index_ = 0;
-    TwoWire &wire_ = Wire;
-    const uint8_t i2c_address_ = kDefaultI2cAddress;
+    BasicMd40 &md40_;
+    const uint8_t motors_ = kAllMotors;
+    uint32_t start_offsets_us_[kMotorNum] = {0};
+    uint32_t start_skew_us_ = 0;
   };
 
   /**
    * @~Chinese
    * @brief 构造函数。
    * @param[in] i2c_address I2C地址。
-   * @param[in] wire TwoWire 对象引用。
+   * @param[in] transport 传输层，对于 @ref Md40 可以直接传入 TwoWire 对象。
    */
   /**
    * @~English
    * @brief Constructor.
    * @param[in] i2c_address I2C address.
-   * @param[in] wire TwoWire object reference.
+   * @param[in] transport Transport, for @ref Md40 a TwoWire object can be passed directly.
    */
-  Md40(const uint8_t i2c_address, TwoWire &wire);
+  BasicMd40(const uint8_t i2c_address, const Transport &transport);
 
   /**
    * @~Chinese
@@ -548,56 +2125,506 @@ class Md40 {
   /**
    * @~Chinese
    * @brief 初始化。
+   * @details 通过一次连续读取获得并缓存设备信息，按 @ref set_command_write 的设置确定命令的写入方式，默认检测固件是否接受通过一次I2C写入提交的命令
+   * （命令类型、电机索引、参数和执行标志），然后把所有电机的重置命令一起放入命令队列，只在最后等待一次。
+   * @return 执行结果，参见 @ref Status 。
    */
   /**
    * @~English
    * @brief Initialize.
+   * @details Fetches and caches the device information in one burst read and settles how commands are written as set by @ref set_command_write,
+   * by default detecting whether the firmware accepts a command in a single I2C write (command type, motor index, parameters and execute flag).
+   * Then queues the resets of all motors together and waits only once at the end.
+   * @return Execution result, see @ref Status.
+   */
+  Status Init();
+
+  /**
+   * @~Chinese
+   * @brief 通过一次连续读取获取设备信息，并更新缓存。
+   * @param[out] info 设备信息。
+   * @return 执行结果，参见 @ref Status 。
+   */
+  /**
+   * @~English
+   * @brief Fetch the device information in one burst read and update the cache.
+   * @param[out] info Device information.
+   * @return Execution result, see @ref Status.
+   */
+  Status ReadDeviceInfo(DeviceInfo &info);
+
+  /**
+   * @~Chinese
+   * @brief 获取 @ref Init 或 @ref ReadDeviceInfo 缓存的设备信息，不访问总线。
+   * @return 设备信息，尚未读取过时所有字段为0。
+   */
+  /**
+   * @~English
+   * @brief Get the device information cached by @ref Init or @ref ReadDeviceInfo, without touching the bus.
+   * @return Device information, all fields are 0 when it has not been read yet.
    */
-  void Init();
+  const DeviceInfo &device_info() const;
 
   /**
    * @~Chinese
-   * @brief 获取固件版本。
+   * @brief 获取固件版本。已缓存设备信息时不访问总线，参见 @ref device_info 。
    * @return 固件版本。
    */
   /**
    * @~English
-   * @brief Get firmware version.
+   * @brief Get firmware version. Served without touching the bus once the device information is cached, see @ref device_info.
    * @return Firmware version.
    */
   String firmware_version();
 
   /**
    * @~Chinese
-   * @brief 获取设备ID。
+   * @brief 获取设备ID。已缓存设备信息时不访问总线，参见 @ref device_info 。
    * @return 设备ID。
    */
   /**
    * @~English
-   * @brief Get device ID.
+   * @brief Get device ID. Served without touching the bus once the device information is cached, see @ref device_info.
    * @return Device ID.
    */
   uint8_t device_id();
 
   /**
    * @~Chinese
-   * @brief 获取设备名称。
+   * @brief 获取设备名称。已缓存设备信息时不访问总线，参见 @ref device_info 。
    * @return 设备名称。
    */
   /**
    * @~English
-   * @brief Get device name.
+   * @brief Get device name. Served without touching the bus once the device information is cached, see @ref device_info.
    * @return Device name.
    */
   String name();
 
+  /**
+   * @~Chinese
+   * @brief 以差异方式应用配置文件：只发送与MD40当前配置不同的命令。
+   * @details 模式无法从MD40读回，因此只有当电机的配置缓存（ @ref Motor::set_config_cache_enabled ）中已有相同模式时才会跳过，否则总是发送。
+   * 固件切换模式时可能重新初始化PID参数，因此先发出模式命令并等待执行完毕，再比较PID参数：每个电机的六个PID参数通过一次连续读取获得
+   * （配置缓存中已全部缓存时不读取），只发送不同的参数。配置文件中未设置的部分保持不变。
+   * @param[in] profile 配置文件。
+   * @return 执行结果，参见 @ref Status 。
+   */
+  /**
+   * @~English
+   * @brief Apply a configuration profile as a diff: only the commands that differ from the MD40's current configuration are sent.
+   * @details The mode cannot be read back from the MD40, so it is only skipped when the motor's configuration cache
+   * (@ref Motor::set_config_cache_enabled) already holds the same mode, otherwise it is always sent. The firmware may reinitialize the PID gains
+   * when the mode changes, so the mode commands are sent and waited for first, then the PID gains are compared: the six gains of each motor are
+   * fetched in one burst read (skipped when all of them are in the configuration cache) and only the differing ones are sent. Parts not set in
+   * the profile are left alone.
+   * @param[in] profile Configuration profile.
+   * @return Execution result, see @ref Status.
+   */
+  Status ApplyConfigProfile(const ConfigProfile &profile);
+
+  /**
+   * @~Chinese
+   * @brief 读取当前配置生成配置文件：每个电机的PID参数通过一次连续读取获得，模式取自配置缓存，未缓存的模式在配置文件中保持未设置。
+   * @param[out] profile 配置文件。
+   * @return 执行结果，参见 @ref Status 。
+   */
+  /**
+   * @~English
+   * @brief Capture the current configuration into a profile: the PID gains of each motor are fetched in one burst read, the mode is taken from
+   * the configuration cache, and a mode that is not cached stays unset in the profile.
+   * @param[out] profile Configuration profile.
+   * @return Execution result, see @ref Status.
+   */
+  Status ReadConfigProfile(ConfigProfile &profile);
+
+  /**
+   * @~Chinese
+   * @brief 推进非阻塞命令的执行，每次调用最多进行一次总线操作。
+   * @details 所有电机共用MD40上的一个命令邮箱，已提交的命令按提交顺序依次写入并等待执行完毕。应在主循环中反复调用。
+   * 总线操作失败时命令保留在队列中，下次调用时重试；但执行标志的写入失败且可能已被MD40接收时，重试可能使命令被执行两次，该命令会被放弃，
+   * 其句柄的 @ref CommandHandle::Done 返回true。每条命令执行完毕后队列腾出一个位置，之前因队列已满被拒绝的命令可以重新提交。
+   * @return 本次总线操作的结果，参见 @ref Status 。
+   */
+  /**
+   * @~English
+   * @brief Advance the execution of non-blocking commands, doing at most one bus operation per call.
+   * @details All motors share the single command mailbox of the MD40, submitted commands are written and waited for one after another in
+   * submission order. Call it repeatedly from the main loop. When the bus operation fails the command stays queued and is retried on the next
+   * call, except when a failed write of the execute flag may still have reached the MD40: writing it again could run the command twice, so the
+   * command is abandoned and its @ref CommandHandle::Done returns true. Every executed command frees a place in the queue, so a command rejected while the queue was full can be submitted again.
+   * @return Result of this bus operation, see @ref Status.
+   */
+  Status Poll();
+
+  /**
+   * @~Chinese
+   * @brief 按等待策略阻塞等待命令执行完毕。
+   * @details 超时或总线错误时，该命令及排在它前面尚未执行完毕的命令会被放弃，其句柄的 @ref CommandHandle::Done 将返回true。已写入MD40的命令仍可能被执行。
+   * @param[in] handle 命令句柄。
+   * @return 执行结果，超时返回 @ref Status::kTimeout ，总线错误返回 @ref Status::kBusError ，被拒绝的命令返回 @ref Status::kQueueFull 。
+   */
+  /**
+   * @~English
+   * @brief Block according to the wait policy until the command has been executed.
+   * @details On timeout or bus error the command and the unfinished commands queued before it are abandoned and their @ref CommandHandle::Done
+   * returns true. A command already written to the MD40 may still be executed.
+   * @param[in] handle Command handle.
+   * @return Execution result, @ref Status::kTimeout on timeout, @ref Status::kBusError on bus error, @ref Status::kQueueFull for a rejected
+   * command.
+   */
+  Status Wait(const CommandHandle &handle);
+
+  /**
+   * @~Chinese
+   * @brief 按等待策略阻塞直到所有已提交的命令都执行完毕。
+   * @return 执行结果，超时返回 @ref Status::kTimeout 。
+   */
+  /**
+   * @~English
+   * @brief Block according to the wait policy until all submitted commands have been executed.
+   * @return Execution result, @ref Status::kTimeout on timeout.
+   */
+  Status Flush();
+
+  /**
+   * @~Chinese
+   * @brief 设置等待命令执行完毕时的轮询策略，默认为不超时的连续轮询。
+   * @param[in] policy 等待策略。
+   */
+  /**
+   * @~English
+   * @brief Set the polling policy used while waiting for commands to be executed, spinning without timeout by default.
+   * @param[in] policy Wait policy.
+   */
+  void set_wait_policy(const WaitPolicy &policy);
+
+  /**
+   * @~Chinese
+   * @brief 获取等待命令执行完毕时的轮询策略。
+   * @return 等待策略。
+   */
+  /**
+   * @~English
+   * @brief Get the polling policy used while waiting for commands to be executed.
+   * @return Wait policy.
+   */
+  const WaitPolicy &wait_policy() const;
+
+  /**
+   * @~Chinese
+   * @brief 设置每次I2C传输失败后的重试次数，默认为2。
+   * @details 每次传输尝试的耗时受传输层超时限制（ TwoWireTransport 在支持的平台上由 @ref Init 设置为25毫秒），因此单次传输的最坏耗时为 (重试次数 + 1) × 超时时间。
+   * 命令写入只在地址未被应答时才会重试，以免同一命令被执行两次。
+   * @param[in] retry_count 重试次数。
+   */
+  /**
+   * @~English
+   * @brief Set the number of retries after a failed I2C transaction, 2 by default.
+   * @details Every attempt is bounded by the transport's timeout (TwoWireTransport sets 25 ms in @ref Init where the core supports it), so the worst case of one transaction is
+   * (retry count + 1) × timeout. A command write is only retried when its address was not acknowledged, so that no command is executed twice.
+   * @param[in] retry_count Number of retries.
+   */
+  void set_retry_count(const uint8_t retry_count);
+
+  /**
+   * @~Chinese
+   * @brief 获取每次I2C传输失败后的重试次数。
+   * @return 重试次数。
+   */
+  /**
+   * @~English
+   * @brief Get the number of retries after a failed I2C transaction.
+   * @return Number of retries.
+   */
+  uint8_t retry_count() const;
+
+  /**
+   * @~Chinese
+   * @brief 设置命令的写入方式，默认为 @ref CommandWrite::kDetect 。
+   * @details 检测在 @ref Init 中进行，在不接受一次写入的固件上要等待约20毫秒。已知固件版本时可直接指定写入方式以跳过检测，指定的方式立即生效。
+   * @param[in] command_write 写入方式。
+   */
+  /**
+   * @~English
+   * @brief Set how commands are written, @ref CommandWrite::kDetect by default.
+   * @details Detection runs in @ref Init and takes about 20 ms of waiting on firmware that does not accept the single write. When the firmware is
+   * known the write can be set directly to skip the detection, and takes effect at once.
+   * @param[in] command_write How commands are written.
+   */
+  void set_command_write(const CommandWrite command_write);
+
+  /**
+   * @~Chinese
+   * @brief 获取当前是否通过一次I2C写入提交命令。
+   * @return 使用一次写入时返回true。检测方式下在 @ref Init 之前返回false。
+   */
+  /**
+   * @~English
+   * @brief Get whether commands currently go out in a single I2C write.
+   * @return True for the single write. With detection it is false until @ref Init.
+   */
+  bool fused_command() const;
+
+  /**
+   * @~Chinese
+   * @brief 在候选总线时钟频率中选出能可靠通信的最高频率，并把总线设置为该频率。需要传输层提供 SetClock ，参见 @ref transport_concept 。
+   * @details 可选，通常在 @ref Init 之后调用一次。先在第一个候选频率上读取设备信息寄存器和电机0的速度PID比例值作为参考，然后从低到高逐个尝试：
+   * 每次检查连续读取设备信息寄存器（设备ID、固件版本和名称）并与参考值比对，再把速度PID比例值在原值和最低位取反的值之间交替写入并读回比对。
+   * 检查期间不重试传输，每条命令最多等待20毫秒，以便错误不被掩盖。某个频率的失败次数超过 @ref BusSpeedPolicy::error_budget
+   * 时停止尝试更高的频率，总线设置为最后一个通过的频率，并以该频率恢复原来的PID值。
+   * 总线时钟由总线上所有设备共用，选出的频率也必须适合其他设备。
+   * @param[in] policy 候选频率、检查次数和错误预算。
+   * @return 执行结果，第一个候选频率也未通过时返回 @ref Status::kBusError ，此时总线保持在第一个候选频率。
+   */
+  /**
+   * @~English
+   * @brief Pick the fastest of the candidate bus clock rates that still communicates reliably and set the bus to it. The transport must provide
+   * SetClock, see @ref transport_concept.
+   * @details Optional, usually called once after @ref Init. The device information registers and the speed PID proportional value of motor 0
+   * are read at the first candidate as reference values, then the candidates are tried in ascending order. Every check burst-reads the device
+   * information registers (device ID, firmware version and name) and compares them with the reference, then writes the speed PID proportional
+   * value, alternating between the original value and the value with its lowest bit inverted, and compares the readback. Transfers are not
+   * retried and each command waits at most 20 ms during the checks, so that no error is masked. Once a rate has more failures than
+   * @ref BusSpeedPolicy::error_budget no faster rate is tried, the bus is set to the last rate that passed and the original PID value is restored
+   * at that rate. The bus clock is shared by every device on the bus, so the chosen rate must suit the other devices too.
+   * @param[in] policy Candidate rates, number of checks and error budget.
+   * @return Execution result, @ref Status::kBusError when even the first candidate fails, in which case the bus stays at the first candidate.
+   */
+  Status NegotiateBusSpeed(const BusSpeedPolicy &policy);
+
+  /**
+   * @~Chinese
+   * @brief 使用默认的 @ref BusSpeedPolicy 协商总线时钟频率，参见 @ref NegotiateBusSpeed(const BusSpeedPolicy &) 。
+   * @return 执行结果，参见 @ref Status 。
+   */
+  /**
+   * @~English
+   * @brief Negotiate the bus clock rate with the default @ref BusSpeedPolicy, see @ref NegotiateBusSpeed(const BusSpeedPolicy &).
+   * @return Execution result, see @ref Status.
+   */
+  Status NegotiateBusSpeed();
+
+  /**
+   * @~Chinese
+   * @brief 获取最近一次 @ref NegotiateBusSpeed 选出的总线时钟频率。
+   * @return 总线时钟频率（Hz），尚未协商或没有频率通过时为0。
+   */
+  /**
+   * @~English
+   * @brief Get the bus clock rate chosen by the most recent @ref NegotiateBusSpeed.
+   * @return Bus clock rate (Hz), 0 when not negotiated yet or when no rate passed.
+   */
+  uint32_t bus_clock_hz() const;
+
+  /**
+   * @~Chinese
+   * @brief 获取最近一次 @ref NegotiateBusSpeed 在选出的频率上失败的检查次数。
+   * @return 失败的检查次数。
+   */
+  /**
+   * @~English
+   * @brief Get the number of checks that failed at the rate chosen by the most recent @ref NegotiateBusSpeed.
+   * @return Number of failed checks.
+   */
+  uint8_t bus_clock_error_count() const;
+
+  /**
+   * @~Chinese
+   * @brief 获取最近一次总线操作的结果。
+   * @details 返回数值的读取函数（如 @ref Motor::speed 、 @ref device_id ）在失败时返回0，可通过该函数判断读取是否成功。
+   * @return 最近一次总线操作的结果。
+   */
+  /**
+   * @~English
+   * @brief Get the result of the most recent bus operation.
+   * @details Getters that return a value (such as @ref Motor::speed or @ref device_id) return 0 on failure, use this function to tell whether the
+   * read succeeded.
+   * @return Result of the most recent bus operation.
+   */
+  Status last_status() const;
+
  private:
-  Md40(const Md40 &) = delete;
-  Md40 &operator=(const Md40 &) = delete;
+  enum CommandType : uint8_t {
+    kSetup = 1,
+    kReset = 2,
+    kSetSpeedPidP = 3,
+    kSetSpeedPidI = 4,
+    kSetSpeedPidD = 5,
+    kSetPositionPidP = 6,
+    kSetPositionPidI = 7,
+    kSetPositionPidD = 8,
+    kSetPosition = 9,
+    kSetPulseCount = 10,
+    kStop = 11,
+    kRunPwmDuty = 12,
+    kRunSpeed = 13,
+    kMoveTo = 14,
+    kMove = 15,
+  };
+
+  enum MemoryAddress : uint8_t {
+    kDeviceId = 0x00,
+    kMajorVersion = 0x01,
+    kMinorVersion = 0x02,
+    kPatchVersion = 0x03,
+    kName = 0x04,
+    kCommandType = 0x11,
+    kCommandIndex = 0x12,
+    kCommandParam = 0x13,
+    kCommandExecute = 0x23,
+    kState = 0x24,
+    kSpeedP = 0x26,
+    kSpeedI = 0x28,
+    kSpeedD = 0x2A,
+    kPositionP = 0x2C,
+    kPositionI = 0x2E,
+    kPositionD = 0x30,
+    kSpeed = 0x34,
+    kPosition = 0x38,
+    kPulseCount = 0x3C,
+    kPwmDuty = 0x40,
+  };
+
+  struct FieldLayout {
+    uint8_t address;
+    uint8_t length;
+  };
+
+  static constexpr uint8_t kMotorStateOffset = 0x20;
+  // The longest parameters of any command, the target and speed of MoveTo and Move. The mailbox has room for 16 bytes, but queueing only what
+  // is used keeps every queue entry at 11 bytes on boards with little RAM.
+  static constexpr uint8_t kCommandParamLength = 2 * sizeof(int32_t);
+  // Deep enough for one command per motor or a whole SubmitPidGains.
+  static constexpr uint8_t kCommandQueueSize = Motor::kPidGainNum > kMotorNum ? Motor::kPidGainNum : kMotorNum;
+  static constexpr uint8_t kCommandLength = kCommandExecute + 1 - kCommandType;
+  static constexpr uint8_t kSnapshotLength = kPwmDuty + sizeof(int16_t) - kState;
+  static constexpr uint32_t kArrivalPollIntervalUs = 2000;
+  static constexpr uint8_t kDeviceInfoLength = kName + DeviceInfo::kNameLength - kDeviceId;
+  // Long enough for the firmware to execute one command, bounds the waits of the bus check and of the command write detection.
+  static constexpr uint32_t kBusCheckCommandTimeoutUs = 20000;
+
+  // Skipping a gap of up to this many bytes is cheaper on the wire than a separate segment. At 9 bits per byte with its ACK, a segment adds a
+  // register write (address and register byte, 18 bits, plus start and stop) and a read header (9 bits plus start and stop), about 31 bits,
+  // while a 3-byte gap costs 27 bits and a 4-byte gap 36.
+  static constexpr uint8_t kMaxMergeGap = 3;
+
+  // Indexed by the bit position of the ReadPlan field.
+  static constexpr FieldLayout kFieldLayouts[] = {
+      {kState, sizeof(uint8_t)},
+      {kSpeed, sizeof(int32_t)},
+      {kPosition, sizeof(int32_t)},
+      {kPulseCount, sizeof(int32_t)},
+      {kPwmDuty, sizeof(int16_t)},
+  };
+
+  enum class MailboxPhase : uint8_t {
+    kIdle,
+    kWaitEmptied,
+    kWrite,
+    kExecute,
+    kWaitExecuted,
+  };
+
+  struct Command {
+    uint8_t type = 0;
+    uint8_t index = 0;
+    uint8_t length = 0;
+    uint8_t param[kCommandParamLength] = {0};
+  };
+
+  template <typename, uint8_t>
+  friend class BasicMd40Bus;
+
+  template <typename>
+  friend class BasicMd40ProfileStreamer;
+
+  template <typename, uint16_t>
+  friend class BasicMd40Sampler;
+
+  template <typename, uint32_t>
+  friend class BasicMd40Worker;
+
+  template <typename, uint8_t>
+  friend class BasicMd40EventDispatcher;
+
+  template <typename>
+  friend class BasicMd40Autotuner;
+
+  BasicMd40(const BasicMd40 &) = delete;
+  BasicMd40 &operator=(const BasicMd40 &) = delete;
+
+  Status Probe();
+
+  Status LoadDeviceInfo();
+
+  Status DetectFusedCommand();
+
+  Status WaitCommandEmptied();
+
+  Status ReadPidGainRegisters(const uint8_t index, uint16_t (&gains)[Motor::kPidGainNum]);
+
+  bool CheckBusIntegrity(const uint8_t (&reference)[kDeviceInfoLength], const uint16_t gain);
+
+  CommandHandle Submit(const uint8_t type, const uint8_t index, const void *param, const uint8_t length);
+
+  CommandHandle Reject();
+
+  Status Reserve(const uint8_t command_num);
+
+  Status Step(bool &progressed);
+
+  void Abandon(const uint16_t sequence);
+
+  Status ReadCommandEmptied(bool &emptied);
+
+  Status WriteCommand(const Command &command);
+
+  Status WriteRegisters(const uint8_t address, const void *data, const uint8_t length, const bool idempotent);
+
+  Status ReadRegisters(const uint8_t address, void *data, const uint8_t length);
+
+  Status ReadLatchedRegisters(const uint8_t address, void *data, const uint8_t length);
 
   const uint8_t i2c_address_ = kDefaultI2cAddress;
-  TwoWire &wire_ = Wire;
-  Motor *motors_[kMotorNum] = {nullptr};
+  Transport transport_;
+  Motor motors_[kMotorNum];
+  CommandWrite command_write_ = CommandWrite::kDetect;
+  bool fused_command_ = false;
+  bool device_info_cached_ = false;
+  DeviceInfo device_info_ = {};
+  WaitPolicy wait_policy_;
+  uint8_t retry_count_ = 2;
+  Status last_status_ = Status::kOk;
+  I2cResult last_write_result_ = I2cResult::kOk;
+  uint32_t bus_clock_hz_ = 0;
+  uint8_t bus_clock_error_count_ = 0;
+  MailboxPhase mailbox_phase_ = MailboxPhase::kIdle;
+  bool mailbox_emptied_ = false;
+  Command commands_[kCommandQueueSize];
+  uint8_t command_head_ = 0;
+  uint8_t command_num_ = 0;
+  uint16_t submitted_sequence_ = 0;
+  uint16_t finished_sequence_ = 0;
 };
 }  // namespace em
+
+#include "md40_impl.h"
+
+#ifdef ARDUINO
+namespace em {
+
+/**
+ * @~Chinese
+ * @brief 使用 TwoWire 的MD40驱动类。
+ */
+/**
+ * @~English
+ * @brief MD40 driver class using TwoWire.
+ */
+using Md40 = BasicMd40<TwoWireTransport>;
+
+extern template class BasicMd40<TwoWireTransport>;
+}  // namespace em
+#endif
 #endif
\ No newline at end of file
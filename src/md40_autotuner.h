@@ -0,0 +1,1039 @@
+#pragma once
+
+#ifndef _EM_MD40_AUTOTUNER_H_
+#define _EM_MD40_AUTOTUNER_H_
+
+#include <math.h>
+
+#include "md40.h"
+
+/**
+ * @file md40_autotuner.h
+ */
+
+namespace em {
+
+/**
+ * @~Chinese
+ * @class BasicMd40Autotuner
+ * @brief 基于继电反馈（Åström–Hägglund）的PID自整定，用于速度环或位置环。
+ * @details 非阻塞：调用 @ref Begin 后在 loop() 中反复调用 @ref Step ，每次调用最多推进一条命令或在采样时刻读取一次测量值，直到
+ * @ref phase 变为 @ref Phase::kDone 或 @ref Phase::kFailed 。整定分为三步：
+ * - 继电实验：以固定周期采样，测量值低于目标时输出高，高于目标时输出低（带回差），使闭环产生等幅振荡。速度环用 RunPwmDuty 输出
+ *   偏置 ± 幅值的PWM占空比，偏置根据高低两半周期的不对称自动调整；位置环的板载PID输出的是速度环的目标速度，因此用 RunSpeed 输出
+ *   ± 幅值的速度（RPM），速度环应已整定。振荡稳定后由最近几个周期的平均振幅 a 和周期得到临界增益 Ku = 4d / (πa) 和临界周期 Pu。
+ * - 由 Ku、Pu 和已知的静态增益拟合一阶加纯滞后模型（位置环再加一个积分），按所选的整定规则计算连续PID参数，再按板载PID的控制周期
+ *   换算为其离散形式（ I = Kp·T/Ti ， D = Kp·Td/T ）并写入MD40。用该模型离线仿真一次阶跃，得到预测的调节时间。
+ * - 验证：等电机停稳后，速度环以 RunSpeed 阶跃到目标速度，位置环以 MoveTo 回到起点，按同样的误差带（目标的2%，至少为1）测量实际的调节时间。
+ * 只有 @ref Step 访问总线，它必须与同一 Md40 对象的其他调用位于同一上下文中。
+ * @tparam Transport 传输层类型。
+ */
+/**
+ * @~English
+ * @class BasicMd40Autotuner
+ * @brief Relay feedback (Åström–Hägglund) PID autotuner for the speed loop or the position loop.
+ * @details Non-blocking: after @ref Begin, call @ref Step repeatedly from loop(). Each call advances at most one command or takes one measurement
+ * when a sample is due, until @ref phase becomes @ref Phase::kDone or @ref Phase::kFailed. Tuning takes three steps:
+ * - Relay experiment: sampled at a fixed period, the output is high while the measurement is below the target and low while it is above (with
+ *   hysteresis), so the closed loop settles into a limit cycle. The speed loop outputs a PWM duty of bias ± amplitude with RunPwmDuty, the bias
+ *   following the asymmetry between the high and the low half periods. The onboard position PID outputs the target of the speed loop, so the
+ *   position loop outputs a speed of ± amplitude (RPM) with RunSpeed, and the speed loop should be tuned already. Once the oscillation is steady,
+ *   the average amplitude a and period of the last few cycles give the ultimate gain Ku = 4d / (πa) and the ultimate period Pu.
+ * - Ku, Pu and the known static gain are fitted to a first order plus dead time model (with an extra integrator for the position loop). The
+ *   selected tuning rule gives continuous PID gains, which are converted to the discrete form of the onboard PID with its control period
+ *   (I = Kp·T/Ti, D = Kp·Td/T) and written to the MD40. A step is simulated offline on the model to predict the settling time.
+ * - Verification: once the motor is at rest, the speed loop steps to the target speed with RunSpeed and the position loop returns to its start
+ *   with MoveTo, and the actual settling time is measured with the same error band (2% of the target, at least 1).
+ * Only @ref Step touches the bus, it must run in the same context as every other call on the same Md40 object.
+ * @tparam Transport Transport type.
+ */
+template <typename Transport>
+class BasicMd40Autotuner {
+ public:
+  /**
+   * @~Chinese
+   * @brief 驱动类型。
+   */
+  /**
+   * @~English
+   * @brief Driver type.
+   */
+  using Md40 = BasicMd40<Transport>;
+
+  /**
+   * @~Chinese
+   * @brief 状态码类型。
+   */
+  /**
+   * @~English
+   * @brief Status code type.
+   */
+  using Status = typename Md40::Status;
+
+  /**
+   * @~Chinese
+   * @brief 表示调节时间无法确定：阶跃响应在观察窗口结束时仍在误差带之外。
+   */
+  /**
+   * @~English
+   * @brief Marks a settling time that could not be determined: the step response is still outside the error band when the observation window
+   * ends.
+   */
+  static constexpr uint32_t kNotSettled = UINT32_MAX;
+
+  /**
+   * @~Chinese
+   * @brief 整定的控制环。
+   */
+  /**
+   * @~English
+   * @brief Control loop to tune.
+   */
+  enum class Loop : uint8_t {
+    /**
+     * @~Chinese
+     * @brief 速度环，写入速度PID参数。
+     */
+    /**
+     * @~English
+     * @brief Speed loop, writes the speed PID gains.
+     */
+    kSpeed = 0,
+
+    /**
+     * @~Chinese
+     * @brief 位置环，写入位置PID参数。
+     */
+    /**
+     * @~English
+     * @brief Position loop, writes the position PID gains.
+     */
+    kPosition = 1,
+  };
+
+  /**
+   * @~Chinese
+   * @brief 由 Ku 和 Pu 计算PID参数的整定规则。
+   */
+  /**
+   * @~English
+   * @brief Tuning rule computing the PID gains from Ku and Pu.
+   */
+  enum class Rule : uint8_t {
+    /**
+     * @~Chinese
+     * @brief Ziegler–Nichols PID：Kp = 0.6Ku，Ti = Pu/2，Td = Pu/8。响应快，超调较大。
+     */
+    /**
+     * @~English
+     * @brief Ziegler–Nichols PID: Kp = 0.6Ku, Ti = Pu/2, Td = Pu/8. Fast, with a large overshoot.
+     */
+    kZieglerNichols = 0,
+
+    /**
+     * @~Chinese
+     * @brief Ziegler–Nichols PI：Kp = 0.45Ku，Ti = Pu/1.2，Td = 0。
+     */
+    /**
+     * @~English
+     * @brief Ziegler–Nichols PI: Kp = 0.45Ku, Ti = Pu/1.2, Td = 0.
+     */
+    kZieglerNicholsPi = 1,
+
+    /**
+     * @~Chinese
+     * @brief Tyreus–Luyben PID：Kp = Ku/2.2，Ti = 2.2Pu，Td = Pu/6.3。比Ziegler–Nichols保守，振荡更少。
+     */
+    /**
+     * @~English
+     * @brief Tyreus–Luyben PID: Kp = Ku/2.2, Ti = 2.2Pu, Td = Pu/6.3. More conservative than Ziegler–Nichols, with less oscillation.
+     */
+    kTyreusLuyben = 2,
+
+    /**
+     * @~Chinese
+     * @brief 少量超调：Kp = 0.33Ku，Ti = Pu/2，Td = Pu/3。
+     */
+    /**
+     * @~English
+     * @brief Some overshoot: Kp = 0.33Ku, Ti = Pu/2, Td = Pu/3.
+     */
+    kSomeOvershoot = 3,
+
+    /**
+     * @~Chinese
+     * @brief 无超调：Kp = 0.2Ku，Ti = Pu/2，Td = Pu/3。
+     */
+    /**
+     * @~English
+     * @brief No overshoot: Kp = 0.2Ku, Ti = Pu/2, Td = Pu/3.
+     */
+    kNoOvershoot = 4,
+  };
+
+  /**
+   * @~Chinese
+   * @brief 整定进度。
+   */
+  /**
+   * @~English
+   * @brief Tuning progress.
+   */
+  enum class Phase : uint8_t {
+    /**
+     * @~Chinese
+     * @brief 尚未开始。
+     */
+    /**
+     * @~English
+     * @brief Not started.
+     */
+    kIdle = 0,
+
+    /**
+     * @~Chinese
+     * @brief 正在进行继电实验。
+     */
+    /**
+     * @~English
+     * @brief Running the relay experiment.
+     */
+    kRelay = 1,
+
+    /**
+     * @~Chinese
+     * @brief 已写入PID参数，等待电机停稳。
+     */
+    /**
+     * @~English
+     * @brief The PID gains are written, waiting for the motor to come to rest.
+     */
+    kRest = 2,
+
+    /**
+     * @~Chinese
+     * @brief 正在测量阶跃响应的调节时间。
+     */
+    /**
+     * @~English
+     * @brief Measuring the settling time of the step response.
+     */
+    kVerify = 3,
+
+    /**
+     * @~Chinese
+     * @brief 整定完成，结果参见 @ref result 。
+     */
+    /**
+     * @~English
+     * @brief Tuning finished, see @ref result.
+     */
+    kDone = 4,
+
+    /**
+     * @~Chinese
+     * @brief 继电实验超时或振荡无法使用，PID参数未被修改，电机已停止。
+     */
+    /**
+     * @~English
+     * @brief The relay experiment timed out or its oscillation was unusable. The PID gains are unchanged and the motor is stopped.
+     */
+    kFailed = 5,
+  };
+
+  /**
+   * @~Chinese
+   * @brief 整定参数。
+   */
+  /**
+   * @~English
+   * @brief Tuning parameters.
+   */
+  struct Config {
+    /**
+     * @~Chinese
+     * @brief 整定的控制环。
+     */
+    /**
+     * @~English
+     * @brief Control loop to tune.
+     */
+    Loop loop = Loop::kSpeed;
+
+    /**
+     * @~Chinese
+     * @brief 整定规则。
+     */
+    /**
+     * @~English
+     * @brief Tuning rule.
+     */
+    Rule rule = Rule::kZieglerNichols;
+
+    /**
+     * @~Chinese
+     * @brief 继电实验的目标，不能为0：速度环为目标速度（RPM），位置环为相对起始位置的位移（度）。也是验证时阶跃的大小。
+     */
+    /**
+     * @~English
+     * @brief Target of the relay experiment, must not be 0: the target speed (RPM) for the speed loop, the offset from the start position
+     * (degrees) for the position loop. Also the size of the verification step.
+     */
+    int32_t setpoint = 100;
+
+    /**
+     * @~Chinese
+     * @brief 继电幅值 d ，必须大于0：速度环为PWM占空比，位置环为速度（RPM），也是位置环验证时的速度上限。
+     */
+    /**
+     * @~English
+     * @brief Relay amplitude d, must be greater than 0: a PWM duty for the speed loop, a speed (RPM) for the position loop, which is also the
+     * speed limit of the position loop verification.
+     */
+    int32_t relay_amplitude = 300;
+
+    /**
+     * @~Chinese
+     * @brief 继电回差，单位与测量值相同（RPM或度），用于抑制测量噪声引起的抖动。
+     */
+    /**
+     * @~English
+     * @brief Relay hysteresis in the unit of the measurement (RPM or degrees), keeping measurement noise from chattering the relay.
+     */
+    int32_t hysteresis = 1;
+
+    /**
+     * @~Chinese
+     * @brief 采样周期（微秒）。默认与板载PID的控制周期相同，使继电回路的采样延迟与板载PID相近。
+     */
+    /**
+     * @~English
+     * @brief Sampling period in microseconds. By default the same as the control period of the onboard PID, so the relay loop sees about the same
+     * sampling delay as the onboard PID.
+     */
+    uint32_t sample_period_us = 10000;
+
+    /**
+     * @~Chinese
+     * @brief 板载PID的控制周期（微秒），用于换算离散PID参数和预测调节时间。
+     */
+    /**
+     * @~English
+     * @brief Control period of the onboard PID in microseconds, used to convert to discrete PID gains and to predict the settling time.
+     */
+    uint32_t control_period_us = 10000;
+
+    /**
+     * @~Chinese
+     * @brief 参与平均的振荡周期数，前两个周期作为过渡过程被丢弃。
+     */
+    /**
+     * @~English
+     * @brief Number of oscillation cycles averaged, the first two cycles are discarded as transient.
+     */
+    uint8_t cycle_num = 4;
+
+    /**
+     * @~Chinese
+     * @brief 继电实验的超时时间（微秒）。
+     */
+    /**
+     * @~English
+     * @brief Timeout of the relay experiment in microseconds.
+     */
+    uint32_t timeout_us = 20000000;
+  };
+
+  /**
+   * @~Chinese
+   * @brief 整定结果。
+   */
+  /**
+   * @~English
+   * @brief Tuning result.
+   */
+  struct Result {
+    /**
+     * @~Chinese
+     * @brief 临界增益 Ku ：速度环单位为PWM占空比/RPM，位置环单位为RPM/度。
+     */
+    /**
+     * @~English
+     * @brief Ultimate gain Ku: PWM duty per RPM for the speed loop, RPM per degree for the position loop.
+     */
+    float ultimate_gain = 0;
+
+    /**
+     * @~Chinese
+     * @brief 临界周期 Pu （微秒）。
+     */
+    /**
+     * @~English
+     * @brief Ultimate period Pu in microseconds.
+     */
+    uint32_t ultimate_period_us = 0;
+
+    /**
+     * @~Chinese
+     * @brief 拟合模型的静态增益：速度环为RPM/PWM占空比，由继电偏置得到；位置环为速度积分的系数6度/秒/RPM。
+     */
+    /**
+     * @~English
+     * @brief Static gain of the fitted model: RPM per PWM duty for the speed loop, taken from the relay bias; for the position loop the factor of
+     * the speed integration, 6 degrees per second per RPM.
+     */
+    float model_gain = 0;
+
+    /**
+     * @~Chinese
+     * @brief 拟合模型的时间常数（秒）。
+     */
+    /**
+     * @~English
+     * @brief Time constant of the fitted model in seconds.
+     */
+    float model_time_constant_s = 0;
+
+    /**
+     * @~Chinese
+     * @brief 拟合模型的纯滞后（秒）。
+     */
+    /**
+     * @~English
+     * @brief Dead time of the fitted model in seconds.
+     */
+    float model_dead_time_s = 0;
+
+    /**
+     * @~Chinese
+     * @brief 写入的比例（P）值。
+     */
+    /**
+     * @~English
+     * @brief Proportional (P) value written.
+     */
+    float p = 0;
+
+    /**
+     * @~Chinese
+     * @brief 写入的积分（I）值。
+     */
+    /**
+     * @~English
+     * @brief Integral (I) value written.
+     */
+    float i = 0;
+
+    /**
+     * @~Chinese
+     * @brief 写入的微分（D）值。
+     */
+    /**
+     * @~English
+     * @brief Derivative (D) value written.
+     */
+    float d = 0;
+
+    /**
+     * @~Chinese
+     * @brief 由模型预测的调节时间（微秒），或 @ref kNotSettled 。
+     */
+    /**
+     * @~English
+     * @brief Settling time predicted on the model in microseconds, or @ref kNotSettled.
+     */
+    uint32_t predicted_settling_us = kNotSettled;
+
+    /**
+     * @~Chinese
+     * @brief 实际测得的调节时间（微秒），或 @ref kNotSettled 。
+     */
+    /**
+     * @~English
+     * @brief Settling time actually measured in microseconds, or @ref kNotSettled.
+     */
+    uint32_t measured_settling_us = kNotSettled;
+  };
+
+  /**
+   * @~Chinese
+   * @brief 构造函数。
+   * @param[in] md40 Md40 对象引用。
+   */
+  /**
+   * @~English
+   * @brief Constructor.
+   * @param[in] md40 Md40 object reference.
+   */
+  explicit BasicMd40Autotuner(Md40 &md40);
+
+  /**
+   * @~Chinese
+   * @brief 开始整定。电机应已设置为编码器模式并处于静止状态，整定过程中电机会来回运动。
+   * @param[in] index 电机索引。
+   * @param[in] config 整定参数。
+   * @return 执行结果，参见 @ref BasicMd40::Status 。
+   */
+  /**
+   * @~English
+   * @brief Start tuning. The motor should be in encoder mode and at rest, it moves back and forth while being tuned.
+   * @param[in] index Motor index.
+   * @param[in] config Tuning parameters.
+   * @return Execution result, see @ref BasicMd40::Status.
+   */
+  Status Begin(const uint8_t index, const Config &config);
+
+  /**
+   * @~Chinese
+   * @brief 推进整定，应在 loop() 中反复调用，未开始或已结束时立即返回。
+   * @return 本次总线操作的结果，参见 @ref BasicMd40::Status 。失败的操作在下次调用时重试。
+   */
+  /**
+   * @~English
+   * @brief Advance the tuning, call it repeatedly from loop(). Returns at once when not started or already finished.
+   * @return Result of this bus operation, see @ref BasicMd40::Status. A failed operation is retried on the next call.
+   */
+  Status Step();
+
+  /**
+   * @~Chinese
+   * @brief 中止整定并停止电机。已写入的PID参数不会恢复。
+   * @return 执行结果，参见 @ref BasicMd40::Status 。
+   */
+  /**
+   * @~English
+   * @brief Abort the tuning and stop the motor. PID gains already written are not restored.
+   * @return Execution result, see @ref BasicMd40::Status.
+   */
+  Status Abort();
+
+  /**
+   * @~Chinese
+   * @brief 获取整定进度。
+   * @return 整定进度。
+   */
+  /**
+   * @~English
+   * @brief Get the tuning progress.
+   * @return Tuning progress.
+   */
+  Phase phase() const;
+
+  /**
+   * @~Chinese
+   * @brief 获取整定结果，各字段在对应步骤完成后有效。
+   * @return 整定结果。
+   */
+  /**
+   * @~English
+   * @brief Get the tuning result, each field is valid once its step has finished.
+   * @return Tuning result.
+   */
+  const Result &result() const;
+
+ private:
+  struct RuleFactors {
+    float kp;
+    float ti;
+    float td;
+  };
+
+  static constexpr float kPi = 3.14159265f;
+
+  // Degrees per second per RPM.
+  static constexpr float kDegreesPerSecondPerRpm = 6;
+
+  static constexpr int16_t kMaxPwmDuty = 1023;
+
+  // The first cycles after the start or a bias jump are transient.
+  static constexpr uint8_t kWarmupCycleNum = 2;
+
+  // Without a switch for this many samples the relay is stuck on one side and the bias jumps.
+  static constexpr uint8_t kStuckSampleNum = 50;
+
+  static constexpr uint8_t kRestSampleNum = 3;
+  static constexpr uint32_t kRestTimeoutUs = 2000000;
+
+  // The verification window and the prediction horizon are 40 ultimate periods, within these limits.
+  static constexpr uint8_t kObservationPeriodNum = 40;
+  static constexpr uint32_t kMinObservationUs = 1000000;
+  static constexpr uint32_t kMaxObservationUs = 15000000;
+
+  // The prediction integrates the model in substeps of the control period, the dead time is a ring of substep inputs.
+  static constexpr uint8_t kPredictionSubstepNum = 4;
+  static constexpr uint8_t kPredictionDelayNum = 32;
+
+  // Indexed by Rule.
+  static constexpr RuleFactors kRuleFactors[] = {
+      {0.6f, 0.5f, 0.125f},
+      {0.45f, 1 / 1.2f, 0},
+      {1 / 2.2f, 2.2f, 1 / 6.3f},
+      {0.33f, 0.5f, 1 / 3.0f},
+      {0.2f, 0.5f, 1 / 3.0f},
+  };
+
+  Status Measure(int32_t &value);
+
+  void Relay(const uint32_t now, const int32_t value);
+
+  void OnCycle(const uint32_t period_us, const uint32_t high_us, const uint32_t low_us, const int32_t amplitude);
+
+  void SubmitRelayOutput();
+
+  void Tune();
+
+  uint32_t PredictSettlingUs() const;
+
+  uint32_t observation_us() const;
+
+  void Fail();
+
+  Md40 &md40_;
+  uint8_t index_ = 0;
+  Config config_;
+  Phase phase_ = Phase::kIdle;
+  Result result_;
+  typename Md40::CommandHandle pending_;
+  uint32_t phase_start_us_ = 0;
+  uint32_t next_sample_us_ = 0;
+  int32_t target_ = 0;
+  int32_t band_ = 1;
+  float bias_ = 0;
+  bool relay_high_ = true;
+  uint8_t switch_num_ = 0;
+  uint8_t samples_since_switch_ = 0;
+  uint32_t last_rise_us_ = 0;
+  uint32_t last_fall_us_ = 0;
+  int32_t half_extreme_ = 0;
+  int32_t high_min_ = 0;
+  uint8_t cycle_num_ = 0;
+  uint8_t accepted_num_ = 0;
+  uint32_t period_sum_us_ = 0;
+  int32_t amplitude_sum_ = 0;
+  uint8_t rest_num_ = 0;
+  uint32_t settled_since_us_ = 0;
+  bool settled_ = false;
+};
+
+template <typename Transport>
+constexpr uint32_t BasicMd40Autotuner<Transport>::kNotSettled;
+
+template <typename Transport>
+constexpr float BasicMd40Autotuner<Transport>::kPi;
+
+template <typename Transport>
+constexpr float BasicMd40Autotuner<Transport>::kDegreesPerSecondPerRpm;
+
+template <typename Transport>
+constexpr int16_t BasicMd40Autotuner<Transport>::kMaxPwmDuty;
+
+template <typename Transport>
+constexpr uint8_t BasicMd40Autotuner<Transport>::kWarmupCycleNum;
+
+template <typename Transport>
+constexpr uint8_t BasicMd40Autotuner<Transport>::kStuckSampleNum;
+
+template <typename Transport>
+constexpr uint8_t BasicMd40Autotuner<Transport>::kRestSampleNum;
+
+template <typename Transport>
+constexpr uint32_t BasicMd40Autotuner<Transport>::kRestTimeoutUs;
+
+template <typename Transport>
+constexpr uint8_t BasicMd40Autotuner<Transport>::kObservationPeriodNum;
+
+template <typename Transport>
+constexpr uint32_t BasicMd40Autotuner<Transport>::kMinObservationUs;
+
+template <typename Transport>
+constexpr uint32_t BasicMd40Autotuner<Transport>::kMaxObservationUs;
+
+template <typename Transport>
+constexpr uint8_t BasicMd40Autotuner<Transport>::kPredictionSubstepNum;
+
+template <typename Transport>
+constexpr uint8_t BasicMd40Autotuner<Transport>::kPredictionDelayNum;
+
+template <typename Transport>
+constexpr typename BasicMd40Autotuner<Transport>::RuleFactors BasicMd40Autotuner<Transport>::kRuleFactors[];
+
+template <typename Transport>
+BasicMd40Autotuner<Transport>::BasicMd40Autotuner(Md40 &md40) : md40_(md40) {
+}
+
+template <typename Transport>
+typename BasicMd40Autotuner<Transport>::Status BasicMd40Autotuner<Transport>::Begin(const uint8_t index, const Config &config) {
+  EM_CHECK_LT(index, Md40::kMotorNum);
+  EM_CHECK_NE(config.setpoint, 0);
+  EM_CHECK_GT(config.relay_amplitude, 0);
+  EM_CHECK_GT(config.sample_period_us, 0);
+  EM_CHECK_GT(config.control_period_us, 0);
+  EM_CHECK_GT(config.cycle_num, 0);
+
+  index_ = index;
+  config_ = config;
+  result_ = Result();
+  phase_ = Phase::kIdle;
+
+  const int32_t magnitude = config.setpoint < 0 ? -config.setpoint : config.setpoint;
+  band_ = magnitude * 2 / 100 > 1 ? magnitude * 2 / 100 : 1;
+
+  target_ = config.setpoint;
+  if (config.loop == Loop::kPosition) {
+    int32_t position = 0;
+    const Status status = Measure(position);
+    if (status != Status::kOk) {
+      return status;
+    }
+    target_ += position;
+  }
+
+  bias_ = 0;
+  relay_high_ = true;
+  switch_num_ = 0;
+  samples_since_switch_ = 0;
+  cycle_num_ = 0;
+  accepted_num_ = 0;
+  period_sum_us_ = 0;
+  amplitude_sum_ = 0;
+  half_extreme_ = INT32_MAX;
+
+  phase_start_us_ = md40_.transport_.Micros();
+  next_sample_us_ = phase_start_us_;
+  last_rise_us_ = phase_start_us_;
+  phase_ = Phase::kRelay;
+  SubmitRelayOutput();
+  return Status::kOk;
+}
+
+template <typename Transport>
+typename BasicMd40Autotuner<Transport>::Status BasicMd40Autotuner<Transport>::Step() {
+  if (phase_ == Phase::kIdle || phase_ == Phase::kDone || phase_ == Phase::kFailed) {
+    return Status::kOk;
+  }
+
+  // Queued commands go out one bus operation per call, measurements wait until they have been executed.
+  if (!pending_.Done()) {
+    return md40_.Poll();
+  }
+
+  const uint32_t now = md40_.transport_.Micros();
+  if (static_cast<int32_t>(now - next_sample_us_) < 0) {
+    return Status::kOk;
+  }
+  // Stay on the grid of the first sample, skipping the periods a late call overran.
+  next_sample_us_ += ((now - next_sample_us_) / config_.sample_period_us + 1) * config_.sample_period_us;
+
+  int32_t value = 0;
+  const Status status = Measure(value);
+  if (status != Status::kOk) {
+    return status;
+  }
+
+  switch (phase_) {
+    case Phase::kRelay:
+      if (now - phase_start_us_ > config_.timeout_us) {
+        Fail();
+      } else {
+        Relay(now, value);
+      }
+      break;
+
+    case Phase::kRest: {
+      const int32_t speed = config_.loop == Loop::kSpeed ? value : md40_[index_].speed();
+      rest_num_ = speed >= -1 && speed <= 1 ? rest_num_ + 1 : 0;
+      if (rest_num_ >= kRestSampleNum || now - phase_start_us_ > kRestTimeoutUs) {
+        // The position loop steps back to where the relay experiment started.
+        if (config_.loop == Loop::kSpeed) {
+          pending_ = md40_[index_].SubmitRunSpeed(target_);
+        } else {
+          target_ -= config_.setpoint;
+          pending_ = md40_[index_].SubmitMoveTo(target_, config_.relay_amplitude);
+        }
+        phase_ = Phase::kVerify;
+        phase_start_us_ = now;
+        settled_ = false;
+      }
+      break;
+    }
+
+    case Phase::kVerify: {
+      const int32_t error = target_ - value;
+      if (error > band_ || error < -band_) {
+        settled_ = false;
+      } else if (!settled_) {
+        settled_ = true;
+        settled_since_us_ = now;
+      }
+
+      if (now - phase_start_us_ >= observation_us()) {
+        result_.measured_settling_us = settled_ ? settled_since_us_ - phase_start_us_ : kNotSettled;
+        pending_ = md40_[index_].SubmitStop();
+        phase_ = Phase::kDone;
+      }
+      break;
+    }
+
+    default:
+      break;
+  }
+  return Status::kOk;
+}
+
+template <typename Transport>
+typename BasicMd40Autotuner<Transport>::Status BasicMd40Autotuner<Transport>::Abort() {
+  if (phase_ == Phase::kIdle) {
+    return Status::kOk;
+  }
+  phase_ = Phase::kFailed;
+  pending_ = typename Md40::CommandHandle();
+  return md40_[index_].Stop();
+}
+
+template <typename Transport>
+typename BasicMd40Autotuner<Transport>::Phase BasicMd40Autotuner<Transport>::phase() const {
+  return phase_;
+}
+
+template <typename Transport>
+const typename BasicMd40Autotuner<Transport>::Result &BasicMd40Autotuner<Transport>::result() const {
+  return result_;
+}
+
+template <typename Transport>
+typename BasicMd40Autotuner<Transport>::Status BasicMd40Autotuner<Transport>::Measure(int32_t &value) {
+  typename Md40::Motor &motor = md40_[index_];
+  value = config_.loop == Loop::kSpeed ? motor.speed() : motor.position();
+  return md40_.last_status();
+}
+
+template <typename Transport>
+void BasicMd40Autotuner<Transport>::Relay(const uint32_t now, const int32_t value) {
+  samples_since_switch_++;
+
+  // The peaks lag the switches: the minimum falls into the high half and the maximum into the low half.
+  if (relay_high_) {
+    if (value < half_extreme_) {
+      half_extreme_ = value;
+    }
+    if (value > target_ + config_.hysteresis) {
+      high_min_ = half_extreme_;
+      half_extreme_ = value;
+      relay_high_ = false;
+      last_fall_us_ = now;
+      switch_num_++;
+      samples_since_switch_ = 0;
+      SubmitRelayOutput();
+    }
+  } else {
+    if (value > half_extreme_) {
+      half_extreme_ = value;
+    }
+    if (value < target_ - config_.hysteresis) {
+      // A full cycle needs a rise, a fall and this rise.
+      if (switch_num_ >= 2) {
+        OnCycle(now - last_rise_us_, last_fall_us_ - last_rise_us_, now - last_fall_us_, (half_extreme_ - high_min_) / 2);
+      }
+      half_extreme_ = value;
+      relay_high_ = true;
+      last_rise_us_ = now;
+      switch_num_++;
+      samples_since_switch_ = 0;
+      if (phase_ == Phase::kRelay) {
+        SubmitRelayOutput();
+      }
+    }
+  }
+
+  if (phase_ == Phase::kRelay && samples_since_switch_ >= kStuckSampleNum && config_.loop == Loop::kSpeed) {
+    // The bias cannot carry the measurement across the target, move it halfway towards the side the relay is stuck on.
+    bias_ += relay_high_ ? config_.relay_amplitude / 2.0f : -config_.relay_amplitude / 2.0f;
+    const float max_bias = kMaxPwmDuty - config_.relay_amplitude > 0 ? kMaxPwmDuty - config_.relay_amplitude : 0;
+    bias_ = bias_ > max_bias ? max_bias : (bias_ < -max_bias ? -max_bias : bias_);
+    samples_since_switch_ = 0;
+    cycle_num_ = 0;
+    accepted_num_ = 0;
+    period_sum_us_ = 0;
+    amplitude_sum_ = 0;
+    SubmitRelayOutput();
+  }
+}
+
+template <typename Transport>
+void BasicMd40Autotuner<Transport>::OnCycle(const uint32_t period_us, const uint32_t high_us, const uint32_t low_us, const int32_t amplitude) {
+  if (config_.loop == Loop::kSpeed) {
+    // Spending longer on the high side means the bias is too low. Half of the correction keeps the bias from oscillating itself.
+    bias_ += config_.relay_amplitude * (static_cast<float>(high_us) - static_cast<float>(low_us)) / (2.0f * period_us);
+    const float max_bias = kMaxPwmDuty - config_.relay_amplitude > 0 ? kMaxPwmDuty - config_.relay_amplitude : 0;
+    bias_ = bias_ > max_bias ? max_bias : (bias_ < -max_bias ? -max_bias : bias_);
+  }
+
+  if (++cycle_num_ <= kWarmupCycleNum) {
+    return;
+  }
+
+  // A lopsided cycle means the bias is still moving, start averaging again.
+  const uint32_t asymmetry_us = high_us > low_us ? high_us - low_us : low_us - high_us;
+  if (asymmetry_us * 10 > period_us) {
+    accepted_num_ = 0;
+    period_sum_us_ = 0;
+    amplitude_sum_ = 0;
+    return;
+  }
+
+  period_sum_us_ += period_us;
+  amplitude_sum_ += amplitude;
+  if (++accepted_num_ >= config_.cycle_num) {
+    Tune();
+  }
+}
+
+template <typename Transport>
+void BasicMd40Autotuner<Transport>::SubmitRelayOutput() {
+  typename Md40::Motor &motor = md40_[index_];
+  if (config_.loop == Loop::kSpeed) {
+    float output = bias_ + (relay_high_ ? config_.relay_amplitude : -config_.relay_amplitude);
+    output = output > kMaxPwmDuty ? kMaxPwmDuty : (output < -kMaxPwmDuty ? -kMaxPwmDuty : output);
+    pending_ = motor.SubmitRunPwmDuty(static_cast<int16_t>(output < 0 ? output - 0.5f : output + 0.5f));
+  } else {
+    pending_ = motor.SubmitRunSpeed(relay_high_ ? config_.relay_amplitude : -config_.relay_amplitude);
+  }
+}
+
+template <typename Transport>
+void BasicMd40Autotuner<Transport>::Tune() {
+  const float amplitude = static_cast<float>(amplitude_sum_) / accepted_num_;
+  const float period_s = period_sum_us_ / 1000000.0f / accepted_num_;
+  const float gain = config_.loop == Loop::kSpeed ? config_.setpoint / bias_ : kDegreesPerSecondPerRpm;
+  if (amplitude <= 0 || period_s <= 0 || !(gain > 0)) {
+    Fail();
+    return;
+  }
+
+  result_.ultimate_gain = 4 * config_.relay_amplitude / (kPi * amplitude);
+  result_.ultimate_period_us = period_sum_us_ / accepted_num_;
+  result_.model_gain = gain;
+
+  // At the ultimate frequency the model has a magnitude of 1/Ku and a phase of -180 degrees, an integrator takes 90 degrees of it.
+  const float omega = 2 * kPi / period_s;
+  const bool integrating = config_.loop == Loop::kPosition;
+  const float lag_ratio = result_.ultimate_gain * gain / (integrating ? omega : 1);
+  const float time_constant_s = lag_ratio > 1 ? sqrtf(lag_ratio * lag_ratio - 1) / omega : 0;
+  result_.model_time_constant_s = time_constant_s;
+  result_.model_dead_time_s = ((integrating ? kPi / 2 : kPi) - atanf(time_constant_s * omega)) / omega;
+
+  const RuleFactors &factors = kRuleFactors[static_cast<uint8_t>(config_.rule)];
+  const float control_period_s = config_.control_period_us / 1000000.0f;
+  const float kp = factors.kp * result_.ultimate_gain;
+  result_.p = kp;
+  result_.i = kp * control_period_s / (factors.ti * period_s);
+  result_.d = kp * factors.td * period_s / control_period_s;
+  result_.predicted_settling_us = PredictSettlingUs();
+
+  typename Md40::Motor &motor = md40_[index_];
+  motor.SubmitStop();
+  if (config_.loop == Loop::kSpeed) {
+    motor.SubmitSpeedPidP(result_.p);
+    motor.SubmitSpeedPidI(result_.i);
+    pending_ = motor.SubmitSpeedPidD(result_.d);
+  } else {
+    motor.SubmitPositionPidP(result_.p);
+    motor.SubmitPositionPidI(result_.i);
+    pending_ = motor.SubmitPositionPidD(result_.d);
+  }
+
+  phase_ = Phase::kRest;
+  phase_start_us_ = md40_.transport_.Micros();
+  rest_num_ = 0;
+}
+
+template <typename Transport>
+uint32_t BasicMd40Autotuner<Transport>::PredictSettlingUs() const {
+  // Rounded the way the MD40 stores them, so the prediction runs the gains actually written.
+  const float p = md40_internal::PidGainToRegister(result_.p) / 100.0f;
+  const float i = md40_internal::PidGainToRegister(result_.i) / 100.0f;
+  const float d = md40_internal::PidGainToRegister(result_.d) / 100.0f;
+
+  const float control_period_s = config_.control_period_us / 1000000.0f;
+  uint8_t substep_num = kPredictionSubstepNum;
+  while (substep_num > 1 && result_.model_dead_time_s * substep_num / control_period_s >= kPredictionDelayNum) {
+    substep_num--;
+  }
+  const float dt = control_period_s / substep_num;
+  uint8_t delay_num = static_cast<uint8_t>(result_.model_dead_time_s / dt + 0.5f);
+  if (delay_num >= kPredictionDelayNum) {
+    delay_num = kPredictionDelayNum - 1;
+  }
+  const float alpha = result_.model_time_constant_s > 0 ? 1 - expf(-dt / result_.model_time_constant_s) : 1;
+
+  const bool integrating = config_.loop == Loop::kPosition;
+  const float limit = integrating ? config_.relay_amplitude : kMaxPwmDuty;
+  const float step = config_.setpoint;
+  const uint32_t period_num = observation_us() / config_.control_period_us;
+
+  float inputs[kPredictionDelayNum] = {0};
+  uint8_t input_index = 0;
+  float speed = 0;
+  float position = 0;
+  float error_sum = 0;
+  float last_error = 0;
+  bool settled = false;
+  uint32_t settled_since = 0;
+  for (uint32_t n = 0; n < period_num; n++) {
+    // The same discrete PID with conditional integration as the onboard controller.
+    const float error = step - (integrating ? position : speed);
+    float command = p * error + i * (error_sum + error) + d * (error - last_error);
+    last_error = error;
+    if (command < limit && command > -limit) {
+      error_sum += error;
+    } else {
+      command = command > 0 ? limit : -limit;
+    }
+
+    if (error > band_ || error < -band_) {
+      settled = false;
+    } else if (!settled) {
+      settled = true;
+      settled_since = n;
+    }
+
+    for (uint8_t s = 0; s < substep_num; s++) {
+      inputs[input_index] = command;
+      const float delayed = inputs[(input_index + kPredictionDelayNum - delay_num) % kPredictionDelayNum];
+      input_index = (input_index + 1) % kPredictionDelayNum;
+      if (integrating) {
+        speed += (delayed - speed) * alpha;
+        position += kDegreesPerSecondPerRpm * speed * dt;
+      } else {
+        speed += (result_.model_gain * delayed - speed) * alpha;
+      }
+    }
+  }
+  return settled ? settled_since * config_.control_period_us : kNotSettled;
+}
+
+template <typename Transport>
+uint32_t BasicMd40Autotuner<Transport>::observation_us() const {
+  const uint32_t us = kObservationPeriodNum * result_.ultimate_period_us;
+  return us < kMinObservationUs ? kMinObservationUs : (us > kMaxObservationUs ? kMaxObservationUs : us);
+}
+
+template <typename Transport>
+void BasicMd40Autotuner<Transport>::Fail() {
+  pending_ = md40_[index_].SubmitStop();
+  phase_ = Phase::kFailed;
+}
+
+#ifdef ARDUINO
+/**
+ * @~Chinese
+ * @brief 使用 TwoWire 的PID自整定。
+ */
+/**
+ * @~English
+ * @brief PID autotuner using TwoWire.
+ */
+using Md40Autotuner = BasicMd40Autotuner<TwoWireTransport>;
+#endif
+}  // namespace em
+#endif
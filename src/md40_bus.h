@@ -0,0 +1,427 @@
+#pragma once
+
+#ifndef _EM_MD40_BUS_H_
+#define _EM_MD40_BUS_H_
+
+#include "md40.h"
+
+/**
+ * @file md40_bus.h
+ */
+
+namespace em {
+
+/**
+ * @~Chinese
+ * @class BasicMd40Bus
+ * @brief 把同一条I2C总线上多个不同地址的MD40模块作为一个电机池来驱动，电机使用统一编号：模块 k 的电机 i 的编号为 k * 4 + i。
+ * @details 各模块仍然各自排队命令（例如 @ref BasicMd40::Motor::SubmitRunSpeed ），BasicMd40Bus 负责交替推进它们：
+ * @ref Update 每个周期依次推进每个模块的命令邮箱一步，然后读取该模块的运行数据，因此一个模块等待命令执行的时间被其他模块的总线访问填满，
+ * 而不是空等； @ref Flush 轮流推进所有模块，直到所有命令执行完毕。所有模块必须使用同一条总线，时钟取自第一个模块的传输层。
+ * BasicMd40Bus 不拥有模块对象，模块的生命周期必须长于 BasicMd40Bus 。
+ * @tparam Transport 传输层类型。
+ * @tparam kBoardNum 模块数量。
+ */
+/**
+ * @~English
+ * @class BasicMd40Bus
+ * @brief Drives several MD40 modules at different addresses on one I2C bus as a single motor pool with flat motor indices: motor i of module k is
+ * motor k * 4 + i.
+ * @details The modules still queue their own commands (for example @ref BasicMd40::Motor::SubmitRunSpeed), BasicMd40Bus advances them in turn:
+ * every cycle of @ref Update advances each module's command mailbox by one step and then reads that module's runtime data, so the time one
+ * module spends executing a command is filled with the other modules' bus traffic instead of idle polling. @ref Flush advances all modules in
+ * turn until every command has been executed. All modules must be on the same bus, the clock is taken from the first module's transport.
+ * BasicMd40Bus does not own the modules, they must outlive it.
+ * @tparam Transport Transport type.
+ * @tparam kBoardNum Number of modules.
+ */
+template <typename Transport, uint8_t kBoardNum>
+class BasicMd40Bus {
+ public:
+  /**
+   * @~Chinese
+   * @brief 模块类型。
+   */
+  /**
+   * @~English
+   * @brief Module type.
+   */
+  using Board = BasicMd40<Transport>;
+
+  /**
+   * @~Chinese
+   * @brief 电机类型。
+   */
+  /**
+   * @~English
+   * @brief Motor type.
+   */
+  using Motor = typename Board::Motor;
+
+  /**
+   * @~Chinese
+   * @brief 状态码类型。
+   */
+  /**
+   * @~English
+   * @brief Status code type.
+   */
+  using Status = typename Board::Status;
+
+  /**
+   * @~Chinese
+   * @brief 等待策略类型。
+   */
+  /**
+   * @~English
+   * @brief Wait policy type.
+   */
+  using WaitPolicy = typename Board::WaitPolicy;
+
+  /**
+   * @~Chinese
+   * @brief 电机总数。
+   */
+  /**
+   * @~English
+   * @brief Total number of motors.
+   */
+  static constexpr uint8_t kMotorNum = kBoardNum * Board::kMotorNum;
+
+  /**
+   * @~Chinese
+   * @brief 构造函数。
+   * @param[in] boards 模块指针数组，顺序决定电机编号。
+   */
+  /**
+   * @~English
+   * @brief Constructor.
+   * @param[in] boards Array of module pointers, the order determines the motor indices.
+   */
+  explicit BasicMd40Bus(Board *const (&boards)[kBoardNum]);
+
+  /**
+   * @~Chinese
+   * @brief 获取模块。
+   * @param[in] index 模块索引。
+   * @return 模块的引用。
+   */
+  /**
+   * @~English
+   * @brief Get a module.
+   * @param[in] index Module index.
+   * @return Reference to the module.
+   */
+  Board &board(const uint8_t index);
+
+  /**
+   * @~Chinese
+   * @brief 按统一编号获取电机。
+   * @param[in] index 电机编号，范围为0到 @ref kMotorNum - 1。
+   * @return 电机的引用。
+   */
+  /**
+   * @~English
+   * @brief Get a motor by its flat index.
+   * @param[in] index Motor index, from 0 to @ref kMotorNum - 1.
+   * @return Reference to the motor.
+   */
+  Motor &operator[](const uint8_t index);
+
+  /**
+   * @~Chinese
+   * @brief 初始化所有模块。先读取每个模块的固件版本，然后把所有电机的复位命令排入队列，再交替执行，而不是逐个模块、逐个电机地等待。
+   * @return 状态码。
+   */
+  /**
+   * @~English
+   * @brief Initialize all modules. The firmware version of every module is read first, then the resets of all motors are queued and executed in
+   * turn instead of waiting module by module and motor by motor.
+   * @return Status code.
+   */
+  Status Init();
+
+  /**
+   * @~Chinese
+   * @brief 执行一个周期：依次推进每个模块的命令邮箱一步（如果有排队的命令），并读取该模块所有电机的运行数据。
+   * @param[out] snapshots 按电机编号存放的运行数据。
+   * @param[in] fields 要读取的字段，参见 @ref BasicMd40::ReadPlan::Field ，默认为全部字段。
+   * @return 状态码。某个模块出错时，放弃该模块队首的命令，其后排队的命令保留到下一个周期，仍然会继续处理其余模块，并返回遇到的第一个错误。
+   */
+  /**
+   * @~English
+   * @brief Run one cycle: advance each module's command mailbox by one step (if it has queued commands) and read the runtime data of all its
+   * motors, module by module.
+   * @param[out] snapshots Runtime data indexed by motor index.
+   * @param[in] fields Fields to read, see @ref BasicMd40::ReadPlan::Field, all fields by default.
+   * @return Status code. When a module fails the command at the head of its queue is abandoned while the ones behind it stay queued for the next
+   * cycle, the remaining modules are still processed and the first error is returned.
+   */
+  Status Update(typename Motor::Snapshot (&snapshots)[kMotorNum], const uint8_t fields = Board::ReadPlan::kFieldAll);
+
+  /**
+   * @~Chinese
+   * @brief 交替推进所有模块的命令邮箱，直到所有排队的命令执行完毕。一轮推进中没有进展时按 @ref wait_policy 等待。
+   * @return 状态码。超时时所有未完成的命令会被放弃，返回 Status::kTimeout 。
+   */
+  /**
+   * @~English
+   * @brief Advance the command mailboxes of all modules in turn until every queued command has been executed. When a round makes no progress,
+   * waits according to @ref wait_policy.
+   * @return Status code. On timeout all unfinished commands are abandoned and Status::kTimeout is returned.
+   */
+  Status Flush();
+
+  /**
+   * @~Chinese
+   * @brief 设置 @ref Flush 的等待策略，默认为 WaitPolicy::Spin() 。
+   * @param[in] policy 等待策略。
+   */
+  /**
+   * @~English
+   * @brief Set the wait policy of @ref Flush, WaitPolicy::Spin() by default.
+   * @param[in] policy Wait policy.
+   */
+  void set_wait_policy(const WaitPolicy &policy);
+
+  /**
+   * @~Chinese
+   * @brief 获取 @ref Flush 的等待策略。
+   * @return 等待策略。
+   */
+  /**
+   * @~English
+   * @brief Get the wait policy of @ref Flush.
+   * @return Wait policy.
+   */
+  const WaitPolicy &wait_policy() const;
+
+  /**
+   * @~Chinese
+   * @brief 获取最近一次 @ref Update 的耗时。
+   * @return 微秒数。
+   */
+  /**
+   * @~English
+   * @brief Get the duration of the most recent @ref Update.
+   * @return Microseconds.
+   */
+  uint32_t last_cycle_us() const;
+
+  /**
+   * @~Chinese
+   * @brief 按最近一次 @ref Update 的耗时估算可达到的更新频率。每个周期更新所有电机，因此每秒得到的电机数据总数为该值乘以 @ref kMotorNum 。
+   * @return 每秒周期数，尚未执行过 @ref Update 时返回0。
+   */
+  /**
+   * @~English
+   * @brief Estimate the achievable update rate from the duration of the most recent @ref Update. Every cycle updates all motors, so the aggregate
+   * number of motor samples per second is this value times @ref kMotorNum.
+   * @return Cycles per second, 0 if @ref Update has not run yet.
+   */
+  float update_rate_hz() const;
+
+ private:
+  BasicMd40Bus(const BasicMd40Bus &) = delete;
+  BasicMd40Bus &operator=(const BasicMd40Bus &) = delete;
+
+  Status Step(Board &board, bool &progressed);
+
+  uint32_t Micros();
+
+  Board *boards_[kBoardNum] = {nullptr};
+  WaitPolicy wait_policy_;
+  uint32_t last_cycle_us_ = 0;
+};
+
+template <typename Transport, uint8_t kBoardNum>
+constexpr uint8_t BasicMd40Bus<Transport, kBoardNum>::kMotorNum;
+
+template <typename Transport, uint8_t kBoardNum>
+BasicMd40Bus<Transport, kBoardNum>::BasicMd40Bus(Board *const (&boards)[kBoardNum]) {
+  for (uint8_t i = 0; i < kBoardNum; i++) {
+    EM_CHECK(boards[i] != nullptr);
+    boards_[i] = boards[i];
+  }
+}
+
+template <typename Transport, uint8_t kBoardNum>
+typename BasicMd40Bus<Transport, kBoardNum>::Board &BasicMd40Bus<Transport, kBoardNum>::board(const uint8_t index) {
+  EM_CHECK_LT(index, kBoardNum);
+  return *boards_[index];
+}
+
+template <typename Transport, uint8_t kBoardNum>
+typename BasicMd40Bus<Transport, kBoardNum>::Motor &BasicMd40Bus<Transport, kBoardNum>::operator[](const uint8_t index) {
+  EM_CHECK_LT(index, kMotorNum);
+  return (*boards_[index / Board::kMotorNum])[index % Board::kMotorNum];
+}
+
+template <typename Transport, uint8_t kBoardNum>
+typename BasicMd40Bus<Transport, kBoardNum>::Status BasicMd40Bus<Transport, kBoardNum>::Init() {
+  for (auto board : boards_) {
+    const Status status = board->Probe();
+    if (status != Status::kOk) {
+      return status;
+    }
+  }
+
+  for (auto board : boards_) {
+    const Status status = board->Reserve(Board::kMotorNum);
+    if (status != Status::kOk) {
+      return status;
+    }
+    for (uint8_t i = 0; i < Board::kMotorNum; i++) {
+      (*board)[i].SubmitReset();
+    }
+  }
+  return Flush();
+}
+
+template <typename Transport, uint8_t kBoardNum>
+typename BasicMd40Bus<Transport, kBoardNum>::Status BasicMd40Bus<Transport, kBoardNum>::Update(typename Motor::Snapshot (&snapshots)[kMotorNum],
+                                                                                              const uint8_t fields) {
+  const uint32_t start_time = Micros();
+  uint8_t board_fields[Board::kMotorNum] = {0};
+  memset(board_fields, fields, sizeof(board_fields));
+  Status result = Status::kOk;
+
+  for (uint8_t k = 0; k < kBoardNum; k++) {
+    Board &board = *boards_[k];
+    bool progressed = false;
+    Status status = Step(board, progressed);
+    if (result == Status::kOk) {
+      result = status;
+    }
+
+    typename Board::ReadPlan plan(board, board_fields);
+    typename Motor::Snapshot board_snapshots[Board::kMotorNum];
+    status = plan.Execute(board_snapshots);
+    if (status != Status::kOk) {
+      if (result == Status::kOk) {
+        result = status;
+      }
+      continue;
+    }
+    for (uint8_t i = 0; i < Board::kMotorNum; i++) {
+      snapshots[k * Board::kMotorNum + i] = board_snapshots[i];
+    }
+  }
+
+  last_cycle_us_ = Micros() - start_time;
+  return result;
+}
+
+template <typename Transport, uint8_t kBoardNum>
+typename BasicMd40Bus<Transport, kBoardNum>::Status BasicMd40Bus<Transport, kBoardNum>::Flush() {
+  const uint32_t start_time = Micros();
+  uint32_t interval_us = wait_policy_.interval_us;
+  Status result = Status::kOk;
+
+  while (true) {
+    bool pending = false;
+    bool progressed = false;
+    for (auto board : boards_) {
+      bool board_progressed = false;
+      const Status status = Step(*board, board_progressed);
+      if (result == Status::kOk) {
+        result = status;
+      }
+      progressed = progressed || board_progressed;
+      pending = pending || board->command_num_ > 0;
+    }
+
+    if (!pending) {
+      return result;
+    }
+
+    if (progressed) {
+      interval_us = wait_policy_.interval_us;
+      continue;
+    }
+
+    if (wait_policy_.timeout_us > 0 && Micros() - start_time >= wait_policy_.timeout_us) {
+      for (auto board : boards_) {
+        if (board->command_num_ > 0) {
+          board->Abandon(board->submitted_sequence_);
+          board->last_status_ = Status::kTimeout;
+        }
+      }
+      return Status::kTimeout;
+    }
+
+    switch (wait_policy_.mode) {
+      case WaitPolicy::Mode::kFixedInterval:
+        boards_[0]->transport_.DelayMicroseconds(interval_us);
+        break;
+
+      case WaitPolicy::Mode::kExponentialBackoff:
+        boards_[0]->transport_.DelayMicroseconds(interval_us);
+        interval_us = interval_us > wait_policy_.max_interval_us / 2 ? wait_policy_.max_interval_us : interval_us * 2;
+        break;
+
+      default:
+        break;
+    }
+  }
+}
+
+template <typename Transport, uint8_t kBoardNum>
+void BasicMd40Bus<Transport, kBoardNum>::set_wait_policy(const WaitPolicy &policy) {
+  wait_policy_ = policy;
+}
+
+template <typename Transport, uint8_t kBoardNum>
+const typename BasicMd40Bus<Transport, kBoardNum>::WaitPolicy &BasicMd40Bus<Transport, kBoardNum>::wait_policy() const {
+  return wait_policy_;
+}
+
+template <typename Transport, uint8_t kBoardNum>
+uint32_t BasicMd40Bus<Transport, kBoardNum>::last_cycle_us() const {
+  return last_cycle_us_;
+}
+
+template <typename Transport, uint8_t kBoardNum>
+float BasicMd40Bus<Transport, kBoardNum>::update_rate_hz() const {
+  return last_cycle_us_ == 0 ? 0 : 1000000.0f / last_cycle_us_;
+}
+
+// One mailbox step of a module. A failing step abandons only the command at the head of the queue, as BasicMd40Worker does: a transient bus
+// error then costs one command instead of everything queued behind it, and an unreachable module still drains one command per step without
+// stalling the others. The head is taken before the step, which may already have dropped it after a failed fused write.
+template <typename Transport, uint8_t kBoardNum>
+typename BasicMd40Bus<Transport, kBoardNum>::Status BasicMd40Bus<Transport, kBoardNum>::Step(Board &board, bool &progressed) {
+  progressed = false;
+  if (board.command_num_ == 0) {
+    return Status::kOk;
+  }
+
+  const uint16_t head_sequence = board.finished_sequence_ + 1;
+  const Status status = board.Step(progressed);
+  if (status != Status::kOk) {
+    board.Abandon(head_sequence);
+  }
+  return status;
+}
+
+template <typename Transport, uint8_t kBoardNum>
+uint32_t BasicMd40Bus<Transport, kBoardNum>::Micros() {
+  return boards_[0]->transport_.Micros();
+}
+
+#ifdef ARDUINO
+/**
+ * @~Chinese
+ * @brief 使用 TwoWire 的多模块驱动类。
+ * @tparam kBoardNum 模块数量。
+ */
+/**
+ * @~English
+ * @brief Multi-module driver class using TwoWire.
+ * @tparam kBoardNum Number of modules.
+ */
+template <uint8_t kBoardNum>
+using Md40Bus = BasicMd40Bus<TwoWireTransport, kBoardNum>;
+#endif
+}  // namespace em
+#endif
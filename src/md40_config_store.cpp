@@ -0,0 +1,90 @@
+/**
+ * @file md40_config_store.cpp
+ */
+
+#include "md40_config_store.h"
+
+#if defined(ARDUINO_ARCH_AVR)
+#include <EEPROM.h>
+#elif defined(ARDUINO_ARCH_ESP32)
+#include <Preferences.h>
+#elif !defined(ARDUINO)
+#include <stdio.h>
+#endif
+
+namespace em {
+
+#if defined(ARDUINO_ARCH_AVR)
+EepromConfigStore::EepromConfigStore(const uint16_t address) : address_(address) {
+}
+
+bool EepromConfigStore::Write(const void *data, const uint8_t length) {
+  if (address_ + length > EEPROM.length()) {
+    return false;
+  }
+  for (uint8_t i = 0; i < length; i++) {
+    EEPROM.update(address_ + i, static_cast<const uint8_t *>(data)[i]);
+  }
+  return true;
+}
+
+bool EepromConfigStore::Read(void *data, const uint8_t length) {
+  if (address_ + length > EEPROM.length()) {
+    return false;
+  }
+  for (uint8_t i = 0; i < length; i++) {
+    static_cast<uint8_t *>(data)[i] = EEPROM.read(address_ + i);
+  }
+  return true;
+}
+#endif
+
+#if defined(ARDUINO_ARCH_ESP32)
+NvsConfigStore::NvsConfigStore(const char *name_space, const char *key) : name_space_(name_space), key_(key) {
+}
+
+bool NvsConfigStore::Write(const void *data, const uint8_t length) {
+  Preferences preferences;
+  if (!preferences.begin(name_space_, false)) {
+    return false;
+  }
+  const bool written = preferences.putBytes(key_, data, length) == length;
+  preferences.end();
+  return written;
+}
+
+bool NvsConfigStore::Read(void *data, const uint8_t length) {
+  Preferences preferences;
+  if (!preferences.begin(name_space_, true)) {
+    return false;
+  }
+  const bool read = preferences.getBytesLength(key_) == length && preferences.getBytes(key_, data, length) == length;
+  preferences.end();
+  return read;
+}
+#endif
+
+#ifndef ARDUINO
+FileConfigStore::FileConfigStore(const std::string &path) : path_(path) {
+}
+
+bool FileConfigStore::Write(const void *data, const uint8_t length) {
+  FILE *file = fopen(path_.c_str(), "wb");
+  if (file == nullptr) {
+    return false;
+  }
+  const bool written = fwrite(data, 1, length, file) == length;
+  return fclose(file) == 0 && written;
+}
+
+bool FileConfigStore::Read(void *data, const uint8_t length) {
+  FILE *file = fopen(path_.c_str(), "rb");
+  if (file == nullptr) {
+    return false;
+  }
+  const bool read = fread(data, 1, length, file) == length;
+  fclose(file);
+  return read;
+}
+#endif
+}  // namespace em
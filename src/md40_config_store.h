@@ -0,0 +1,231 @@
+#pragma once
+
+#ifndef _EM_MD40_CONFIG_STORE_H_
+#define _EM_MD40_CONFIG_STORE_H_
+
+#ifdef ARDUINO
+#include <Arduino.h>
+#else
+#include <stdint.h>
+
+#include <string>
+#endif
+
+/**
+ * @file md40_config_store.h
+ */
+
+namespace em {
+
+/**
+ * @~Chinese
+ * @page config_store_concept 配置存储
+ * @ref BasicMd40::ConfigProfile::Save 和 @ref BasicMd40::ConfigProfile::Load 通过模板参数 Store 保存二进制配置文件，Store 需要提供：
+ * - `bool Write(const void *data, uint8_t length)`：保存length个字节，成功时返回true。
+ * - `bool Read(void *data, uint8_t length)`：读取之前保存的length个字节，成功时返回true。
+ *
+ * 内容的有效性由配置文件的标识、版本号和校验判断，存储本身不需要检查。本库提供AVR上的 @ref EepromConfigStore 、ESP32上的
+ * @ref NvsConfigStore 和主机上的 @ref FileConfigStore 。
+ */
+/**
+ * @~English
+ * @page config_store_concept Configuration store
+ * @ref BasicMd40::ConfigProfile::Save and @ref BasicMd40::ConfigProfile::Load keep the binary profile in their Store template parameter, which
+ * must provide:
+ * - `bool Write(const void *data, uint8_t length)`: store length bytes, true on success.
+ * - `bool Read(void *data, uint8_t length)`: read length previously stored bytes, true on success.
+ *
+ * Whether the content is valid is decided by the profile's tag, version and checksum, the store itself does not need to check. The library
+ * provides @ref EepromConfigStore on AVR, @ref NvsConfigStore on ESP32 and @ref FileConfigStore on the host.
+ */
+
+#if defined(ARDUINO_ARCH_AVR)
+/**
+ * @~Chinese
+ * @class EepromConfigStore
+ * @brief 保存在AVR内部EEPROM中的配置存储。写入时只改写内容不同的字节，以减少EEPROM磨损。
+ */
+/**
+ * @~English
+ * @class EepromConfigStore
+ * @brief Configuration store in the AVR's internal EEPROM. Only bytes whose content differs are rewritten, to reduce EEPROM wear.
+ */
+class EepromConfigStore {
+ public:
+  /**
+   * @~Chinese
+   * @brief 构造函数。
+   * @param[in] address EEPROM中的起始地址。
+   */
+  /**
+   * @~English
+   * @brief Constructor.
+   * @param[in] address Start address in the EEPROM.
+   */
+  explicit EepromConfigStore(const uint16_t address = 0);
+
+  /**
+   * @~Chinese
+   * @brief 写入数据，参见 @ref config_store_concept 。
+   * @param[in] data 数据。
+   * @param[in] length 数据长度。
+   * @return 数据超出EEPROM时返回false。
+   */
+  /**
+   * @~English
+   * @brief Write data, see @ref config_store_concept.
+   * @param[in] data Data.
+   * @param[in] length Data length.
+   * @return False when the data does not fit into the EEPROM.
+   */
+  bool Write(const void *data, const uint8_t length);
+
+  /**
+   * @~Chinese
+   * @brief 读取数据，参见 @ref config_store_concept 。
+   * @param[out] data 数据。
+   * @param[in] length 数据长度。
+   * @return 数据超出EEPROM时返回false。
+   */
+  /**
+   * @~English
+   * @brief Read data, see @ref config_store_concept.
+   * @param[out] data Data.
+   * @param[in] length Data length.
+   * @return False when the data does not fit into the EEPROM.
+   */
+  bool Read(void *data, const uint8_t length);
+
+ private:
+  const uint16_t address_ = 0;
+};
+#endif
+
+#if defined(ARDUINO_ARCH_ESP32)
+/**
+ * @~Chinese
+ * @class NvsConfigStore
+ * @brief 保存在ESP32 NVS中的配置存储，使用 Preferences 库，数据以一个二进制键值保存。
+ */
+/**
+ * @~English
+ * @class NvsConfigStore
+ * @brief Configuration store in the ESP32's NVS, using the Preferences library. The data is kept as one binary key.
+ */
+class NvsConfigStore {
+ public:
+  /**
+   * @~Chinese
+   * @brief 构造函数。字符串不会被复制，必须在存储的整个生命周期内有效。
+   * @param[in] name_space NVS命名空间，最长15个字符。
+   * @param[in] key 键名，最长15个字符。
+   */
+  /**
+   * @~English
+   * @brief Constructor. The strings are not copied and must stay valid for the whole lifetime of the store.
+   * @param[in] name_space NVS namespace, at most 15 characters.
+   * @param[in] key Key, at most 15 characters.
+   */
+  NvsConfigStore(const char *name_space = "md40", const char *key = "config");
+
+  /**
+   * @~Chinese
+   * @brief 写入数据，参见 @ref config_store_concept 。
+   * @param[in] data 数据。
+   * @param[in] length 数据长度。
+   * @return 成功时返回true。
+   */
+  /**
+   * @~English
+   * @brief Write data, see @ref config_store_concept.
+   * @param[in] data Data.
+   * @param[in] length Data length.
+   * @return True on success.
+   */
+  bool Write(const void *data, const uint8_t length);
+
+  /**
+   * @~Chinese
+   * @brief 读取数据，参见 @ref config_store_concept 。
+   * @param[out] data 数据。
+   * @param[in] length 数据长度。
+   * @return 键不存在或长度不符时返回false。
+   */
+  /**
+   * @~English
+   * @brief Read data, see @ref config_store_concept.
+   * @param[out] data Data.
+   * @param[in] length Data length.
+   * @return False when the key does not exist or its length differs.
+   */
+  bool Read(void *data, const uint8_t length);
+
+ private:
+  const char *name_space_ = nullptr;
+  const char *key_ = nullptr;
+};
+#endif
+
+#ifndef ARDUINO
+/**
+ * @~Chinese
+ * @class FileConfigStore
+ * @brief 保存在主机文件中的配置存储。
+ */
+/**
+ * @~English
+ * @class FileConfigStore
+ * @brief Configuration store in a file on the host.
+ */
+class FileConfigStore {
+ public:
+  /**
+   * @~Chinese
+   * @brief 构造函数。
+   * @param[in] path 文件路径。
+   */
+  /**
+   * @~English
+   * @brief Constructor.
+   * @param[in] path File path.
+   */
+  explicit FileConfigStore(const std::string &path);
+
+  /**
+   * @~Chinese
+   * @brief 覆盖写入文件，参见 @ref config_store_concept 。
+   * @param[in] data 数据。
+   * @param[in] length 数据长度。
+   * @return 成功时返回true。
+   */
+  /**
+   * @~English
+   * @brief Overwrite the file, see @ref config_store_concept.
+   * @param[in] data Data.
+   * @param[in] length Data length.
+   * @return True on success.
+   */
+  bool Write(const void *data, const uint8_t length);
+
+  /**
+   * @~Chinese
+   * @brief 读取文件，参见 @ref config_store_concept 。
+   * @param[out] data 数据。
+   * @param[in] length 数据长度。
+   * @return 文件不存在或长度不足时返回false。
+   */
+  /**
+   * @~English
+   * @brief Read the file, see @ref config_store_concept.
+   * @param[out] data Data.
+   * @param[in] length Data length.
+   * @return False when the file does not exist or is too short.
+   */
+  bool Read(void *data, const uint8_t length);
+
+ private:
+  const std::string path_;
+};
+#endif
+}  // namespace em
+#endif
@@ -0,0 +1,477 @@
+#pragma once
+
+#ifndef _EM_MD40_EVENT_DISPATCHER_H_
+#define _EM_MD40_EVENT_DISPATCHER_H_
+
+#include "md40.h"
+
+/**
+ * @file md40_event_dispatcher.h
+ */
+
+namespace em {
+
+/**
+ * @~Chinese
+ * @class BasicMd40EventDispatcher
+ * @brief 电机状态变化事件分发器，代替应用程序反复查询 @ref BasicMd40::Motor::state 。
+ * @details 应用程序为电机订阅状态变化（例如 kRuningToPosition → kReachedPosition ，或任意状态 → kIdle ），然后在 loop() 中调用 @ref Poll 。
+ * 到达轮询时刻时，分发器只读取有订阅的电机的状态，所有电机的读取合并为一次 @ref BasicMd40::ReadPlan ；发现状态变化时调用匹配的回调函数。
+ * 有命令在执行、有电机正在运动到目标位置或刚刚发生状态变化时，按 @ref set_active_interval_us 的间隔轮询；否则间隔逐次加倍，
+ * 直到 @ref set_idle_interval_us 。提交了新命令（包括 @ref BasicMd40::MotorGroup 的命令）后，下一次 @ref Poll 立即轮询。订阅保存在固定大小的表中，回调函数是函数指针加上下文指针，不会分配内存。
+ * 订阅后第一次轮询读到的状态作为基准，不触发回调，因此应在发出命令之前订阅；轮询间隔内经过的中间状态可能观察不到，
+ * 等待运动结束时建议订阅“任意状态 → kReachedPosition ”。
+ * @tparam Transport 传输层类型。
+ * @tparam kSubscriptionNum 订阅表的大小。
+ */
+/**
+ * @~English
+ * @class BasicMd40EventDispatcher
+ * @brief Dispatcher of motor state transition events, replacing application code that keeps polling @ref BasicMd40::Motor::state.
+ * @details The application subscribes to state transitions of a motor (for example kRuningToPosition → kReachedPosition, or any state → kIdle)
+ * and calls @ref Poll from loop(). When a poll is due the dispatcher reads the state of the subscribed motors only, all of them merged into one
+ * @ref BasicMd40::ReadPlan, and invokes the matching callbacks for every change it sees. While a command is in flight, a motor is running to a
+ * position or a transition has just happened it polls every @ref set_active_interval_us, otherwise the interval doubles on every poll up to
+ * @ref set_idle_interval_us. After a new command has been submitted, @ref BasicMd40::MotorGroup commands included, the next @ref Poll polls at
+ * once. Subscriptions live in a fixed-size table and callbacks are a function pointer plus a context pointer, so nothing is
+ * allocated. The state read by the first poll after subscribing is the baseline and does not fire, so subscribe before sending the command.
+ * States passed through between two polls may go unseen, so to wait for the end of a move subscribe to any state → kReachedPosition.
+ * @tparam Transport Transport type.
+ * @tparam kSubscriptionNum Size of the subscription table.
+ */
+template <typename Transport, uint8_t kSubscriptionNum = 8>
+class BasicMd40EventDispatcher {
+ public:
+  /**
+   * @~Chinese
+   * @brief 驱动类型。
+   */
+  /**
+   * @~English
+   * @brief Driver type.
+   */
+  using Md40 = BasicMd40<Transport>;
+
+  /**
+   * @~Chinese
+   * @brief 状态码类型。
+   */
+  /**
+   * @~English
+   * @brief Status code type.
+   */
+  using Status = typename Md40::Status;
+
+  /**
+   * @~Chinese
+   * @brief 电机状态类型。
+   */
+  /**
+   * @~English
+   * @brief Motor state type.
+   */
+  using State = typename Md40::Motor::State;
+
+  /**
+   * @~Chinese
+   * @brief 回调函数类型。
+   * @param[in] context 订阅时传入的上下文指针。
+   * @param[in] index 电机索引。
+   * @param[in] from 变化前的状态。
+   * @param[in] to 变化后的状态。
+   */
+  /**
+   * @~English
+   * @brief Callback type.
+   * @param[in] context Context pointer given when subscribing.
+   * @param[in] index Motor index.
+   * @param[in] from State before the transition.
+   * @param[in] to State after the transition.
+   */
+  using Callback = void (*)(void *context, uint8_t index, State from, State to);
+
+  /**
+   * @~Chinese
+   * @brief 订阅失败时返回的订阅号。
+   */
+  /**
+   * @~English
+   * @brief Subscription id returned when subscribing fails.
+   */
+  static constexpr int8_t kInvalidSubscription = -1;
+
+  /**
+   * @~Chinese
+   * @brief 默认的活跃轮询间隔，单位为微秒。
+   */
+  /**
+   * @~English
+   * @brief Default active polling interval in microseconds.
+   */
+  static constexpr uint32_t kDefaultActiveIntervalUs = 10000;
+
+  /**
+   * @~Chinese
+   * @brief 默认的最长空闲轮询间隔，单位为微秒。
+   */
+  /**
+   * @~English
+   * @brief Default longest idle polling interval in microseconds.
+   */
+  static constexpr uint32_t kDefaultIdleIntervalUs = 200000;
+
+  /**
+   * @~Chinese
+   * @brief 构造函数。
+   * @param[in] md40 Md40 对象引用。
+   */
+  /**
+   * @~English
+   * @brief Constructor.
+   * @param[in] md40 Md40 object reference.
+   */
+  explicit BasicMd40EventDispatcher(Md40 &md40);
+
+  /**
+   * @~Chinese
+   * @brief 订阅电机从指定状态到指定状态的变化。
+   * @param[in] index 电机索引。
+   * @param[in] from 变化前的状态。
+   * @param[in] to 变化后的状态。
+   * @param[in] callback 回调函数。
+   * @param[in] context 传给回调函数的上下文指针。
+   * @return 订阅号，订阅表已满时返回 @ref kInvalidSubscription 。
+   */
+  /**
+   * @~English
+   * @brief Subscribe to a transition of a motor from one given state to another.
+   * @param[in] index Motor index.
+   * @param[in] from State before the transition.
+   * @param[in] to State after the transition.
+   * @param[in] callback Callback.
+   * @param[in] context Context pointer passed to the callback.
+   * @return Subscription id, @ref kInvalidSubscription when the subscription table is full.
+   */
+  int8_t Subscribe(const uint8_t index, const State from, const State to, const Callback callback, void *const context = nullptr);
+
+  /**
+   * @~Chinese
+   * @brief 订阅电机从任意状态到指定状态的变化。
+   * @param[in] index 电机索引。
+   * @param[in] to 变化后的状态。
+   * @param[in] callback 回调函数。
+   * @param[in] context 传给回调函数的上下文指针。
+   * @return 订阅号，订阅表已满时返回 @ref kInvalidSubscription 。
+   */
+  /**
+   * @~English
+   * @brief Subscribe to a transition of a motor from any state to a given state.
+   * @param[in] index Motor index.
+   * @param[in] to State after the transition.
+   * @param[in] callback Callback.
+   * @param[in] context Context pointer passed to the callback.
+   * @return Subscription id, @ref kInvalidSubscription when the subscription table is full.
+   */
+  int8_t Subscribe(const uint8_t index, const State to, const Callback callback, void *const context = nullptr);
+
+  /**
+   * @~Chinese
+   * @brief 取消订阅，可以在回调函数中调用。
+   * @param[in] subscription 订阅号，无效的订阅号会被忽略。
+   */
+  /**
+   * @~English
+   * @brief Cancel a subscription, may be called from a callback.
+   * @param[in] subscription Subscription id, invalid ids are ignored.
+   */
+  void Unsubscribe(const int8_t subscription);
+
+  /**
+   * @~Chinese
+   * @brief 到达轮询时刻时读取有订阅的电机的状态并调用匹配的回调函数，否则立即返回。
+   * @return 执行结果，参见 @ref BasicMd40::Status 。
+   */
+  /**
+   * @~English
+   * @brief Read the state of the subscribed motors and invoke the matching callbacks when a poll is due, otherwise return at once.
+   * @return Execution result, see @ref BasicMd40::Status.
+   */
+  Status Poll();
+
+  /**
+   * @~Chinese
+   * @brief 让下一次 @ref Poll 立即轮询，并恢复活跃轮询间隔。
+   */
+  /**
+   * @~English
+   * @brief Make the next @ref Poll poll at once and return to the active polling interval.
+   */
+  void Wake();
+
+  /**
+   * @~Chinese
+   * @brief 设置活跃轮询间隔。
+   * @param[in] us 微秒数。
+   */
+  /**
+   * @~English
+   * @brief Set the active polling interval.
+   * @param[in] us Microseconds.
+   */
+  void set_active_interval_us(const uint32_t us);
+
+  /**
+   * @~Chinese
+   * @brief 设置最长空闲轮询间隔。
+   * @param[in] us 微秒数。
+   */
+  /**
+   * @~English
+   * @brief Set the longest idle polling interval.
+   * @param[in] us Microseconds.
+   */
+  void set_idle_interval_us(const uint32_t us);
+
+  /**
+   * @~Chinese
+   * @brief 获取当前的轮询间隔。
+   * @return 微秒数。
+   */
+  /**
+   * @~English
+   * @brief Get the current polling interval.
+   * @return Microseconds.
+   */
+  uint32_t interval_us() const;
+
+  /**
+   * @~Chinese
+   * @brief 获取已执行的轮询次数。
+   * @return 轮询次数。
+   */
+  /**
+   * @~English
+   * @brief Get the number of polls performed.
+   * @return Number of polls.
+   */
+  uint32_t poll_count() const;
+
+ private:
+  static constexpr uint8_t kAnyState = 0xFF;
+
+  struct Subscription {
+    Callback callback = nullptr;
+    void *context = nullptr;
+    uint8_t index = 0;
+    uint8_t from_states = 0;
+    uint8_t to_states = 0;
+  };
+
+  static uint8_t StateBit(const State state);
+
+  int8_t Add(const uint8_t index, const uint8_t from_states, const uint8_t to_states, const Callback callback, void *const context);
+
+  void Dispatch(const uint8_t index, const State from, const State to);
+
+  Md40 &md40_;
+  Subscription subscriptions_[kSubscriptionNum];
+  State states_[Md40::kMotorNum];
+  uint8_t known_motors_ = 0;
+  uint16_t seen_sequence_ = 0;
+  bool due_ = true;
+  uint32_t next_poll_us_ = 0;
+  uint32_t active_interval_us_ = kDefaultActiveIntervalUs;
+  uint32_t idle_interval_us_ = kDefaultIdleIntervalUs;
+  uint32_t interval_us_ = kDefaultActiveIntervalUs;
+  uint32_t poll_count_ = 0;
+};
+
+template <typename Transport, uint8_t kSubscriptionNum>
+constexpr int8_t BasicMd40EventDispatcher<Transport, kSubscriptionNum>::kInvalidSubscription;
+
+template <typename Transport, uint8_t kSubscriptionNum>
+constexpr uint32_t BasicMd40EventDispatcher<Transport, kSubscriptionNum>::kDefaultActiveIntervalUs;
+
+template <typename Transport, uint8_t kSubscriptionNum>
+constexpr uint32_t BasicMd40EventDispatcher<Transport, kSubscriptionNum>::kDefaultIdleIntervalUs;
+
+template <typename Transport, uint8_t kSubscriptionNum>
+BasicMd40EventDispatcher<Transport, kSubscriptionNum>::BasicMd40EventDispatcher(Md40 &md40) : md40_(md40) {
+  static_assert(kSubscriptionNum > 0 && kSubscriptionNum <= 127, "kSubscriptionNum must be between 1 and 127");
+  for (auto &state : states_) {
+    state = State::kIdle;
+  }
+}
+
+template <typename Transport, uint8_t kSubscriptionNum>
+int8_t BasicMd40EventDispatcher<Transport, kSubscriptionNum>::Subscribe(
+    const uint8_t index, const State from, const State to, const Callback callback, void *const context) {
+  return Add(index, StateBit(from), StateBit(to), callback, context);
+}
+
+template <typename Transport, uint8_t kSubscriptionNum>
+int8_t BasicMd40EventDispatcher<Transport, kSubscriptionNum>::Subscribe(const uint8_t index,
+                                                                        const State to,
+                                                                        const Callback callback,
+                                                                        void *const context) {
+  return Add(index, kAnyState, StateBit(to), callback, context);
+}
+
+template <typename Transport, uint8_t kSubscriptionNum>
+void BasicMd40EventDispatcher<Transport, kSubscriptionNum>::Unsubscribe(const int8_t subscription) {
+  if (subscription >= 0 && subscription < kSubscriptionNum) {
+    subscriptions_[subscription].callback = nullptr;
+  }
+}
+
+template <typename Transport, uint8_t kSubscriptionNum>
+typename BasicMd40EventDispatcher<Transport, kSubscriptionNum>::Status BasicMd40EventDispatcher<Transport, kSubscriptionNum>::Poll() {
+  const uint32_t now = md40_.transport_.Micros();
+  // A command submitted since the last poll makes the poll due at once, otherwise a short move could start and end between two idle polls.
+  if (!due_ && md40_.submitted_sequence_ == seen_sequence_ && static_cast<int32_t>(now - next_poll_us_) < 0) {
+    return Status::kOk;
+  }
+
+  uint8_t fields[Md40::kMotorNum] = {0};
+  bool subscribed = false;
+  for (const auto &subscription : subscriptions_) {
+    if (subscription.callback != nullptr) {
+      fields[subscription.index] = Md40::ReadPlan::kFieldState;
+      subscribed = true;
+    }
+  }
+
+  // A motor without subscriptions starts over from a fresh baseline when it gets one again.
+  for (uint8_t i = 0; i < Md40::kMotorNum; i++) {
+    if (fields[i] == 0) {
+      known_motors_ &= ~(1 << i);
+    }
+  }
+
+  if (!subscribed) {
+    due_ = true;
+    return Status::kOk;
+  }
+
+  due_ = false;
+  poll_count_++;
+
+  typename Md40::ReadPlan plan(md40_, fields);
+  typename Md40::Motor::Snapshot snapshots[Md40::kMotorNum];
+  const Status status = plan.Execute(snapshots);
+  if (status != Status::kOk) {
+    interval_us_ = active_interval_us_;
+    next_poll_us_ = now + interval_us_;
+    return status;
+  }
+
+  // Any command submitted since the last poll may change a state, so does a motor still on its way to a position.
+  bool in_flight = md40_.submitted_sequence_ != seen_sequence_ || md40_.command_num_ > 0;
+  seen_sequence_ = md40_.submitted_sequence_;
+
+  for (uint8_t i = 0; i < Md40::kMotorNum; i++) {
+    if (fields[i] == 0) {
+      continue;
+    }
+
+    const State from = states_[i];
+    const State to = snapshots[i].state;
+    states_[i] = to;
+    in_flight = in_flight || to == State::kRuningToPosition;
+    if (!(known_motors_ & (1 << i))) {
+      known_motors_ |= 1 << i;
+    } else if (to != from) {
+      in_flight = true;
+      Dispatch(i, from, to);
+    }
+  }
+
+  if (in_flight) {
+    interval_us_ = active_interval_us_;
+  } else {
+    interval_us_ = interval_us_ * 2 < idle_interval_us_ ? interval_us_ * 2 : idle_interval_us_;
+  }
+  next_poll_us_ = now + interval_us_;
+  return Status::kOk;
+}
+
+template <typename Transport, uint8_t kSubscriptionNum>
+void BasicMd40EventDispatcher<Transport, kSubscriptionNum>::Wake() {
+  due_ = true;
+  interval_us_ = active_interval_us_;
+}
+
+template <typename Transport, uint8_t kSubscriptionNum>
+void BasicMd40EventDispatcher<Transport, kSubscriptionNum>::set_active_interval_us(const uint32_t us) {
+  active_interval_us_ = us;
+}
+
+template <typename Transport, uint8_t kSubscriptionNum>
+void BasicMd40EventDispatcher<Transport, kSubscriptionNum>::set_idle_interval_us(const uint32_t us) {
+  idle_interval_us_ = us;
+}
+
+template <typename Transport, uint8_t kSubscriptionNum>
+uint32_t BasicMd40EventDispatcher<Transport, kSubscriptionNum>::interval_us() const {
+  return interval_us_;
+}
+
+template <typename Transport, uint8_t kSubscriptionNum>
+uint32_t BasicMd40EventDispatcher<Transport, kSubscriptionNum>::poll_count() const {
+  return poll_count_;
+}
+
+template <typename Transport, uint8_t kSubscriptionNum>
+uint8_t BasicMd40EventDispatcher<Transport, kSubscriptionNum>::StateBit(const State state) {
+  return 1 << static_cast<uint8_t>(state);
+}
+
+template <typename Transport, uint8_t kSubscriptionNum>
+int8_t BasicMd40EventDispatcher<Transport, kSubscriptionNum>::Add(
+    const uint8_t index, const uint8_t from_states, const uint8_t to_states, const Callback callback, void *const context) {
+  EM_CHECK_LT(index, Md40::kMotorNum);
+  EM_CHECK(callback != nullptr);
+
+  for (int8_t i = 0; i < kSubscriptionNum; i++) {
+    Subscription &subscription = subscriptions_[i];
+    if (subscription.callback == nullptr) {
+      subscription.callback = callback;
+      subscription.context = context;
+      subscription.index = index;
+      subscription.from_states = from_states;
+      subscription.to_states = to_states;
+      Wake();
+      return i;
+    }
+  }
+  return kInvalidSubscription;
+}
+
+template <typename Transport, uint8_t kSubscriptionNum>
+void BasicMd40EventDispatcher<Transport, kSubscriptionNum>::Dispatch(const uint8_t index, const State from, const State to) {
+  // Read each entry afresh: a callback may unsubscribe itself or others, or take a free entry, while the table is being walked.
+  for (uint8_t i = 0; i < kSubscriptionNum; i++) {
+    const Subscription subscription = subscriptions_[i];
+    if (subscription.callback != nullptr && subscription.index == index && (subscription.from_states & StateBit(from)) &&
+        (subscription.to_states & StateBit(to))) {
+      subscription.callback(subscription.context, index, from, to);
+    }
+  }
+}
+
+#ifdef ARDUINO
+/**
+ * @~Chinese
+ * @brief 使用 TwoWire 的电机状态变化事件分发器。
+ * @tparam kSubscriptionNum 订阅表的大小。
+ */
+/**
+ * @~English
+ * @brief Motor state transition event dispatcher using TwoWire.
+ * @tparam kSubscriptionNum Size of the subscription table.
+ */
+template <uint8_t kSubscriptionNum = 8>
+using Md40EventDispatcher = BasicMd40EventDispatcher<TwoWireTransport, kSubscriptionNum>;
+#endif
+}  // namespace em
+#endif
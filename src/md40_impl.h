@@ -0,0 +1,1621 @@
+#pragma once
+
+#ifndef _EM_MD40_IMPL_H_
+#define _EM_MD40_IMPL_H_
+
+/**
+ * @file md40_impl.h
+ * @brief Definitions of the BasicMd40 template, included at the end of md40.h.
+ */
+
+namespace em {
+
+namespace md40_internal {
+inline uint16_t PidGainToRegister(const float value) {
+  // Written as a negated comparison so that NaN also ends up as 0.
+  if (!(value > 0)) {
+    return 0;
+  }
+  if (value >= UINT16_MAX / 100.0f) {
+    return UINT16_MAX;
+  }
+  return static_cast<uint16_t>(value * 100 + 0.5f);
+}
+
+inline char *FormatDecimal(char *out, const uint8_t value) {
+  if (value >= 100) {
+    *out++ = '0' + value / 100;
+  }
+  if (value >= 10) {
+    *out++ = '0' + value / 10 % 10;
+  }
+  *out++ = '0' + value % 10;
+  return out;
+}
+
+// CRC-8 with polynomial 0x07, enough to reject an erased or half-written store.
+inline uint8_t Crc8(const uint8_t *data, const uint8_t length) {
+  uint8_t crc = 0;
+  for (uint8_t i = 0; i < length; i++) {
+    crc ^= data[i];
+    for (uint8_t bit = 0; bit < 8; bit++) {
+      crc = crc & 0x80 ? (crc << 1) ^ 0x07 : crc << 1;
+    }
+  }
+  return crc;
+}
+}  // namespace md40_internal
+
+template <typename Transport>
+constexpr typename BasicMd40<Transport>::FieldLayout BasicMd40<Transport>::kFieldLayouts[];
+
+template <typename Transport>
+constexpr uint32_t BasicMd40<Transport>::kArrivalPollIntervalUs;
+
+template <typename Transport>
+constexpr uint32_t BasicMd40<Transport>::kBusCheckCommandTimeoutUs;
+
+template <typename Transport>
+constexpr uint32_t BasicMd40<Transport>::BusSpeedPolicy::kDefaultClocksHz[];
+
+template <typename Transport>
+constexpr uint8_t BasicMd40<Transport>::ConfigProfile::kVersion;
+
+template <typename Transport>
+constexpr uint8_t BasicMd40<Transport>::ConfigProfile::kSerializedLength;
+
+template <typename Transport>
+constexpr uint8_t BasicMd40<Transport>::ConfigProfile::kTag;
+
+template <typename Transport>
+constexpr uint8_t BasicMd40<Transport>::DeviceInfo::kNameLength;
+
+template <typename Transport>
+constexpr uint8_t BasicMd40<Transport>::DeviceInfo::kVersionLength;
+
+template <typename Transport>
+uint8_t BasicMd40<Transport>::DeviceInfo::FormatFirmwareVersion(char *buffer, const uint8_t size) const {
+  EM_CHECK_GT(size, 0);
+
+  char text[kVersionLength + 1] = {0};
+  char *end = text;
+  for (uint8_t i = 0; i < sizeof(firmware_version); i++) {
+    if (i > 0) {
+      *end++ = '.';
+    }
+    end = md40_internal::FormatDecimal(end, firmware_version[i]);
+  }
+
+  const uint8_t length = end - text < size ? end - text : size - 1;
+  memcpy(buffer, text, length);
+  buffer[length] = '\0';
+  return length;
+}
+
+template <typename Transport>
+BasicMd40<Transport>::BasicMd40(const uint8_t i2c_address, const Transport &transport)
+    : i2c_address_(i2c_address), transport_(transport), motors_{{*this, 0}, {*this, 1}, {*this, 2}, {*this, 3}} {
+  static_assert(kMotorNum == 4, "motors_ is initialized for exactly four motors");
+}
+
+template <typename Transport>
+typename BasicMd40<Transport>::Motor &BasicMd40<Transport>::operator[](const uint8_t index) {
+  EM_CHECK_LT(index, kMotorNum);
+  return motors_[index];
+}
+
+template <typename Transport>
+typename BasicMd40<Transport>::Status BasicMd40<Transport>::Init() {
+  Status status = Probe();
+  if (status != Status::kOk) {
+    return status;
+  }
+
+  // The mailbox still takes one command at a time, but queueing all resets lets each one go out as soon as the previous one has been executed
+  // instead of waiting out a full wait-policy interval per motor.
+  status = Reserve(kMotorNum);
+  if (status != Status::kOk) {
+    return status;
+  }
+  for (auto &motor : motors_) {
+    motor.SubmitReset();
+  }
+  return Flush();
+}
+
+template <typename Transport>
+typename BasicMd40<Transport>::Status BasicMd40<Transport>::Probe() {
+  transport_.Init();
+
+  device_info_cached_ = false;
+  device_info_ = DeviceInfo();
+  DeviceInfo info;
+  const Status status = ReadDeviceInfo(info);
+  if (status != Status::kOk) {
+    return status;
+  }
+
+  if (command_write_ != CommandWrite::kDetect) {
+    fused_command_ = command_write_ == CommandWrite::kFused;
+    return Status::kOk;
+  }
+  return DetectFusedCommand();
+}
+
+template <typename Transport>
+typename BasicMd40<Transport>::Status BasicMd40<Transport>::DetectFusedCommand() {
+  // Motor 0's own speed P gain written back changes nothing, whichever way the command ends up being executed.
+  uint16_t gain = 0;
+  Status status = ReadRegisters(kSpeedP, &gain, sizeof(gain));
+  if (status == Status::kOk) {
+    status = WaitCommandEmptied();
+  }
+  if (status != Status::kOk) {
+    return status;
+  }
+
+  Command command;
+  command.type = kSetSpeedPidP;
+  command.length = sizeof(gain);
+  memcpy(command.param, &gain, sizeof(gain));
+  fused_command_ = true;
+  status = WriteCommand(command);
+  if (status != Status::kOk) {
+    return status;
+  }
+  status = WaitCommandEmptied();
+  if (status != Status::kTimeout) {
+    return status;
+  }
+
+  // Firmware that ignores an execute flag written together with the command leaves it set, and runs the command once the flag is written on its
+  // own.
+  fused_command_ = false;
+  const uint8_t execute = 0x01;
+  status = WriteRegisters(kCommandExecute, &execute, sizeof(execute), false);
+  return status == Status::kOk ? WaitCommandEmptied() : status;
+}
+
+template <typename Transport>
+typename BasicMd40<Transport>::Status BasicMd40<Transport>::WaitCommandEmptied() {
+  const uint32_t start_time = transport_.Micros();
+  for (;;) {
+    bool emptied = false;
+    const Status status = ReadCommandEmptied(emptied);
+    if (status != Status::kOk || emptied) {
+      return status;
+    }
+    if (transport_.Micros() - start_time >= kBusCheckCommandTimeoutUs) {
+      last_status_ = Status::kTimeout;
+      return Status::kTimeout;
+    }
+  }
+}
+
+template <typename Transport>
+typename BasicMd40<Transport>::Status BasicMd40<Transport>::ReadDeviceInfo(DeviceInfo &info) {
+  uint8_t data[kDeviceInfoLength] = {0};
+  const Status status = ReadRegisters(kDeviceId, data, sizeof(data));
+  if (status != Status::kOk) {
+    return status;
+  }
+
+  info = DeviceInfo();
+  info.device_id = data[kDeviceId - kDeviceId];
+  memcpy(info.firmware_version, data + (kMajorVersion - kDeviceId), sizeof(info.firmware_version));
+  memcpy(info.name, data + (kName - kDeviceId), DeviceInfo::kNameLength);
+  device_info_ = info;
+  device_info_cached_ = true;
+  return Status::kOk;
+}
+
+template <typename Transport>
+const typename BasicMd40<Transport>::DeviceInfo &BasicMd40<Transport>::device_info() const {
+  return device_info_;
+}
+
+template <typename Transport>
+String BasicMd40<Transport>::firmware_version() {
+  LoadDeviceInfo();
+  char text[DeviceInfo::kVersionLength + 1] = {0};
+  device_info_.FormatFirmwareVersion(text, sizeof(text));
+  return String(text);
+}
+
+template <typename Transport>
+uint8_t BasicMd40<Transport>::device_id() {
+  LoadDeviceInfo();
+  return device_info_.device_id;
+}
+
+template <typename Transport>
+String BasicMd40<Transport>::name() {
+  LoadDeviceInfo();
+  return String(device_info_.name);
+}
+
+template <typename Transport>
+typename BasicMd40<Transport>::Status BasicMd40<Transport>::LoadDeviceInfo() {
+  if (device_info_cached_) {
+    return Status::kOk;
+  }
+  DeviceInfo info;
+  return ReadDeviceInfo(info);
+}
+
+template <typename Transport>
+typename BasicMd40<Transport>::Status BasicMd40<Transport>::ReadPidGainRegisters(const uint8_t index, uint16_t (&gains)[Motor::kPidGainNum]) {
+  Motor &motor = motors_[index];
+  if (motor.config_cache_enabled_ && (motor.cache_valid_ & Motor::kPidGainsCached) == Motor::kPidGainsCached) {
+    memcpy(gains, motor.pid_gain_cache_, sizeof(gains));
+    return Status::kOk;
+  }
+
+  const Status status = ReadRegisters(kSpeedP + index * kMotorStateOffset, gains, sizeof(gains));
+  if (status == Status::kOk && motor.config_cache_enabled_) {
+    memcpy(motor.pid_gain_cache_, gains, sizeof(motor.pid_gain_cache_));
+    motor.cache_valid_ |= Motor::kPidGainsCached;
+  }
+  return status;
+}
+
+template <typename Transport>
+bool BasicMd40<Transport>::CheckBusIntegrity(const uint8_t (&reference)[kDeviceInfoLength], const uint16_t gain) {
+  uint8_t data[kDeviceInfoLength] = {0};
+  if (ReadRegisters(kDeviceId, data, sizeof(data)) != Status::kOk || memcmp(data, reference, sizeof(data)) != 0) {
+    return false;
+  }
+
+  if (Wait(Submit(kSetSpeedPidP, 0, &gain, sizeof(gain))) != Status::kOk) {
+    return false;
+  }
+
+  uint16_t readback = 0;
+  return ReadRegisters(kSpeedP, &readback, sizeof(readback)) == Status::kOk && readback == gain;
+}
+
+template <typename Transport>
+typename BasicMd40<Transport>::Status BasicMd40<Transport>::ApplyConfigProfile(const ConfigProfile &profile) {
+  for (uint8_t i = 0; i < kMotorNum; i++) {
+    if (profile.has_mode(i)) {
+      const Status status = Reserve(1);
+      if (status != Status::kOk) {
+        return status;
+      }
+      // A setup equal to the cached one is skipped by SubmitSetup itself.
+      motors_[i].SubmitSetup(profile.setups_[i], sizeof(profile.setups_[i]));
+    }
+  }
+  Status status = Flush();
+  if (status != Status::kOk) {
+    return status;
+  }
+
+  for (uint8_t i = 0; i < kMotorNum; i++) {
+    if (!profile.has_pid_gains(i)) {
+      continue;
+    }
+
+    uint16_t gains[Motor::kPidGainNum] = {0};
+    status = ReadPidGainRegisters(i, gains);
+    if (status != Status::kOk) {
+      return status;
+    }
+    for (uint8_t slot = 0; slot < Motor::kPidGainNum; slot++) {
+      if (gains[slot] != profile.pid_gains_[i][slot]) {
+        status = Reserve(1);
+        if (status != Status::kOk) {
+          return status;
+        }
+        motors_[i].SubmitPidGainRegister(slot, profile.pid_gains_[i][slot]);
+      }
+    }
+  }
+  return Flush();
+}
+
+template <typename Transport>
+typename BasicMd40<Transport>::Status BasicMd40<Transport>::ReadConfigProfile(ConfigProfile &profile) {
+  profile = ConfigProfile();
+  for (uint8_t i = 0; i < kMotorNum; i++) {
+    const Motor &motor = motors_[i];
+    if (motor.config_cache_enabled_ && (motor.cache_valid_ & Motor::kSetupCached)) {
+      memcpy(profile.setups_[i], motor.setup_cache_, sizeof(profile.setups_[i]));
+      profile.mode_mask_ |= 1 << i;
+    }
+
+    const Status status = ReadPidGainRegisters(i, profile.pid_gains_[i]);
+    if (status != Status::kOk) {
+      return status;
+    }
+    profile.pid_gain_mask_ |= 1 << i;
+  }
+  return Status::kOk;
+}
+
+template <typename Transport>
+typename BasicMd40<Transport>::WaitPolicy BasicMd40<Transport>::WaitPolicy::Spin(const uint32_t timeout_us) {
+  WaitPolicy policy;
+  policy.timeout_us = timeout_us;
+  return policy;
+}
+
+template <typename Transport>
+typename BasicMd40<Transport>::WaitPolicy BasicMd40<Transport>::WaitPolicy::FixedInterval(const uint32_t interval_us, const uint32_t timeout_us) {
+  WaitPolicy policy;
+  policy.mode = Mode::kFixedInterval;
+  policy.interval_us = interval_us;
+  policy.timeout_us = timeout_us;
+  return policy;
+}
+
+template <typename Transport>
+typename BasicMd40<Transport>::WaitPolicy BasicMd40<Transport>::WaitPolicy::ExponentialBackoff(const uint32_t interval_us,
+                                                                                               const uint32_t max_interval_us,
+                                                                                               const uint32_t timeout_us) {
+  WaitPolicy policy;
+  policy.mode = Mode::kExponentialBackoff;
+  policy.interval_us = interval_us;
+  policy.max_interval_us = max_interval_us;
+  policy.timeout_us = timeout_us;
+  return policy;
+}
+
+template <typename Transport>
+typename BasicMd40<Transport>::Status BasicMd40<Transport>::Poll() {
+  bool progressed = false;
+  return Step(progressed);
+}
+
+template <typename Transport>
+typename BasicMd40<Transport>::Status BasicMd40<Transport>::Step(bool &progressed) {
+  progressed = false;
+
+  if (mailbox_phase_ == MailboxPhase::kIdle) {
+    if (command_num_ == 0) {
+      return Status::kOk;
+    }
+    mailbox_phase_ = mailbox_emptied_ ? MailboxPhase::kWrite : MailboxPhase::kWaitEmptied;
+  }
+
+  Status status = Status::kOk;
+  switch (mailbox_phase_) {
+    case MailboxPhase::kWaitEmptied:
+      status = ReadCommandEmptied(mailbox_emptied_);
+      if (status == Status::kOk && mailbox_emptied_) {
+        mailbox_phase_ = MailboxPhase::kWrite;
+        progressed = true;
+      }
+      return status;
+
+    case MailboxPhase::kWrite:
+      mailbox_emptied_ = false;
+      status = WriteCommand(commands_[command_head_]);
+      if (status == Status::kOk) {
+        mailbox_phase_ = fused_command_ ? MailboxPhase::kWaitExecuted : MailboxPhase::kExecute;
+        progressed = true;
+      } else if (fused_command_ && last_write_result_ != I2cResult::kAddressNack) {
+        // The execute flag may have arrived with the command, so writing it again could run the command twice.
+        Abandon(finished_sequence_ + 1);
+        progressed = true;
+      }
+      return status;
+
+    case MailboxPhase::kExecute: {
+      const uint8_t execute = 0x01;
+      status = WriteRegisters(kCommandExecute, &execute, sizeof(execute), false);
+      if (status == Status::kOk) {
+        mailbox_phase_ = MailboxPhase::kWaitExecuted;
+        progressed = true;
+      } else if (last_write_result_ != I2cResult::kAddressNack) {
+        Abandon(finished_sequence_ + 1);
+        progressed = true;
+      }
+      return status;
+    }
+
+    case MailboxPhase::kWaitExecuted:
+      status = ReadCommandEmptied(mailbox_emptied_);
+      if (status == Status::kOk && mailbox_emptied_) {
+        command_head_ = (command_head_ + 1) % kCommandQueueSize;
+        command_num_--;
+        finished_sequence_++;
+        mailbox_phase_ = command_num_ > 0 ? MailboxPhase::kWrite : MailboxPhase::kIdle;
+        progressed = true;
+      }
+      return status;
+
+    default:
+      return Status::kOk;
+  }
+}
+
+template <typename Transport>
+typename BasicMd40<Transport>::Status BasicMd40<Transport>::Wait(const CommandHandle &handle) {
+  const uint32_t start_time = transport_.Micros();
+  uint32_t interval_us = wait_policy_.interval_us;
+
+  if (handle.rejected_) {
+    last_status_ = Status::kQueueFull;
+    return Status::kQueueFull;
+  }
+
+  while (!handle.Done()) {
+    bool progressed = false;
+    const Status status = Step(progressed);
+    if (status != Status::kOk) {
+      Abandon(handle.sequence_);
+      return status;
+    }
+
+    if (progressed) {
+      interval_us = wait_policy_.interval_us;
+      continue;
+    }
+
+    if (wait_policy_.timeout_us > 0 && transport_.Micros() - start_time >= wait_policy_.timeout_us) {
+      Abandon(handle.sequence_);
+      last_status_ = Status::kTimeout;
+      return Status::kTimeout;
+    }
+
+    switch (wait_policy_.mode) {
+      case WaitPolicy::Mode::kFixedInterval:
+        transport_.DelayMicroseconds(interval_us);
+        break;
+
+      case WaitPolicy::Mode::kExponentialBackoff:
+        transport_.DelayMicroseconds(interval_us);
+        interval_us = interval_us > wait_policy_.max_interval_us / 2 ? wait_policy_.max_interval_us : interval_us * 2;
+        break;
+
+      default:
+        break;
+    }
+  }
+
+  return Status::kOk;
+}
+
+template <typename Transport>
+typename BasicMd40<Transport>::Status BasicMd40<Transport>::Flush() {
+  return Wait(CommandHandle(this, submitted_sequence_));
+}
+
+template <typename Transport>
+void BasicMd40<Transport>::set_wait_policy(const WaitPolicy &policy) {
+  wait_policy_ = policy;
+}
+
+template <typename Transport>
+const typename BasicMd40<Transport>::WaitPolicy &BasicMd40<Transport>::wait_policy() const {
+  return wait_policy_;
+}
+
+template <typename Transport>
+void BasicMd40<Transport>::set_retry_count(const uint8_t retry_count) {
+  retry_count_ = retry_count;
+}
+
+template <typename Transport>
+uint8_t BasicMd40<Transport>::retry_count() const {
+  return retry_count_;
+}
+
+template <typename Transport>
+void BasicMd40<Transport>::set_command_write(const CommandWrite command_write) {
+  command_write_ = command_write;
+  if (command_write != CommandWrite::kDetect) {
+    fused_command_ = command_write == CommandWrite::kFused;
+  }
+}
+
+template <typename Transport>
+bool BasicMd40<Transport>::fused_command() const {
+  return fused_command_;
+}
+
+template <typename Transport>
+typename BasicMd40<Transport>::Status BasicMd40<Transport>::NegotiateBusSpeed(const BusSpeedPolicy &policy) {
+  EM_CHECK_GT(policy.clock_num, 0);
+
+  Status status = Flush();
+  if (status != Status::kOk) {
+    return status;
+  }
+
+  bus_clock_hz_ = 0;
+  bus_clock_error_count_ = 0;
+
+  transport_.SetClock(policy.clocks_hz[0]);
+  uint8_t reference[kDeviceInfoLength] = {0};
+  uint16_t gain = 0;
+  status = ReadRegisters(kDeviceId, reference, sizeof(reference));
+  if (status == Status::kOk) {
+    status = ReadRegisters(kSpeedP, &gain, sizeof(gain));
+  }
+  if (status != Status::kOk) {
+    return status;
+  }
+
+  // Retries would mask the very errors being counted, and a corrupted execute flag must not keep a check waiting forever.
+  const WaitPolicy wait_policy = wait_policy_;
+  const uint8_t retry_count = retry_count_;
+  wait_policy_ = WaitPolicy::Spin(kBusCheckCommandTimeoutUs);
+  retry_count_ = 0;
+
+  uint32_t clock_hz = 0;
+  uint8_t clock_error_count = 0;
+  for (uint8_t i = 0; i < policy.clock_num; i++) {
+    transport_.SetClock(policy.clocks_hz[i]);
+
+    uint8_t error_count = 0;
+    for (uint8_t trial = 0; trial < policy.trial_count && error_count <= policy.error_budget; trial++) {
+      // Alternating the lowest bit makes every writeback change the register, so a dropped write cannot pass for a good one.
+      if (!CheckBusIntegrity(reference, trial % 2 == 0 ? static_cast<uint16_t>(gain ^ 1) : gain)) {
+        error_count++;
+      }
+    }
+
+    if (error_count > policy.error_budget) {
+      break;
+    }
+    clock_hz = policy.clocks_hz[i];
+    clock_error_count = error_count;
+  }
+
+  wait_policy_ = wait_policy;
+  retry_count_ = retry_count;
+
+  transport_.SetClock(clock_hz == 0 ? policy.clocks_hz[0] : clock_hz);
+  motors_[0].Invalidate();
+  status = Wait(Submit(kSetSpeedPidP, 0, &gain, sizeof(gain)));
+  if (status != Status::kOk) {
+    return status;
+  }
+  if (clock_hz == 0) {
+    return Status::kBusError;
+  }
+
+  bus_clock_hz_ = clock_hz;
+  bus_clock_error_count_ = clock_error_count;
+  return Status::kOk;
+}
+
+template <typename Transport>
+typename BasicMd40<Transport>::Status BasicMd40<Transport>::NegotiateBusSpeed() {
+  return NegotiateBusSpeed(BusSpeedPolicy());
+}
+
+template <typename Transport>
+uint32_t BasicMd40<Transport>::bus_clock_hz() const {
+  return bus_clock_hz_;
+}
+
+template <typename Transport>
+uint8_t BasicMd40<Transport>::bus_clock_error_count() const {
+  return bus_clock_error_count_;
+}
+
+template <typename Transport>
+typename BasicMd40<Transport>::Status BasicMd40<Transport>::last_status() const {
+  return last_status_;
+}
+
+template <typename Transport>
+typename BasicMd40<Transport>::CommandHandle BasicMd40<Transport>::Submit(const uint8_t type,
+                                                                          const uint8_t index,
+                                                                          const void *param,
+                                                                          const uint8_t length) {
+  EM_CHECK_LE(length, kCommandParamLength);
+
+  if (command_num_ == kCommandQueueSize) {
+    return Reject();
+  }
+
+  Command &command = commands_[(command_head_ + command_num_) % kCommandQueueSize];
+  command.type = type;
+  command.index = index;
+  command.length = length;
+  memset(command.param, 0, sizeof(command.param));
+  if (param != nullptr && length > 0) {
+    memcpy(command.param, param, length);
+  }
+  motors_[index].NoteCommand(type, command.param, submitted_sequence_ + 1);
+  command_num_++;
+
+  return CommandHandle(this, ++submitted_sequence_);
+}
+
+template <typename Transport>
+typename BasicMd40<Transport>::CommandHandle BasicMd40<Transport>::Reject() {
+  last_status_ = Status::kQueueFull;
+  CommandHandle handle(this, finished_sequence_);
+  handle.rejected_ = true;
+  return handle;
+}
+
+// For the blocking calls only: waits until the oldest queued commands have made room for command_num more.
+template <typename Transport>
+typename BasicMd40<Transport>::Status BasicMd40<Transport>::Reserve(const uint8_t command_num) {
+  EM_CHECK_LE(command_num, kCommandQueueSize);
+  if (command_num_ + command_num <= kCommandQueueSize) {
+    return Status::kOk;
+  }
+  return Wait(CommandHandle(this, finished_sequence_ + command_num_ + command_num - kCommandQueueSize));
+}
+
+template <typename Transport>
+void BasicMd40<Transport>::Abandon(const uint16_t sequence) {
+  while (command_num_ > 0 && static_cast<int16_t>(sequence - finished_sequence_) > 0) {
+    motors_[commands_[command_head_].index].Invalidate();
+    command_head_ = (command_head_ + 1) % kCommandQueueSize;
+    command_num_--;
+    finished_sequence_++;
+  }
+  mailbox_phase_ = MailboxPhase::kIdle;
+  mailbox_emptied_ = false;
+}
+
+template <typename Transport>
+typename BasicMd40<Transport>::Status BasicMd40<Transport>::ReadCommandEmptied(bool &emptied) {
+  uint8_t execute = 0xFF;
+  const Status status = ReadRegisters(kCommandExecute, &execute, sizeof(execute));
+  emptied = status == Status::kOk && execute == 0;
+  return status;
+}
+
+template <typename Transport>
+typename BasicMd40<Transport>::Status BasicMd40<Transport>::WriteCommand(const Command &command) {
+  uint8_t data[kCommandLength] = {command.type, command.index};
+  memcpy(data + (kCommandParam - kCommandType), command.param, sizeof(command.param));
+  if (fused_command_) {
+    data[kCommandExecute - kCommandType] = 0x01;
+    return WriteRegisters(kCommandType, data, sizeof(data), false);
+  }
+  return WriteRegisters(kCommandType, data, kCommandParam - kCommandType + command.length, false);
+}
+
+template <typename Transport>
+typename BasicMd40<Transport>::Status BasicMd40<Transport>::WriteRegisters(const uint8_t address,
+                                                                           const void *data,
+                                                                           const uint8_t length,
+                                                                           const bool idempotent) {
+  for (uint8_t attempt = 0;; attempt++) {
+    const I2cResult result = transport_.Write(i2c_address_, address, data, length);
+    last_write_result_ = result;
+    if (result == I2cResult::kOk) {
+      last_status_ = Status::kOk;
+      return Status::kOk;
+    }
+
+    // A command must not reach the MD40 twice, so it is only retried when nothing was acknowledged.
+    if (attempt >= retry_count_ || (!idempotent && result != I2cResult::kAddressNack)) {
+      last_status_ = Status::kBusError;
+      return Status::kBusError;
+    }
+  }
+}
+
+template <typename Transport>
+typename BasicMd40<Transport>::Status BasicMd40<Transport>::ReadRegisters(const uint8_t address, void *data, const uint8_t length) {
+  for (uint8_t attempt = 0;; attempt++) {
+    if (transport_.WriteRead(i2c_address_, address, data, length) == I2cResult::kOk) {
+      last_status_ = Status::kOk;
+      return Status::kOk;
+    }
+
+    if (attempt >= retry_count_) {
+      last_status_ = Status::kBusError;
+      return Status::kBusError;
+    }
+  }
+}
+
+template <typename Transport>
+typename BasicMd40<Transport>::Status BasicMd40<Transport>::ReadLatchedRegisters(const uint8_t address, void *data, const uint8_t length) {
+  const uint8_t latch = 0;
+  const Status status = WriteRegisters(address, &latch, sizeof(latch), true);
+  if (status != Status::kOk) {
+    return status;
+  }
+  return ReadRegisters(address, data, length);
+}
+
+template <typename Transport>
+BasicMd40<Transport>::CommandHandle::CommandHandle(const BasicMd40 *md40, const uint16_t sequence) : md40_(md40), sequence_(sequence) {
+}
+
+template <typename Transport>
+bool BasicMd40<Transport>::CommandHandle::Done() const {
+  return md40_ == nullptr || rejected_ || static_cast<int16_t>(md40_->finished_sequence_ - sequence_) >= 0;
+}
+
+template <typename Transport>
+bool BasicMd40<Transport>::CommandHandle::rejected() const {
+  return rejected_;
+}
+
+template <typename Transport>
+BasicMd40<Transport>::Motor::Motor(BasicMd40 &md40, const uint8_t index) : md40_(md40), index_(index) {
+}
+
+template <typename Transport>
+typename BasicMd40<Transport>::Status BasicMd40<Transport>::Motor::Reset() {
+  const Status status = md40_.Reserve(1);
+  return status == Status::kOk ? md40_.Wait(SubmitReset()) : status;
+}
+
+template <typename Transport>
+typename BasicMd40<Transport>::CommandHandle BasicMd40<Transport>::Motor::SubmitReset() {
+  Invalidate();
+  return md40_.Submit(kReset, index_, nullptr, 0);
+}
+
+template <typename Transport>
+typename BasicMd40<Transport>::Status BasicMd40<Transport>::Motor::SetEncoderMode(const uint16_t ppr,
+                                                                                  const uint16_t reduction_ratio,
+                                                                                  const PhaseRelation phase_relation) {
+  const Status status = md40_.Reserve(1);
+  return status == Status::kOk ? md40_.Wait(SubmitEncoderMode(ppr, reduction_ratio, phase_relation)) : status;
+}
+
+template <typename Transport>
+typename BasicMd40<Transport>::CommandHandle BasicMd40<Transport>::Motor::SubmitEncoderMode(const uint16_t ppr,
+                                                                                            const uint16_t reduction_ratio,
+                                                                                            const PhaseRelation phase_relation) {
+  uint8_t data[kSetupLength] = {0};
+  memcpy(data, &ppr, sizeof(ppr));
+  memcpy(data + sizeof(ppr), &reduction_ratio, sizeof(reduction_ratio));
+  data[sizeof(ppr) + sizeof(reduction_ratio)] = static_cast<uint8_t>(phase_relation);
+  return SubmitSetup(data, sizeof(data));
+}
+
+template <typename Transport>
+typename BasicMd40<Transport>::Status BasicMd40<Transport>::Motor::SetDcMode() {
+  const Status status = md40_.Reserve(1);
+  return status == Status::kOk ? md40_.Wait(SubmitDcMode()) : status;
+}
+
+template <typename Transport>
+typename BasicMd40<Transport>::CommandHandle BasicMd40<Transport>::Motor::SubmitDcMode() {
+  const uint8_t data[] = {0, 0, 0};
+  return SubmitSetup(data, sizeof(data));
+}
+
+template <typename Transport>
+float BasicMd40<Transport>::Motor::speed_pid_p() {
+  return ReadPidGain(0);
+}
+
+template <typename Transport>
+typename BasicMd40<Transport>::Status BasicMd40<Transport>::Motor::set_speed_pid_p(const float value) {
+  const Status status = md40_.Reserve(1);
+  return status == Status::kOk ? md40_.Wait(SubmitSpeedPidP(value)) : status;
+}
+
+template <typename Transport>
+typename BasicMd40<Transport>::CommandHandle BasicMd40<Transport>::Motor::SubmitSpeedPidP(const float value) {
+  return SubmitPidGain(0, value);
+}
+
+template <typename Transport>
+float BasicMd40<Transport>::Motor::speed_pid_i() {
+  return ReadPidGain(1);
+}
+
+template <typename Transport>
+typename BasicMd40<Transport>::Status BasicMd40<Transport>::Motor::set_speed_pid_i(const float value) {
+  const Status status = md40_.Reserve(1);
+  return status == Status::kOk ? md40_.Wait(SubmitSpeedPidI(value)) : status;
+}
+
+template <typename Transport>
+typename BasicMd40<Transport>::CommandHandle BasicMd40<Transport>::Motor::SubmitSpeedPidI(const float value) {
+  return SubmitPidGain(1, value);
+}
+
+template <typename Transport>
+float BasicMd40<Transport>::Motor::speed_pid_d() {
+  return ReadPidGain(2);
+}
+
+template <typename Transport>
+typename BasicMd40<Transport>::Status BasicMd40<Transport>::Motor::set_speed_pid_d(const float value) {
+  const Status status = md40_.Reserve(1);
+  return status == Status::kOk ? md40_.Wait(SubmitSpeedPidD(value)) : status;
+}
+
+template <typename Transport>
+typename BasicMd40<Transport>::CommandHandle BasicMd40<Transport>::Motor::SubmitSpeedPidD(const float value) {
+  return SubmitPidGain(2, value);
+}
+
+template <typename Transport>
+float BasicMd40<Transport>::Motor::position_pid_p() {
+  return ReadPidGain(3);
+}
+
+template <typename Transport>
+typename BasicMd40<Transport>::Status BasicMd40<Transport>::Motor::set_position_pid_p(const float value) {
+  const Status status = md40_.Reserve(1);
+  return status == Status::kOk ? md40_.Wait(SubmitPositionPidP(value)) : status;
+}
+
+template <typename Transport>
+typename BasicMd40<Transport>::CommandHandle BasicMd40<Transport>::Motor::SubmitPositionPidP(const float value) {
+  return SubmitPidGain(3, value);
+}
+
+template <typename Transport>
+float BasicMd40<Transport>::Motor::position_pid_i() {
+  return ReadPidGain(4);
+}
+
+template <typename Transport>
+typename BasicMd40<Transport>::Status BasicMd40<Transport>::Motor::set_position_pid_i(const float value) {
+  const Status status = md40_.Reserve(1);
+  return status == Status::kOk ? md40_.Wait(SubmitPositionPidI(value)) : status;
+}
+
+template <typename Transport>
+typename BasicMd40<Transport>::CommandHandle BasicMd40<Transport>::Motor::SubmitPositionPidI(const float value) {
+  return SubmitPidGain(4, value);
+}
+
+template <typename Transport>
+float BasicMd40<Transport>::Motor::position_pid_d() {
+  return ReadPidGain(5);
+}
+
+template <typename Transport>
+typename BasicMd40<Transport>::Status BasicMd40<Transport>::Motor::set_position_pid_d(const float value) {
+  const Status status = md40_.Reserve(1);
+  return status == Status::kOk ? md40_.Wait(SubmitPositionPidD(value)) : status;
+}
+
+template <typename Transport>
+typename BasicMd40<Transport>::CommandHandle BasicMd40<Transport>::Motor::SubmitPositionPidD(const float value) {
+  return SubmitPidGain(5, value);
+}
+
+template <typename Transport>
+typename BasicMd40<Transport>::Motor::PidGains BasicMd40<Transport>::Motor::pid_gains() {
+  uint16_t data[kPidGainNum] = {0};
+  if (config_cache_enabled_ && (cache_valid_ & kPidGainsCached) == kPidGainsCached) {
+    memcpy(data, pid_gain_cache_, sizeof(data));
+  } else if (md40_.ReadRegisters(kSpeedP + index_ * kMotorStateOffset, data, sizeof(data)) == Status::kOk && config_cache_enabled_) {
+    memcpy(pid_gain_cache_, data, sizeof(pid_gain_cache_));
+    cache_valid_ |= kPidGainsCached;
+  }
+
+  PidGains gains;
+  gains.speed_p = data[0] / 100.0f;
+  gains.speed_i = data[1] / 100.0f;
+  gains.speed_d = data[2] / 100.0f;
+  gains.position_p = data[3] / 100.0f;
+  gains.position_i = data[4] / 100.0f;
+  gains.position_d = data[5] / 100.0f;
+  return gains;
+}
+
+template <typename Transport>
+typename BasicMd40<Transport>::Status BasicMd40<Transport>::Motor::SetPidGains(const PidGains &gains) {
+  const Status status = md40_.Reserve(kPidGainNum);
+  return status == Status::kOk ? md40_.Wait(SubmitPidGains(gains)) : status;
+}
+
+template <typename Transport>
+typename BasicMd40<Transport>::CommandHandle BasicMd40<Transport>::Motor::SubmitPidGains(const PidGains &gains) {
+  // All or nothing, so a rejected call can simply be repeated.
+  if (md40_.command_num_ + kPidGainNum > kCommandQueueSize) {
+    return md40_.Reject();
+  }
+
+  const float values[kPidGainNum] = {gains.speed_p, gains.speed_i, gains.speed_d, gains.position_p, gains.position_i, gains.position_d};
+  CommandHandle last_handle;
+  for (uint8_t slot = 0; slot < kPidGainNum; slot++) {
+    // Commands finish in submission order, so the last one actually sent covers all of them.
+    const CommandHandle handle = SubmitPidGain(slot, values[slot]);
+    if (!handle.Done()) {
+      last_handle = handle;
+    }
+  }
+  return last_handle;
+}
+
+template <typename Transport>
+typename BasicMd40<Transport>::Status BasicMd40<Transport>::Motor::set_position(const int32_t position) {
+  const Status status = md40_.Reserve(1);
+  return status == Status::kOk ? md40_.Wait(SubmitPosition(position)) : status;
+}
+
+template <typename Transport>
+typename BasicMd40<Transport>::CommandHandle BasicMd40<Transport>::Motor::SubmitPosition(const int32_t position) {
+  return md40_.Submit(kSetPosition, index_, &position, sizeof(position));
+}
+
+template <typename Transport>
+typename BasicMd40<Transport>::Status BasicMd40<Transport>::Motor::set_pulse_count(const int32_t pulse_count) {
+  const Status status = md40_.Reserve(1);
+  return status == Status::kOk ? md40_.Wait(SubmitPulseCount(pulse_count)) : status;
+}
+
+template <typename Transport>
+typename BasicMd40<Transport>::CommandHandle BasicMd40<Transport>::Motor::SubmitPulseCount(const int32_t pulse_count) {
+  return md40_.Submit(kSetPulseCount, index_, &pulse_count, sizeof(pulse_count));
+}
+
+template <typename Transport>
+typename BasicMd40<Transport>::Status BasicMd40<Transport>::Motor::Stop() {
+  const Status status = md40_.Reserve(1);
+  return status == Status::kOk ? md40_.Wait(SubmitStop()) : status;
+}
+
+template <typename Transport>
+typename BasicMd40<Transport>::CommandHandle BasicMd40<Transport>::Motor::SubmitStop() {
+  return md40_.Submit(kStop, index_, nullptr, 0);
+}
+
+template <typename Transport>
+typename BasicMd40<Transport>::Status BasicMd40<Transport>::Motor::RunSpeed(const int32_t rpm) {
+  const Status status = md40_.Reserve(1);
+  return status == Status::kOk ? md40_.Wait(SubmitRunSpeed(rpm)) : status;
+}
+
+template <typename Transport>
+typename BasicMd40<Transport>::CommandHandle BasicMd40<Transport>::Motor::SubmitRunSpeed(const int32_t rpm) {
+  return md40_.Submit(kRunSpeed, index_, &rpm, sizeof(rpm));
+}
+
+template <typename Transport>
+typename BasicMd40<Transport>::Status BasicMd40<Transport>::Motor::RunPwmDuty(const int16_t pwm_duty) {
+  const Status status = md40_.Reserve(1);
+  return status == Status::kOk ? md40_.Wait(SubmitRunPwmDuty(pwm_duty)) : status;
+}
+
+template <typename Transport>
+typename BasicMd40<Transport>::CommandHandle BasicMd40<Transport>::Motor::SubmitRunPwmDuty(const int16_t pwm_duty) {
+  return md40_.Submit(kRunPwmDuty, index_, &pwm_duty, sizeof(pwm_duty));
+}
+
+template <typename Transport>
+typename BasicMd40<Transport>::Status BasicMd40<Transport>::Motor::MoveTo(const int32_t position, const int32_t speed) {
+  const Status status = md40_.Reserve(1);
+  return status == Status::kOk ? md40_.Wait(SubmitMoveTo(position, speed)) : status;
+}
+
+template <typename Transport>
+typename BasicMd40<Transport>::CommandHandle BasicMd40<Transport>::Motor::SubmitMoveTo(const int32_t position, const int32_t speed) {
+  const int32_t data[] = {position, speed};
+  return md40_.Submit(kMoveTo, index_, data, sizeof(data));
+}
+
+template <typename Transport>
+typename BasicMd40<Transport>::Status BasicMd40<Transport>::Motor::Move(const int32_t offset, const int32_t speed) {
+  const Status status = md40_.Reserve(1);
+  return status == Status::kOk ? md40_.Wait(SubmitMove(offset, speed)) : status;
+}
+
+template <typename Transport>
+typename BasicMd40<Transport>::CommandHandle BasicMd40<Transport>::Motor::SubmitMove(const int32_t offset, const int32_t speed) {
+  const int32_t data[] = {offset, speed};
+  return md40_.Submit(kMove, index_, data, sizeof(data));
+}
+
+template <typename Transport>
+typename BasicMd40<Transport>::Status BasicMd40<Transport>::Motor::ReachedBy(const uint32_t deadline_us, bool &reached) {
+  reached = false;
+  const uint32_t now = md40_.transport_.Micros();
+  const bool expired = static_cast<int32_t>(now - deadline_us) >= 0;
+  if (!arrival_check_due_ && static_cast<int32_t>(now - next_arrival_check_time_) < 0) {
+    return expired ? Status::kTimeout : Status::kOk;
+  }
+
+  // Until the move has left the command queue the state still belongs to whatever ran before it, possibly an earlier move that has arrived.
+  if (static_cast<int16_t>(md40_.finished_sequence_ - move_sequence_) < 0) {
+    return expired ? Status::kTimeout : Status::kOk;
+  }
+
+  uint8_t data[kPosition + sizeof(int32_t) - kState] = {0};
+  const Status status = md40_.ReadLatchedRegisters(kState + index_ * kMotorStateOffset, data, sizeof(data));
+  if (status != Status::kOk) {
+    return status;
+  }
+
+  if (static_cast<State>(data[0]) == State::kReachedPosition) {
+    reached = true;
+    arrival_check_due_ = true;
+    return Status::kOk;
+  }
+
+  if (expired) {
+    arrival_check_due_ = true;
+    return Status::kTimeout;
+  }
+
+  // Degrees per second is rpm * 6, so a degree takes 1000000 / 6 / rpm microseconds. Checking again after half the predicted remaining time
+  // halves the error of every prediction, and the commanded speed is the fastest the motor goes, so the checks never start late.
+  float remaining_us = 0;
+  const int32_t speed = move_speed_ < 0 ? -move_speed_ : move_speed_;
+  if (move_type_ == kMoveTo && speed > 0) {
+    int32_t position = 0;
+    memcpy(&position, data + (kPosition - kState), sizeof(position));
+    const int32_t distance = move_value_ > position ? move_value_ - position : position - move_value_;
+    remaining_us = distance * (1000000.0f / 6) / speed;
+  } else if (move_type_ == kMove && speed > 0) {
+    const int32_t distance = move_value_ < 0 ? -move_value_ : move_value_;
+    remaining_us = distance * (1000000.0f / 6) / speed - (now - move_submit_time_);
+  }
+
+  // A slow long move can be hours away, more than a uint32_t holds, so clamp to the deadline before converting.
+  const uint32_t until_deadline_us = deadline_us - now;
+  if (remaining_us > until_deadline_us) {
+    remaining_us = until_deadline_us;
+  } else if (remaining_us < 0) {
+    remaining_us = 0;
+  }
+  uint32_t wait_us = static_cast<uint32_t>(remaining_us) / 2;
+  if (wait_us < kArrivalPollIntervalUs) {
+    wait_us = kArrivalPollIntervalUs;
+  }
+  if (wait_us > until_deadline_us) {
+    wait_us = until_deadline_us;
+  }
+  next_arrival_check_time_ = now + wait_us;
+  arrival_check_due_ = false;
+  return Status::kOk;
+}
+
+template <typename Transport>
+typename BasicMd40<Transport>::Status BasicMd40<Transport>::Motor::WaitUntilReached(const uint32_t deadline_us) {
+  Status status = md40_.Flush();
+  if (status != Status::kOk) {
+    return status;
+  }
+
+  while (true) {
+    bool reached = false;
+    status = ReachedBy(deadline_us, reached);
+    if (status != Status::kOk || reached) {
+      return status;
+    }
+
+    const int32_t wait_us = static_cast<int32_t>(next_arrival_check_time_ - md40_.transport_.Micros());
+    if (wait_us > 0) {
+      md40_.transport_.DelayMicroseconds(wait_us);
+    }
+  }
+}
+
+template <typename Transport>
+void BasicMd40<Transport>::Motor::NoteCommand(const uint8_t type, const uint8_t *param, const uint16_t sequence) {
+  if (type == kMoveTo || type == kMove) {
+    move_type_ = type;
+    memcpy(&move_value_, param, sizeof(move_value_));
+    memcpy(&move_speed_, param + sizeof(move_value_), sizeof(move_speed_));
+    move_submit_time_ = md40_.transport_.Micros();
+    move_sequence_ = sequence;
+    arrival_check_due_ = true;
+  } else if (type == kReset || type == kStop || type == kRunPwmDuty || type == kRunSpeed) {
+    move_type_ = 0;
+    move_sequence_ = sequence;
+    arrival_check_due_ = true;
+  }
+}
+
+template <typename Transport>
+typename BasicMd40<Transport>::Motor::State BasicMd40<Transport>::Motor::state() {
+  uint8_t data = 0;
+  md40_.ReadLatchedRegisters(kState + index_ * kMotorStateOffset, &data, sizeof(data));
+  return static_cast<State>(data);
+}
+
+template <typename Transport>
+int32_t BasicMd40<Transport>::Motor::speed() {
+  int32_t data = 0;
+  md40_.ReadLatchedRegisters(kSpeed + index_ * kMotorStateOffset, &data, sizeof(data));
+  return data;
+}
+
+template <typename Transport>
+int32_t BasicMd40<Transport>::Motor::position() {
+  int32_t data = 0;
+  md40_.ReadLatchedRegisters(kPosition + index_ * kMotorStateOffset, &data, sizeof(data));
+  return data;
+}
+
+template <typename Transport>
+int32_t BasicMd40<Transport>::Motor::pulse_count() {
+  int32_t data = 0;
+  md40_.ReadLatchedRegisters(kPulseCount + index_ * kMotorStateOffset, &data, sizeof(data));
+  return data;
+}
+
+template <typename Transport>
+int16_t BasicMd40<Transport>::Motor::pwm_duty() {
+  int16_t data = 0;
+  md40_.ReadLatchedRegisters(kPwmDuty + index_ * kMotorStateOffset, &data, sizeof(data));
+  return data;
+}
+
+template <typename Transport>
+void BasicMd40<Transport>::Motor::set_config_cache_enabled(const bool enabled) {
+  config_cache_enabled_ = enabled;
+  cache_valid_ = 0;
+}
+
+template <typename Transport>
+bool BasicMd40<Transport>::Motor::config_cache_enabled() const {
+  return config_cache_enabled_;
+}
+
+template <typename Transport>
+void BasicMd40<Transport>::Motor::Invalidate() {
+  cache_valid_ = 0;
+}
+
+template <typename Transport>
+typename BasicMd40<Transport>::Status BasicMd40<Transport>::Motor::Refresh() {
+  cache_valid_ = 0;
+
+  uint16_t data[kPidGainNum] = {0};
+  const Status status = md40_.ReadRegisters(kSpeedP + index_ * kMotorStateOffset, data, sizeof(data));
+  if (status == Status::kOk && config_cache_enabled_) {
+    memcpy(pid_gain_cache_, data, sizeof(pid_gain_cache_));
+    cache_valid_ = kPidGainsCached;
+  }
+  return status;
+}
+
+template <typename Transport>
+float BasicMd40<Transport>::Motor::ReadPidGain(const uint8_t slot) {
+  if (config_cache_enabled_ && (cache_valid_ & (1 << slot))) {
+    return pid_gain_cache_[slot] / 100.0f;
+  }
+
+  uint16_t data = 0;
+  if (md40_.ReadRegisters(kSpeedP + slot * sizeof(data) + index_ * kMotorStateOffset, &data, sizeof(data)) == Status::kOk && config_cache_enabled_) {
+    pid_gain_cache_[slot] = data;
+    cache_valid_ |= 1 << slot;
+  }
+  return data / 100.0f;
+}
+
+template <typename Transport>
+typename BasicMd40<Transport>::CommandHandle BasicMd40<Transport>::Motor::SubmitPidGain(const uint8_t slot, const float value) {
+  return SubmitPidGainRegister(slot, md40_internal::PidGainToRegister(value));
+}
+
+template <typename Transport>
+typename BasicMd40<Transport>::CommandHandle BasicMd40<Transport>::Motor::SubmitPidGainRegister(const uint8_t slot, const uint16_t value) {
+  if (config_cache_enabled_ && (cache_valid_ & (1 << slot)) && pid_gain_cache_[slot] == value) {
+    return CommandHandle();
+  }
+
+  // A command turned away by a full queue never reaches the device, so the cache has to keep the old value for the retry to go out.
+  const CommandHandle handle = md40_.Submit(kSetSpeedPidP + slot, index_, &value, sizeof(value));
+  if (config_cache_enabled_ && !handle.rejected()) {
+    pid_gain_cache_[slot] = value;
+    cache_valid_ |= 1 << slot;
+  }
+  return handle;
+}
+
+template <typename Transport>
+typename BasicMd40<Transport>::CommandHandle BasicMd40<Transport>::Motor::SubmitSetup(const uint8_t *data, const uint8_t length) {
+  uint8_t setup[kSetupLength] = {0};
+  memcpy(setup, data, length);
+  if (config_cache_enabled_ && (cache_valid_ & kSetupCached) && memcmp(setup, setup_cache_, sizeof(setup)) == 0) {
+    return CommandHandle();
+  }
+
+  const CommandHandle handle = md40_.Submit(kSetup, index_, data, length);
+  if (config_cache_enabled_ && !handle.rejected()) {
+    memcpy(setup_cache_, setup, sizeof(setup_cache_));
+    // The firmware may reinitialize the PID gains when the mode changes, so only the mode stays cached.
+    cache_valid_ = kSetupCached;
+  }
+  return handle;
+}
+
+template <typename Transport>
+typename BasicMd40<Transport>::Motor::Snapshot BasicMd40<Transport>::Motor::ReadSnapshot() {
+  uint8_t data[kSnapshotLength] = {0};
+  md40_.ReadLatchedRegisters(kState + index_ * kMotorStateOffset, data, sizeof(data));
+
+  Snapshot snapshot;
+  snapshot.state = static_cast<State>(data[0]);
+  memcpy(&snapshot.speed, data + (kSpeed - kState), sizeof(snapshot.speed));
+  memcpy(&snapshot.position, data + (kPosition - kState), sizeof(snapshot.position));
+  memcpy(&snapshot.pulse_count, data + (kPulseCount - kState), sizeof(snapshot.pulse_count));
+  memcpy(&snapshot.pwm_duty, data + (kPwmDuty - kState), sizeof(snapshot.pwm_duty));
+  return snapshot;
+}
+
+template <typename Transport>
+void BasicMd40<Transport>::ConfigProfile::SetEncoderMode(const uint8_t index,
+                                                         const uint16_t ppr,
+                                                         const uint16_t reduction_ratio,
+                                                         const typename Motor::PhaseRelation phase_relation) {
+  EM_CHECK_LT(index, kMotorNum);
+  memcpy(setups_[index], &ppr, sizeof(ppr));
+  memcpy(setups_[index] + sizeof(ppr), &reduction_ratio, sizeof(reduction_ratio));
+  setups_[index][sizeof(ppr) + sizeof(reduction_ratio)] = static_cast<uint8_t>(phase_relation);
+  mode_mask_ |= 1 << index;
+}
+
+template <typename Transport>
+void BasicMd40<Transport>::ConfigProfile::SetDcMode(const uint8_t index) {
+  EM_CHECK_LT(index, kMotorNum);
+  memset(setups_[index], 0, sizeof(setups_[index]));
+  mode_mask_ |= 1 << index;
+}
+
+template <typename Transport>
+void BasicMd40<Transport>::ConfigProfile::SetPidGains(const uint8_t index, const typename Motor::PidGains &gains) {
+  EM_CHECK_LT(index, kMotorNum);
+  const float values[Motor::kPidGainNum] = {gains.speed_p, gains.speed_i, gains.speed_d, gains.position_p, gains.position_i, gains.position_d};
+  for (uint8_t slot = 0; slot < Motor::kPidGainNum; slot++) {
+    pid_gains_[index][slot] = md40_internal::PidGainToRegister(values[slot]);
+  }
+  pid_gain_mask_ |= 1 << index;
+}
+
+template <typename Transport>
+typename BasicMd40<Transport>::Motor::PidGains BasicMd40<Transport>::ConfigProfile::pid_gains(const uint8_t index) const {
+  EM_CHECK_LT(index, kMotorNum);
+  typename Motor::PidGains gains;
+  gains.speed_p = pid_gains_[index][0] / 100.0f;
+  gains.speed_i = pid_gains_[index][1] / 100.0f;
+  gains.speed_d = pid_gains_[index][2] / 100.0f;
+  gains.position_p = pid_gains_[index][3] / 100.0f;
+  gains.position_i = pid_gains_[index][4] / 100.0f;
+  gains.position_d = pid_gains_[index][5] / 100.0f;
+  return gains;
+}
+
+template <typename Transport>
+bool BasicMd40<Transport>::ConfigProfile::has_mode(const uint8_t index) const {
+  EM_CHECK_LT(index, kMotorNum);
+  return mode_mask_ & (1 << index);
+}
+
+template <typename Transport>
+bool BasicMd40<Transport>::ConfigProfile::has_pid_gains(const uint8_t index) const {
+  EM_CHECK_LT(index, kMotorNum);
+  return pid_gain_mask_ & (1 << index);
+}
+
+template <typename Transport>
+void BasicMd40<Transport>::ConfigProfile::Serialize(uint8_t (&data)[kSerializedLength]) const {
+  uint8_t *out = data;
+  *out++ = kTag;
+  *out++ = kVersion;
+  *out++ = mode_mask_;
+  *out++ = pid_gain_mask_;
+  for (uint8_t i = 0; i < kMotorNum; i++) {
+    memcpy(out, setups_[i], sizeof(setups_[i]));
+    out += sizeof(setups_[i]);
+    memcpy(out, pid_gains_[i], sizeof(pid_gains_[i]));
+    out += sizeof(pid_gains_[i]);
+  }
+  *out = md40_internal::Crc8(data, kSerializedLength - 1);
+}
+
+template <typename Transport>
+bool BasicMd40<Transport>::ConfigProfile::Deserialize(const uint8_t (&data)[kSerializedLength]) {
+  if (data[0] != kTag || data[1] != kVersion || data[kSerializedLength - 1] != md40_internal::Crc8(data, kSerializedLength - 1)) {
+    return false;
+  }
+
+  const uint8_t *in = data + 2;
+  mode_mask_ = *in++;
+  pid_gain_mask_ = *in++;
+  for (uint8_t i = 0; i < kMotorNum; i++) {
+    memcpy(setups_[i], in, sizeof(setups_[i]));
+    in += sizeof(setups_[i]);
+    memcpy(pid_gains_[i], in, sizeof(pid_gains_[i]));
+    in += sizeof(pid_gains_[i]);
+  }
+  return true;
+}
+
+template <typename Transport>
+template <typename Store>
+bool BasicMd40<Transport>::ConfigProfile::Save(Store &store) const {
+  uint8_t data[kSerializedLength] = {0};
+  Serialize(data);
+  return store.Write(data, sizeof(data));
+}
+
+template <typename Transport>
+template <typename Store>
+bool BasicMd40<Transport>::ConfigProfile::Load(Store &store) {
+  uint8_t data[kSerializedLength] = {0};
+  return store.Read(data, sizeof(data)) && Deserialize(data);
+}
+
+template <typename Transport>
+BasicMd40<Transport>::ReadPlan::ReadPlan(BasicMd40 &md40, const uint8_t (&fields)[kMotorNum]) : md40_(md40) {
+  for (uint8_t i = 0; i < kMotorNum; i++) {
+    fields_[i] = fields[i] & kFieldAll;
+    for (uint8_t f = 0; f < kFieldNum; f++) {
+      if (fields_[i] & (1 << f)) {
+        AddRange(kFieldLayouts[f].address + i * kMotorStateOffset, kFieldLayouts[f].length);
+      }
+    }
+  }
+}
+
+template <typename Transport>
+void BasicMd40<Transport>::ReadPlan::AddRange(const uint8_t address, const uint8_t length) {
+  if (segment_num_ > 0) {
+    Segment &last = segments_[segment_num_ - 1];
+    const uint8_t end = last.address + last.length;
+    if (address - end <= kMaxMergeGap && address + length - last.address <= Transport::kBufferLength) {
+      last.length = address + length - last.address;
+      return;
+    }
+  }
+
+  segments_[segment_num_].address = address;
+  segments_[segment_num_].length = length;
+  segment_num_++;
+}
+
+template <typename Transport>
+typename BasicMd40<Transport>::Status BasicMd40<Transport>::ReadPlan::Execute(typename Motor::Snapshot (&snapshots)[kMotorNum]) {
+  for (uint8_t i = 0; i < kMotorNum; i++) {
+    if (fields_[i] == 0) {
+      continue;
+    }
+
+    const uint8_t latch = 0;
+    const Status status = md40_.WriteRegisters(kState + i * kMotorStateOffset, &latch, sizeof(latch), true);
+    if (status != Status::kOk) {
+      return status;
+    }
+  }
+
+  for (uint8_t s = 0; s < segment_num_; s++) {
+    const Segment &segment = segments_[s];
+
+    uint8_t data[Transport::kBufferLength] = {0};
+    const Status status = md40_.ReadRegisters(segment.address, data, segment.length);
+    if (status != Status::kOk) {
+      return status;
+    }
+
+    for (uint8_t i = 0; i < kMotorNum; i++) {
+      for (uint8_t f = 0; f < kFieldNum; f++) {
+        const FieldLayout &layout = kFieldLayouts[f];
+        const uint8_t address = layout.address + i * kMotorStateOffset;
+        if ((fields_[i] & (1 << f)) && address >= segment.address && address + layout.length <= segment.address + segment.length) {
+          memcpy(FieldPointer(snapshots[i], 1 << f), data + (address - segment.address), layout.length);
+        }
+      }
+    }
+  }
+
+  return Status::kOk;
+}
+
+template <typename Transport>
+uint8_t BasicMd40<Transport>::ReadPlan::transaction_count() const {
+  uint8_t count = segment_num_ * 2;
+  for (const auto fields : fields_) {
+    if (fields != 0) {
+      count++;
+    }
+  }
+  return count;
+}
+
+template <typename Transport>
+void *BasicMd40<Transport>::ReadPlan::FieldPointer(typename Motor::Snapshot &snapshot, const uint8_t field) {
+  switch (field) {
+    case kFieldState:
+      return &snapshot.state;
+    case kFieldSpeed:
+      return &snapshot.speed;
+    case kFieldPosition:
+      return &snapshot.position;
+    case kFieldPulseCount:
+      return &snapshot.pulse_count;
+    default:
+      return &snapshot.pwm_duty;
+  }
+}
+
+template <typename Transport>
+constexpr uint8_t BasicMd40<Transport>::MotorGroup::kAllMotors;
+
+template <typename Transport>
+BasicMd40<Transport>::MotorGroup::MotorGroup(BasicMd40 &md40, const uint8_t motors) : md40_(md40), motors_(motors & kAllMotors) {
+}
+
+template <typename Transport>
+typename BasicMd40<Transport>::Status BasicMd40<Transport>::MotorGroup::RunSpeed(const int32_t (&rpm)[kMotorNum]) {
+  return Fire(kRunSpeed, rpm, sizeof(rpm[0]));
+}
+
+template <typename Transport>
+typename BasicMd40<Transport>::Status BasicMd40<Transport>::MotorGroup::RunPwmDuty(const int16_t (&pwm_duty)[kMotorNum]) {
+  return Fire(kRunPwmDuty, pwm_duty, sizeof(pwm_duty[0]));
+}
+
+template <typename Transport>
+typename BasicMd40<Transport>::Status BasicMd40<Transport>::MotorGroup::MoveTo(const int32_t (&positions)[kMotorNum],
+                                                                               const int32_t (&speeds)[kMotorNum]) {
+  int32_t data[kMotorNum][2] = {{0}};
+  for (uint8_t i = 0; i < kMotorNum; i++) {
+    data[i][0] = positions[i];
+    data[i][1] = speeds[i];
+  }
+  return Fire(kMoveTo, data, sizeof(data[0]));
+}
+
+template <typename Transport>
+typename BasicMd40<Transport>::Status BasicMd40<Transport>::MotorGroup::CoordinatedMoveTo(const int32_t (&positions)[kMotorNum],
+                                                                                          const int32_t speed) {
+  // A queued SubmitPosition or move would change the start positions after they have been read.
+  Status status = md40_.Flush();
+  if (status != Status::kOk) {
+    return status;
+  }
+
+  uint8_t fields[kMotorNum] = {0};
+  FillFields(fields, ReadPlan::kFieldPosition);
+  ReadPlan plan(md40_, fields);
+  typename Motor::Snapshot snapshots[kMotorNum];
+  status = plan.Execute(snapshots);
+  if (status != Status::kOk) {
+    return status;
+  }
+
+  float distances[kMotorNum] = {0};
+  float longest = 0;
+  for (uint8_t i = 0; i < kMotorNum; i++) {
+    if (fields[i] != 0) {
+      const float distance = static_cast<float>(positions[i]) - static_cast<float>(snapshots[i].position);
+      distances[i] = distance < 0 ? -distance : distance;
+      longest = distances[i] > longest ? distances[i] : longest;
+    }
+  }
+
+  const int32_t top_speed = speed < 0 ? -speed : speed;
+  int32_t data[kMotorNum][2] = {{0}};
+  for (uint8_t i = 0; i < kMotorNum; i++) {
+    data[i][0] = positions[i];
+    data[i][1] = longest > 0 ? static_cast<int32_t>(top_speed * distances[i] / longest + 0.5f) : top_speed;
+    // A speed of 0 would never arrive, a short move at the slowest speed is closer to the others than that.
+    if (data[i][1] == 0) {
+      data[i][1] = 1;
+    }
+  }
+  return Fire(kMoveTo, data, sizeof(data[0]));
+}
+
+template <typename Transport>
+typename BasicMd40<Transport>::Status BasicMd40<Transport>::MotorGroup::ReadAllReached(bool &reached) {
+  reached = false;
+  uint8_t fields[kMotorNum] = {0};
+  FillFields(fields, ReadPlan::kFieldState);
+  ReadPlan plan(md40_, fields);
+  typename Motor::Snapshot snapshots[kMotorNum];
+  const Status status = plan.Execute(snapshots);
+  if (status != Status::kOk) {
+    return status;
+  }
+
+  reached = true;
+  for (uint8_t i = 0; i < kMotorNum; i++) {
+    if (fields[i] != 0 && snapshots[i].state != Motor::State::kReachedPosition) {
+      reached = false;
+    }
+  }
+  return Status::kOk;
+}
+
+template <typename Transport>
+typename BasicMd40<Transport>::Status BasicMd40<Transport>::MotorGroup::Stop() {
+  return Fire(kStop, nullptr, 0);
+}
+
+template <typename Transport>
+uint32_t BasicMd40<Transport>::MotorGroup::start_skew_us() const {
+  return start_skew_us_;
+}
+
+template <typename Transport>
+uint32_t BasicMd40<Transport>::MotorGroup::start_offset_us(const uint8_t index) const {
+  EM_CHECK_LT(index, kMotorNum);
+  return start_offsets_us_[index];
+}
+
+template <typename Transport>
+void BasicMd40<Transport>::MotorGroup::FillFields(uint8_t (&fields)[kMotorNum], const uint8_t field) const {
+  for (uint8_t i = 0; i < kMotorNum; i++) {
+    fields[i] = (motors_ & (1 << i)) ? field : 0;
+  }
+}
+
+// Bypasses the command queue: once the queue is drained the mailbox is driven directly, so nothing but the bus and the firmware's execution
+// time separates two commands.
+template <typename Transport>
+typename BasicMd40<Transport>::Status BasicMd40<Transport>::MotorGroup::Fire(const uint8_t type, const void *params, const uint8_t param_length) {
+  Status status = md40_.Flush();
+  if (status != Status::kOk) {
+    return status;
+  }
+
+  // The queue is empty, so the group takes one sequence number that is finished at once: observers of submitted_sequence_ such as the event
+  // dispatcher see it like any other command, and no handle is affected.
+  md40_.submitted_sequence_++;
+  md40_.finished_sequence_ = md40_.submitted_sequence_;
+
+  Command commands[kMotorNum];
+  uint8_t command_num = 0;
+  for (uint8_t i = 0; i < kMotorNum; i++) {
+    start_offsets_us_[i] = 0;
+    if ((motors_ & (1 << i)) == 0) {
+      continue;
+    }
+    Command &command = commands[command_num++];
+    command.type = type;
+    command.index = i;
+    command.length = param_length;
+    if (params != nullptr) {
+      memcpy(command.param, static_cast<const uint8_t *>(params) + i * param_length, param_length);
+    }
+    md40_.motors_[i].NoteCommand(type, command.param, md40_.submitted_sequence_);
+  }
+  start_skew_us_ = 0;
+
+  const uint32_t timeout_us = md40_.wait_policy_.timeout_us;
+  uint32_t first_start_time = 0;
+  bool emptied = md40_.mailbox_emptied_;
+  // One more round than there are commands: like a queued command, the group returns once the last command has been executed.
+  for (uint8_t n = 0; n <= command_num; n++) {
+    const uint32_t wait_start_time = md40_.transport_.Micros();
+    while (!emptied) {
+      status = md40_.ReadCommandEmptied(emptied);
+      if (status != Status::kOk) {
+        md40_.mailbox_emptied_ = false;
+        return status;
+      }
+      if (!emptied && timeout_us > 0 && md40_.transport_.Micros() - wait_start_time >= timeout_us) {
+        md40_.mailbox_emptied_ = false;
+        md40_.last_status_ = Status::kTimeout;
+        return Status::kTimeout;
+      }
+    }
+    if (n == command_num) {
+      break;
+    }
+
+    emptied = false;
+    status = md40_.WriteCommand(commands[n]);
+    if (status == Status::kOk && !md40_.fused_command_) {
+      const uint8_t execute = 0x01;
+      status = md40_.WriteRegisters(kCommandExecute, &execute, sizeof(execute), false);
+    }
+    if (status != Status::kOk) {
+      md40_.mailbox_emptied_ = false;
+      return status;
+    }
+
+    const uint32_t start_time = md40_.transport_.Micros();
+    if (n == 0) {
+      first_start_time = start_time;
+    }
+    start_offsets_us_[commands[n].index] = start_time - first_start_time;
+    start_skew_us_ = start_time - first_start_time;
+  }
+
+  md40_.mailbox_emptied_ = true;
+  return Status::kOk;
+}
+}  // namespace em
+#endif
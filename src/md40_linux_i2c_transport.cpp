@@ -0,0 +1,247 @@
+/**
+ * @file md40_linux_i2c_transport.cpp
+ */
+
+#include "md40_linux_i2c_transport.h"
+
+#if defined(__linux__) && !defined(ARDUINO)
+
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/i2c-dev.h>
+#include <linux/i2c.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <time.h>
+#include <unistd.h>
+
+namespace em {
+
+namespace {
+constexpr uint8_t kMaxWriteLength = 0xFF;
+
+I2cResult ToI2cResult(const int error) {
+  switch (error) {
+    // ENXIO is the documented code for an unacknowledged address, some adapters (and i2c-stub) report ENODEV instead.
+    case ENXIO:
+    case ENODEV:
+      return I2cResult::kAddressNack;
+    default:
+      return I2cResult::kError;
+  }
+}
+}  // namespace
+
+LinuxI2cBus::~LinuxI2cBus() {
+  Close();
+}
+
+bool LinuxI2cBus::Open(const char *path) {
+  Close();
+
+  fd_ = open(path, O_RDWR);
+  syscall_count_++;
+  if (fd_ < 0) {
+    return false;
+  }
+
+  if (Ioctl(I2C_FUNCS, &functionality_) != I2cResult::kOk) {
+    Close();
+    return false;
+  }
+
+  if (Supports(Method::kI2cRdwr)) {
+    method_ = Method::kI2cRdwr;
+  } else if (Supports(Method::kSmbus)) {
+    method_ = Method::kSmbus;
+  } else {
+    Close();
+    return false;
+  }
+  return true;
+}
+
+void LinuxI2cBus::Close() {
+  if (fd_ >= 0) {
+    close(fd_);
+    syscall_count_++;
+  }
+  fd_ = -1;
+  functionality_ = 0;
+  slave_address_ = -1;
+}
+
+LinuxI2cBus::Method LinuxI2cBus::method() const {
+  return method_;
+}
+
+bool LinuxI2cBus::set_method(const Method method) {
+  if (!Supports(method)) {
+    return false;
+  }
+  method_ = method;
+  return true;
+}
+
+I2cResult LinuxI2cBus::Write(const uint8_t i2c_address, const uint8_t reg, const void *data, const uint8_t length) {
+  if (method_ == Method::kSmbus) {
+    if (length == 0) {
+      return Smbus(i2c_address, I2C_SMBUS_WRITE, reg, I2C_SMBUS_BYTE, nullptr);
+    }
+    if (length > I2C_SMBUS_BLOCK_MAX) {
+      return I2cResult::kError;
+    }
+    i2c_smbus_data block;
+    block.block[0] = length;
+    memcpy(block.block + 1, data, length);
+    return Smbus(i2c_address, I2C_SMBUS_WRITE, reg, I2C_SMBUS_I2C_BLOCK_DATA, &block);
+  }
+
+  if (length >= kMaxWriteLength) {
+    return I2cResult::kError;
+  }
+  uint8_t buffer[kMaxWriteLength] = {reg};
+  memcpy(buffer + 1, data, length);
+  i2c_msg message = {i2c_address, 0, static_cast<uint16_t>(length + 1), buffer};
+  i2c_rdwr_ioctl_data transfer = {&message, 1};
+  transaction_count_++;
+  return Ioctl(I2C_RDWR, &transfer);
+}
+
+I2cResult LinuxI2cBus::WriteRead(const uint8_t i2c_address, const uint8_t reg, void *data, const uint8_t length) {
+  if (method_ == Method::kSmbus) {
+    if (length > I2C_SMBUS_BLOCK_MAX) {
+      return I2cResult::kError;
+    }
+    i2c_smbus_data block;
+    block.block[0] = length;
+    const I2cResult result = Smbus(i2c_address, I2C_SMBUS_READ, reg, I2C_SMBUS_I2C_BLOCK_DATA, &block);
+    if (result == I2cResult::kOk) {
+      memcpy(data, block.block + 1, length);
+    }
+    return result;
+  }
+
+  uint8_t address = reg;
+  i2c_msg messages[] = {
+      {i2c_address, 0, sizeof(address), &address},
+      {i2c_address, I2C_M_RD, length, static_cast<uint8_t *>(data)},
+  };
+  i2c_rdwr_ioctl_data transfer = {messages, 2};
+  transaction_count_++;
+  return Ioctl(I2C_RDWR, &transfer);
+}
+
+I2cResult LinuxI2cBus::Read(const uint8_t i2c_address, void *data, const uint8_t length) {
+  if (method_ == Method::kSmbus) {
+    for (uint8_t i = 0; i < length; i++) {
+      i2c_smbus_data byte;
+      const I2cResult result = Smbus(i2c_address, I2C_SMBUS_READ, 0, I2C_SMBUS_BYTE, &byte);
+      if (result != I2cResult::kOk) {
+        return result;
+      }
+      static_cast<uint8_t *>(data)[i] = byte.byte;
+    }
+    return I2cResult::kOk;
+  }
+
+  i2c_msg message = {i2c_address, I2C_M_RD, length, static_cast<uint8_t *>(data)};
+  i2c_rdwr_ioctl_data transfer = {&message, 1};
+  transaction_count_++;
+  return Ioctl(I2C_RDWR, &transfer);
+}
+
+uint32_t LinuxI2cBus::syscall_count() const {
+  return syscall_count_;
+}
+
+uint32_t LinuxI2cBus::transaction_count() const {
+  return transaction_count_;
+}
+
+void LinuxI2cBus::ResetCounters() {
+  syscall_count_ = 0;
+  transaction_count_ = 0;
+}
+
+bool LinuxI2cBus::Supports(const Method method) const {
+  switch (method) {
+    case Method::kI2cRdwr:
+      return (functionality_ & I2C_FUNC_I2C) != 0;
+    case Method::kSmbus:
+      return (functionality_ & I2C_FUNC_SMBUS_I2C_BLOCK) == I2C_FUNC_SMBUS_I2C_BLOCK;
+    default:
+      return false;
+  }
+}
+
+bool LinuxI2cBus::SelectSlave(const uint8_t i2c_address) {
+  if (slave_address_ == i2c_address) {
+    return true;
+  }
+
+  // I2C_SLAVE takes the address by value, not through a pointer.
+  syscall_count_++;
+  if (fd_ < 0 || ioctl(fd_, I2C_SLAVE, static_cast<unsigned long>(i2c_address)) < 0) {
+    slave_address_ = -1;
+    return false;
+  }
+  slave_address_ = i2c_address;
+  return true;
+}
+
+I2cResult LinuxI2cBus::Ioctl(const unsigned long request, void *argument) {
+  if (fd_ < 0) {
+    return I2cResult::kError;
+  }
+
+  syscall_count_++;
+  if (ioctl(fd_, request, argument) < 0) {
+    return ToI2cResult(errno);
+  }
+  return I2cResult::kOk;
+}
+
+I2cResult LinuxI2cBus::Smbus(const uint8_t i2c_address, const uint8_t read_write, const uint8_t command, const uint32_t size, void *data) {
+  if (!SelectSlave(i2c_address)) {
+    return I2cResult::kError;
+  }
+
+  i2c_smbus_ioctl_data transfer = {read_write, command, size, static_cast<i2c_smbus_data *>(data)};
+  transaction_count_++;
+  return Ioctl(I2C_SMBUS, &transfer);
+}
+
+constexpr uint8_t LinuxI2cTransport::kBufferLength;
+
+LinuxI2cTransport::LinuxI2cTransport(LinuxI2cBus &bus) : bus_(&bus) {
+}
+
+void LinuxI2cTransport::Init() {
+}
+
+I2cResult LinuxI2cTransport::Write(const uint8_t i2c_address, const uint8_t reg, const void *data, const uint8_t length) {
+  return bus_->Write(i2c_address, reg, data, length);
+}
+
+I2cResult LinuxI2cTransport::WriteRead(const uint8_t i2c_address, const uint8_t reg, void *data, const uint8_t length) {
+  return bus_->WriteRead(i2c_address, reg, data, length);
+}
+
+I2cResult LinuxI2cTransport::Read(const uint8_t i2c_address, void *data, const uint8_t length) {
+  return bus_->Read(i2c_address, data, length);
+}
+
+uint32_t LinuxI2cTransport::Micros() {
+  timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return static_cast<uint32_t>(now.tv_sec * 1000000ULL + now.tv_nsec / 1000);
+}
+
+void LinuxI2cTransport::DelayMicroseconds(const uint32_t us) {
+  timespec remaining = {static_cast<time_t>(us / 1000000), static_cast<long>(us % 1000000) * 1000};
+  while (nanosleep(&remaining, &remaining) < 0 && errno == EINTR) {
+  }
+}
+}  // namespace em
+#endif
@@ -0,0 +1,335 @@
+#pragma once
+
+#ifndef _EM_MD40_LINUX_I2C_TRANSPORT_H_
+#define _EM_MD40_LINUX_I2C_TRANSPORT_H_
+
+#if defined(__linux__) && !defined(ARDUINO)
+
+#include "md40_transport.h"
+
+/**
+ * @file md40_linux_i2c_transport.h
+ */
+
+namespace em {
+
+/**
+ * @~Chinese
+ * @class LinuxI2cBus
+ * @brief Linux i2c-dev总线（/dev/i2c-N），用于在Linux单板计算机上直接驱动MD40。
+ * @details 适配器支持时使用 I2C_RDWR ，寄存器地址写入和数据读取通过重复起始条件合并为一次ioctl和一次总线传输；
+ * 只支持SMBus的适配器（例如内核的 i2c-stub 模块）使用 SMBus I2C块读写，同样每次读取只需一次ioctl。
+ */
+/**
+ * @~English
+ * @class LinuxI2cBus
+ * @brief Linux i2c-dev bus (/dev/i2c-N), used to drive the MD40 directly from a Linux single-board computer.
+ * @details When the adapter supports it I2C_RDWR is used, so the register address write and the data read are combined with a repeated start into
+ * one ioctl and one bus transaction. Adapters that only speak SMBus (such as the kernel's i2c-stub module) use SMBus I2C block transfers, which
+ * also need a single ioctl per read.
+ */
+class LinuxI2cBus {
+ public:
+  /**
+   * @~Chinese
+   * @brief 传输方式。
+   */
+  /**
+   * @~English
+   * @brief Transfer method.
+   */
+  enum class Method : uint8_t {
+    /**
+     * @~Chinese
+     * @brief 使用 I2C_RDWR 组合传输。
+     */
+    /**
+     * @~English
+     * @brief Combined transfers with I2C_RDWR.
+     */
+    kI2cRdwr,
+
+    /**
+     * @~Chinese
+     * @brief 使用 SMBus I2C块传输，单次最多32字节。
+     */
+    /**
+     * @~English
+     * @brief SMBus I2C block transfers, at most 32 bytes each.
+     */
+    kSmbus,
+  };
+
+  /**
+   * @~Chinese
+   * @brief 析构函数，关闭设备。
+   */
+  /**
+   * @~English
+   * @brief Destructor, closes the device.
+   */
+  ~LinuxI2cBus();
+
+  /**
+   * @~Chinese
+   * @brief 打开总线设备，并根据适配器的功能选择传输方式，优先使用 @ref Method::kI2cRdwr 。
+   * @param[in] path 设备路径，例如 "/dev/i2c-1"。
+   * @return 成功返回true，设备无法打开或适配器既不支持 I2C_RDWR 也不支持SMBus I2C块传输时返回false。
+   */
+  /**
+   * @~English
+   * @brief Open the bus device and choose the transfer method from the adapter's functionality, preferring @ref Method::kI2cRdwr.
+   * @param[in] path Device path, such as "/dev/i2c-1".
+   * @return True on success, false if the device cannot be opened or the adapter supports neither I2C_RDWR nor SMBus I2C block transfers.
+   */
+  bool Open(const char *path);
+
+  /**
+   * @~Chinese
+   * @brief 关闭总线设备。
+   */
+  /**
+   * @~English
+   * @brief Close the bus device.
+   */
+  void Close();
+
+  /**
+   * @~Chinese
+   * @brief 获取当前的传输方式。
+   * @return 传输方式。
+   */
+  /**
+   * @~English
+   * @brief Get the current transfer method.
+   * @return Transfer method.
+   */
+  Method method() const;
+
+  /**
+   * @~Chinese
+   * @brief 指定传输方式，例如用于对比测试。
+   * @param[in] method 传输方式。
+   * @return 适配器支持该方式时返回true，否则保持原来的方式并返回false。
+   */
+  /**
+   * @~English
+   * @brief Force a transfer method, for example to compare them.
+   * @param[in] method Transfer method.
+   * @return True if the adapter supports the method, otherwise the current method is kept and false is returned.
+   */
+  bool set_method(const Method method);
+
+  /**
+   * @~Chinese
+   * @brief 写入寄存器地址和数据，参见 @ref transport_concept 。
+   * @param[in] i2c_address I2C地址。
+   * @param[in] reg 寄存器地址。
+   * @param[in] data 数据。
+   * @param[in] length 数据长度。
+   * @return 传输结果。
+   */
+  /**
+   * @~English
+   * @brief Write the register address and the data, see @ref transport_concept.
+   * @param[in] i2c_address I2C address.
+   * @param[in] reg Register address.
+   * @param[in] data Data.
+   * @param[in] length Data length.
+   * @return Transfer result.
+   */
+  I2cResult Write(const uint8_t i2c_address, const uint8_t reg, const void *data, const uint8_t length);
+
+  /**
+   * @~Chinese
+   * @brief 写入寄存器地址，然后通过重复起始条件读取数据，只需一次ioctl，参见 @ref transport_concept 。
+   * @param[in] i2c_address I2C地址。
+   * @param[in] reg 寄存器地址。
+   * @param[out] data 数据。
+   * @param[in] length 数据长度。
+   * @return 传输结果。
+   */
+  /**
+   * @~English
+   * @brief Write the register address, then read the data after a repeated start, all in one ioctl, see @ref transport_concept.
+   * @param[in] i2c_address I2C address.
+   * @param[in] reg Register address.
+   * @param[out] data Data.
+   * @param[in] length Data length.
+   * @return Transfer result.
+   */
+  I2cResult WriteRead(const uint8_t i2c_address, const uint8_t reg, void *data, const uint8_t length);
+
+  /**
+   * @~Chinese
+   * @brief 从设备当前的寄存器地址读取数据，参见 @ref transport_concept 。SMBus方式下每个字节需要一次传输。
+   * @param[in] i2c_address I2C地址。
+   * @param[out] data 数据。
+   * @param[in] length 数据长度。
+   * @return 传输结果。
+   */
+  /**
+   * @~English
+   * @brief Read data from the device's current register address, see @ref transport_concept. With SMBus every byte takes one transfer.
+   * @param[in] i2c_address I2C address.
+   * @param[out] data Data.
+   * @param[in] length Data length.
+   * @return Transfer result.
+   */
+  I2cResult Read(const uint8_t i2c_address, void *data, const uint8_t length);
+
+  /**
+   * @~Chinese
+   * @brief 获取已执行的系统调用数，包括选择从机地址的ioctl。
+   * @return 系统调用数。
+   */
+  /**
+   * @~English
+   * @brief Get the number of system calls made, including the ioctls selecting the slave address.
+   * @return Number of system calls.
+   */
+  uint32_t syscall_count() const;
+
+  /**
+   * @~Chinese
+   * @brief 获取总线传输数，一次传输从起始条件开始到停止条件结束，重复起始条件不会开始新的传输。
+   * @return 总线传输数。
+   */
+  /**
+   * @~English
+   * @brief Get the number of bus transactions, each running from a start to a stop condition. A repeated start does not begin a new transaction.
+   * @return Number of bus transactions.
+   */
+  uint32_t transaction_count() const;
+
+  /**
+   * @~Chinese
+   * @brief 清零系统调用数和总线传输数。
+   */
+  /**
+   * @~English
+   * @brief Reset the system call and bus transaction counts to zero.
+   */
+  void ResetCounters();
+
+ private:
+  bool Supports(const Method method) const;
+
+  bool SelectSlave(const uint8_t i2c_address);
+
+  I2cResult Ioctl(const unsigned long request, void *argument);
+
+  I2cResult Smbus(const uint8_t i2c_address, const uint8_t read_write, const uint8_t command, const uint32_t size, void *data);
+
+  int fd_ = -1;
+  unsigned long functionality_ = 0;
+  Method method_ = Method::kI2cRdwr;
+  int slave_address_ = -1;
+  uint32_t syscall_count_ = 0;
+  uint32_t transaction_count_ = 0;
+};
+
+/**
+ * @~Chinese
+ * @class LinuxI2cTransport
+ * @brief 访问 @ref LinuxI2cBus 的传输层，时钟使用 CLOCK_MONOTONIC 。
+ */
+/**
+ * @~English
+ * @class LinuxI2cTransport
+ * @brief Transport accessing a @ref LinuxI2cBus, using CLOCK_MONOTONIC as its clock.
+ */
+class LinuxI2cTransport {
+ public:
+  /**
+   * @~Chinese
+   * @brief 单次读取的最大字节数，受SMBus块传输的限制。
+   */
+  /**
+   * @~English
+   * @brief Maximum number of bytes of one read, limited by SMBus block transfers.
+   */
+  static constexpr uint8_t kBufferLength = 32;
+
+  /**
+   * @~Chinese
+   * @brief 构造函数，可从 LinuxI2cBus 对象隐式转换。
+   * @param[in] bus 总线。
+   */
+  /**
+   * @~English
+   * @brief Constructor, implicitly converting from a LinuxI2cBus object.
+   * @param[in] bus Bus.
+   */
+  LinuxI2cTransport(LinuxI2cBus &bus);
+
+  /**
+   * @~Chinese
+   * @brief 初始化，不做任何事。
+   */
+  /**
+   * @~English
+   * @brief Initialize, does nothing.
+   */
+  void Init();
+
+  /**
+   * @~Chinese
+   * @brief 参见 @ref LinuxI2cBus::Write 。
+   */
+  /**
+   * @~English
+   * @brief See @ref LinuxI2cBus::Write.
+   */
+  I2cResult Write(const uint8_t i2c_address, const uint8_t reg, const void *data, const uint8_t length);
+
+  /**
+   * @~Chinese
+   * @brief 参见 @ref LinuxI2cBus::WriteRead 。
+   */
+  /**
+   * @~English
+   * @brief See @ref LinuxI2cBus::WriteRead.
+   */
+  I2cResult WriteRead(const uint8_t i2c_address, const uint8_t reg, void *data, const uint8_t length);
+
+  /**
+   * @~Chinese
+   * @brief 参见 @ref LinuxI2cBus::Read 。
+   */
+  /**
+   * @~English
+   * @brief See @ref LinuxI2cBus::Read.
+   */
+  I2cResult Read(const uint8_t i2c_address, void *data, const uint8_t length);
+
+  /**
+   * @~Chinese
+   * @brief 获取 CLOCK_MONOTONIC 时钟的微秒数。
+   * @return 微秒数。
+   */
+  /**
+   * @~English
+   * @brief Get the CLOCK_MONOTONIC clock in microseconds.
+   * @return Microseconds.
+   */
+  uint32_t Micros();
+
+  /**
+   * @~Chinese
+   * @brief 休眠指定的微秒数。
+   * @param[in] us 微秒数。
+   */
+  /**
+   * @~English
+   * @brief Sleep for the given number of microseconds.
+   * @param[in] us Microseconds.
+   */
+  void DelayMicroseconds(const uint32_t us);
+
+ private:
+  LinuxI2cBus *bus_ = nullptr;
+};
+}  // namespace em
+#endif
+#endif
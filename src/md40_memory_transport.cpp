@@ -0,0 +1,238 @@
+/**
+ * @file md40_memory_transport.cpp
+ */
+
+#include "md40_memory_transport.h"
+
+#ifndef ARDUINO
+
+namespace em {
+
+namespace {
+constexpr uint8_t kCommandExecute = 0x23;
+
+// A message carries the address byte before its data.
+constexpr uint8_t kAddressByteLength = 1;
+
+// Every byte takes 8 data bits and an acknowledge bit, the start and stop conditions take about one bit time each.
+constexpr uint8_t kBitsPerByte = 9;
+constexpr uint8_t kStartStopBits = 2;
+
+void CopyIn(uint8_t *registers, const uint8_t reg, const uint8_t *data, const uint8_t length) {
+  for (uint8_t i = 0; i < length; i++) {
+    registers[static_cast<uint8_t>(reg + i)] = data[i];
+  }
+}
+
+void CopyOut(const uint8_t *registers, const uint8_t reg, uint8_t *data, const uint8_t length) {
+  for (uint8_t i = 0; i < length; i++) {
+    data[i] = registers[static_cast<uint8_t>(reg + i)];
+  }
+}
+}  // namespace
+
+constexpr uint16_t MemoryBus::Device::kRegisterNum;
+
+MemoryBus::Device::Device(const uint8_t i2c_address) : i2c_address_(i2c_address) {
+}
+
+uint8_t MemoryBus::Device::i2c_address() const {
+  return i2c_address_;
+}
+
+uint8_t *MemoryBus::Device::registers() {
+  return registers_;
+}
+
+void MemoryBus::Device::OnWrite(const uint8_t reg, const uint8_t length) {
+  (void)reg;
+  (void)length;
+}
+
+void MemoryBus::Device::OnRead(const uint8_t reg, const uint8_t length) {
+  (void)reg;
+  (void)length;
+}
+
+uint32_t MemoryBus::Device::now_us() const {
+  return bus_ == nullptr ? 0 : bus_->now_us();
+}
+
+void MemoryBus::Attach(Device &device) {
+  device.bus_ = this;
+  device.next_ = devices_;
+  devices_ = &device;
+}
+
+I2cResult MemoryBus::Write(const uint8_t i2c_address, const uint8_t reg, const void *data, const uint8_t length) {
+  CountMessage(sizeof(reg) + length);
+
+  Device *device = Find(i2c_address);
+  if (device == nullptr) {
+    return I2cResult::kAddressNack;
+  }
+
+  uint8_t byte_index = 0;
+  uint8_t bit_index = 0;
+  if (InjectFault(length, byte_index, bit_index)) {
+    return I2cResult::kError;
+  }
+
+  CopyIn(device->registers_, reg, static_cast<const uint8_t *>(data), length);
+  device->register_pointer_ = reg + length;
+  device->OnWrite(reg, length);
+  return I2cResult::kOk;
+}
+
+I2cResult MemoryBus::WriteRead(const uint8_t i2c_address, const uint8_t reg, void *data, const uint8_t length) {
+  const I2cResult result = Write(i2c_address, reg, nullptr, 0);
+  if (result != I2cResult::kOk) {
+    return result;
+  }
+  return Read(i2c_address, data, length);
+}
+
+I2cResult MemoryBus::Read(const uint8_t i2c_address, void *data, const uint8_t length) {
+  CountMessage(length);
+
+  Device *device = Find(i2c_address);
+  if (device == nullptr) {
+    return I2cResult::kAddressNack;
+  }
+
+  const uint8_t reg = device->register_pointer_;
+  device->OnRead(reg, length);
+  CopyOut(device->registers_, reg, static_cast<uint8_t *>(data), length);
+  device->register_pointer_ = reg + length;
+
+  uint8_t byte_index = 0;
+  uint8_t bit_index = 0;
+  if (InjectFault(length, byte_index, bit_index)) {
+    static_cast<uint8_t *>(data)[byte_index] ^= 1 << bit_index;
+  }
+  return I2cResult::kOk;
+}
+
+uint32_t MemoryBus::now_us() const {
+  return static_cast<uint32_t>(now_ns_ / 1000);
+}
+
+void MemoryBus::Advance(const uint32_t us) {
+  now_ns_ += static_cast<uint64_t>(us) * 1000;
+}
+
+void MemoryBus::set_clock_hz(const uint32_t clock_hz) {
+  clock_hz_ = clock_hz;
+}
+
+uint32_t MemoryBus::clock_hz() const {
+  return clock_hz_;
+}
+
+void MemoryBus::set_fault_injection(const uint32_t max_clock_hz, const uint32_t byte_error_interval) {
+  fault_max_clock_hz_ = max_clock_hz;
+  fault_byte_interval_ = byte_error_interval;
+}
+
+uint32_t MemoryBus::fault_count() const {
+  return fault_count_;
+}
+
+uint32_t MemoryBus::message_count() const {
+  return message_count_;
+}
+
+uint32_t MemoryBus::byte_count() const {
+  return byte_count_;
+}
+
+void MemoryBus::ResetCounters() {
+  message_count_ = 0;
+  byte_count_ = 0;
+}
+
+MemoryBus::Device *MemoryBus::Find(const uint8_t i2c_address) {
+  for (Device *device = devices_; device != nullptr; device = device->next_) {
+    if (device->i2c_address_ == i2c_address) {
+      return device;
+    }
+  }
+  return nullptr;
+}
+
+void MemoryBus::CountMessage(const uint8_t length) {
+  const uint32_t bytes = kAddressByteLength + length;
+  message_count_++;
+  byte_count_ += bytes;
+  if (clock_hz_ > 0) {
+    now_ns_ += (bytes * kBitsPerByte + kStartStopBits) * 1000000000ULL / clock_hz_;
+  }
+}
+
+bool MemoryBus::InjectFault(const uint8_t length, uint8_t &byte_index, uint8_t &bit_index) {
+  if (fault_max_clock_hz_ == 0 || fault_byte_interval_ == 0 || clock_hz_ <= fault_max_clock_hz_) {
+    return false;
+  }
+
+  for (uint8_t i = 0; i < length; i++) {
+    // xorshift32, a fixed seed keeps the injected errors reproducible.
+    fault_random_state_ ^= fault_random_state_ << 13;
+    fault_random_state_ ^= fault_random_state_ >> 17;
+    fault_random_state_ ^= fault_random_state_ << 5;
+    if (fault_random_state_ % fault_byte_interval_ == 0) {
+      byte_index = i;
+      bit_index = (fault_random_state_ >> 24) % 8;
+      fault_count_++;
+      return true;
+    }
+  }
+  return false;
+}
+
+constexpr uint8_t MemoryTransport::kBufferLength;
+
+MemoryTransport::MemoryTransport(MemoryBus &bus) : bus_(&bus) {
+}
+
+void MemoryTransport::Init() {
+}
+
+I2cResult MemoryTransport::Write(const uint8_t i2c_address, const uint8_t reg, const void *data, const uint8_t length) {
+  return bus_->Write(i2c_address, reg, data, length);
+}
+
+I2cResult MemoryTransport::WriteRead(const uint8_t i2c_address, const uint8_t reg, void *data, const uint8_t length) {
+  return bus_->WriteRead(i2c_address, reg, data, length);
+}
+
+I2cResult MemoryTransport::Read(const uint8_t i2c_address, void *data, const uint8_t length) {
+  return bus_->Read(i2c_address, data, length);
+}
+
+uint32_t MemoryTransport::Micros() {
+  return bus_->now_us();
+}
+
+void MemoryTransport::DelayMicroseconds(const uint32_t us) {
+  bus_->Advance(us);
+}
+
+void MemoryTransport::SetClock(const uint32_t clock_hz) {
+  bus_->set_clock_hz(clock_hz);
+}
+
+Md40MemoryDevice::Md40MemoryDevice(const uint8_t i2c_address) : Device(i2c_address) {
+}
+
+uint32_t Md40MemoryDevice::command_count() const {
+  return command_count_;
+}
+
+void Md40MemoryDevice::OnWrite(const uint8_t reg, const uint8_t length) {
+  if (reg <= kCommandExecute && kCommandExecute - reg < length && registers_[kCommandExecute] != 0) {
+    registers_[kCommandExecute] = 0;
+    command_count_++;
+  }
+}
+}  // namespace em
+#endif
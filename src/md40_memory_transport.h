@@ -0,0 +1,524 @@
+#pragma once
+
+#ifndef _EM_MD40_MEMORY_TRANSPORT_H_
+#define _EM_MD40_MEMORY_TRANSPORT_H_
+
+#ifndef ARDUINO
+
+#include "md40_transport.h"
+
+/**
+ * @file md40_memory_transport.h
+ */
+
+namespace em {
+
+/**
+ * @~Chinese
+ * @class MemoryBus
+ * @brief 内存中的I2C总线，用于在主机上不依赖硬件运行和测试驱动。
+ * @details 总线上挂接若干 @ref Device ，每个设备是一个256字节的寄存器文件。总线带有一个虚拟时钟，每条消息按总线时钟频率计算的传输时间
+ * 以及 @ref Advance 使其前进。总线还统计消息数和字节数。
+ */
+/**
+ * @~English
+ * @class MemoryBus
+ * @brief In-memory I2C bus used to run and test the driver on the host without hardware.
+ * @details A number of @ref Device objects are attached to the bus, each one a 256-byte register file. The bus has a virtual clock that moves
+ * by the transfer time of every message at the bus clock rate, and by @ref Advance. The bus also counts the messages and bytes.
+ */
+class MemoryBus {
+ public:
+  /**
+   * @~Chinese
+   * @class Device
+   * @brief 挂接在 @ref MemoryBus 上的设备，默认行为是一个普通的寄存器文件，派生类可以重写读写回调来模拟设备行为。
+   */
+  /**
+   * @~English
+   * @class Device
+   * @brief Device attached to a @ref MemoryBus. It behaves as a plain register file by default, derived classes override the read and write
+   * hooks to model the device.
+   */
+  class Device {
+   public:
+    /**
+     * @~Chinese
+     * @brief 寄存器数量。
+     */
+    /**
+     * @~English
+     * @brief Number of registers.
+     */
+    static constexpr uint16_t kRegisterNum = 256;
+
+    /**
+     * @~Chinese
+     * @brief 构造函数。
+     * @param[in] i2c_address I2C地址。
+     */
+    /**
+     * @~English
+     * @brief Constructor.
+     * @param[in] i2c_address I2C address.
+     */
+    explicit Device(const uint8_t i2c_address);
+
+    /**
+     * @~Chinese
+     * @brief 析构函数。
+     */
+    /**
+     * @~English
+     * @brief Destructor.
+     */
+    virtual ~Device() = default;
+
+    /**
+     * @~Chinese
+     * @brief 获取I2C地址。
+     * @return I2C地址。
+     */
+    /**
+     * @~English
+     * @brief Get the I2C address.
+     * @return I2C address.
+     */
+    uint8_t i2c_address() const;
+
+    /**
+     * @~Chinese
+     * @brief 获取寄存器文件，可用于预置或检查寄存器的值。
+     * @return 长度为 @ref kRegisterNum 的寄存器数组。
+     */
+    /**
+     * @~English
+     * @brief Get the register file, used to preset or inspect register values.
+     * @return Register array of @ref kRegisterNum bytes.
+     */
+    uint8_t *registers();
+
+   protected:
+    /**
+     * @~Chinese
+     * @brief 数据写入寄存器之后调用，默认不做任何事。
+     * @param[in] reg 起始寄存器地址。
+     * @param[in] length 写入的字节数，只写入寄存器地址时为0。
+     */
+    /**
+     * @~English
+     * @brief Called after data has been written to the registers, does nothing by default.
+     * @param[in] reg First register address.
+     * @param[in] length Number of bytes written, 0 when only the register address was written.
+     */
+    virtual void OnWrite(const uint8_t reg, const uint8_t length);
+
+    /**
+     * @~Chinese
+     * @brief 从寄存器读取数据之前调用，默认不做任何事。
+     * @param[in] reg 起始寄存器地址。
+     * @param[in] length 读取的字节数。
+     */
+    /**
+     * @~English
+     * @brief Called before data is read from the registers, does nothing by default.
+     * @param[in] reg First register address.
+     * @param[in] length Number of bytes to read.
+     */
+    virtual void OnRead(const uint8_t reg, const uint8_t length);
+
+    /**
+     * @~Chinese
+     * @brief 获取所在总线虚拟时钟的当前时间，未挂接时返回0。
+     * @return 微秒数。
+     */
+    /**
+     * @~English
+     * @brief Get the current time of the virtual clock of the bus the device is attached to, 0 when not attached.
+     * @return Microseconds.
+     */
+    uint32_t now_us() const;
+
+    /**
+     * @~Chinese
+     * @brief 寄存器文件。
+     */
+    /**
+     * @~English
+     * @brief Register file.
+     */
+    uint8_t registers_[kRegisterNum] = {0};
+
+   private:
+    friend class MemoryBus;
+
+    Device(const Device &) = delete;
+    Device &operator=(const Device &) = delete;
+
+    const uint8_t i2c_address_ = 0;
+    uint8_t register_pointer_ = 0;
+    const MemoryBus *bus_ = nullptr;
+    Device *next_ = nullptr;
+  };
+
+  /**
+   * @~Chinese
+   * @brief 将设备挂接到总线上。设备对象的生命周期必须长于总线。
+   * @param[in] device 设备。
+   */
+  /**
+   * @~English
+   * @brief Attach a device to the bus. The device must outlive the bus.
+   * @param[in] device Device.
+   */
+  void Attach(Device &device);
+
+  /**
+   * @~Chinese
+   * @brief 写入寄存器地址和数据，参见 @ref transport_concept 。
+   * @param[in] i2c_address I2C地址。
+   * @param[in] reg 寄存器地址。
+   * @param[in] data 数据。
+   * @param[in] length 数据长度。
+   * @return 传输结果，地址上没有设备时返回 @ref I2cResult::kAddressNack 。
+   */
+  /**
+   * @~English
+   * @brief Write the register address and the data, see @ref transport_concept.
+   * @param[in] i2c_address I2C address.
+   * @param[in] reg Register address.
+   * @param[in] data Data.
+   * @param[in] length Data length.
+   * @return Transfer result, @ref I2cResult::kAddressNack when there is no device at the address.
+   */
+  I2cResult Write(const uint8_t i2c_address, const uint8_t reg, const void *data, const uint8_t length);
+
+  /**
+   * @~Chinese
+   * @brief 写入寄存器地址，然后读取数据，参见 @ref transport_concept 。
+   * @param[in] i2c_address I2C地址。
+   * @param[in] reg 寄存器地址。
+   * @param[out] data 数据。
+   * @param[in] length 数据长度。
+   * @return 传输结果，地址上没有设备时返回 @ref I2cResult::kAddressNack 。
+   */
+  /**
+   * @~English
+   * @brief Write the register address, then read the data, see @ref transport_concept.
+   * @param[in] i2c_address I2C address.
+   * @param[in] reg Register address.
+   * @param[out] data Data.
+   * @param[in] length Data length.
+   * @return Transfer result, @ref I2cResult::kAddressNack when there is no device at the address.
+   */
+  I2cResult WriteRead(const uint8_t i2c_address, const uint8_t reg, void *data, const uint8_t length);
+
+  /**
+   * @~Chinese
+   * @brief 从设备当前的寄存器地址读取数据，参见 @ref transport_concept 。
+   * @param[in] i2c_address I2C地址。
+   * @param[out] data 数据。
+   * @param[in] length 数据长度。
+   * @return 传输结果，地址上没有设备时返回 @ref I2cResult::kAddressNack 。
+   */
+  /**
+   * @~English
+   * @brief Read data from the device's current register address, see @ref transport_concept.
+   * @param[in] i2c_address I2C address.
+   * @param[out] data Data.
+   * @param[in] length Data length.
+   * @return Transfer result, @ref I2cResult::kAddressNack when there is no device at the address.
+   */
+  I2cResult Read(const uint8_t i2c_address, void *data, const uint8_t length);
+
+  /**
+   * @~Chinese
+   * @brief 获取虚拟时钟的当前时间。
+   * @return 微秒数。
+   */
+  /**
+   * @~English
+   * @brief Get the current time of the virtual clock.
+   * @return Microseconds.
+   */
+  uint32_t now_us() const;
+
+  /**
+   * @~Chinese
+   * @brief 使虚拟时钟前进。
+   * @param[in] us 微秒数。
+   */
+  /**
+   * @~English
+   * @brief Move the virtual clock forward.
+   * @param[in] us Microseconds.
+   */
+  void Advance(const uint32_t us);
+
+  /**
+   * @~Chinese
+   * @brief 设置总线时钟频率，用于计算每条消息的传输时间，默认为100kHz，0表示消息不占用时间。
+   * @param[in] clock_hz 总线时钟频率（Hz）。
+   */
+  /**
+   * @~English
+   * @brief Set the bus clock rate used to compute the transfer time of every message, 100 kHz by default. 0 means messages take no time.
+   * @param[in] clock_hz Bus clock rate (Hz).
+   */
+  void set_clock_hz(const uint32_t clock_hz);
+
+  /**
+   * @~Chinese
+   * @brief 获取总线时钟频率。
+   * @return 总线时钟频率（Hz）。
+   */
+  /**
+   * @~English
+   * @brief Get the bus clock rate.
+   * @return Bus clock rate (Hz).
+   */
+  uint32_t clock_hz() const;
+
+  /**
+   * @~Chinese
+   * @brief 模拟时钟过快时的传输错误：总线时钟高于 max_clock_hz 时，每个数据字节有 1/byte_error_interval 的概率出错。
+   * @details 写入出错时整次写入被丢弃并返回 @ref I2cResult::kError ，读取出错时返回的数据中有一位被翻转，传输本身仍然成功。
+   * 错误由固定种子的伪随机序列决定，因此可以重现。max_clock_hz 为0时不注入错误，这是默认设置。
+   * @param[in] max_clock_hz 不出错的最高总线时钟频率（Hz）。
+   * @param[in] byte_error_interval 平均每多少个字节出错一次。
+   */
+  /**
+   * @~English
+   * @brief Model the transfer errors of a clock that is too fast: above max_clock_hz every data byte has a 1 in byte_error_interval chance of
+   * going wrong.
+   * @details A write that goes wrong is dropped as a whole and returns @ref I2cResult::kError. A read that goes wrong has one bit of the
+   * returned data flipped while the transfer itself still succeeds. The errors come from a pseudo-random sequence with a fixed seed, so they are
+   * reproducible. A max_clock_hz of 0 injects no errors, which is the default.
+   * @param[in] max_clock_hz Highest bus clock rate without errors (Hz).
+   * @param[in] byte_error_interval One byte in this many goes wrong on average.
+   */
+  void set_fault_injection(const uint32_t max_clock_hz, const uint32_t byte_error_interval);
+
+  /**
+   * @~Chinese
+   * @brief 获取已注入的错误数。
+   * @return 已注入的错误数。
+   */
+  /**
+   * @~English
+   * @brief Get the number of injected errors.
+   * @return Number of injected errors.
+   */
+  uint32_t fault_count() const;
+
+  /**
+   * @~Chinese
+   * @brief 获取总线上的消息数。每次写入计为一条消息，写入后读取计为两条消息（寄存器地址写入和数据读取）。
+   * @return 消息数。
+   */
+  /**
+   * @~English
+   * @brief Get the number of messages on the bus. A write counts as one message, a write-read as two (the register address write and the data
+   * read).
+   * @return Number of messages.
+   */
+  uint32_t message_count() const;
+
+  /**
+   * @~Chinese
+   * @brief 获取总线上的字节数，包括每条消息的地址字节。
+   * @return 字节数。
+   */
+  /**
+   * @~English
+   * @brief Get the number of bytes on the bus, including the address byte of every message.
+   * @return Number of bytes.
+   */
+  uint32_t byte_count() const;
+
+  /**
+   * @~Chinese
+   * @brief 清零消息数和字节数。
+   */
+  /**
+   * @~English
+   * @brief Reset the message and byte counts to zero.
+   */
+  void ResetCounters();
+
+ private:
+  Device *Find(const uint8_t i2c_address);
+
+  void CountMessage(const uint8_t length);
+
+  bool InjectFault(const uint8_t length, uint8_t &byte_index, uint8_t &bit_index);
+
+  Device *devices_ = nullptr;
+  uint32_t clock_hz_ = 100000;
+  uint32_t fault_max_clock_hz_ = 0;
+  uint32_t fault_byte_interval_ = 0;
+  uint32_t fault_random_state_ = 1;
+  uint32_t fault_count_ = 0;
+  uint64_t now_ns_ = 0;
+  uint32_t message_count_ = 0;
+  uint32_t byte_count_ = 0;
+};
+
+/**
+ * @~Chinese
+ * @class MemoryTransport
+ * @brief 访问 @ref MemoryBus 的传输层，时钟使用总线的虚拟时钟，因此等待不会占用真实时间。
+ */
+/**
+ * @~English
+ * @class MemoryTransport
+ * @brief Transport accessing a @ref MemoryBus. It uses the bus's virtual clock, so waiting takes no real time.
+ */
+class MemoryTransport {
+ public:
+  /**
+   * @~Chinese
+   * @brief 单次读取的最大字节数，与AVR上的 TwoWire 相同。
+   */
+  /**
+   * @~English
+   * @brief Maximum number of bytes of one read, the same as TwoWire on AVR.
+   */
+  static constexpr uint8_t kBufferLength = 32;
+
+  /**
+   * @~Chinese
+   * @brief 构造函数，可从 MemoryBus 对象隐式转换。
+   * @param[in] bus 内存总线。
+   */
+  /**
+   * @~English
+   * @brief Constructor, implicitly converting from a MemoryBus object.
+   * @param[in] bus Memory bus.
+   */
+  MemoryTransport(MemoryBus &bus);
+
+  /**
+   * @~Chinese
+   * @brief 初始化，不做任何事。
+   */
+  /**
+   * @~English
+   * @brief Initialize, does nothing.
+   */
+  void Init();
+
+  /**
+   * @~Chinese
+   * @brief 参见 @ref MemoryBus::Write 。
+   */
+  /**
+   * @~English
+   * @brief See @ref MemoryBus::Write.
+   */
+  I2cResult Write(const uint8_t i2c_address, const uint8_t reg, const void *data, const uint8_t length);
+
+  /**
+   * @~Chinese
+   * @brief 参见 @ref MemoryBus::WriteRead 。
+   */
+  /**
+   * @~English
+   * @brief See @ref MemoryBus::WriteRead.
+   */
+  I2cResult WriteRead(const uint8_t i2c_address, const uint8_t reg, void *data, const uint8_t length);
+
+  /**
+   * @~Chinese
+   * @brief 参见 @ref MemoryBus::Read 。
+   */
+  /**
+   * @~English
+   * @brief See @ref MemoryBus::Read.
+   */
+  I2cResult Read(const uint8_t i2c_address, void *data, const uint8_t length);
+
+  /**
+   * @~Chinese
+   * @brief 获取总线虚拟时钟的当前时间。
+   * @return 微秒数。
+   */
+  /**
+   * @~English
+   * @brief Get the current time of the bus's virtual clock.
+   * @return Microseconds.
+   */
+  uint32_t Micros();
+
+  /**
+   * @~Chinese
+   * @brief 使总线的虚拟时钟前进，立即返回。
+   * @param[in] us 微秒数。
+   */
+  /**
+   * @~English
+   * @brief Move the bus's virtual clock forward and return immediately.
+   * @param[in] us Microseconds.
+   */
+  void DelayMicroseconds(const uint32_t us);
+
+  /**
+   * @~Chinese
+   * @brief 参见 @ref MemoryBus::set_clock_hz 。
+   */
+  /**
+   * @~English
+   * @brief See @ref MemoryBus::set_clock_hz.
+   */
+  void SetClock(const uint32_t clock_hz);
+
+ private:
+  MemoryBus *bus_ = nullptr;
+};
+
+/**
+ * @~Chinese
+ * @class Md40MemoryDevice
+ * @brief 最简单的内存MD40设备：命令写入后立即执行完毕，不模拟电机。用于不关心电机行为的测试。
+ */
+/**
+ * @~English
+ * @class Md40MemoryDevice
+ * @brief The simplest in-memory MD40: every command is done as soon as it is written, no motors are modelled. Used by tests that do not care
+ * about motor behaviour.
+ */
+class Md40MemoryDevice : public MemoryBus::Device {
+ public:
+  /**
+   * @~Chinese
+   * @brief 构造函数。
+   * @param[in] i2c_address I2C地址。
+   */
+  /**
+   * @~English
+   * @brief Constructor.
+   * @param[in] i2c_address I2C address.
+   */
+  explicit Md40MemoryDevice(const uint8_t i2c_address);
+
+  /**
+   * @~Chinese
+   * @brief 获取已执行的命令数。
+   * @return 已执行的命令数。
+   */
+  /**
+   * @~English
+   * @brief Get the number of executed commands.
+   * @return Number of executed commands.
+   */
+  uint32_t command_count() const;
+
+ protected:
+  void OnWrite(const uint8_t reg, const uint8_t length) override;
+
+ private:
+  uint32_t command_count_ = 0;
+};
+}  // namespace em
+#endif
+#endif
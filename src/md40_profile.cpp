@@ -0,0 +1,131 @@
+/**
+ * @file md40_profile.cpp
+ */
+
+#include "md40_profile.h"
+
+#include <math.h>
+
+namespace em {
+
+namespace {
+// Jerk and starting acceleration of each segment, in units of the peak jerk and the peak acceleration: jerk up, hold, jerk down, cruise, then the
+// mirror image. A trapezoid has no jerk, its odd segments are simply empty.
+constexpr int8_t kJerkSigns[] = {1, 0, -1, 0, -1, 0, 1};
+constexpr int8_t kAccelerationSigns[] = {0, 1, 1, 0, 0, -1, -1};
+}  // namespace
+
+constexpr uint8_t VelocityProfile::kSegmentNum;
+
+VelocityProfile VelocityProfile::Trapezoidal(const float distance, const float max_speed, const float max_acceleration) {
+  return Plan(distance, max_speed, max_acceleration, 0);
+}
+
+VelocityProfile VelocityProfile::SCurve(const float distance, const float max_speed, const float max_acceleration, const float max_jerk) {
+  EM_CHECK_GT(max_jerk, 0);
+  return Plan(distance, max_speed, max_acceleration, max_jerk);
+}
+
+float VelocityProfile::Speed(const float time) const {
+  const float clamped = time < 0 ? 0 : (time < times_[kSegmentNum] ? time : times_[kSegmentNum]);
+  const uint8_t k = Segment(clamped);
+  const float t = clamped - times_[k];
+  const float acceleration = kAccelerationSigns[k] * peak_acceleration_;
+  const float jerk = kJerkSigns[k] * jerk_;
+  return sign_ * (speeds_[k] + t * (acceleration + t * jerk / 2));
+}
+
+float VelocityProfile::Position(const float time) const {
+  const float clamped = time < 0 ? 0 : (time < times_[kSegmentNum] ? time : times_[kSegmentNum]);
+  const uint8_t k = Segment(clamped);
+  const float t = clamped - times_[k];
+  const float acceleration = kAccelerationSigns[k] * peak_acceleration_;
+  const float jerk = kJerkSigns[k] * jerk_;
+  return sign_ * (positions_[k] + t * (speeds_[k] + t * (acceleration / 2 + t * jerk / 6)));
+}
+
+float VelocityProfile::duration() const {
+  return times_[kSegmentNum];
+}
+
+float VelocityProfile::distance() const {
+  return sign_ * positions_[kSegmentNum];
+}
+
+float VelocityProfile::peak_speed() const {
+  return peak_speed_;
+}
+
+VelocityProfile VelocityProfile::Plan(const float distance, const float max_speed, const float max_acceleration, const float max_jerk) {
+  EM_CHECK_GT(max_speed, 0);
+  EM_CHECK_GT(max_acceleration, 0);
+
+  VelocityProfile profile;
+  profile.sign_ = distance < 0 ? -1 : 1;
+  const float length = distance < 0 ? -distance : distance;
+  const float jerk = max_jerk;
+  float speed = max_speed;
+  float acceleration = max_acceleration;
+
+  // jerk_time is each jerk segment, ramp_time the whole speed-up from rest to the peak speed.
+  float jerk_time = 0;
+  float ramp_time = speed / acceleration;
+  if (jerk > 0) {
+    if (speed * jerk >= acceleration * acceleration) {
+      jerk_time = acceleration / jerk;
+      ramp_time = jerk_time + speed / acceleration;
+    } else {
+      jerk_time = sqrtf(speed / jerk);
+      ramp_time = 2 * jerk_time;
+    }
+  }
+
+  // Speeding up and slowing down cover speed * ramp_time together, a shorter move cannot reach the maximum speed.
+  if (speed * ramp_time > length) {
+    if (jerk > 0) {
+      const float ratio = acceleration / jerk;
+      speed = acceleration * (sqrtf(ratio * ratio + 4 * length / acceleration) - ratio) / 2;
+      if (speed * jerk >= acceleration * acceleration) {
+        jerk_time = ratio;
+        ramp_time = jerk_time + speed / acceleration;
+      } else {
+        speed = powf(length * length * jerk / 4, 1.0f / 3);
+        jerk_time = sqrtf(speed / jerk);
+        ramp_time = 2 * jerk_time;
+      }
+    } else {
+      speed = sqrtf(length * acceleration);
+      ramp_time = speed / acceleration;
+    }
+  }
+
+  if (jerk > 0) {
+    acceleration = jerk * jerk_time;
+  }
+  profile.jerk_ = jerk;
+  profile.peak_acceleration_ = acceleration;
+  profile.peak_speed_ = speed;
+
+  const float cruise_time = speed > 0 ? (length - speed * ramp_time) / speed : 0;
+  const float hold_time = ramp_time - 2 * jerk_time;
+  const float durations[kSegmentNum] = {
+      jerk_time, hold_time, jerk_time, cruise_time > 0 ? cruise_time : 0, jerk_time, hold_time, jerk_time};
+  for (uint8_t k = 0; k < kSegmentNum; k++) {
+    const float t = durations[k] > 0 ? durations[k] : 0;
+    const float segment_acceleration = kAccelerationSigns[k] * acceleration;
+    const float segment_jerk = kJerkSigns[k] * jerk;
+    profile.times_[k + 1] = profile.times_[k] + t;
+    profile.speeds_[k + 1] = profile.speeds_[k] + t * (segment_acceleration + t * segment_jerk / 2);
+    profile.positions_[k + 1] = profile.positions_[k] + t * (profile.speeds_[k] + t * (segment_acceleration / 2 + t * segment_jerk / 6));
+  }
+  return profile;
+}
+
+uint8_t VelocityProfile::Segment(const float time) const {
+  uint8_t k = 0;
+  while (k < kSegmentNum - 1 && time >= times_[k + 1]) {
+    k++;
+  }
+  return k;
+}
+}  // namespace em
@@ -0,0 +1,524 @@
+#pragma once
+
+#ifndef _EM_MD40_PROFILE_H_
+#define _EM_MD40_PROFILE_H_
+
+#include "md40.h"
+
+/**
+ * @file md40_profile.h
+ */
+
+namespace em {
+
+/**
+ * @~Chinese
+ * @class VelocityProfile
+ * @brief 从静止到静止的速度曲线：梯形（限制加速度）或S形（同时限制加加速度）。
+ * @details 规划时计算出最多7段匀加加速度的分段边界，之后每次求值只需找到所在分段并计算一个三次多项式，不分配内存，适合在AVR上以较高频率求值。
+ * 距离太短达不到最大速度（或最大加速度）时会自动降低峰值。单位由调用者决定，只要一致即可；用于 @ref BasicMd40ProfileStreamer 时位置单位为度，
+ * 时间单位为秒。
+ */
+/**
+ * @~English
+ * @class VelocityProfile
+ * @brief A rest-to-rest velocity profile: trapezoidal (acceleration limited) or S-curve (jerk limited as well).
+ * @details Planning computes the boundaries of at most seven constant-jerk segments, after which every evaluation only finds its segment and
+ * computes one cubic polynomial, without allocating memory, cheap enough to evaluate at a high rate on an AVR. When the distance is too short to
+ * reach the maximum speed (or acceleration), the peak is lowered automatically. Units are up to the caller as long as they are consistent; for
+ * @ref BasicMd40ProfileStreamer positions are in degrees and time in seconds.
+ */
+class VelocityProfile {
+ public:
+  /**
+   * @~Chinese
+   * @brief 规划梯形速度曲线。
+   * @param[in] distance 位移，可为负数。
+   * @param[in] max_speed 最大速度，必须大于0。
+   * @param[in] max_acceleration 最大加速度，必须大于0。
+   * @return 速度曲线。
+   */
+  /**
+   * @~English
+   * @brief Plan a trapezoidal velocity profile.
+   * @param[in] distance Distance, may be negative.
+   * @param[in] max_speed Maximum speed, must be greater than 0.
+   * @param[in] max_acceleration Maximum acceleration, must be greater than 0.
+   * @return Velocity profile.
+   */
+  static VelocityProfile Trapezoidal(const float distance, const float max_speed, const float max_acceleration);
+
+  /**
+   * @~Chinese
+   * @brief 规划限制加加速度的S形速度曲线。
+   * @param[in] distance 位移，可为负数。
+   * @param[in] max_speed 最大速度，必须大于0。
+   * @param[in] max_acceleration 最大加速度，必须大于0。
+   * @param[in] max_jerk 最大加加速度，必须大于0。
+   * @return 速度曲线。
+   */
+  /**
+   * @~English
+   * @brief Plan a jerk-limited S-curve velocity profile.
+   * @param[in] distance Distance, may be negative.
+   * @param[in] max_speed Maximum speed, must be greater than 0.
+   * @param[in] max_acceleration Maximum acceleration, must be greater than 0.
+   * @param[in] max_jerk Maximum jerk, must be greater than 0.
+   * @return Velocity profile.
+   */
+  static VelocityProfile SCurve(const float distance, const float max_speed, const float max_acceleration, const float max_jerk);
+
+  /**
+   * @~Chinese
+   * @brief 求指定时刻的速度，时刻超出范围时按端点处理。
+   * @param[in] time 从开始算起的时间。
+   * @return 速度，方向与位移相同。
+   */
+  /**
+   * @~English
+   * @brief Evaluate the speed at the given time, times out of range are clamped to the ends.
+   * @param[in] time Time since the start.
+   * @return Speed, in the direction of the distance.
+   */
+  float Speed(const float time) const;
+
+  /**
+   * @~Chinese
+   * @brief 求指定时刻相对起点的位置，时刻超出范围时按端点处理。
+   * @param[in] time 从开始算起的时间。
+   * @return 位置。
+   */
+  /**
+   * @~English
+   * @brief Evaluate the position relative to the start at the given time, times out of range are clamped to the ends.
+   * @param[in] time Time since the start.
+   * @return Position.
+   */
+  float Position(const float time) const;
+
+  /**
+   * @~Chinese
+   * @brief 获取总时长。
+   * @return 时长。
+   */
+  /**
+   * @~English
+   * @brief Get the total duration.
+   * @return Duration.
+   */
+  float duration() const;
+
+  /**
+   * @~Chinese
+   * @brief 获取位移。
+   * @return 位移。
+   */
+  /**
+   * @~English
+   * @brief Get the distance.
+   * @return Distance.
+   */
+  float distance() const;
+
+  /**
+   * @~Chinese
+   * @brief 获取实际达到的峰值速度，距离太短时小于最大速度。
+   * @return 峰值速度，总为非负数。
+   */
+  /**
+   * @~English
+   * @brief Get the peak speed actually reached, lower than the maximum speed when the distance is too short.
+   * @return Peak speed, never negative.
+   */
+  float peak_speed() const;
+
+ private:
+  static constexpr uint8_t kSegmentNum = 7;
+
+  static VelocityProfile Plan(const float distance, const float max_speed, const float max_acceleration, const float max_jerk);
+
+  uint8_t Segment(const float time) const;
+
+  float sign_ = 1;
+  float jerk_ = 0;
+  float peak_acceleration_ = 0;
+  float peak_speed_ = 0;
+  float times_[kSegmentNum + 1] = {0};
+  float positions_[kSegmentNum + 1] = {0};
+  float speeds_[kSegmentNum + 1] = {0};
+};
+
+/**
+ * @~Chinese
+ * @class BasicMd40ProfileStreamer
+ * @brief 以非阻塞方式把 @ref VelocityProfile 按固定周期作为 RunSpeed 的设定值发给一个电机，结束时用一次 MoveTo 精确停到目标位置。
+ * @details 在主循环中反复调用 @ref Poll ：不到周期时只推进命令队列，到达周期时求出下一周期中点的速度（使阶梯状设定值的积分与曲线的位移一致），
+ * 换算为RPM并取整，只在与上次发出的值不同时才提交 RunSpeed ，因此匀速段不产生写入。曲线结束后提交 MoveTo(起点 + 位移) ，
+ * 电机状态变为 Motor::State::kReachedPosition 时结束。启用跟踪时每个周期读取一次位置，与曲线计划的位置比较得到跟踪误差。
+ * 多个电机各用一个对象即可同时运行。
+ * @tparam Transport 传输层类型。
+ */
+/**
+ * @~English
+ * @class BasicMd40ProfileStreamer
+ * @brief Streams a @ref VelocityProfile to one motor as RunSpeed setpoints at a fixed period without blocking, then lands exactly on the target
+ * with one MoveTo.
+ * @details Call @ref Poll repeatedly from the main loop. Between periods it only advances the command queue. At each period it evaluates the
+ * speed at the middle of the next period (so the integral of the staircase of setpoints matches the profile's distance), converts it to RPM,
+ * rounds it, and submits RunSpeed only when that differs from the value sent last, so the cruise phase costs no writes. When the profile ends,
+ * MoveTo(start + distance) is submitted and the move finishes once the motor state becomes Motor::State::kReachedPosition. With tracking enabled
+ * the position is read once per period and compared with the planned position to give the tracking error. Use one object per motor to run several
+ * motors at once.
+ * @tparam Transport Transport type.
+ */
+template <typename Transport>
+class BasicMd40ProfileStreamer {
+ public:
+  /**
+   * @~Chinese
+   * @brief 驱动类型。
+   */
+  /**
+   * @~English
+   * @brief Driver type.
+   */
+  using Md40 = BasicMd40<Transport>;
+
+  /**
+   * @~Chinese
+   * @brief 状态码类型。
+   */
+  /**
+   * @~English
+   * @brief Status code type.
+   */
+  using Status = typename Md40::Status;
+
+  /**
+   * @~Chinese
+   * @brief 运行阶段。
+   */
+  /**
+   * @~English
+   * @brief Run phase.
+   */
+  enum class Phase : uint8_t {
+    /**
+     * @~Chinese
+     * @brief 未开始。
+     */
+    /**
+     * @~English
+     * @brief Not started.
+     */
+    kIdle,
+
+    /**
+     * @~Chinese
+     * @brief 正在发送速度设定值。
+     */
+    /**
+     * @~English
+     * @brief Streaming speed setpoints.
+     */
+    kStreaming,
+
+    /**
+     * @~Chinese
+     * @brief 已提交最后的 MoveTo ，等待到达。
+     */
+    /**
+     * @~English
+     * @brief The final MoveTo has been submitted, waiting for arrival.
+     */
+    kLanding,
+
+    /**
+     * @~Chinese
+     * @brief 已到达目标位置。
+     */
+    /**
+     * @~English
+     * @brief The target position has been reached.
+     */
+    kDone,
+  };
+
+  /**
+   * @~Chinese
+   * @brief 构造函数。
+   * @param[in] md40 Md40 对象引用。
+   * @param[in] index 电机索引。
+   */
+  /**
+   * @~English
+   * @brief Constructor.
+   * @param[in] md40 Md40 object reference.
+   * @param[in] index Motor index.
+   */
+  BasicMd40ProfileStreamer(Md40 &md40, const uint8_t index);
+
+  /**
+   * @~Chinese
+   * @brief 设置发送设定值的周期，默认为10毫秒（100 Hz）。
+   * @param[in] period_us 微秒数，必须大于0。
+   */
+  /**
+   * @~English
+   * @brief Set the setpoint period, 10 ms (100 Hz) by default.
+   * @param[in] period_us Microseconds, must be greater than 0.
+   */
+  void set_period_us(const uint32_t period_us);
+
+  /**
+   * @~Chinese
+   * @brief 设置是否每个周期读取位置以计算跟踪误差，默认启用。不需要跟踪误差时关闭可省去每周期一次位置读取。
+   * @param[in] enabled 是否启用。
+   */
+  /**
+   * @~English
+   * @brief Set whether the position is read every period to compute the tracking error, enabled by default. Disable it to save one position read per
+   * period when the tracking error is not needed.
+   * @param[in] enabled Whether to enable.
+   */
+  void set_tracking_enabled(const bool enabled);
+
+  /**
+   * @~Chinese
+   * @brief 开始一次运动。读取一次当前位置作为起点。只保存曲线对象的引用，因此曲线对象必须在运动结束前保持有效，不接受临时对象。
+   * @param[in] profile 速度曲线，位置单位为度，时间单位为秒。
+   * @return 执行结果，参见 @ref BasicMd40::Status 。
+   */
+  /**
+   * @~English
+   * @brief Start a move. The current position is read once as the start. Only a reference to the profile is kept, so the profile object must stay
+   * valid until the move ends and temporaries are not accepted.
+   * @param[in] profile Velocity profile, positions in degrees and time in seconds.
+   * @return Execution result, see @ref BasicMd40::Status.
+   */
+  Status Start(const VelocityProfile &profile);
+
+  // A temporary profile would be destroyed before the move ends.
+  Status Start(const VelocityProfile &&) = delete;
+
+  /**
+   * @~Chinese
+   * @brief 推进运动，需要在主循环中反复调用，不会阻塞。命令队列已满时命令在下一个周期重新提交。
+   * @return 执行结果，参见 @ref BasicMd40::Status 。
+   */
+  /**
+   * @~English
+   * @brief Advance the move, to be called repeatedly from the main loop. Does not block, a command turned away by a full command queue is
+   * submitted again on the next tick.
+   * @return Execution result, see @ref BasicMd40::Status.
+   */
+  Status Poll();
+
+  /**
+   * @~Chinese
+   * @brief 获取运行阶段。
+   * @return 运行阶段。
+   */
+  /**
+   * @~English
+   * @brief Get the run phase.
+   * @return Run phase.
+   */
+  Phase phase() const;
+
+  /**
+   * @~Chinese
+   * @brief 获取最近一次的跟踪误差（计划位置减实际位置）。
+   * @return 跟踪误差，单位为度。
+   */
+  /**
+   * @~English
+   * @brief Get the most recent tracking error (planned minus actual position).
+   * @return Tracking error in degrees.
+   */
+  float tracking_error() const;
+
+  /**
+   * @~Chinese
+   * @brief 获取本次运动中跟踪误差绝对值的最大值。
+   * @return 跟踪误差，单位为度。
+   */
+  /**
+   * @~English
+   * @brief Get the largest absolute tracking error of the current move.
+   * @return Tracking error in degrees.
+   */
+  float max_tracking_error() const;
+
+  /**
+   * @~Chinese
+   * @brief 获取本次运动已提交的命令数，包括 RunSpeed 和最后的 MoveTo 。
+   * @return 命令数。
+   */
+  /**
+   * @~English
+   * @brief Get the number of commands submitted for the current move, including RunSpeed and the final MoveTo.
+   * @return Number of commands.
+   */
+  uint16_t command_count() const;
+
+ private:
+  // Degrees per second in one RPM.
+  static constexpr float kDegreesPerSecondPerRpm = 6;
+
+  static int32_t Round(const float value);
+
+  Status Track(const float planned_position);
+
+  Md40 &md40_;
+  const uint8_t index_ = 0;
+  const VelocityProfile *profile_ = nullptr;
+  uint32_t period_us_ = 10000;
+  bool tracking_enabled_ = true;
+  Phase phase_ = Phase::kIdle;
+  int32_t start_position_ = 0;
+  uint32_t start_time_ = 0;
+  uint32_t next_tick_us_ = 0;
+  int32_t last_rpm_ = 0;
+  bool rpm_sent_ = false;
+  float tracking_error_ = 0;
+  float max_tracking_error_ = 0;
+  uint16_t command_count_ = 0;
+};
+
+template <typename Transport>
+constexpr float BasicMd40ProfileStreamer<Transport>::kDegreesPerSecondPerRpm;
+
+template <typename Transport>
+BasicMd40ProfileStreamer<Transport>::BasicMd40ProfileStreamer(Md40 &md40, const uint8_t index) : md40_(md40), index_(index) {
+  EM_CHECK_LT(index, Md40::kMotorNum);
+}
+
+template <typename Transport>
+void BasicMd40ProfileStreamer<Transport>::set_period_us(const uint32_t period_us) {
+  EM_CHECK_GT(period_us, 0);
+  period_us_ = period_us;
+}
+
+template <typename Transport>
+void BasicMd40ProfileStreamer<Transport>::set_tracking_enabled(const bool enabled) {
+  tracking_enabled_ = enabled;
+}
+
+template <typename Transport>
+typename BasicMd40ProfileStreamer<Transport>::Status BasicMd40ProfileStreamer<Transport>::Start(const VelocityProfile &profile) {
+  phase_ = Phase::kIdle;
+  start_position_ = md40_[index_].position();
+  if (md40_.last_status() != Status::kOk) {
+    return md40_.last_status();
+  }
+
+  profile_ = &profile;
+  start_time_ = md40_.transport_.Micros();
+  next_tick_us_ = 0;
+  rpm_sent_ = false;
+  tracking_error_ = 0;
+  max_tracking_error_ = 0;
+  command_count_ = 0;
+  phase_ = Phase::kStreaming;
+  return Poll();
+}
+
+template <typename Transport>
+typename BasicMd40ProfileStreamer<Transport>::Status BasicMd40ProfileStreamer<Transport>::Poll() {
+  Status status = md40_.Poll();
+  if (status != Status::kOk || phase_ == Phase::kIdle || phase_ == Phase::kDone) {
+    return status;
+  }
+
+  const uint32_t elapsed_us = md40_.transport_.Micros() - start_time_;
+  if (static_cast<int32_t>(elapsed_us - next_tick_us_) < 0) {
+    return Status::kOk;
+  }
+  // Ticks stay on the grid of the start time, a late poll catches up instead of shifting every later tick.
+  next_tick_us_ += period_us_;
+  if (static_cast<int32_t>(elapsed_us - next_tick_us_) >= 0) {
+    next_tick_us_ = elapsed_us - elapsed_us % period_us_ + period_us_;
+  }
+
+  const float time = elapsed_us / 1000000.0f;
+  if (phase_ == Phase::kLanding) {
+    if (md40_[index_].state() == Md40::Motor::State::kReachedPosition) {
+      phase_ = Phase::kDone;
+    }
+    status = md40_.last_status();
+    return status == Status::kOk ? Track(profile_->distance()) : status;
+  }
+
+  if (time >= profile_->duration()) {
+    const int32_t speed = Round(profile_->peak_speed() / kDegreesPerSecondPerRpm) + 1;
+    if (!md40_[index_].SubmitMoveTo(start_position_ + Round(profile_->distance()), speed).rejected()) {
+      command_count_++;
+      phase_ = Phase::kLanding;
+    }
+    return Track(profile_->distance());
+  }
+
+  const int32_t rpm = Round(profile_->Speed(time + period_us_ / 2000000.0f) / kDegreesPerSecondPerRpm);
+  if ((!rpm_sent_ || rpm != last_rpm_) && !md40_[index_].SubmitRunSpeed(rpm).rejected()) {
+    command_count_++;
+    last_rpm_ = rpm;
+    rpm_sent_ = true;
+  }
+  return Track(profile_->Position(time));
+}
+
+template <typename Transport>
+typename BasicMd40ProfileStreamer<Transport>::Phase BasicMd40ProfileStreamer<Transport>::phase() const {
+  return phase_;
+}
+
+template <typename Transport>
+float BasicMd40ProfileStreamer<Transport>::tracking_error() const {
+  return tracking_error_;
+}
+
+template <typename Transport>
+float BasicMd40ProfileStreamer<Transport>::max_tracking_error() const {
+  return max_tracking_error_;
+}
+
+template <typename Transport>
+uint16_t BasicMd40ProfileStreamer<Transport>::command_count() const {
+  return command_count_;
+}
+
+template <typename Transport>
+int32_t BasicMd40ProfileStreamer<Transport>::Round(const float value) {
+  return static_cast<int32_t>(value < 0 ? value - 0.5f : value + 0.5f);
+}
+
+template <typename Transport>
+typename BasicMd40ProfileStreamer<Transport>::Status BasicMd40ProfileStreamer<Transport>::Track(const float planned_position) {
+  if (!tracking_enabled_) {
+    return Status::kOk;
+  }
+
+  const int32_t position = md40_[index_].position();
+  if (md40_.last_status() != Status::kOk) {
+    return md40_.last_status();
+  }
+  tracking_error_ = planned_position - static_cast<float>(position - start_position_);
+  const float magnitude = tracking_error_ < 0 ? -tracking_error_ : tracking_error_;
+  max_tracking_error_ = magnitude > max_tracking_error_ ? magnitude : max_tracking_error_;
+  return Status::kOk;
+}
+
+#ifdef ARDUINO
+/**
+ * @~Chinese
+ * @brief 使用 TwoWire 的速度曲线发送器。
+ */
+/**
+ * @~English
+ * @brief Velocity profile streamer using TwoWire.
+ */
+using Md40ProfileStreamer = BasicMd40ProfileStreamer<TwoWireTransport>;
+#endif
+}  // namespace em
+#endif
@@ -0,0 +1,362 @@
+#pragma once
+
+#ifndef _EM_MD40_SAMPLER_H_
+#define _EM_MD40_SAMPLER_H_
+
+#include "em_spsc_ring_buffer.h"
+#include "md40.h"
+
+/**
+ * @file md40_sampler.h
+ */
+
+namespace em {
+
+/**
+ * @~Chinese
+ * @class BasicMd40Sampler
+ * @brief 按固定周期采集电机运行数据（状态、速度、位置、脉冲数、PWM占空比），存入预分配的单生产者单消费者无锁环形缓冲区。
+ * @details 生产者（后台任务，或在 loop() 中按定时调用）反复调用 @ref Step ，到达采样时刻时用一次 @ref BasicMd40::ReadPlan 读取所有电机并加上时间戳；
+ * 消费者用 @ref Drain 批量取出样本用于记录或控制，不会阻塞生产者。缓冲区满时新样本被丢弃并计入 @ref overflow_count 。
+ * 采样时刻固定在起始时刻的网格上，调用过晚时跳过的周期计入 @ref missed_period_count ，实际间隔与周期之差记为抖动。
+ * 只有 @ref Step 访问总线，它必须与同一 Md40 对象的其他调用位于同一上下文中。
+ * @tparam Transport 传输层类型。
+ * @tparam kCapacity 缓冲区能容纳的样本数，必须是2的幂。
+ */
+/**
+ * @~English
+ * @class BasicMd40Sampler
+ * @brief Captures motor runtime data (state, speed, position, pulse count, PWM duty) at a fixed period into a preallocated lock-free
+ * single-producer single-consumer ring buffer.
+ * @details The producer (a background task, or a timed call from loop()) calls @ref Step repeatedly. When a sample is due it reads all motors with
+ * one @ref BasicMd40::ReadPlan and timestamps the result. The consumer takes samples out in batches with @ref Drain for logging or control without
+ * ever blocking the producer. When the buffer is full new samples are dropped and counted in @ref overflow_count. Sample times stay on the grid of
+ * the first sample, periods skipped because @ref Step ran late are counted in @ref missed_period_count, and the difference between the actual
+ * interval and the period is recorded as jitter. Only @ref Step touches the bus, it must run in the same context as every other call on the same
+ * Md40 object.
+ * @tparam Transport Transport type.
+ * @tparam kCapacity Number of samples the buffer holds, must be a power of two.
+ */
+template <typename Transport, uint16_t kCapacity>
+class BasicMd40Sampler {
+ public:
+  /**
+   * @~Chinese
+   * @brief 驱动类型。
+   */
+  /**
+   * @~English
+   * @brief Driver type.
+   */
+  using Md40 = BasicMd40<Transport>;
+
+  /**
+   * @~Chinese
+   * @brief 状态码类型。
+   */
+  /**
+   * @~English
+   * @brief Status code type.
+   */
+  using Status = typename Md40::Status;
+
+  /**
+   * @~Chinese
+   * @brief 一次采样。
+   */
+  /**
+   * @~English
+   * @brief One sample.
+   */
+  struct Sample {
+    /**
+     * @~Chinese
+     * @brief 开始读取的时刻，单位为微秒，取自传输层的时钟。
+     */
+    /**
+     * @~English
+     * @brief Time the read started in microseconds, from the transport's clock.
+     */
+    uint32_t timestamp_us = 0;
+
+    /**
+     * @~Chinese
+     * @brief 每个电机的运行数据，只有构造时指定的字段有效。
+     */
+    /**
+     * @~English
+     * @brief Runtime data of every motor, only the fields given at construction are valid.
+     */
+    typename Md40::Motor::Snapshot snapshots[Md40::kMotorNum];
+  };
+
+  /**
+   * @~Chinese
+   * @brief 构造函数，采集所有电机的所有字段。
+   * @param[in] md40 Md40 对象引用。
+   * @param[in] period_us 采样周期，单位为微秒，必须大于0。
+   */
+  /**
+   * @~English
+   * @brief Constructor, captures every field of every motor.
+   * @param[in] md40 Md40 object reference.
+   * @param[in] period_us Sampling period in microseconds, must be greater than 0.
+   */
+  BasicMd40Sampler(Md40 &md40, const uint32_t period_us);
+
+  /**
+   * @~Chinese
+   * @brief 构造函数。
+   * @param[in] md40 Md40 对象引用。
+   * @param[in] period_us 采样周期，单位为微秒，必须大于0。
+   * @param[in] fields 每个电机需要采集的字段，参见 @ref BasicMd40::ReadPlan::Field 。
+   */
+  /**
+   * @~English
+   * @brief Constructor.
+   * @param[in] md40 Md40 object reference.
+   * @param[in] period_us Sampling period in microseconds, must be greater than 0.
+   * @param[in] fields Fields to capture for each motor, see @ref BasicMd40::ReadPlan::Field.
+   */
+  BasicMd40Sampler(Md40 &md40, const uint32_t period_us, const uint8_t (&fields)[Md40::kMotorNum]);
+
+  /**
+   * @~Chinese
+   * @brief 生产者：到达采样时刻时采集一次并写入缓冲区，否则立即返回。
+   * @return 执行结果，参见 @ref BasicMd40::Status 。读取失败时不写入样本。
+   */
+  /**
+   * @~English
+   * @brief Producer: capture one sample into the buffer when it is due, otherwise return at once.
+   * @return Execution result, see @ref BasicMd40::Status. No sample is written when the read fails.
+   */
+  Status Step();
+
+  /**
+   * @~Chinese
+   * @brief 消费者：取出最多 max_count 个样本。
+   * @param[out] samples 存放样本的数组。
+   * @param[in] max_count 最多取出的样本数。
+   * @return 实际取出的样本数。
+   */
+  /**
+   * @~English
+   * @brief Consumer: take out up to max_count samples.
+   * @param[out] samples Array receiving the samples.
+   * @param[in] max_count Maximum number of samples to take out.
+   * @return Number of samples taken out.
+   */
+  uint16_t Drain(Sample *samples, const uint16_t max_count);
+
+  /**
+   * @~Chinese
+   * @brief 获取缓冲区中尚未取出的样本数。
+   * @return 样本数。
+   */
+  /**
+   * @~English
+   * @brief Get the number of samples in the buffer not taken out yet.
+   * @return Number of samples.
+   */
+  uint16_t pending_count() const;
+
+  /**
+   * @~Chinese
+   * @brief 获取已采集的样本数，包括因缓冲区满而丢弃的样本。
+   * @return 样本数。
+   */
+  /**
+   * @~English
+   * @brief Get the number of samples captured, including those dropped because the buffer was full.
+   * @return Number of samples.
+   */
+  uint32_t sample_count() const;
+
+  /**
+   * @~Chinese
+   * @brief 获取因缓冲区满而丢弃的样本数。
+   * @return 样本数。
+   */
+  /**
+   * @~English
+   * @brief Get the number of samples dropped because the buffer was full.
+   * @return Number of samples.
+   */
+  uint32_t overflow_count() const;
+
+  /**
+   * @~Chinese
+   * @brief 获取因 @ref Step 调用过晚而跳过的采样周期数。
+   * @return 周期数。
+   */
+  /**
+   * @~English
+   * @brief Get the number of sampling periods skipped because @ref Step ran late.
+   * @return Number of periods.
+   */
+  uint32_t missed_period_count() const;
+
+  /**
+   * @~Chinese
+   * @brief 获取最近两次采样的实际间隔。
+   * @return 微秒数。
+   */
+  /**
+   * @~English
+   * @brief Get the actual interval between the two most recent samples.
+   * @return Microseconds.
+   */
+  uint32_t last_interval_us() const;
+
+  /**
+   * @~Chinese
+   * @brief 获取采样间隔与周期之差的最大绝对值，跳过周期的间隔不计入。
+   * @return 微秒数。
+   */
+  /**
+   * @~English
+   * @brief Get the largest absolute difference between a sampling interval and the period, intervals that skipped periods are left out.
+   * @return Microseconds.
+   */
+  uint32_t max_jitter_us() const;
+
+  /**
+   * @~Chinese
+   * @brief 清零抖动和跳过周期的统计，只能由生产者调用。
+   */
+  /**
+   * @~English
+   * @brief Reset the jitter and missed period statistics, producer only.
+   */
+  void ResetStatistics();
+
+ private:
+  static constexpr uint8_t kAllFields[Md40::kMotorNum] = {
+      Md40::ReadPlan::kFieldAll, Md40::ReadPlan::kFieldAll, Md40::ReadPlan::kFieldAll, Md40::ReadPlan::kFieldAll};
+
+  Md40 &md40_;
+  typename Md40::ReadPlan plan_;
+  SpscRingBuffer<Sample, kCapacity> samples_;
+  const uint32_t period_us_ = 0;
+  bool started_ = false;
+  uint32_t next_due_us_ = 0;
+  uint32_t last_timestamp_us_ = 0;
+  volatile uint32_t sample_count_ = 0;
+  volatile uint32_t missed_period_count_ = 0;
+  volatile uint32_t last_interval_us_ = 0;
+  volatile uint32_t max_jitter_us_ = 0;
+};
+
+template <typename Transport, uint16_t kCapacity>
+constexpr uint8_t BasicMd40Sampler<Transport, kCapacity>::kAllFields[];
+
+template <typename Transport, uint16_t kCapacity>
+BasicMd40Sampler<Transport, kCapacity>::BasicMd40Sampler(Md40 &md40, const uint32_t period_us)
+    : BasicMd40Sampler(md40, period_us, kAllFields) {
+}
+
+template <typename Transport, uint16_t kCapacity>
+BasicMd40Sampler<Transport, kCapacity>::BasicMd40Sampler(Md40 &md40, const uint32_t period_us, const uint8_t (&fields)[Md40::kMotorNum])
+    : md40_(md40), plan_(md40, fields), period_us_(period_us) {
+  EM_CHECK_GT(period_us, 0);
+}
+
+template <typename Transport, uint16_t kCapacity>
+typename BasicMd40Sampler<Transport, kCapacity>::Status BasicMd40Sampler<Transport, kCapacity>::Step() {
+  const uint32_t now = md40_.transport_.Micros();
+  if (started_ && static_cast<int32_t>(now - next_due_us_) < 0) {
+    return Status::kOk;
+  }
+
+  // Stay on the grid of the first sample: a late call takes the sample now and skips the periods it overran instead of drifting.
+  uint32_t missed = 0;
+  if (started_) {
+    missed = (now - next_due_us_) / period_us_;
+    next_due_us_ += (missed + 1) * period_us_;
+  } else {
+    next_due_us_ = now + period_us_;
+  }
+
+  Sample sample;
+  sample.timestamp_us = now;
+  const Status status = plan_.Execute(sample.snapshots);
+  if (status != Status::kOk) {
+    return status;
+  }
+
+  if (started_) {
+    const uint32_t interval = now - last_timestamp_us_;
+    last_interval_us_ = interval;
+    if (missed > 0) {
+      missed_period_count_ = missed_period_count_ + missed;
+    } else {
+      const uint32_t jitter = interval > period_us_ ? interval - period_us_ : period_us_ - interval;
+      if (jitter > max_jitter_us_) {
+        max_jitter_us_ = jitter;
+      }
+    }
+  }
+  started_ = true;
+  last_timestamp_us_ = now;
+  sample_count_ = sample_count_ + 1;
+  samples_.Push(sample);
+  return Status::kOk;
+}
+
+template <typename Transport, uint16_t kCapacity>
+uint16_t BasicMd40Sampler<Transport, kCapacity>::Drain(Sample *samples, const uint16_t max_count) {
+  return samples_.Pop(samples, max_count);
+}
+
+template <typename Transport, uint16_t kCapacity>
+uint16_t BasicMd40Sampler<Transport, kCapacity>::pending_count() const {
+  return samples_.size();
+}
+
+template <typename Transport, uint16_t kCapacity>
+uint32_t BasicMd40Sampler<Transport, kCapacity>::sample_count() const {
+  return sample_count_;
+}
+
+template <typename Transport, uint16_t kCapacity>
+uint32_t BasicMd40Sampler<Transport, kCapacity>::overflow_count() const {
+  return samples_.overflow_count();
+}
+
+template <typename Transport, uint16_t kCapacity>
+uint32_t BasicMd40Sampler<Transport, kCapacity>::missed_period_count() const {
+  return missed_period_count_;
+}
+
+template <typename Transport, uint16_t kCapacity>
+uint32_t BasicMd40Sampler<Transport, kCapacity>::last_interval_us() const {
+  return last_interval_us_;
+}
+
+template <typename Transport, uint16_t kCapacity>
+uint32_t BasicMd40Sampler<Transport, kCapacity>::max_jitter_us() const {
+  return max_jitter_us_;
+}
+
+template <typename Transport, uint16_t kCapacity>
+void BasicMd40Sampler<Transport, kCapacity>::ResetStatistics() {
+  missed_period_count_ = 0;
+  max_jitter_us_ = 0;
+}
+
+#ifdef ARDUINO
+/**
+ * @~Chinese
+ * @brief 使用 TwoWire 的采样器。
+ * @tparam kCapacity 缓冲区能容纳的样本数，必须是2的幂。
+ */
+/**
+ * @~English
+ * @brief Sampler using TwoWire.
+ * @tparam kCapacity Number of samples the buffer holds, must be a power of two.
+ */
+template <uint16_t kCapacity>
+using Md40Sampler = BasicMd40Sampler<TwoWireTransport, kCapacity>;
+#endif
+}  // namespace em
+#endif
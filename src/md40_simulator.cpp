@@ -0,0 +1,351 @@
+/**
+ * @file md40_simulator.cpp
+ */
+
+#include "md40_simulator.h"
+
+#ifndef ARDUINO
+
+#include <string.h>
+
+namespace em {
+
+namespace {
+// Placeholder identity, the driver only reads these back.
+constexpr uint8_t kDeviceIdValue = 0x40;
+constexpr uint8_t kVersionValue[] = {1, 1, 0};
+constexpr char kNameValue[] = "MD40";
+
+enum CommandType : uint8_t {
+  kSetup = 1,
+  kReset = 2,
+  kSetSpeedPidP = 3,
+  kSetPositionPidD = 8,
+  kSetPosition = 9,
+  kSetPulseCount = 10,
+  kStop = 11,
+  kRunPwmDuty = 12,
+  kRunSpeed = 13,
+  kMoveTo = 14,
+  kMove = 15,
+};
+
+enum MemoryAddress : uint8_t {
+  kDeviceId = 0x00,
+  kMajorVersion = 0x01,
+  kName = 0x04,
+  kCommandType = 0x11,
+  kCommandIndex = 0x12,
+  kCommandParam = 0x13,
+  kCommandExecute = 0x23,
+  kState = 0x24,
+  kSpeedP = 0x26,
+  kSpeed = 0x34,
+  kPosition = 0x38,
+  kPulseCount = 0x3C,
+  kPwmDuty = 0x40,
+};
+
+enum State : uint8_t {
+  kIdle = 0,
+  kRuningWithPwmDuty = 1,
+  kRuningWithSpeed = 2,
+  kRuningToPosition = 3,
+  kReachedPosition = 4,
+};
+
+constexpr uint8_t kMotorStateOffset = 0x20;
+constexpr uint8_t kPidGainNum = 6;
+constexpr int16_t kMaxPwmDuty = 1023;
+
+// Registers hold the gains multiplied by 100: speed P, I, D, then position P, I, D.
+constexpr uint16_t kDefaultGains[kPidGainNum] = {150, 150, 100, 1000, 100, 100};
+
+// Physics runs at a fixed step so results do not depend on how often the driver touches the bus.
+constexpr uint32_t kStepUs = 1000;
+
+float Abs(const float value) {
+  return value < 0 ? -value : value;
+}
+
+float Clamp(const float value, const float limit) {
+  return value > limit ? limit : (value < -limit ? -limit : value);
+}
+
+int32_t Round(const float value) {
+  return static_cast<int32_t>(value < 0 ? value - 0.5f : value + 0.5f);
+}
+
+// One step of a discrete PID with conditional integration: the error is not accumulated while the output saturates.
+float RunPid(float &error_sum, float &last_error, const uint16_t *gains, const float error, const float limit) {
+  const float p = gains[0] / 100.0f;
+  const float i = gains[1] / 100.0f;
+  const float d = gains[2] / 100.0f;
+  const float output = p * error + i * (error_sum + error) + d * (error - last_error);
+  last_error = error;
+  if (Abs(output) < limit) {
+    error_sum += error;
+    return output;
+  }
+  return Clamp(output, limit);
+}
+}  // namespace
+
+constexpr uint8_t Md40Simulator::kMotorNum;
+
+Md40Simulator::Md40Simulator(const uint8_t i2c_address) : Device(i2c_address) {
+  registers_[kDeviceId] = kDeviceIdValue;
+  memcpy(registers_ + kMajorVersion, kVersionValue, sizeof(kVersionValue));
+  memcpy(registers_ + kName, kNameValue, sizeof(kNameValue) - 1);
+  for (uint8_t i = 0; i < kMotorNum; i++) {
+    Reset(i);
+    Latch(i);
+  }
+}
+
+void Md40Simulator::set_firmware_version(const uint8_t major, const uint8_t minor, const uint8_t patch) {
+  registers_[kMajorVersion] = major;
+  registers_[kMajorVersion + 1] = minor;
+  registers_[kMajorVersion + 2] = patch;
+}
+
+void Md40Simulator::set_fused_command_accepted(const bool accepted) {
+  fused_command_accepted_ = accepted;
+}
+
+void Md40Simulator::set_motor_model(const uint8_t index, const MotorModel &model) {
+  if (index < kMotorNum) {
+    motors_[index].model = model;
+  }
+}
+
+void Md40Simulator::set_command_latency_us(const uint32_t us) {
+  command_latency_us_ = us;
+}
+
+void Md40Simulator::set_control_period_us(const uint32_t us) {
+  control_period_us_ = us == 0 ? 1 : us;
+}
+
+void Md40Simulator::set_position_tolerance(const int32_t degrees) {
+  position_tolerance_ = degrees < 0 ? -degrees : degrees;
+}
+
+uint32_t Md40Simulator::command_count() const {
+  return command_count_;
+}
+
+float Md40Simulator::shaft_position(const uint8_t index) const {
+  return index < kMotorNum ? motors_[index].shaft_position : 0;
+}
+
+float Md40Simulator::shaft_speed(const uint8_t index) const {
+  return index < kMotorNum ? motors_[index].shaft_speed : 0;
+}
+
+void Md40Simulator::OnWrite(const uint8_t reg, const uint8_t length) {
+  Update();
+
+  const bool executes = fused_command_accepted_ ? reg <= kCommandExecute && kCommandExecute - reg < length : reg == kCommandExecute && length > 0;
+  if (executes && registers_[kCommandExecute] != 0 && !command_pending_) {
+    command_pending_ = true;
+    command_due_us_ = simulated_us_ + command_latency_us_;
+    if (command_latency_us_ == 0) {
+      Execute();
+    }
+  }
+
+  for (uint8_t i = 0; i < kMotorNum; i++) {
+    const uint16_t begin = kState + i * kMotorStateOffset;
+    if (reg < begin + kMotorStateOffset && begin < reg + length) {
+      Latch(i);
+    }
+  }
+}
+
+void Md40Simulator::OnRead(const uint8_t reg, const uint8_t length) {
+  (void)reg;
+  (void)length;
+  Update();
+}
+
+void Md40Simulator::Update() {
+  const uint32_t now = now_us();
+  while (static_cast<int32_t>(now - simulated_us_) > 0) {
+    uint32_t step = now - simulated_us_;
+    if (step > kStepUs) {
+      step = kStepUs;
+    }
+    if (control_period_us_ - control_elapsed_us_ < step) {
+      step = control_period_us_ - control_elapsed_us_;
+    }
+    if (command_pending_ && static_cast<int32_t>(command_due_us_ - simulated_us_) > 0 && command_due_us_ - simulated_us_ < step) {
+      step = command_due_us_ - simulated_us_;
+    }
+
+    const float dt = step / 1000000.0f;
+    for (Motor &motor : motors_) {
+      float factor = dt / motor.model.time_constant_s;
+      if (factor > 1 || motor.model.time_constant_s <= 0) {
+        factor = 1;
+      }
+      const float delta_degrees = motor.shaft_speed * 6 * dt;
+      motor.shaft_speed += (motor.model.no_load_rpm * motor.pwm_duty / kMaxPwmDuty - motor.shaft_speed) * factor;
+      motor.shaft_position += delta_degrees;
+      if (encoder_mode(motor)) {
+        const float sign = encoder_sign(motor);
+        motor.position += sign * delta_degrees;
+        motor.pulse_count += sign * delta_degrees / 360 * motor.reduction_ratio * motor.ppr;
+      }
+    }
+    simulated_us_ += step;
+
+    control_elapsed_us_ += step;
+    if (control_elapsed_us_ >= control_period_us_) {
+      control_elapsed_us_ = 0;
+      for (Motor &motor : motors_) {
+        Control(motor);
+      }
+    }
+
+    if (command_pending_ && static_cast<int32_t>(simulated_us_ - command_due_us_) >= 0) {
+      Execute();
+    }
+  }
+}
+
+void Md40Simulator::Execute() {
+  command_pending_ = false;
+  registers_[kCommandExecute] = 0;
+  command_count_++;
+
+  const uint8_t index = registers_[kCommandIndex];
+  if (index >= kMotorNum) {
+    return;
+  }
+
+  Motor &motor = motors_[index];
+  const uint8_t *param = registers_ + kCommandParam;
+  int32_t value = 0;
+  memcpy(&value, param, sizeof(value));
+  const uint8_t type = registers_[kCommandType];
+
+  switch (type) {
+    case kSetup:
+      memcpy(&motor.ppr, param, sizeof(motor.ppr));
+      memcpy(&motor.reduction_ratio, param + sizeof(motor.ppr), sizeof(motor.reduction_ratio));
+      motor.phase_relation = param[sizeof(motor.ppr) + sizeof(motor.reduction_ratio)];
+      break;
+    case kReset:
+      Reset(index);
+      break;
+    case kSetPosition:
+      motor.position = value;
+      break;
+    case kSetPulseCount:
+      motor.pulse_count = value;
+      break;
+    case kStop:
+      motor.mode = Mode::kIdle;
+      motor.state = kIdle;
+      motor.pwm_duty = 0;
+      break;
+    case kRunPwmDuty: {
+      int16_t pwm_duty = 0;
+      memcpy(&pwm_duty, param, sizeof(pwm_duty));
+      motor.mode = Mode::kPwmDuty;
+      motor.state = kRuningWithPwmDuty;
+      motor.pwm_duty = static_cast<int16_t>(Clamp(pwm_duty, kMaxPwmDuty));
+      break;
+    }
+    case kRunSpeed:
+      if (encoder_mode(motor)) {
+        motor.mode = Mode::kSpeed;
+        motor.state = kRuningWithSpeed;
+        motor.target_speed = value;
+      }
+      break;
+    case kMoveTo:
+    case kMove:
+      if (encoder_mode(motor)) {
+        motor.mode = Mode::kPosition;
+        motor.state = kRuningToPosition;
+        motor.target_position = type == kMove ? Round(motor.position) + value : value;
+        memcpy(&motor.target_speed, param + sizeof(value), sizeof(motor.target_speed));
+        motor.position_pid = Pid();
+      }
+      break;
+    default:
+      if (type >= kSetSpeedPidP && type <= kSetPositionPidD) {
+        const uint8_t slot = type - kSetSpeedPidP;
+        memcpy(&motor.gains[slot], param, sizeof(motor.gains[slot]));
+        memcpy(registers_ + kSpeedP + index * kMotorStateOffset + slot * sizeof(uint16_t), param, sizeof(uint16_t));
+      }
+      break;
+  }
+
+  if (motor.mode != Mode::kSpeed && motor.mode != Mode::kPosition) {
+    motor.speed_pid = Pid();
+  }
+}
+
+void Md40Simulator::Reset(const uint8_t index) {
+  Motor &motor = motors_[index];
+  motor.ppr = 0;
+  motor.reduction_ratio = 0;
+  motor.phase_relation = 0;
+  memcpy(motor.gains, kDefaultGains, sizeof(motor.gains));
+  memcpy(registers_ + kSpeedP + index * kMotorStateOffset, motor.gains, sizeof(motor.gains));
+  motor.mode = Mode::kIdle;
+  motor.state = kIdle;
+  motor.pwm_duty = 0;
+  motor.target_speed = 0;
+  motor.target_position = 0;
+  motor.speed_pid = Pid();
+  motor.position_pid = Pid();
+  motor.position = 0;
+  motor.pulse_count = 0;
+}
+
+void Md40Simulator::Control(Motor &motor) {
+  if (!encoder_mode(motor) || (motor.mode != Mode::kSpeed && motor.mode != Mode::kPosition)) {
+    return;
+  }
+
+  float target_speed = static_cast<float>(motor.target_speed);
+  if (motor.mode == Mode::kPosition) {
+    const float error = motor.target_position - motor.position;
+    if (motor.state == kRuningToPosition && Abs(error) <= position_tolerance_) {
+      motor.state = kReachedPosition;
+    }
+    target_speed = RunPid(motor.position_pid.error_sum, motor.position_pid.last_error, motor.gains + 3, error, Abs(target_speed));
+  }
+
+  const float measured_speed = encoder_sign(motor) * motor.shaft_speed;
+  motor.pwm_duty = static_cast<int16_t>(
+      Round(RunPid(motor.speed_pid.error_sum, motor.speed_pid.last_error, motor.gains, target_speed - measured_speed, kMaxPwmDuty)));
+}
+
+void Md40Simulator::Latch(const uint8_t index) {
+  const Motor &motor = motors_[index];
+  uint8_t *block = registers_ + index * kMotorStateOffset;
+  const bool encoder = encoder_mode(motor);
+  const int32_t speed = encoder ? Round(encoder_sign(motor) * motor.shaft_speed) : 0;
+  const int32_t position = encoder ? Round(motor.position) : 0;
+  const int32_t pulse_count = encoder ? Round(motor.pulse_count) : 0;
+  block[kState] = motor.state;
+  memcpy(block + kSpeed, &speed, sizeof(speed));
+  memcpy(block + kPosition, &position, sizeof(position));
+  memcpy(block + kPulseCount, &pulse_count, sizeof(pulse_count));
+  memcpy(block + kPwmDuty, &motor.pwm_duty, sizeof(motor.pwm_duty));
+}
+
+bool Md40Simulator::encoder_mode(const Motor &motor) const {
+  return motor.ppr != 0 && motor.reduction_ratio != 0;
+}
+
+float Md40Simulator::encoder_sign(const Motor &motor) const {
+  return motor.phase_relation == motor.model.phase_relation ? 1.0f : -1.0f;
+}
+}  // namespace em
+#endif
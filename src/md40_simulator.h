@@ -0,0 +1,286 @@
+#pragma once
+
+#ifndef _EM_MD40_SIMULATOR_H_
+#define _EM_MD40_SIMULATOR_H_
+
+#ifndef ARDUINO
+
+#include "md40_memory_transport.h"
+
+/**
+ * @file md40_simulator.h
+ */
+
+namespace em {
+
+/**
+ * @~Chinese
+ * @class Md40Simulator
+ * @brief 寄存器级的MD40模拟器，挂接在 @ref MemoryBus 上，用于在主机上不依赖硬件测试驱动。
+ * @details 模拟器实现了驱动使用的寄存器映射：设备信息、命令邮箱（命令在 @ref set_command_latency_us 指定的延时后执行完毕并清除执行标志），
+ * 以及每个电机的状态寄存器块（写入任意状态寄存器会锁存该电机当前的运行数据）。每个电机是一个一阶模型（空载转速和时间常数），带编码器，
+ * 板载PID按 @ref set_control_period_us 指定的周期运行，因此 RunSpeed 、 MoveTo 和 Move 会产生接近实际的轨迹和状态变化。
+ * 模型在读写时按总线的虚拟时钟推进，因此运行速度远快于实时。
+ */
+/**
+ * @~English
+ * @class Md40Simulator
+ * @brief Register-level MD40 simulator attached to a @ref MemoryBus, used to test the driver on the host without hardware.
+ * @details The simulator implements the register map the driver uses: the device information, the command mailbox (a command is executed and
+ * its execute flag cleared after the delay given by @ref set_command_latency_us), and the state register block of every motor (a write to any
+ * of its state registers latches the motor's current runtime data). Every motor is a first-order model (no-load speed and time constant) with
+ * an encoder, and the onboard PID runs at the period given by @ref set_control_period_us, so RunSpeed, MoveTo and Move produce realistic
+ * trajectories and state transitions. The model is advanced on reads and writes following the bus's virtual clock, so it runs much faster than
+ * real time.
+ */
+class Md40Simulator : public MemoryBus::Device {
+ public:
+  /**
+   * @~Chinese
+   * @brief 电机数量。
+   */
+  /**
+   * @~English
+   * @brief Number of motors.
+   */
+  static constexpr uint8_t kMotorNum = 4;
+
+  /**
+   * @~Chinese
+   * @brief 电机和编码器模型。
+   */
+  /**
+   * @~English
+   * @brief Motor and encoder model.
+   */
+  struct MotorModel {
+    /**
+     * @~Chinese
+     * @brief 满占空比时输出轴的空载转速（RPM）。
+     */
+    /**
+     * @~English
+     * @brief No-load output shaft speed at full duty (RPM).
+     */
+    float no_load_rpm = 150;
+
+    /**
+     * @~Chinese
+     * @brief 一阶时间常数（秒）。默认值是小型减速电机输出轴的典型值，使用板载的默认PID参数时运动可以稳定在目标位置。
+     */
+    /**
+     * @~English
+     * @brief First-order time constant (seconds). The default is typical of the output shaft of a small gear motor, with it a move under the
+     * onboard default PID gains comes to rest at its target.
+     */
+    float time_constant_s = 0.02f;
+
+    /**
+     * @~Chinese
+     * @brief 编码器实际接线的相位关系，0表示正转时A相领先，与 Motor::PhaseRelation 相同。设置的相位关系不一致时编码器计数方向相反。
+     */
+    /**
+     * @~English
+     * @brief Phase relation of the encoder as actually wired, 0 means phase A leads when turning forward, the same as Motor::PhaseRelation. When
+     * the configured phase relation differs, the encoder counts in the opposite direction.
+     */
+    uint8_t phase_relation = 0;
+  };
+
+  /**
+   * @~Chinese
+   * @brief 构造函数。设备ID、名称和固件版本预置为0x40、"MD40"和1.1.0，可通过 @ref registers 或 @ref set_firmware_version 修改。
+   * @param[in] i2c_address I2C地址。
+   */
+  /**
+   * @~English
+   * @brief Constructor. The device ID, name and firmware version are preset to 0x40, "MD40" and 1.1.0 and can be changed through @ref registers
+   * or @ref set_firmware_version.
+   * @param[in] i2c_address I2C address.
+   */
+  explicit Md40Simulator(const uint8_t i2c_address);
+
+  /**
+   * @~Chinese
+   * @brief 设置固件版本，只改变读出的设备信息。
+   * @param[in] major 主版本号。
+   * @param[in] minor 次版本号。
+   * @param[in] patch 修订号。
+   */
+  /**
+   * @~English
+   * @brief Set the firmware version, which only changes the device information read back.
+   * @param[in] major Major version.
+   * @param[in] minor Minor version.
+   * @param[in] patch Patch version.
+   */
+  void set_firmware_version(const uint8_t major, const uint8_t minor, const uint8_t patch);
+
+  /**
+   * @~Chinese
+   * @brief 设置是否执行与命令一起写入的执行标志，默认为true。设为false时模拟只在单独写入执行标志时才执行命令的固件，与命令一起写入的执行标志被保留但不执行。
+   * @param[in] accepted 是否执行与命令一起写入的执行标志。
+   */
+  /**
+   * @~English
+   * @brief Set whether an execute flag written together with the command is acted on, true by default. False simulates firmware that only
+   * executes a command when the execute flag is written on its own, and keeps a flag written together with the command without executing it.
+   * @param[in] accepted Whether an execute flag written together with the command is acted on.
+   */
+  void set_fused_command_accepted(const bool accepted);
+
+  /**
+   * @~Chinese
+   * @brief 设置电机模型。
+   * @param[in] index 电机索引。
+   * @param[in] model 电机模型。
+   */
+  /**
+   * @~English
+   * @brief Set the motor model.
+   * @param[in] index Motor index.
+   * @param[in] model Motor model.
+   */
+  void set_motor_model(const uint8_t index, const MotorModel &model);
+
+  /**
+   * @~Chinese
+   * @brief 设置命令从写入执行标志到执行完毕的延时，默认为200微秒。
+   * @param[in] us 微秒数。
+   */
+  /**
+   * @~English
+   * @brief Set the delay from writing a command's execute flag until it is done, 200 µs by default.
+   * @param[in] us Microseconds.
+   */
+  void set_command_latency_us(const uint32_t us);
+
+  /**
+   * @~Chinese
+   * @brief 设置板载PID的控制周期，默认为10毫秒。
+   * @param[in] us 微秒数。
+   */
+  /**
+   * @~English
+   * @brief Set the control period of the onboard PID, 10 ms by default.
+   * @param[in] us Microseconds.
+   */
+  void set_control_period_us(const uint32_t us);
+
+  /**
+   * @~Chinese
+   * @brief 设置到达目标位置的判定范围，默认为±1度。
+   * @param[in] degrees 角度(°)。
+   */
+  /**
+   * @~English
+   * @brief Set the window within which the target position counts as reached, ±1 degree by default.
+   * @param[in] degrees Degrees (°).
+   */
+  void set_position_tolerance(const int32_t degrees);
+
+  /**
+   * @~Chinese
+   * @brief 获取已执行的命令数。
+   * @return 已执行的命令数。
+   */
+  /**
+   * @~English
+   * @brief Get the number of executed commands.
+   * @return Number of executed commands.
+   */
+  uint32_t command_count() const;
+
+  /**
+   * @~Chinese
+   * @brief 获取电机输出轴的真实位置，不经过编码器和锁存，用于检查测试结果。
+   * @param[in] index 电机索引。
+   * @return 位置，单位为角度(°)。
+   */
+  /**
+   * @~English
+   * @brief Get the true position of the motor's output shaft, bypassing the encoder and the latch, used to check test results.
+   * @param[in] index Motor index.
+   * @return Position in degrees (°).
+   */
+  float shaft_position(const uint8_t index) const;
+
+  /**
+   * @~Chinese
+   * @brief 获取电机输出轴的真实转速，不经过编码器和锁存，用于检查测试结果。
+   * @param[in] index 电机索引。
+   * @return 转速（RPM）。
+   */
+  /**
+   * @~English
+   * @brief Get the true speed of the motor's output shaft, bypassing the encoder and the latch, used to check test results.
+   * @param[in] index Motor index.
+   * @return Speed (RPM).
+   */
+  float shaft_speed(const uint8_t index) const;
+
+ protected:
+  void OnWrite(const uint8_t reg, const uint8_t length) override;
+
+  void OnRead(const uint8_t reg, const uint8_t length) override;
+
+ private:
+  enum class Mode : uint8_t {
+    kIdle,
+    kPwmDuty,
+    kSpeed,
+    kPosition,
+  };
+
+  struct Pid {
+    float error_sum = 0;
+    float last_error = 0;
+  };
+
+  struct Motor {
+    MotorModel model;
+    uint16_t ppr = 0;
+    uint16_t reduction_ratio = 0;
+    uint8_t phase_relation = 0;
+    uint16_t gains[6] = {0};
+    Mode mode = Mode::kIdle;
+    uint8_t state = 0;
+    int16_t pwm_duty = 0;
+    int32_t target_speed = 0;
+    int32_t target_position = 0;
+    Pid speed_pid;
+    Pid position_pid;
+    float shaft_speed = 0;
+    float shaft_position = 0;
+    float position = 0;
+    float pulse_count = 0;
+  };
+
+  void Update();
+
+  void Execute();
+
+  void Reset(const uint8_t index);
+
+  void Control(Motor &motor);
+
+  void Latch(const uint8_t index);
+
+  bool encoder_mode(const Motor &motor) const;
+
+  float encoder_sign(const Motor &motor) const;
+
+  Motor motors_[kMotorNum];
+  uint32_t command_latency_us_ = 200;
+  bool fused_command_accepted_ = true;
+  uint32_t control_period_us_ = 10000;
+  int32_t position_tolerance_ = 1;
+  uint32_t simulated_us_ = 0;
+  uint32_t control_elapsed_us_ = 0;
+  bool command_pending_ = false;
+  uint32_t command_due_us_ = 0;
+  uint32_t command_count_ = 0;
+};
+}  // namespace em
+#endif
+#endif
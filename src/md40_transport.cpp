@@ -0,0 +1,80 @@
+/**
+ * @file md40_transport.cpp
+ */
+
+#include "md40_transport.h"
+
+#ifdef ARDUINO
+namespace em {
+
+namespace {
+constexpr uint8_t kI2cEndTransmissionSuccess = 0;
+constexpr uint8_t kI2cEndTransmissionAddressNack = 2;
+constexpr uint32_t kWireTimeoutUs = 25000;
+
+I2cResult ToI2cResult(const uint8_t end_transmission_result) {
+  switch (end_transmission_result) {
+    case kI2cEndTransmissionSuccess:
+      return I2cResult::kOk;
+    case kI2cEndTransmissionAddressNack:
+      return I2cResult::kAddressNack;
+    default:
+      return I2cResult::kError;
+  }
+}
+}  // namespace
+
+constexpr uint8_t TwoWireTransport::kBufferLength;
+
+TwoWireTransport::TwoWireTransport(TwoWire &wire) : wire_(&wire) {
+}
+
+void TwoWireTransport::Init() {
+#ifdef WIRE_HAS_TIMEOUT
+  wire_->setWireTimeout(kWireTimeoutUs, true);
+#endif
+}
+
+I2cResult TwoWireTransport::Write(const uint8_t i2c_address, const uint8_t reg, const void *data, const uint8_t length) {
+  wire_->beginTransmission(i2c_address);
+  wire_->write(reg);
+  wire_->write(static_cast<const uint8_t *>(data), length);
+  return ToI2cResult(wire_->endTransmission());
+}
+
+I2cResult TwoWireTransport::WriteRead(const uint8_t i2c_address, const uint8_t reg, void *data, const uint8_t length) {
+  wire_->beginTransmission(i2c_address);
+  wire_->write(reg);
+  const I2cResult result = ToI2cResult(wire_->endTransmission());
+  if (result != I2cResult::kOk) {
+    return result;
+  }
+  return Read(i2c_address, data, length);
+}
+
+I2cResult TwoWireTransport::Read(const uint8_t i2c_address, void *data, const uint8_t length) {
+  if (wire_->requestFrom(i2c_address, length) != length) {
+    return I2cResult::kError;
+  }
+  for (uint8_t i = 0; i < length; i++) {
+    static_cast<uint8_t *>(data)[i] = wire_->read();
+  }
+  return I2cResult::kOk;
+}
+
+uint32_t TwoWireTransport::Micros() {
+  return micros();
+}
+
+void TwoWireTransport::DelayMicroseconds(const uint32_t us) {
+  if (us >= 1000) {
+    delay(us / 1000);
+  }
+  delayMicroseconds(us % 1000);
+}
+
+void TwoWireTransport::SetClock(const uint32_t clock_hz) {
+  wire_->setClock(clock_hz);
+}
+}  // namespace em
+#endif
@@ -0,0 +1,242 @@
+#pragma once
+
+#ifndef _EM_MD40_TRANSPORT_H_
+#define _EM_MD40_TRANSPORT_H_
+
+#ifdef ARDUINO
+#include <Arduino.h>
+#include <Wire.h>
+#else
+#include <stdint.h>
+#endif
+
+/**
+ * @file md40_transport.h
+ */
+
+namespace em {
+
+/**
+ * @~Chinese
+ * @brief I2C传输结果。
+ */
+/**
+ * @~English
+ * @brief Result of an I2C transfer.
+ */
+enum class I2cResult : uint8_t {
+  /**
+   * @~Chinese
+   * @brief 传输成功。
+   */
+  /**
+   * @~English
+   * @brief The transfer succeeded.
+   */
+  kOk = 0,
+
+  /**
+   * @~Chinese
+   * @brief 设备地址未被应答，设备没有收到任何数据。
+   */
+  /**
+   * @~English
+   * @brief The device address was not acknowledged, the device did not receive any data.
+   */
+  kAddressNack = 1,
+
+  /**
+   * @~Chinese
+   * @brief 其它错误，例如数据未被应答、仲裁丢失或超时，设备可能已收到部分数据。
+   */
+  /**
+   * @~English
+   * @brief Any other error, such as a data NACK, lost arbitration or a timeout. The device may have received part of the data.
+   */
+  kError = 2,
+};
+
+/**
+ * @~Chinese
+ * @page transport_concept 传输层
+ * @ref BasicMd40 通过模板参数 Transport 访问总线，Transport 需要提供：
+ * - `static constexpr uint8_t kBufferLength`：单次读取的最大字节数。
+ * - `void Init()`：在 @ref BasicMd40::Init 开始时调用。
+ * - `I2cResult Write(uint8_t i2c_address, uint8_t reg, const void *data, uint8_t length)`：在一次传输中写入寄存器地址和数据。
+ * - `I2cResult WriteRead(uint8_t i2c_address, uint8_t reg, void *data, uint8_t length)`：写入寄存器地址，然后读取length个字节。
+ * - `I2cResult Read(uint8_t i2c_address, void *data, uint8_t length)`：从设备当前的寄存器地址读取length个字节。
+ * - `uint32_t Micros()`：单调递增的微秒时钟。
+ * - `void DelayMicroseconds(uint32_t us)`：延时指定的微秒数。
+ * - `void SetClock(uint32_t clock_hz)`：设置总线时钟频率。可选，只有 @ref BasicMd40::NegotiateBusSpeed 需要。
+ *
+ * Transport 按值保存在 @ref BasicMd40 中，因此应是一个轻量的句柄。调用都是静态绑定的，没有虚函数开销。
+ */
+/**
+ * @~English
+ * @page transport_concept Transport
+ * @ref BasicMd40 accesses the bus through its Transport template parameter, which must provide:
+ * - `static constexpr uint8_t kBufferLength`: the maximum number of bytes of one read.
+ * - `void Init()`: called at the start of @ref BasicMd40::Init.
+ * - `I2cResult Write(uint8_t i2c_address, uint8_t reg, const void *data, uint8_t length)`: write the register address and the data in one
+ *   transfer.
+ * - `I2cResult WriteRead(uint8_t i2c_address, uint8_t reg, void *data, uint8_t length)`: write the register address, then read length bytes.
+ * - `I2cResult Read(uint8_t i2c_address, void *data, uint8_t length)`: read length bytes from the device's current register address.
+ * - `uint32_t Micros()`: a monotonic microsecond clock.
+ * - `void DelayMicroseconds(uint32_t us)`: delay for the given number of microseconds.
+ * - `void SetClock(uint32_t clock_hz)`: set the bus clock rate. Optional, only @ref BasicMd40::NegotiateBusSpeed needs it.
+ *
+ * The transport is held by value in @ref BasicMd40, so it should be a lightweight handle. All calls are bound statically, there is no virtual
+ * call overhead.
+ */
+
+#ifdef ARDUINO
+/**
+ * @~Chinese
+ * @class TwoWireTransport
+ * @brief 基于Arduino TwoWire的传输层，是 @ref Md40 使用的默认传输层。
+ */
+/**
+ * @~English
+ * @class TwoWireTransport
+ * @brief Transport on top of Arduino TwoWire, the default transport used by @ref Md40.
+ */
+class TwoWireTransport {
+ public:
+  /**
+   * @~Chinese
+   * @brief TwoWire接收缓冲区的长度，即单次读取的最大字节数。
+   */
+  /**
+   * @~English
+   * @brief Length of the TwoWire receive buffer, the maximum number of bytes of one read.
+   */
+#if defined(BUFFER_LENGTH)
+  static constexpr uint8_t kBufferLength = BUFFER_LENGTH;
+#elif defined(I2C_BUFFER_LENGTH)
+  static constexpr uint8_t kBufferLength = I2C_BUFFER_LENGTH;
+#else
+  static constexpr uint8_t kBufferLength = 32;
+#endif
+
+  /**
+   * @~Chinese
+   * @brief 构造函数，可从 TwoWire 对象隐式转换，因此 `em::Md40 md40(address, Wire)` 可以直接使用。
+   * @param[in] wire TwoWire 对象引用。
+   */
+  /**
+   * @~English
+   * @brief Constructor, implicitly converting from a TwoWire object so that `em::Md40 md40(address, Wire)` keeps working.
+   * @param[in] wire TwoWire object reference.
+   */
+  TwoWireTransport(TwoWire &wire);
+
+  /**
+   * @~Chinese
+   * @brief 初始化，支持时设置25毫秒的总线超时。
+   */
+  /**
+   * @~English
+   * @brief Initialize, setting a 25 ms bus timeout where the core supports it.
+   */
+  void Init();
+
+  /**
+   * @~Chinese
+   * @brief 在一次传输中写入寄存器地址和数据。
+   * @param[in] i2c_address I2C地址。
+   * @param[in] reg 寄存器地址。
+   * @param[in] data 数据。
+   * @param[in] length 数据长度。
+   * @return 传输结果。
+   */
+  /**
+   * @~English
+   * @brief Write the register address and the data in one transfer.
+   * @param[in] i2c_address I2C address.
+   * @param[in] reg Register address.
+   * @param[in] data Data.
+   * @param[in] length Data length.
+   * @return Transfer result.
+   */
+  I2cResult Write(const uint8_t i2c_address, const uint8_t reg, const void *data, const uint8_t length);
+
+  /**
+   * @~Chinese
+   * @brief 写入寄存器地址，然后读取数据。TwoWire 需要两次传输完成。
+   * @param[in] i2c_address I2C地址。
+   * @param[in] reg 寄存器地址。
+   * @param[out] data 数据。
+   * @param[in] length 数据长度。
+   * @return 传输结果。
+   */
+  /**
+   * @~English
+   * @brief Write the register address, then read the data. TwoWire needs two transfers for this.
+   * @param[in] i2c_address I2C address.
+   * @param[in] reg Register address.
+   * @param[out] data Data.
+   * @param[in] length Data length.
+   * @return Transfer result.
+   */
+  I2cResult WriteRead(const uint8_t i2c_address, const uint8_t reg, void *data, const uint8_t length);
+
+  /**
+   * @~Chinese
+   * @brief 从设备当前的寄存器地址读取数据。
+   * @param[in] i2c_address I2C地址。
+   * @param[out] data 数据。
+   * @param[in] length 数据长度。
+   * @return 传输结果。
+   */
+  /**
+   * @~English
+   * @brief Read data from the device's current register address.
+   * @param[in] i2c_address I2C address.
+   * @param[out] data Data.
+   * @param[in] length Data length.
+   * @return Transfer result.
+   */
+  I2cResult Read(const uint8_t i2c_address, void *data, const uint8_t length);
+
+  /**
+   * @~Chinese
+   * @brief 获取微秒时钟，即 micros() 。
+   * @return 微秒数。
+   */
+  /**
+   * @~English
+   * @brief Get the microsecond clock, i.e. micros().
+   * @return Microseconds.
+   */
+  uint32_t Micros();
+
+  /**
+   * @~Chinese
+   * @brief 延时指定的微秒数，超过1毫秒的部分使用 delay() ，以便在ESP32上让出CPU。
+   * @param[in] us 微秒数。
+   */
+  /**
+   * @~English
+   * @brief Delay for the given number of microseconds, using delay() for whole milliseconds so that the CPU is yielded on ESP32.
+   * @param[in] us Microseconds.
+   */
+  void DelayMicroseconds(const uint32_t us);
+
+  /**
+   * @~Chinese
+   * @brief 设置总线时钟频率，即 TwoWire::setClock() 。总线上的其他设备也将使用该频率。
+   * @param[in] clock_hz 总线时钟频率（Hz）。
+   */
+  /**
+   * @~English
+   * @brief Set the bus clock rate, i.e. TwoWire::setClock(). Every other device on the bus runs at this rate too.
+   * @param[in] clock_hz Bus clock rate (Hz).
+   */
+  void SetClock(const uint32_t clock_hz);
+
+ private:
+  TwoWire *wire_ = nullptr;
+};
+#endif
+}  // namespace em
+#endif
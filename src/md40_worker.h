@@ -0,0 +1,716 @@
+#pragma once
+
+#ifndef _EM_MD40_WORKER_H_
+#define _EM_MD40_WORKER_H_
+
+#if defined(ARDUINO) && !defined(ARDUINO_ARCH_ESP32)
+#error "md40_worker.h needs ESP32 or a non-Arduino host"
+#endif
+
+#include "em_mpsc_queue.h"
+#include "md40.h"
+
+#ifdef ARDUINO_ARCH_ESP32
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#else
+#include <thread>
+#endif
+
+/**
+ * @file md40_worker.h
+ */
+
+namespace em {
+
+/**
+ * @~Chinese
+ * @class BasicMd40Worker
+ * @brief 后台总线工作者，让多个任务或线程安全地控制同一个 Md40 。
+ * @details Md40 没有同步机制，工作者启动后独占总线：其他任务调用 @ref RunSpeed 等函数只是把命令写入无锁多生产者队列并立即返回，
+ * 不会等待邮箱或其他任务；工作者依次把命令交给 Md40 的命令队列执行，并按固定周期读取所有电机的运行数据，以顺序锁（seqlock）发布，
+ * 任何任务都可以用 @ref ReadTelemetry 读取最新数据而不访问总线。
+ * 工作者在主机上使用 std::thread ，在ESP32上使用FreeRTOS任务；空闲时通过传输层的 DelayMicroseconds 让出CPU。
+ * 启动前可以在当前任务中完成 Init 、模式和PID等设置；启动后直到 @ref End 返回之前，只能通过工作者访问 Md40 。
+ * 命令失败时被丢弃并计入 @ref failed_command_count ，队列满时入队函数返回false并计入 @ref dropped_command_count 。
+ * @tparam Transport 传输层类型。
+ * @tparam kQueueCapacity 命令队列容量，必须是2的幂。
+ */
+/**
+ * @~English
+ * @class BasicMd40Worker
+ * @brief Background bus worker that lets several tasks or threads safely control the same Md40.
+ * @details Md40 has no synchronization. Once started the worker owns the bus: other tasks calling @ref RunSpeed and friends only write the command
+ * into a lock-free multi-producer queue and return at once, never waiting on the mailbox or on each other. The worker hands the commands to the
+ * Md40 command queue in order, reads the runtime data of all motors at a fixed period and publishes it under a seqlock, so any task can read the
+ * latest data with @ref ReadTelemetry without touching the bus. The worker runs on a std::thread on the host and on a FreeRTOS task on ESP32,
+ * and yields the CPU through the transport's DelayMicroseconds when idle. Init, modes, PID gains and other setup may be done from the current task
+ * before starting; from then on until @ref End returns the Md40 must only be reached through the worker. A failing command is dropped and counted in
+ * @ref failed_command_count, and when the queue is full the enqueue functions return false and count the command in
+ * @ref dropped_command_count.
+ * @tparam Transport Transport type.
+ * @tparam kQueueCapacity Command queue capacity, must be a power of two.
+ */
+template <typename Transport, uint32_t kQueueCapacity = 16>
+class BasicMd40Worker {
+ public:
+  /**
+   * @~Chinese
+   * @brief 驱动类型。
+   */
+  /**
+   * @~English
+   * @brief Driver type.
+   */
+  using Md40 = BasicMd40<Transport>;
+
+  /**
+   * @~Chinese
+   * @brief 状态码类型。
+   */
+  /**
+   * @~English
+   * @brief Status code type.
+   */
+  using Status = typename Md40::Status;
+
+  /**
+   * @~Chinese
+   * @brief 默认的运行数据发布周期，单位为微秒。
+   */
+  /**
+   * @~English
+   * @brief Default telemetry publishing period in microseconds.
+   */
+  static constexpr uint32_t kDefaultTelemetryPeriodUs = 10000;
+
+  /**
+   * @~Chinese
+   * @brief 工作者发布的运行数据。
+   */
+  /**
+   * @~English
+   * @brief Telemetry published by the worker.
+   */
+  struct Telemetry {
+    /**
+     * @~Chinese
+     * @brief 发布序号，每次发布加一，从1开始。
+     */
+    /**
+     * @~English
+     * @brief Publication number, incremented on every publication, starting from 1.
+     */
+    uint32_t number = 0;
+
+    /**
+     * @~Chinese
+     * @brief 开始读取的时刻，单位为微秒，取自传输层的时钟。
+     */
+    /**
+     * @~English
+     * @brief Time the read started in microseconds, from the transport's clock.
+     */
+    uint32_t timestamp_us = 0;
+
+    /**
+     * @~Chinese
+     * @brief 每个电机的运行数据。
+     */
+    /**
+     * @~English
+     * @brief Runtime data of every motor.
+     */
+    typename Md40::Motor::Snapshot snapshots[Md40::kMotorNum];
+  };
+
+  /**
+   * @~Chinese
+   * @brief 构造函数。
+   * @param[in] md40 Md40 对象引用，必须已经初始化。
+   * @param[in] telemetry_period_us 运行数据发布周期，单位为微秒，0表示不发布。
+   */
+  /**
+   * @~English
+   * @brief Constructor.
+   * @param[in] md40 Md40 object reference, must be initialized already.
+   * @param[in] telemetry_period_us Telemetry publishing period in microseconds, 0 disables publishing.
+   */
+  explicit BasicMd40Worker(Md40 &md40, const uint32_t telemetry_period_us = kDefaultTelemetryPeriodUs);
+
+  /**
+   * @~Chinese
+   * @brief 析构函数，工作者仍在运行时先调用 @ref End 。
+   */
+  /**
+   * @~English
+   * @brief Destructor, calls @ref End first when the worker is still running.
+   */
+  ~BasicMd40Worker();
+
+  /**
+   * @~Chinese
+   * @brief 启动后台线程或任务。
+   * @return 成功返回true，已在运行或创建失败时返回false。
+   */
+  /**
+   * @~English
+   * @brief Start the background thread or task.
+   * @return True on success, false when already running or the thread or task could not be created.
+   */
+  bool Begin();
+
+  /**
+   * @~Chinese
+   * @brief 停止后台线程或任务，等待其退出后返回。队列中尚未执行的命令保留，下次启动后继续执行。
+   */
+  /**
+   * @~English
+   * @brief Stop the background thread or task and return after it has exited. Commands still in the queue are kept and run after the next start.
+   */
+  void End();
+
+  /**
+   * @~Chinese
+   * @brief 执行一轮工作：把队列中的命令交给 Md40 ，推进命令执行，到期时发布运行数据。后台线程反复调用该函数；不启动后台线程时，
+   * 也可以在独占 Md40 的上下文中手动调用。
+   * @return 执行结果，参见 @ref BasicMd40::Status 。
+   */
+  /**
+   * @~English
+   * @brief Run one round of work: hand queued commands to the Md40, advance their execution and publish telemetry when due. The background thread
+   * calls this repeatedly; without it, it may also be called by hand from the context that owns the Md40.
+   * @return Execution result, see @ref BasicMd40::Status.
+   */
+  Status Step();
+
+  /**
+   * @~Chinese
+   * @brief 将停止命令放入队列，可以在任意任务中调用，参见 @ref BasicMd40::Motor::Stop 。
+   * @param[in] index 电机索引。
+   * @return 入队成功返回true，队列已满时返回false。
+   */
+  /**
+   * @~English
+   * @brief Enqueue a stop command, callable from any task, see @ref BasicMd40::Motor::Stop.
+   * @param[in] index Motor index.
+   * @return True when enqueued, false when the queue is full.
+   */
+  bool Stop(const uint8_t index);
+
+  /**
+   * @~Chinese
+   * @brief 将速度命令放入队列，可以在任意任务中调用，参见 @ref BasicMd40::Motor::RunSpeed 。
+   * @param[in] index 电机索引。
+   * @param[in] rpm 转速（RPM）。
+   * @return 入队成功返回true，队列已满时返回false。
+   */
+  /**
+   * @~English
+   * @brief Enqueue a speed command, callable from any task, see @ref BasicMd40::Motor::RunSpeed.
+   * @param[in] index Motor index.
+   * @param[in] rpm Speed (RPM).
+   * @return True when enqueued, false when the queue is full.
+   */
+  bool RunSpeed(const uint8_t index, const int32_t rpm);
+
+  /**
+   * @~Chinese
+   * @brief 将PWM占空比命令放入队列，可以在任意任务中调用，参见 @ref BasicMd40::Motor::RunPwmDuty 。
+   * @param[in] index 电机索引。
+   * @param[in] pwm_duty PWM占空比。
+   * @return 入队成功返回true，队列已满时返回false。
+   */
+  /**
+   * @~English
+   * @brief Enqueue a PWM duty command, callable from any task, see @ref BasicMd40::Motor::RunPwmDuty.
+   * @param[in] index Motor index.
+   * @param[in] pwm_duty PWM duty.
+   * @return True when enqueued, false when the queue is full.
+   */
+  bool RunPwmDuty(const uint8_t index, const int16_t pwm_duty);
+
+  /**
+   * @~Chinese
+   * @brief 将绝对位置运动命令放入队列，可以在任意任务中调用，参见 @ref BasicMd40::Motor::MoveTo 。
+   * @param[in] index 电机索引。
+   * @param[in] position 目标位置，单位为角度(°)。
+   * @param[in] speed 转速（RPM）。
+   * @return 入队成功返回true，队列已满时返回false。
+   */
+  /**
+   * @~English
+   * @brief Enqueue an absolute move command, callable from any task, see @ref BasicMd40::Motor::MoveTo.
+   * @param[in] index Motor index.
+   * @param[in] position Target position, unit degrees (°).
+   * @param[in] speed Speed (RPM).
+   * @return True when enqueued, false when the queue is full.
+   */
+  bool MoveTo(const uint8_t index, const int32_t position, const int32_t speed);
+
+  /**
+   * @~Chinese
+   * @brief 将相对位置运动命令放入队列，可以在任意任务中调用，参见 @ref BasicMd40::Motor::Move 。
+   * @param[in] index 电机索引。
+   * @param[in] offset 位移，单位为角度(°)。
+   * @param[in] speed 转速（RPM）。
+   * @return 入队成功返回true，队列已满时返回false。
+   */
+  /**
+   * @~English
+   * @brief Enqueue a relative move command, callable from any task, see @ref BasicMd40::Motor::Move.
+   * @param[in] index Motor index.
+   * @param[in] offset Offset, unit degrees (°).
+   * @param[in] speed Speed (RPM).
+   * @return True when enqueued, false when the queue is full.
+   */
+  bool Move(const uint8_t index, const int32_t offset, const int32_t speed);
+
+  /**
+   * @~Chinese
+   * @brief 将设定位置值的命令放入队列，可以在任意任务中调用，参见 @ref BasicMd40::Motor::set_position 。
+   * @param[in] index 电机索引。
+   * @param[in] position 位置设定值，单位为角度(°)。
+   * @return 入队成功返回true，队列已满时返回false。
+   */
+  /**
+   * @~English
+   * @brief Enqueue a command setting the position value, callable from any task, see @ref BasicMd40::Motor::set_position.
+   * @param[in] index Motor index.
+   * @param[in] position Position setting value, unit degrees (°).
+   * @return True when enqueued, false when the queue is full.
+   */
+  bool SetPosition(const uint8_t index, const int32_t position);
+
+  /**
+   * @~Chinese
+   * @brief 将设定脉冲计数的命令放入队列，可以在任意任务中调用，参见 @ref BasicMd40::Motor::set_pulse_count 。
+   * @param[in] index 电机索引。
+   * @param[in] pulse_count 编码器脉冲数。
+   * @return 入队成功返回true，队列已满时返回false。
+   */
+  /**
+   * @~English
+   * @brief Enqueue a command setting the pulse count, callable from any task, see @ref BasicMd40::Motor::set_pulse_count.
+   * @param[in] index Motor index.
+   * @param[in] pulse_count Encoder pulse count.
+   * @return True when enqueued, false when the queue is full.
+   */
+  bool SetPulseCount(const uint8_t index, const int32_t pulse_count);
+
+  /**
+   * @~Chinese
+   * @brief 读取最新发布的运行数据，可以在任意任务中调用，不访问总线。
+   * @details 读取与发布同时发生时会重试，因此不会读到一半新一半旧的数据。等待发布完成时会让出CPU（ESP32上延时一个tick），
+   * 因此优先级高于工作者的任务也可以调用。
+   * @param[out] telemetry 运行数据。
+   * @return 已有数据发布时返回true，否则返回false且不修改 telemetry 。
+   */
+  /**
+   * @~English
+   * @brief Read the most recently published telemetry, callable from any task without touching the bus.
+   * @details A read overlapping a publication is retried, so it never returns half new and half old data. While a publication is in progress
+   * the reader gives up the CPU (for one tick on ESP32), so tasks of higher priority than the worker may call it too.
+   * @param[out] telemetry Telemetry.
+   * @return True when data has been published, otherwise false and telemetry is left unchanged.
+   */
+  bool ReadTelemetry(Telemetry &telemetry) const;
+
+  /**
+   * @~Chinese
+   * @brief 获取因队列已满而未能入队的命令数。
+   * @return 命令数。
+   */
+  /**
+   * @~English
+   * @brief Get the number of commands that could not be enqueued because the queue was full.
+   * @return Number of commands.
+   */
+  uint32_t dropped_command_count() const;
+
+  /**
+   * @~Chinese
+   * @brief 获取执行失败而被丢弃的命令数。
+   * @return 命令数。
+   */
+  /**
+   * @~English
+   * @brief Get the number of commands dropped because their execution failed.
+   * @return Number of commands.
+   */
+  uint32_t failed_command_count() const;
+
+  /**
+   * @~Chinese
+   * @brief 获取最近一次失败的状态码，可以在任意任务中调用。
+   * @return 状态码，没有失败过时返回 @ref BasicMd40::Status::kOk 。
+   */
+  /**
+   * @~English
+   * @brief Get the status code of the most recent failure, callable from any task.
+   * @return Status code, @ref BasicMd40::Status::kOk when nothing has failed.
+   */
+  Status last_error() const;
+
+ private:
+  static constexpr uint32_t kIdleIntervalUs = 1000;
+
+#ifdef ARDUINO_ARCH_ESP32
+  static constexpr uint32_t kTaskStackSize = 4096;
+  static constexpr UBaseType_t kTaskPriority = 1;
+#endif
+
+  static constexpr uint8_t kAllFields[Md40::kMotorNum] = {
+      Md40::ReadPlan::kFieldAll, Md40::ReadPlan::kFieldAll, Md40::ReadPlan::kFieldAll, Md40::ReadPlan::kFieldAll};
+
+  static constexpr uint32_t kTelemetryWordNum = (sizeof(Telemetry) + sizeof(uint32_t) - 1) / sizeof(uint32_t);
+
+  enum class CommandType : uint8_t {
+    kStop,
+    kRunSpeed,
+    kRunPwmDuty,
+    kMoveTo,
+    kMove,
+    kPosition,
+    kPulseCount,
+  };
+
+  struct Command {
+    CommandType type = CommandType::kStop;
+    uint8_t index = 0;
+    int32_t value = 0;
+    int32_t speed = 0;
+  };
+
+  BasicMd40Worker(const BasicMd40Worker &) = delete;
+  BasicMd40Worker &operator=(const BasicMd40Worker &) = delete;
+
+  bool Enqueue(const CommandType type, const uint8_t index, const int32_t value, const int32_t speed);
+
+  void Submit(const Command &command);
+
+  void Fail(const Status status, const uint32_t count);
+
+  void Publish(Telemetry &telemetry);
+
+  void Run();
+
+#ifdef ARDUINO_ARCH_ESP32
+  static void TaskEntry(void *worker);
+#endif
+
+  Md40 &md40_;
+  typename Md40::ReadPlan plan_;
+  const uint32_t telemetry_period_us_ = 0;
+  MpscQueue<Command, kQueueCapacity> commands_;
+  bool progressed_ = false;
+  uint32_t next_telemetry_us_ = 0;
+  uint32_t telemetry_sequence_ = 0;
+  uint32_t telemetry_words_[kTelemetryWordNum] = {0};
+  uint32_t dropped_command_count_ = 0;
+  uint32_t failed_command_count_ = 0;
+  uint8_t last_error_ = 0;
+  bool running_ = false;
+#ifdef ARDUINO_ARCH_ESP32
+  TaskHandle_t task_ = nullptr;
+  bool task_exited_ = true;
+#else
+  std::thread thread_;
+#endif
+};
+
+template <typename Transport, uint32_t kQueueCapacity>
+constexpr uint32_t BasicMd40Worker<Transport, kQueueCapacity>::kDefaultTelemetryPeriodUs;
+
+template <typename Transport, uint32_t kQueueCapacity>
+constexpr uint32_t BasicMd40Worker<Transport, kQueueCapacity>::kIdleIntervalUs;
+
+template <typename Transport, uint32_t kQueueCapacity>
+constexpr uint8_t BasicMd40Worker<Transport, kQueueCapacity>::kAllFields[];
+
+template <typename Transport, uint32_t kQueueCapacity>
+BasicMd40Worker<Transport, kQueueCapacity>::BasicMd40Worker(Md40 &md40, const uint32_t telemetry_period_us)
+    : md40_(md40), plan_(md40, kAllFields), telemetry_period_us_(telemetry_period_us) {
+}
+
+template <typename Transport, uint32_t kQueueCapacity>
+BasicMd40Worker<Transport, kQueueCapacity>::~BasicMd40Worker() {
+  End();
+}
+
+#ifdef ARDUINO_ARCH_ESP32
+template <typename Transport, uint32_t kQueueCapacity>
+bool BasicMd40Worker<Transport, kQueueCapacity>::Begin() {
+  if (running_) {
+    return false;
+  }
+
+  __atomic_store_n(&running_, true, __ATOMIC_RELAXED);
+  __atomic_store_n(&task_exited_, false, __ATOMIC_RELAXED);
+  if (xTaskCreate(TaskEntry, "md40_worker", kTaskStackSize, this, kTaskPriority, &task_) != pdPASS) {
+    running_ = false;
+    task_exited_ = true;
+    return false;
+  }
+  return true;
+}
+
+template <typename Transport, uint32_t kQueueCapacity>
+void BasicMd40Worker<Transport, kQueueCapacity>::End() {
+  if (!running_) {
+    return;
+  }
+
+  __atomic_store_n(&running_, false, __ATOMIC_RELAXED);
+  while (!__atomic_load_n(&task_exited_, __ATOMIC_ACQUIRE)) {
+    vTaskDelay(1);
+  }
+  task_ = nullptr;
+}
+
+template <typename Transport, uint32_t kQueueCapacity>
+void BasicMd40Worker<Transport, kQueueCapacity>::TaskEntry(void *worker) {
+  BasicMd40Worker *const self = static_cast<BasicMd40Worker *>(worker);
+  self->Run();
+  __atomic_store_n(&self->task_exited_, true, __ATOMIC_RELEASE);
+  vTaskDelete(nullptr);
+}
+#else
+template <typename Transport, uint32_t kQueueCapacity>
+bool BasicMd40Worker<Transport, kQueueCapacity>::Begin() {
+  if (running_) {
+    return false;
+  }
+
+  __atomic_store_n(&running_, true, __ATOMIC_RELAXED);
+  thread_ = std::thread(&BasicMd40Worker::Run, this);
+  return true;
+}
+
+template <typename Transport, uint32_t kQueueCapacity>
+void BasicMd40Worker<Transport, kQueueCapacity>::End() {
+  if (!running_) {
+    return;
+  }
+
+  __atomic_store_n(&running_, false, __ATOMIC_RELAXED);
+  thread_.join();
+}
+#endif
+
+template <typename Transport, uint32_t kQueueCapacity>
+void BasicMd40Worker<Transport, kQueueCapacity>::Run() {
+  while (__atomic_load_n(&running_, __ATOMIC_RELAXED)) {
+    Step();
+    if (!progressed_) {
+      // Poll a command in flight at the wait policy's interval, otherwise just keep an eye on the queue and the telemetry deadline.
+      md40_.transport_.DelayMicroseconds(md40_.command_num_ > 0 ? md40_.wait_policy_.interval_us : kIdleIntervalUs);
+    }
+  }
+}
+
+template <typename Transport, uint32_t kQueueCapacity>
+typename BasicMd40Worker<Transport, kQueueCapacity>::Status BasicMd40Worker<Transport, kQueueCapacity>::Step() {
+  progressed_ = false;
+
+  Command command;
+  while (md40_.command_num_ < Md40::kCommandQueueSize && commands_.Pop(command)) {
+    Submit(command);
+    progressed_ = true;
+  }
+
+  bool progressed = false;
+  const uint16_t head_sequence = md40_.finished_sequence_ + 1;
+  Status status = md40_.Step(progressed);
+  progressed_ = progressed_ || progressed;
+  if (status != Status::kOk) {
+    // Drop only the command at the head of the queue, the ones behind it belong to other callers and still get their turn. The head is taken
+    // before the step, which may already have dropped it after a failed fused write.
+    md40_.Abandon(head_sequence);
+    Fail(status, 1);
+  }
+
+  const uint32_t now = md40_.transport_.Micros();
+  if (telemetry_period_us_ > 0 && (telemetry_sequence_ == 0 || static_cast<int32_t>(now - next_telemetry_us_) >= 0)) {
+    next_telemetry_us_ = now + telemetry_period_us_;
+    progressed_ = true;
+
+    Telemetry telemetry;
+    telemetry.timestamp_us = now;
+    const Status read_status = plan_.Execute(telemetry.snapshots);
+    if (read_status == Status::kOk) {
+      Publish(telemetry);
+    } else {
+      Fail(read_status, 0);
+      status = read_status;
+    }
+  }
+  return status;
+}
+
+template <typename Transport, uint32_t kQueueCapacity>
+bool BasicMd40Worker<Transport, kQueueCapacity>::Stop(const uint8_t index) {
+  return Enqueue(CommandType::kStop, index, 0, 0);
+}
+
+template <typename Transport, uint32_t kQueueCapacity>
+bool BasicMd40Worker<Transport, kQueueCapacity>::RunSpeed(const uint8_t index, const int32_t rpm) {
+  return Enqueue(CommandType::kRunSpeed, index, rpm, 0);
+}
+
+template <typename Transport, uint32_t kQueueCapacity>
+bool BasicMd40Worker<Transport, kQueueCapacity>::RunPwmDuty(const uint8_t index, const int16_t pwm_duty) {
+  return Enqueue(CommandType::kRunPwmDuty, index, pwm_duty, 0);
+}
+
+template <typename Transport, uint32_t kQueueCapacity>
+bool BasicMd40Worker<Transport, kQueueCapacity>::MoveTo(const uint8_t index, const int32_t position, const int32_t speed) {
+  return Enqueue(CommandType::kMoveTo, index, position, speed);
+}
+
+template <typename Transport, uint32_t kQueueCapacity>
+bool BasicMd40Worker<Transport, kQueueCapacity>::Move(const uint8_t index, const int32_t offset, const int32_t speed) {
+  return Enqueue(CommandType::kMove, index, offset, speed);
+}
+
+template <typename Transport, uint32_t kQueueCapacity>
+bool BasicMd40Worker<Transport, kQueueCapacity>::SetPosition(const uint8_t index, const int32_t position) {
+  return Enqueue(CommandType::kPosition, index, position, 0);
+}
+
+template <typename Transport, uint32_t kQueueCapacity>
+bool BasicMd40Worker<Transport, kQueueCapacity>::SetPulseCount(const uint8_t index, const int32_t pulse_count) {
+  return Enqueue(CommandType::kPulseCount, index, pulse_count, 0);
+}
+
+template <typename Transport, uint32_t kQueueCapacity>
+bool BasicMd40Worker<Transport, kQueueCapacity>::ReadTelemetry(Telemetry &telemetry) const {
+  uint32_t words[kTelemetryWordNum];
+  while (true) {
+    const uint32_t sequence = __atomic_load_n(&telemetry_sequence_, __ATOMIC_ACQUIRE);
+    if (sequence == 0) {
+      return false;
+    }
+
+    if (sequence & 1) {
+      // The worker is in the middle of publishing. A reader of higher priority on the same core would spin forever without letting it finish.
+#ifdef ARDUINO_ARCH_ESP32
+      vTaskDelay(1);
+#else
+      std::this_thread::yield();
+#endif
+      continue;
+    }
+
+    for (uint32_t i = 0; i < kTelemetryWordNum; i++) {
+      words[i] = __atomic_load_n(&telemetry_words_[i], __ATOMIC_RELAXED);
+    }
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    if (__atomic_load_n(&telemetry_sequence_, __ATOMIC_RELAXED) == sequence) {
+      memcpy(&telemetry, words, sizeof(telemetry));
+      return true;
+    }
+  }
+}
+
+template <typename Transport, uint32_t kQueueCapacity>
+uint32_t BasicMd40Worker<Transport, kQueueCapacity>::dropped_command_count() const {
+  return __atomic_load_n(&dropped_command_count_, __ATOMIC_RELAXED);
+}
+
+template <typename Transport, uint32_t kQueueCapacity>
+uint32_t BasicMd40Worker<Transport, kQueueCapacity>::failed_command_count() const {
+  return __atomic_load_n(&failed_command_count_, __ATOMIC_RELAXED);
+}
+
+template <typename Transport, uint32_t kQueueCapacity>
+typename BasicMd40Worker<Transport, kQueueCapacity>::Status BasicMd40Worker<Transport, kQueueCapacity>::last_error() const {
+  return static_cast<Status>(__atomic_load_n(&last_error_, __ATOMIC_RELAXED));
+}
+
+template <typename Transport, uint32_t kQueueCapacity>
+bool BasicMd40Worker<Transport, kQueueCapacity>::Enqueue(const CommandType type, const uint8_t index, const int32_t value, const int32_t speed) {
+  EM_CHECK_LT(index, Md40::kMotorNum);
+
+  Command command;
+  command.type = type;
+  command.index = index;
+  command.value = value;
+  command.speed = speed;
+  if (!commands_.Push(command)) {
+    __atomic_fetch_add(&dropped_command_count_, 1, __ATOMIC_RELAXED);
+    return false;
+  }
+  return true;
+}
+
+template <typename Transport, uint32_t kQueueCapacity>
+void BasicMd40Worker<Transport, kQueueCapacity>::Submit(const Command &command) {
+  auto &motor = md40_[command.index];
+  switch (command.type) {
+    case CommandType::kStop:
+      motor.SubmitStop();
+      break;
+    case CommandType::kRunSpeed:
+      motor.SubmitRunSpeed(command.value);
+      break;
+    case CommandType::kRunPwmDuty:
+      motor.SubmitRunPwmDuty(static_cast<int16_t>(command.value));
+      break;
+    case CommandType::kMoveTo:
+      motor.SubmitMoveTo(command.value, command.speed);
+      break;
+    case CommandType::kMove:
+      motor.SubmitMove(command.value, command.speed);
+      break;
+    case CommandType::kPosition:
+      motor.SubmitPosition(command.value);
+      break;
+    case CommandType::kPulseCount:
+      motor.SubmitPulseCount(command.value);
+      break;
+    default:
+      break;
+  }
+}
+
+template <typename Transport, uint32_t kQueueCapacity>
+void BasicMd40Worker<Transport, kQueueCapacity>::Fail(const Status status, const uint32_t count) {
+  __atomic_fetch_add(&failed_command_count_, count, __ATOMIC_RELAXED);
+  __atomic_store_n(&last_error_, static_cast<uint8_t>(status), __ATOMIC_RELAXED);
+}
+
+template <typename Transport, uint32_t kQueueCapacity>
+void BasicMd40Worker<Transport, kQueueCapacity>::Publish(Telemetry &telemetry) {
+  // Seqlock: the sequence is odd while the words are being rewritten, readers retry until they see the same even value on both sides of
+  // their copy. Only the worker writes, so the sequence itself needs no read-modify-write.
+  const uint32_t sequence = telemetry_sequence_;
+  telemetry.number = sequence / 2 + 1;
+
+  uint32_t words[kTelemetryWordNum] = {0};
+  memcpy(words, &telemetry, sizeof(telemetry));
+
+  __atomic_store_n(&telemetry_sequence_, sequence + 1, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+  for (uint32_t i = 0; i < kTelemetryWordNum; i++) {
+    __atomic_store_n(&telemetry_words_[i], words[i], __ATOMIC_RELAXED);
+  }
+  __atomic_store_n(&telemetry_sequence_, sequence + 2, __ATOMIC_RELEASE);
+}
+
+#ifdef ARDUINO_ARCH_ESP32
+/**
+ * @~Chinese
+ * @brief 使用 TwoWire 的后台总线工作者。
+ * @tparam kQueueCapacity 命令队列容量，必须是2的幂。
+ */
+/**
+ * @~English
+ * @brief Background bus worker using TwoWire.
+ * @tparam kQueueCapacity Command queue capacity, must be a power of two.
+ */
+template <uint32_t kQueueCapacity = 16>
+using Md40Worker = BasicMd40Worker<TwoWireTransport, kQueueCapacity>;
+#endif
+}  // namespace em
+#endif